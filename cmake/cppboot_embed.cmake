@@ -0,0 +1,57 @@
+# cppboot_embed_files(<target> <name> BASE_DIR <dir> [COMPRESS]
+#                     FILES <file>...)
+#
+# Compile files, relative to the current source directory, into <target>,
+# e.g. templates or static assets for production builds. Generates <name>.h
+# and <name>.cc declaring cppboot::embedded::<name>(), which returns the
+# files as cppboot::EmbeddedFiles named by their path relative to BASE_DIR,
+# indexed by a perfect hash and with ETags computed from their contents.
+# The sources are regenerated when a file changes.
+#
+# With COMPRESS, text files also get a gzip variant where it is smaller.
+# Listed ".gz" and ".br" siblings of a file, e.g. made by a bundler, become
+# its variants instead of files of their own.
+#
+# Needs CMake 3.19, older versions only build the rest of the project:
+# callers check CMAKE_VERSION first.
+
+set(CPPBOOT_EMBED_SCRIPT ${CMAKE_CURRENT_LIST_DIR}/embed_files.cmake)
+
+function(cppboot_embed_files target name)
+    if(CMAKE_VERSION VERSION_LESS 3.19)
+        message(FATAL_ERROR "cppboot_embed_files() needs CMake 3.19")
+    endif()
+    cmake_parse_arguments(EMBED "COMPRESS" "BASE_DIR" "FILES" ${ARGN})
+    if(NOT EMBED_BASE_DIR)
+        set(EMBED_BASE_DIR ${CMAKE_CURRENT_SOURCE_DIR})
+    endif()
+    get_filename_component(base_dir ${EMBED_BASE_DIR} ABSOLUTE)
+
+    set(files)
+    foreach(file ${EMBED_FILES})
+        get_filename_component(path ${file} ABSOLUTE)
+        list(APPEND files ${path})
+    endforeach()
+
+    set(out_dir ${CMAKE_CURRENT_BINARY_DIR}/cppboot_embed)
+    set(header ${out_dir}/${name}.h)
+    set(source ${out_dir}/${name}.cc)
+    string(REPLACE ";" "|" file_list "${files}")
+    add_custom_command(
+        OUTPUT ${header} ${source}
+        COMMAND ${CMAKE_COMMAND}
+            -DNAME=${name}
+            -DBASE_DIR=${base_dir}
+            "-DFILES=${file_list}"
+            -DCOMPRESS=${EMBED_COMPRESS}
+            -DWORK_DIR=${out_dir}/${name}.d
+            -DHEADER=${header}
+            -DSOURCE=${source}
+            -P ${CPPBOOT_EMBED_SCRIPT}
+        DEPENDS ${files} ${CPPBOOT_EMBED_SCRIPT}
+        COMMENT "Embedding ${name}"
+        VERBATIM
+    )
+    target_sources(${target} PRIVATE ${source} ${header})
+    target_include_directories(${target} PRIVATE ${out_dir})
+endfunction()
@@ -0,0 +1,244 @@
+# Run by cppboot_embed_files(): writes HEADER and SOURCE holding FILES, a
+# "|" separated list, named relative to BASE_DIR. With COMPRESS, text files
+# get a gzip variant, compressed in WORK_DIR.
+
+# string(HEX) and file(ARCHIVE_CREATE ... COMPRESSION_LEVEL).
+cmake_minimum_required(VERSION 3.19)
+
+string(REPLACE "|" ";" files "${FILES}")
+
+# ".gz" and ".br" siblings of a listed file are its variants, not entries.
+set(entries)
+foreach(path ${files})
+    file(RELATIVE_PATH rel ${BASE_DIR} ${path})
+    if(path MATCHES "^(.*)\\.(gz|br)$" AND CMAKE_MATCH_1 IN_LIST files)
+        set(sibling_${CMAKE_MATCH_2}_${CMAKE_MATCH_1} ${path})
+        continue()
+    endif()
+    list(APPEND entries "${rel}|${path}")
+endforeach()
+# Sorted, so that EmbeddedFiles can be iterated in order.
+list(SORT entries)
+list(LENGTH entries count)
+
+set(guard "CPPBOOT_EMBEDDED_${NAME}_H_")
+string(TOUPPER ${guard} guard)
+file(WRITE ${HEADER}
+"// Generated by cppboot_embed_files(), do not edit.
+#ifndef ${guard}
+#define ${guard}
+
+#include \"cppboot/base/embed.h\"
+
+namespace cppboot {
+namespace embedded {
+
+EmbeddedFiles ${NAME}();
+
+}  // namespace embedded
+}  // namespace cppboot
+
+#endif  // ${guard}
+")
+
+# CMake regexes have no counted repetition.
+set(line)
+foreach(n RANGE 1 16)
+    string(APPEND line "0x..,")
+endforeach()
+
+# Append the array `var` holding the bytes `hex` to `arrays`, and set `view`
+# to a string_view of it.
+macro(embed_array var hex)
+    string(LENGTH "${hex}" _length)
+    math(EXPR _size "${_length} / 2")
+    # 16 bytes a line, a terminating zero for files read as C strings.
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," _bytes "${hex}")
+    string(REGEX REPLACE "(${line})" "\\1\n    " _bytes "${_bytes}")
+    string(APPEND arrays
+        "constexpr unsigned char ${var}[] = {\n    ${_bytes}0};\n\n")
+    set(view "string_view(Chars(${var}), ${_size})")
+endmacro()
+
+# Set `var` to the hash of the name with `bytes`, as EmbeddedFiles::Hash().
+macro(embed_hash var seed bytes)
+    set(${var} ${seed})
+    foreach(_byte ${bytes})
+        math(EXPR ${var} "((${${var}} ^ ${_byte}) * 16777619) & 0xffffffff")
+    endforeach()
+    math(EXPR ${var} "${${var}} ^ (${${var}} >> 16)")
+endmacro()
+
+set(compressible "\\.(html|htm|css|js|json|svg|txt|xml)$")
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+set(arrays)
+set(table)
+set(i 0)
+foreach(entry ${entries})
+    string(REPLACE "|" ";" parts "${entry}")
+    list(GET parts 0 rel)
+    list(GET parts 1 path)
+
+    string(APPEND arrays "// ${rel}\n")
+    file(READ ${path} hex HEX)
+    embed_array(kFile${i} "${hex}")
+    set(data ${view})
+    string(LENGTH "${hex}" plain_length)
+
+    file(SHA1 ${path} sha1)
+    string(SUBSTRING ${sha1} 0 16 etag)
+
+    set(gzip "string_view()")
+    set(gz_path)
+    if(DEFINED sibling_gz_${path})
+        set(gz_path ${sibling_gz_${path}})
+    elseif(COMPRESS AND rel MATCHES "${compressible}")
+        set(gz_path ${WORK_DIR}/${i}.gz)
+        file(ARCHIVE_CREATE OUTPUT ${gz_path} PATHS ${path}
+             FORMAT raw COMPRESSION GZip COMPRESSION_LEVEL 9)
+    endif()
+    if(gz_path)
+        file(READ ${gz_path} hex HEX)
+        string(LENGTH "${hex}" gz_length)
+        if(NOT DEFINED sibling_gz_${path})
+            # No timestamp in the header, so that builds are reproducible.
+            string(SUBSTRING "${hex}" 0 8 head)
+            string(SUBSTRING "${hex}" 16 -1 tail)
+            set(hex "${head}00000000${tail}")
+        endif()
+        if(gz_length LESS plain_length OR DEFINED sibling_gz_${path})
+            embed_array(kGzip${i} "${hex}")
+            set(gzip ${view})
+        endif()
+    endif()
+
+    set(brotli "string_view()")
+    if(DEFINED sibling_br_${path})
+        file(READ ${sibling_br_${path}} hex HEX)
+        embed_array(kBrotli${i} "${hex}")
+        set(brotli ${view})
+    endif()
+
+    string(APPEND table "      {\"${rel}\", ${data}, \"\\\"${etag}\\\"\",\n"
+                        "       ${gzip},\n"
+                        "       ${brotli}},\n")
+
+    # The bytes of the name, for the index.
+    string(HEX "${rel}" hex)
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1;" bytes "${hex}")
+    set(name_bytes_${i})
+    foreach(byte ${bytes})
+        math(EXPR byte "${byte}")
+        list(APPEND name_bytes_${i} ${byte})
+    endforeach()
+    math(EXPR i "${i} + 1")
+endforeach()
+
+# The perfect hash, by hash-and-displace: names are put into buckets by their
+# hash, then the buckets, largest first, get the first seed hashing their
+# names to free slots. Buckets of one name take a free slot directly.
+set(seeds)
+set(slots)
+if(count GREATER 0)
+    math(EXPR last "${count} - 1")
+    set(max_bucket 0)
+    foreach(i RANGE ${last})
+        set(seed_${i} 0)
+        set(slot_${i} -1)
+    endforeach()
+    foreach(i RANGE ${last})
+        embed_hash(h 2166136261 "${name_bytes_${i}}")
+        math(EXPR b "${h} % ${count}")
+        list(APPEND bucket_${b} ${i})
+        list(LENGTH bucket_${b} n)
+        if(n GREATER max_bucket)
+            set(max_bucket ${n})
+        endif()
+    endforeach()
+
+    set(size ${max_bucket})
+    while(size GREATER 1)
+        foreach(b RANGE ${last})
+            list(LENGTH bucket_${b} n)
+            if(NOT n EQUAL size)
+                continue()
+            endif()
+            set(seed 1)
+            while(TRUE)
+                set(taken)
+                foreach(i ${bucket_${b}})
+                    embed_hash(h ${seed} "${name_bytes_${i}}")
+                    math(EXPR s "${h} % ${count}")
+                    if(NOT slot_${s} EQUAL -1 OR s IN_LIST taken)
+                        break()
+                    endif()
+                    list(APPEND taken ${s})
+                endforeach()
+                list(LENGTH taken n)
+                if(n EQUAL size)
+                    break()
+                endif()
+                math(EXPR seed "${seed} + 1")
+                if(seed GREATER 1000000)
+                    message(FATAL_ERROR "No perfect hash for ${NAME}")
+                endif()
+            endwhile()
+            set(seed_${b} ${seed})
+            foreach(i s IN ZIP_LISTS bucket_${b} taken)
+                set(slot_${s} ${i})
+            endforeach()
+        endforeach()
+        math(EXPR size "${size} - 1")
+    endwhile()
+
+    set(free 0)
+    foreach(b RANGE ${last})
+        list(LENGTH bucket_${b} n)
+        if(NOT n EQUAL 1)
+            continue()
+        endif()
+        while(NOT slot_${free} EQUAL -1)
+            math(EXPR free "${free} + 1")
+        endwhile()
+        set(slot_${free} ${bucket_${b}})
+        math(EXPR seed_${b} "-${free} - 1")
+    endforeach()
+
+    foreach(i RANGE ${last})
+        string(APPEND seeds "${seed_${i}}, ")
+        string(APPEND slots "${slot_${i}}, ")
+    endforeach()
+endif()
+
+file(WRITE ${SOURCE}
+"// Generated by cppboot_embed_files(), do not edit.
+#include \"${NAME}.h\"
+
+namespace cppboot {
+namespace embedded {
+
+namespace {
+
+const char* Chars(const unsigned char* data) {
+  return reinterpret_cast<const char*>(data);
+}
+
+${arrays}constexpr int32_t kSeeds[] = {${seeds}0};
+constexpr uint32_t kSlots[] = {${slots}0};
+
+}  // namespace
+
+EmbeddedFiles ${NAME}() {
+  // Built on first use, so that it may be used during static
+  // initialization.
+  static const EmbeddedFile kFiles[] = {
+${table}      {},
+  };
+  return EmbeddedFiles(kFiles, sizeof(kFiles) / sizeof(kFiles[0]) - 1,
+                       kSeeds, kSlots);
+}
+
+}  // namespace embedded
+}  // namespace cppboot
+")
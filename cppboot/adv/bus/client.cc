@@ -35,6 +35,10 @@ void BusClient::Start() {
   ReportMyServiceToServer();  // ???
 }
 
+void BusClient::set_json_only(bool b) {
+  static_cast<BusContext*>(transport_->context())->set_json_only(b);
+}
+
 void BusClient::Stop() {
   // invoker_.SayGoodbyToSever();
   transport_->Stop();
@@ -105,6 +109,9 @@ void BusClient::HandleRequestMessage(const MsgPtr& msg) {
 void BusClient::ReportMyServiceToServer() {
   In in;
   in.set("ServiceName", service_->name());
+  // Packers this client reads, the server picks one for its replies.
+  auto ctx = static_cast<BusContext*>(transport_->context());
+  in.set("Packers", ctx->json_only() ? "json" : "binary,json");
   invoker_->Call("RegisterService", in, NULL);
 }
 
@@ -27,6 +27,15 @@ class BusClient {
 
   void Start();
 
+  /// Send JSON frames only, for debugging. Call before Start(), otherwise
+  /// the client registers with the binary packer and the server switches to
+  /// it.
+  ///
+  /// The negotiation is one-way: the client sends JSON until it receives a
+  /// binary frame, so it keeps sending JSON to a server that does not use
+  /// the binary packer itself, e.g. one with BusServer::set_json_only().
+  void set_json_only(bool b);
+
   // 主动执行关闭，会传递到Transport的Close
   void Stop();
 
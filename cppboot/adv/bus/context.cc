@@ -5,7 +5,22 @@
 
 namespace cppboot {
 
-BusContext::BusContext() : state_(kHeader) {}
+BusContext::BusContext()
+    : state_(kHeader),
+      packer_(MsgPacker::Find(kMsgMagic)),
+      json_only_(false) {}
+
+void BusContext::set_json_only(bool b) {
+  json_only_ = b;
+  if (b) packer_ = MsgPacker::Find(kMsgMagic);
+}
+
+void BusContext::UseBinary() {
+  if (json_only_) return;
+  packer_ = MsgPacker::Find(kBinaryMsgMagic);
+  // set_json_only() wins when called meanwhile from another thread.
+  if (json_only_) packer_ = MsgPacker::Find(kMsgMagic);
+}
 
 BusContext::Result BusContext::Parse(Buffer* buf, Msg* msg) {
   if (state_ == kHeader) {
@@ -17,7 +32,7 @@ BusContext::Result BusContext::Parse(Buffer* buf, Msg* msg) {
     buf->Retrive(sizeof(header_));
     state_ = kBody;
 
-    if (header_.magic != kMsgMagic) {
+    if (!MsgPacker::Find(header_.magic)) {
       return kBad;
     }
   }
@@ -27,19 +42,21 @@ BusContext::Result BusContext::Parse(Buffer* buf, Msg* msg) {
       return kContinue;
     }
 
-    // TODO: 性能优化
-    std::string body(buf->Peek(), header_.length);
+    // Unpacked in place, the buffer is only consumed afterwards.
+    string_view body(buf->Peek(), header_.length);
+    MsgPacker* packer = MsgPacker::Find(header_.magic);
+    auto st = packer->Unpack(body, msg);
     buf->Retrive(header_.length);
     state_ = kHeader;
 
-    JsonPacker p;
-
-    auto st = p.Unpack(body, msg);
     if (!st) {
       return kBad;
     }
+    if (header_.magic == kBinaryMsgMagic) {
+      UseBinary();
+    }
   }
   return kGood;
 }
 
-}  // namespace cppboot
\ No newline at end of file
+}  // namespace cppboot
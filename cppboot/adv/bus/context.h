@@ -1,6 +1,7 @@
 #ifndef CPPBOOT_ADV_BUS_CONTEXT_H_
 #define CPPBOOT_ADV_BUS_CONTEXT_H_
 
+#include <atomic>
 #include <string>
 
 #include "asio.hpp"
@@ -15,6 +16,7 @@ namespace cppboot {
 using cppboot::net::Buffer;
 
 class Msg;
+class MsgPacker;
 
 class BusContext : public cppboot::net::Context {
  public:
@@ -26,12 +28,29 @@ class BusContext : public cppboot::net::Context {
   std::string name() const noexcept { return name_; }
   Result Parse(Buffer* buf, Msg* msg);
 
+  /// Messages are sent to the peer with packer(), JsonPacker until the peer
+  /// is found to read binary frames: the server learns it from the packers
+  /// a client registers with, a client from the first binary frame received.
+  /// The packer is switched on the IO thread while callers on any thread
+  /// send, hence it is atomic.
+  MsgPacker* packer() const noexcept { return packer_.load(); }
+  void set_packer(MsgPacker* packer) { packer_.store(packer); }
+
+  /// Keep sending JSON, for debugging. Frames of either format are read.
+  bool json_only() const noexcept { return json_only_.load(); }
+  void set_json_only(bool b);
+
+  /// Use the binary packer for this peer, unless json_only().
+  void UseBinary();
+
  private:
   enum ParseState { kHeader, kBody };
 
   std::string name_;
   ParseState state_;
   MsgHeader header_;
+  std::atomic<MsgPacker*> packer_;
+  std::atomic<bool> json_only_;
 };
 
 }  // namespace cppboot
@@ -1,31 +1,30 @@
 #include "cppboot/adv/bus/msg.h"
 
-#include "cppboot/net/buffer.h"
+#include <string.h>
+
 #include "cppboot/net/connection.h"
 
+#include "cppboot/adv/bus/context.h"
 #include "cppboot/adv/bus/msg_packer.h"
 namespace cppboot {
 
-using cppboot::net::Buffer;
-
 void SendMessageToConnection(const ConnPtr& conn, const MsgPtr& msg) {
-  cppboot::net::Buffer buffer;
+  BusContext* ctx = static_cast<BusContext*>(conn->context());
+  MsgPacker* packer = ctx ? ctx->packer() : MsgPacker::Find(kMsgMagic);
 
-  JsonPacker jp;
-
-  std::string body;  // TODO 性能优化
-  jp.Pack(*msg, &body);
+  // Packed right behind the header, which is filled in afterwards.
+  std::string frame(sizeof(MsgHeader), '\0');
+  packer->Pack(*msg, &frame);
+  // JSON bodies are sent NUL-terminated.
+  if (packer->magic() == kMsgMagic) frame.push_back('\0');
 
   MsgHeader hdr = {
-      .magic = kMsgMagic,
-      .length = (uint32_t)body.length() + 1,
+      .magic = packer->magic(),
+      .length = (uint32_t)(frame.length() - sizeof(MsgHeader)),
   };
+  memcpy(&frame[0], &hdr, sizeof(hdr));
 
-  Buffer tmp(sizeof(hdr) + body.length() + 1);
-  tmp.Append((const char*)&hdr, sizeof(hdr));
-  tmp.Append(body.data(), body.length() + 1);
-
-  conn->Send(tmp.Peek(), tmp.ReadableBytes());
+  conn->Send(frame.data(), frame.length());
 }
 
-}  // namespace cppboot
\ No newline at end of file
+}  // namespace cppboot
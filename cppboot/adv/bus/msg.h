@@ -12,7 +12,10 @@ namespace cppboot {
 
 using cppboot::net::ConnPtr;
 
+/// Magic of the frames holding a message packed by JsonPacker, and by
+/// BinaryPacker.
 static const uint32_t kMsgMagic = 0x20141021;
+static const uint32_t kBinaryMsgMagic = 0x20141022;
 
 typedef uint32_t MsgId;
 
@@ -44,6 +47,8 @@ struct Params {
     return (it != values_.end()) ? it->second : "";
   }
 
+  size_t size() const noexcept { return values_.size(); }
+
   TypeConstIter begin() const noexcept { return values_.begin(); }
   TypeConstIter end() const noexcept { return values_.end(); }
 
@@ -59,15 +64,17 @@ class Msg {
   bool is_request() const noexcept { return is_request_; }
   void set_request(bool b) { is_request_ = b; }
 
-  std::string caller() const noexcept { return caller_; }
+  const std::string& caller() const noexcept { return caller_; }
   void set_caller(const std::string& caller) { caller_ = caller; }
 
-  std::string method_provider() const noexcept { return method_provider_; }
+  const std::string& method_provider() const noexcept {
+    return method_provider_;
+  }
   void set_method_provider(const std::string& mp) { method_provider_ = mp; }
   MsgId id() const { return id_; }
   void set_id(MsgId id) { id_ = id; }
 
-  std::string method() const { return method_; }
+  const std::string& method() const noexcept { return method_; }
 
   void set_method(const std::string& method) {
     auto pos = method.find_first_of('/');
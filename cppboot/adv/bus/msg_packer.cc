@@ -7,6 +7,18 @@
 
 namespace cppboot {
 
+MsgPacker* MsgPacker::Find(uint32_t magic) {
+  static JsonPacker json_packer;
+  static BinaryPacker binary_packer;
+  switch (magic) {
+    case kMsgMagic:
+      return &json_packer;
+    case kBinaryMsgMagic:
+      return &binary_packer;
+  }
+  return nullptr;
+}
+
 //
 // JsonPacker
 //
@@ -27,12 +39,12 @@ void JsonPacker::Pack(const Msg& msg, std::string* result) {
   }
   root["param"] = param;
 
-  *result = root.dump();
+  result->append(root.dump());
 }
 
-Status JsonPacker::Unpack(const std::string& data, Msg* msg) {
+Status JsonPacker::Unpack(string_view data, Msg* msg) {
   try {
-    auto root = cppboot::json::parse(data);
+    auto root = cppboot::json::parse(data.begin(), data.end());
     msg->set_id(root["id"]);
     msg->set_method(root["method"]);
     msg->set_request(root["is_req"]);
@@ -49,4 +61,146 @@ Status JsonPacker::Unpack(const std::string& data, Msg* msg) {
   return OkStatus();
 }
 
-}  // namespace cppboot
\ No newline at end of file
+uint32_t JsonPacker::magic() const { return kMsgMagic; }
+
+//
+// BinaryPacker
+//
+
+namespace {
+
+size_t VarintSize(uint64_t n) {
+  size_t size = 1;
+  while (n >= 0x80) {
+    n >>= 7;
+    size++;
+  }
+  return size;
+}
+
+void AppendVarint(uint64_t n, std::string* out) {
+  while (n >= 0x80) {
+    out->push_back(static_cast<char>(n | 0x80));
+    n >>= 7;
+  }
+  out->push_back(static_cast<char>(n));
+}
+
+void AppendString(const std::string& s, std::string* out) {
+  AppendVarint(s.size(), out);
+  out->append(s);
+}
+
+/// Reads the fields of a packed message off the front of `data_`.
+class Reader {
+ public:
+  explicit Reader(string_view data) : data_(data) {}
+
+  bool empty() const { return data_.empty(); }
+
+  bool ReadFixed32(uint32_t* n) {
+    if (data_.size() < 4) return false;
+    const unsigned char* p =
+        reinterpret_cast<const unsigned char*>(data_.data());
+    *n = p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24;
+    data_.remove_prefix(4);
+    return true;
+  }
+
+  bool ReadByte(uint8_t* b) {
+    if (data_.empty()) return false;
+    *b = static_cast<uint8_t>(data_[0]);
+    data_.remove_prefix(1);
+    return true;
+  }
+
+  bool ReadVarint(uint64_t* n) {
+    *n = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      uint8_t b;
+      if (!ReadByte(&b)) return false;
+      *n |= static_cast<uint64_t>(b & 0x7f) << shift;
+      if (!(b & 0x80)) return true;
+    }
+    return false;
+  }
+
+  bool ReadString(std::string* s) {
+    uint64_t size;
+    if (!ReadVarint(&size) || size > data_.size()) return false;
+    s->assign(data_.data(), size);
+    data_.remove_prefix(size);
+    return true;
+  }
+
+ private:
+  string_view data_;
+};
+
+}  // namespace
+
+void BinaryPacker::Pack(const Msg& msg, std::string* result) {
+  const std::string& caller = msg.caller();
+  const std::string& method_provider = msg.method_provider();
+  const std::string& method = msg.method();
+  const Params& params = msg.params();
+
+  size_t size = 4 + 1 + VarintSize(caller.size()) + caller.size() +
+                VarintSize(method_provider.size()) + method_provider.size() +
+                VarintSize(method.size()) + method.size() +
+                VarintSize(params.size());
+  for (const auto& i : params) {
+    size += VarintSize(i.first.size()) + i.first.size() +
+            VarintSize(i.second.size()) + i.second.size();
+  }
+  result->reserve(result->size() + size);
+
+  MsgId id = msg.id();
+  for (int i = 0; i < 4; i++) {
+    result->push_back(static_cast<char>(id >> (8 * i)));
+  }
+  result->push_back(msg.is_request() ? kRequest : 0);
+  AppendString(caller, result);
+  AppendString(method_provider, result);
+  AppendString(method, result);
+  AppendVarint(params.size(), result);
+  for (const auto& i : params) {
+    AppendString(i.first, result);
+    AppendString(i.second, result);
+  }
+}
+
+Status BinaryPacker::Unpack(string_view data, Msg* msg) {
+  Reader reader(data);
+  uint32_t id;
+  uint8_t flags;
+  std::string caller, method_provider, method;
+  uint64_t count;
+  if (!reader.ReadFixed32(&id) || !reader.ReadByte(&flags) ||
+      !reader.ReadString(&caller) || !reader.ReadString(&method_provider) ||
+      !reader.ReadString(&method) || !reader.ReadVarint(&count)) {
+    return InvalidArgumentError("truncated message");
+  }
+
+  msg->set_id(id);
+  msg->set_request(flags & kRequest);
+  msg->set_caller(caller);
+  msg->set_method(method);
+  msg->set_method_provider(method_provider);
+
+  std::string key, value;
+  for (uint64_t i = 0; i < count; i++) {
+    if (!reader.ReadString(&key) || !reader.ReadString(&value)) {
+      return InvalidArgumentError("truncated message params");
+    }
+    msg->set_param(key, value);
+  }
+  if (!reader.empty()) {
+    return InvalidArgumentError("trailing bytes after message");
+  }
+  return OkStatus();
+}
+
+uint32_t BinaryPacker::magic() const { return kBinaryMsgMagic; }
+
+}  // namespace cppboot
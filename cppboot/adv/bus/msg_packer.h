@@ -1,8 +1,11 @@
 #ifndef CPPBOOT_ADV_BUS_MSG_PACKER_H_
 #define CPPBOOT_ADV_BUS_MSG_PACKER_H_
 
+#include <stdint.h>
 #include <string>
+
 #include "cppboot/base/status.h"
+#include "cppboot/base/string_view.h"
 
 namespace cppboot {
 
@@ -13,25 +16,56 @@ class MsgPacker {
  public:
   /// @brief 序列化消息
   /// @param msg 消息对象
-  /// @param data 序列化后的结果
+  /// @param data 序列化的结果追加到其后
   virtual void Pack(const Msg& msg, std::string* data) = 0;
 
   /// @brief 反序列化
   /// @param data 数据源
   /// @param msg 反序列化得到的消息对象
   /// @return 状态吗
-  virtual Status Unpack(const std::string& data, Msg* msg) = 0;
+  virtual Status Unpack(string_view data, Msg* msg) = 0;
+
+  /// @brief 帧头中的magic，标识帧的格式
+  virtual uint32_t magic() const = 0;
+
+  /// @brief 协商时使用的名字
+  virtual const char* name() const = 0;
+
+  /// @brief magic对应的packer，未知的返回nullptr
+  static MsgPacker* Find(uint32_t magic);
 
  protected:
   virtual ~MsgPacker() {}
 };
 
+/// Packs a message into a JSON object, readable when debugging.
 class JsonPacker : public MsgPacker {
  public:
   void Pack(const Msg& msg, std::string* result);
-  Status Unpack(const std::string& data, Msg* msg);
+  Status Unpack(string_view data, Msg* msg);
+  uint32_t magic() const;
+  const char* name() const { return "json"; }
+};
+
+/// Packs a message into a compact binary form, without building any
+/// intermediate tree:
+///
+///   id           4 bytes, little-endian
+///   flags        1 byte, 0x1 for a request
+///   caller, method_provider, method
+///   param count, then each key and value
+///
+/// Strings are a varint length and the bytes, the count is a varint.
+class BinaryPacker : public MsgPacker {
+ public:
+  enum { kRequest = 0x1 };
+
+  void Pack(const Msg& msg, std::string* result);
+  Status Unpack(string_view data, Msg* msg);
+  uint32_t magic() const;
+  const char* name() const { return "binary"; }
 };
 
 }  // namespace cppboot
 
-#endif  // CPPBOOT_ADV_BUS_MSG_PACKER_H_
\ No newline at end of file
+#endif  // CPPBOOT_ADV_BUS_MSG_PACKER_H_
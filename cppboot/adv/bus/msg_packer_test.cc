@@ -53,4 +53,71 @@ TEST(MsgPacker, should_catch_exception_with_unpack) {
       &msg));
 }
 
+TEST(MsgPacker, should_pack_and_unpack_by_binary) {
+  Msg msg;
+  msg.set_id(0x12345678);
+  msg.set_caller("client2");
+  msg.set_method("client1/foo");
+  msg.set_param("key1", "str1");
+  msg.set_param("key2", std::string(200, 'x'));
+
+  cppboot::BinaryPacker b;
+  std::string s("head");
+  b.Pack(msg, &s);
+  ASSERT_EQ(s.substr(0, 9), std::string("head\x78\x56\x34\x12\x01", 9));
+
+  Msg out;
+  auto st = b.Unpack(cppboot::string_view(s).substr(4), &out);
+  ASSERT_TRUE(st) << st.ToString();
+  ASSERT_EQ(out.id(), 0x12345678);
+  ASSERT_TRUE(out.is_request());
+  ASSERT_EQ(out.caller(), "client2");
+  ASSERT_EQ(out.method_provider(), "client1");
+  ASSERT_EQ(out.method(), "foo");
+  ASSERT_EQ(out.param("key1"), "str1");
+  ASSERT_EQ(out.param("key2"), std::string(200, 'x'));
+  ASSERT_EQ(out.params().size(), 2);
+}
+
+TEST(MsgPacker, should_pack_smaller_by_binary) {
+  Msg msg;
+  msg.set_id(123);
+  msg.set_method("foo");
+  msg.set_param("key1", "str1");
+  msg.set_param("key2", "1001");
+
+  std::string json, binary;
+  cppboot::JsonPacker().Pack(msg, &json);
+  cppboot::BinaryPacker().Pack(msg, &binary);
+  ASSERT_EQ(binary.size(), 32);
+  ASSERT_LT(binary.size() * 4, json.size());
+}
+
+TEST(MsgPacker, should_reject_bad_binary) {
+  Msg msg;
+  msg.set_id(1);
+  msg.set_method("foo");
+  msg.set_param("key1", "str1");
+  cppboot::BinaryPacker b;
+  std::string s;
+  b.Pack(msg, &s);
+
+  for (size_t n = 0; n < s.size(); n++) {
+    Msg out;
+    ASSERT_FALSE(b.Unpack(cppboot::string_view(s.data(), n), &out)) << n;
+  }
+  Msg out;
+  ASSERT_FALSE(b.Unpack(s + "x", &out));
+  // A string longer than the message.
+  s[6] = 100;
+  ASSERT_FALSE(b.Unpack(s, &out));
+}
+
+TEST(MsgPacker, should_find_packer_by_magic) {
+  ASSERT_STREQ(cppboot::MsgPacker::Find(cppboot::kMsgMagic)->name(), "json");
+  ASSERT_STREQ(cppboot::MsgPacker::Find(cppboot::kBinaryMsgMagic)->name(),
+               "binary");
+  ASSERT_EQ(cppboot::MsgPacker::Find(0), nullptr);
+}
+
 }  // namespace
\ No newline at end of file
@@ -14,7 +14,9 @@ using cppboot::net::_2;
 using cppboot::net::Conn;
 
 BusServer::BusServer(const std::string& name)
-    : local_service_(new BusService(name)), router_(new BusRouter()) {
+    : local_service_(new BusService(name)),
+      router_(new BusRouter()),
+      json_only_(false) {
   local_service_->AddMethod(
       "RegisterService",
       std::bind(&BusServer::HandleRegisterMethod, this, _1, _2));
@@ -28,9 +30,12 @@ void BusServer::Stop() {
 
 void BusServer::HandleConnection(const ConnPtr& conn) {
   switch (conn->state()) {
-    case Conn::kConnected:
-      conn->set_context(new BusContext());
+    case Conn::kConnected: {
+      BusContext* ctx = new BusContext();
+      ctx->set_json_only(json_only_);
+      conn->set_context(ctx);
       break;
+    }
     case Conn::kDisconnected: {
       BusContext* ctx = reinterpret_cast<BusContext*>(conn->context());
       if (ctx) {
@@ -97,6 +102,14 @@ void BusServer::HandleResponseMessage(const MsgPtr& msg) {
 void BusServer::HandleRegisterMethod(const In& in, Out* out) {
   auto name = in.get("ServiceName");
   router_->Add(name, in.conn);
+
+  // Reply in binary to clients reading it, this reply included.
+  for (const auto& packer : StrSplit(in.get("Packers"), ',')) {
+    if (packer == "binary") {
+      static_cast<BusContext*>(in.conn->context())->UseBinary();
+      break;
+    }
+  }
   CPPBOOT_LOG(DEBUG, "handle {}, name is {}", "RegisterMethod", name);
 }
 
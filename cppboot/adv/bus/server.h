@@ -26,6 +26,10 @@ class BusServer {
 
   void Stop();
 
+  /// Send JSON frames only, for debugging, even to clients registering with
+  /// the binary packer. Applies to connections made afterwards.
+  void set_json_only(bool b) { json_only_ = b; }
+
   // call when connection state changed
   void HandleConnection(const ConnPtr& conn);
   // call when connection read bytes
@@ -42,6 +46,7 @@ class BusServer {
 
   std::unique_ptr<BusService> local_service_;  // 服务器本身提供的服务
   std::unique_ptr<BusRouter> router_;
+  bool json_only_;
 };
 
 }  // namespace cppboot
@@ -1,6 +1,8 @@
 #include "gmock/gmock.h"
 
 #include "client.h"
+#include "context.h"
+#include "msg_packer.h"
 #include "server.h"
 #include "cppboot/net/testing/mocks.h"
 
@@ -11,6 +13,7 @@ using cppboot::BusClient;
 using cppboot::net::Conn;
 using cppboot::net::TcpServer;
 using cppboot::net::testing::MockConnectionPair;
+using cppboot::net::testing::MockConnectionPairPtr;
 
 TEST(BusServer, DISABLED_use_tcp_server_as_transport_protocol) {
   asio::io_context io_context;
@@ -29,6 +32,11 @@ TEST(BusServer, DISABLED_use_tcp_server_as_transport_protocol) {
   tcp_svr.Stop();
 }
 
+/// The packer `conn` sends with.
+std::string PackerOf(const ConnPtr& conn) {
+  return static_cast<BusContext*>(conn->context())->packer()->name();
+}
+
 TEST(BusServer, should_register_method_by_client) {
   // SetUp: 1 server + 2 client
   //
@@ -77,5 +85,63 @@ TEST(BusServer, should_register_method_by_client) {
   ASSERT_EQ(out.get("key2"), "666");
 }
 
+class BusNegotiationTest : public ::testing::Test {
+ protected:
+  BusNegotiationTest()
+      : svr_conn_(std::make_shared<MockConnectionPair>()),
+        cli_conn_(std::make_shared<MockConnectionPair>()),
+        server_("server1") {
+    cli_conn_->connect(svr_conn_);
+    svr_conn_->connect(cli_conn_);
+    svr_conn_->set_receive_callback([this](const ConnPtr& conn, Buffer* buf) {
+      server_.OnReceive(conn, buf);
+    });
+  }
+
+  MockConnectionPairPtr svr_conn_;
+  MockConnectionPairPtr cli_conn_;
+  BusServer server_;
+};
+
+TEST_F(BusNegotiationTest, should_switch_to_binary_on_register) {
+  server_.HandleConnection(svr_conn_);
+  BusClient client("client1", cli_conn_);
+  ASSERT_EQ(PackerOf(cli_conn_), "json");
+
+  client.Start();
+  ASSERT_EQ(PackerOf(svr_conn_), "binary");
+  ASSERT_EQ(PackerOf(cli_conn_), "binary");
+
+  Out out;
+  ASSERT_TRUE(client.Call("SvcMgr/Unknown", In(), &out));
+  ASSERT_EQ(out.get("return"), "not found");
+}
+
+TEST_F(BusNegotiationTest, should_keep_json_when_client_json_only) {
+  server_.HandleConnection(svr_conn_);
+  BusClient client("client1", cli_conn_);
+  client.set_json_only(true);
+  client.Start();
+
+  Out out;
+  ASSERT_TRUE(client.Call("SvcMgr/Unknown", In(), &out));
+  ASSERT_EQ(out.get("return"), "not found");
+  ASSERT_EQ(PackerOf(svr_conn_), "json");
+  ASSERT_EQ(PackerOf(cli_conn_), "json");
+}
+
+TEST_F(BusNegotiationTest, should_keep_json_when_server_json_only) {
+  server_.set_json_only(true);
+  server_.HandleConnection(svr_conn_);
+  BusClient client("client1", cli_conn_);
+  client.Start();
+
+  Out out;
+  ASSERT_TRUE(client.Call("SvcMgr/Unknown", In(), &out));
+  ASSERT_EQ(out.get("return"), "not found");
+  ASSERT_EQ(PackerOf(svr_conn_), "json");
+  ASSERT_EQ(PackerOf(cli_conn_), "json");
+}
+
 }  // namespace
 }  // namespace cppboot
\ No newline at end of file
@@ -0,0 +1,96 @@
+#ifndef CPPBOOT_BASE_EMBED_H_
+#define CPPBOOT_BASE_EMBED_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+
+#include "cppboot/base/string_view.h"
+
+namespace cppboot {
+
+/// A file compiled into the program by cppboot_embed_files() in CMake.
+struct EmbeddedFile {
+  /// Path relative to the BASE_DIR of the embedding, e.g. "css/site.css".
+  string_view name;
+  string_view data;
+  /// A strong entity tag of `data` with its quotes, e.g. "\"5f0c...\"".
+  string_view etag;
+  /// Compressed variants, empty if there is none. Gzip is compressed by the
+  /// build with COMPRESS, both may come from ".gz" and ".br" siblings.
+  string_view gzip;
+  string_view brotli;
+};
+
+/// The files of one cppboot_embed_files(), sorted by name. The generated
+/// header declares a function returning them, e.g. for
+///
+///   cppboot_embed_files(server site_assets BASE_DIR www FILES ...)
+///
+/// #include "site_assets.h" declares cppboot::embedded::site_assets().
+///
+/// Generated sets come with a perfect hash of the names, built by
+/// hash-and-displace: the hash of a name picks a seed, and the hash of the
+/// name from that seed the slot holding it, so Find() hashes twice and
+/// compares once.
+class EmbeddedFiles {
+ public:
+  EmbeddedFiles() noexcept
+      : files_(nullptr), size_(0), seeds_(nullptr), slots_(nullptr) {}
+  EmbeddedFiles(const EmbeddedFile* files, size_t size) noexcept
+      : files_(files), size_(size), seeds_(nullptr), slots_(nullptr) {}
+  /// `seeds` and `slots` have `size` entries: the seed of each first level
+  /// hash, a negative one -s - 1 stands for slot s, and the file in each
+  /// slot.
+  EmbeddedFiles(const EmbeddedFile* files, size_t size, const int32_t* seeds,
+                const uint32_t* slots) noexcept
+      : files_(files), size_(size), seeds_(seeds), slots_(slots) {}
+
+  const EmbeddedFile* begin() const noexcept { return files_; }
+  const EmbeddedFile* end() const noexcept { return files_ + size_; }
+  size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+
+  /// The file `name`, null if it was not embedded.
+  const EmbeddedFile* Find(string_view name) const noexcept {
+    if (!seeds_) {
+      auto it = std::lower_bound(
+          begin(), end(), name,
+          [](const EmbeddedFile& f, string_view n) { return f.name < n; });
+      return it != end() && it->name == name ? it : nullptr;
+    }
+
+    if (size_ == 0) return nullptr;
+    int32_t seed = seeds_[Hash(name, kHashBasis) % size_];
+    uint32_t slot = seed < 0 ? static_cast<uint32_t>(-seed - 1)
+                             : Hash(name, static_cast<uint32_t>(seed)) % size_;
+    const EmbeddedFile* file = files_ + slots_[slot];
+    return file->name == name ? file : nullptr;
+  }
+
+  /// 32-bit FNV-1a of `name` starting from `seed`, mirrored by the
+  /// generator in cmake/embed_files.cmake. The high bits are folded into
+  /// the low ones, which alone depend only on the low bits of the seed.
+  static uint32_t Hash(string_view name, uint32_t seed) noexcept {
+    uint32_t h = seed;
+    for (char c : name) {
+      h ^= static_cast<unsigned char>(c);
+      h *= 16777619u;
+    }
+    return h ^ (h >> 16);
+  }
+
+  /// The seed of the first level hash, the FNV offset basis.
+  static const uint32_t kHashBasis = 2166136261u;
+
+ private:
+  const EmbeddedFile* files_;
+  size_t size_;
+  const int32_t* seeds_;
+  const uint32_t* slots_;
+};
+
+}  // namespace cppboot
+
+#endif  // CPPBOOT_BASE_EMBED_H_
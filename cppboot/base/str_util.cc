@@ -161,4 +161,39 @@ std::string StrReplace(std::string& str, const std::string& from,
   }
   return str;
 }
+
+char* FastUInt64ToBuffer(uint64_t i, char* buffer) noexcept {
+  static const char kDigits[] =
+      "00010203040506070809"
+      "10111213141516171819"
+      "20212223242526272829"
+      "30313233343536373839"
+      "40414243444546474849"
+      "50515253545556575859"
+      "60616263646566676869"
+      "70717273747576777879"
+      "80818283848586878889"
+      "90919293949596979899";
+
+  // Two digits at a time from the end into a scratch buffer.
+  char tmp[kFastToBufferSize];
+  char* p = tmp + sizeof(tmp);
+  while (i >= 100) {
+    const char* d = kDigits + (i % 100) * 2;
+    i /= 100;
+    *--p = d[1];
+    *--p = d[0];
+  }
+  if (i >= 10) {
+    const char* d = kDigits + i * 2;
+    *--p = d[1];
+    *--p = d[0];
+  } else {
+    *--p = static_cast<char>('0' + i);
+  }
+
+  size_t n = tmp + sizeof(tmp) - p;
+  for (size_t k = 0; k < n; k++) buffer[k] = p[k];
+  return buffer + n;
+}
 }  // namespace cppboot
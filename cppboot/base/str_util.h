@@ -1,6 +1,8 @@
 #ifndef CPPBOOT_BASE_STR_UTIL_H_
 #define CPPBOOT_BASE_STR_UTIL_H_
 
+#include <stdint.h>
+
 #include <vector>
 #include <string>
 
@@ -87,6 +89,28 @@ bool EndsWithIgnoreCase(string_view text, string_view suffix) noexcept;
 std::vector<std::string> StrFields(const std::string& s);
 std::string StrReplace(std::string& str, const std::string& from,
                        const std::string& to);
+
+//
+// Numbers
+//
+
+// Minimum size of the buffer passed to FastUInt64ToBuffer().
+static const int kFastToBufferSize = 20;
+
+// FastUInt64ToBuffer()
+//
+// Writes the decimal digits of `i` to `buffer`, which must have room for at
+// least kFastToBufferSize chars, and returns a pointer past the last digit.
+// Nothing is allocated and no terminating NUL is written.
+char* FastUInt64ToBuffer(uint64_t i, char* buffer) noexcept;
+
+// StrAppendUInt()
+//
+// Appends the decimal digits of `i` to `s`.
+inline void StrAppendUInt(std::string& s, uint64_t i) {
+  char buf[kFastToBufferSize];
+  s.append(buf, FastUInt64ToBuffer(i, buf));
+}
 }  // namespace cppboot
 
 #endif  // CPPBOOT_BASE_STR_UTIL_H_
@@ -195,4 +195,21 @@ TEST(MatchTest, EndsWithIgnoreCase) {
   EXPECT_FALSE(cppboot::EndsWithIgnoreCase("", "fo"));
 }
 
+TEST(NumbersTest, FastUInt64ToBuffer) {
+  auto to_string = [](uint64_t i) {
+    char buf[cppboot::kFastToBufferSize];
+    return std::string(buf, cppboot::FastUInt64ToBuffer(i, buf));
+  };
+  ASSERT_EQ(to_string(0), "0");
+  ASSERT_EQ(to_string(7), "7");
+  ASSERT_EQ(to_string(42), "42");
+  ASSERT_EQ(to_string(100), "100");
+  ASSERT_EQ(to_string(1234567), "1234567");
+  ASSERT_EQ(to_string(18446744073709551615ULL), "18446744073709551615");
+
+  std::string s = "Content-Length: ";
+  cppboot::StrAppendUInt(s, 1024);
+  ASSERT_EQ(s, "Content-Length: 1024");
+}
+
 }  // namespace
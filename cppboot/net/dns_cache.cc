@@ -0,0 +1,226 @@
+#include "cppboot/net/dns_cache.h"
+
+namespace cppboot {
+namespace net {
+
+using asio::ip::tcp;
+
+namespace {
+
+std::string Key(const std::string& host, const std::string& port) {
+  return host + '\0' + port;
+}
+
+}  // namespace
+
+DnsCache::DnsCache(const Options& options)
+    : options_(options),
+      resolutions_(0),
+      work_(asio::make_work_guard(worker_)) {}
+
+DnsCache::~DnsCache() {
+  work_.reset();
+  if (thread_.joinable()) thread_.join();
+}
+
+DnsCache& DnsCache::Default() {
+  static DnsCache cache;
+  return cache;
+}
+
+Status DnsCache::Resolve(const std::string& host, const std::string& port,
+                         EndpointsPtr* endpoints) {
+  auto key = Key(host, port);
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      Status status;
+      if (Find(key, host, port, &status, endpoints)) return status;
+
+      Entry& entry = Slot(key);
+      if (!entry.resolving) {
+        entry.resolving = true;
+        break;
+      }
+      // Wait for the resolution in flight rather than starting another.
+      resolved_.wait(lock);
+      auto it = entries_.find(key);
+      if (it != entries_.end() && it->second.resolved &&
+          !it->second.resolving) {
+        *endpoints = it->second.endpoints;
+        return it->second.status;
+      }
+    }
+  }
+
+  auto status = DoResolve(host, port, endpoints);
+  Store(key, status, *endpoints);
+  return status;
+}
+
+void DnsCache::AsyncResolve(asio::io_context& io_context,
+                            const std::string& host, const std::string& port,
+                            Callback cb) {
+  auto key = Key(host, port);
+  std::lock_guard<std::mutex> guard(mutex_);
+  Status status;
+  EndpointsPtr endpoints;
+  if (Find(key, host, port, &status, &endpoints)) {
+    asio::post(io_context,
+               [cb, status, endpoints]() { cb(status, endpoints); });
+    return;
+  }
+
+  Entry& entry = Slot(key);
+  entry.waiters.push_back(
+      Waiter{asio::make_work_guard(io_context), std::move(cb)});
+  if (!entry.resolving) StartResolve(&entry, key, host, port);
+}
+
+bool DnsCache::Lookup(const std::string& host, const std::string& port,
+                      Status* status, EndpointsPtr* endpoints) {
+  auto key = Key(host, port);
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (Find(key, host, port, status, endpoints)) return true;
+
+  Entry& entry = Slot(key);
+  if (!entry.resolving) StartResolve(&entry, key, host, port);
+  return false;
+}
+
+void DnsCache::Clear() {
+  std::lock_guard<std::mutex> guard(mutex_);
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    // Resolutions in flight still have callers to answer.
+    if (it->second.resolving) {
+      it->second.resolved = false;
+      ++it;
+    } else {
+      it = entries_.erase(it);
+    }
+  }
+}
+
+size_t DnsCache::entries() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return entries_.size();
+}
+
+uint64_t DnsCache::resolutions() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return resolutions_;
+}
+
+bool DnsCache::Find(const std::string& key, const std::string& host,
+                    const std::string& port, Status* status,
+                    EndpointsPtr* endpoints) {
+  auto it = entries_.find(key);
+  if (it == entries_.end() || !it->second.resolved) return false;
+
+  Entry& entry = it->second;
+  auto now = Clock::now();
+  if (now >= entry.expires) return false;
+
+  if (entry.status && !entry.resolving &&
+      entry.expires - now <= options_.refresh_ahead) {
+    StartResolve(&entry, key, host, port);
+  }
+  *status = entry.status;
+  *endpoints = entry.endpoints;
+  return true;
+}
+
+DnsCache::Entry& DnsCache::Slot(const std::string& key) {
+  auto it = entries_.find(key);
+  if (it != entries_.end()) return it->second;
+
+  Evict();
+  return entries_[key];
+}
+
+void DnsCache::StartResolve(Entry* entry, const std::string& key,
+                            const std::string& host,
+                            const std::string& port) {
+  entry->resolving = true;
+  if (!thread_.joinable()) {
+    thread_ = std::thread([this]() { worker_.run(); });
+  }
+  asio::post(worker_, [this, key, host, port]() {
+    EndpointsPtr endpoints;
+    auto status = DoResolve(host, port, &endpoints);
+    Store(key, status, endpoints);
+  });
+}
+
+void DnsCache::Store(const std::string& key, const Status& status,
+                     const EndpointsPtr& endpoints) {
+  std::vector<Waiter> waiters;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    Entry& entry = Slot(key);
+    entry.resolved = true;
+    entry.status = status;
+    entry.endpoints = endpoints;
+    entry.expires =
+        Clock::now() + (status ? options_.ttl : options_.negative_ttl);
+    entry.resolving = false;
+    waiters.swap(entry.waiters);
+  }
+  resolved_.notify_all();
+
+  for (auto& w : waiters) {
+    Callback cb = std::move(w.cb);
+    asio::post(w.work.get_executor(),
+               [cb, status, endpoints]() { cb(status, endpoints); });
+  }
+}
+
+void DnsCache::Evict() {
+  if (entries_.size() < options_.max_entries) return;
+
+  // Expired entries first, then any idle one.
+  auto now = Clock::now();
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    if (!it->second.resolving && now >= it->second.expires) {
+      it = entries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (auto it = entries_.begin();
+       it != entries_.end() && entries_.size() >= options_.max_entries;) {
+    if (!it->second.resolving) {
+      it = entries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+Status DnsCache::DoResolve(const std::string& host, const std::string& port,
+                           EndpointsPtr* endpoints) {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    resolutions_++;
+  }
+
+  tcp::resolver resolver(worker_);
+  asio::error_code ec;
+  auto results = resolver.resolve(host, port, ec);
+  if (ec) {
+    endpoints->reset();
+    return UnavailableError(ec.message());
+  }
+
+  auto list = std::make_shared<Endpoints>();
+  for (auto& r : results) list->push_back(r.endpoint());
+  if (list->empty()) {
+    endpoints->reset();
+    return UnavailableError("No address for " + host);
+  }
+  *endpoints = std::move(list);
+  return OkStatus();
+}
+
+}  // namespace net
+}  // namespace cppboot
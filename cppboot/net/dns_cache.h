@@ -0,0 +1,151 @@
+#ifndef CPPBOOT_NET_DNS_CACHE_H_
+#define CPPBOOT_NET_DNS_CACHE_H_
+
+#include <stdint.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "asio.hpp"
+
+#include "cppboot/base/status.h"
+
+namespace cppboot {
+namespace net {
+
+/// Cache of host name resolutions shared by the outbound clients, so that
+/// requests do not each wait for the resolver.
+///
+/// The system resolver does not tell record TTLs, entries live for
+/// Options::ttl, failures for Options::negative_ttl. An entry used within
+/// Options::refresh_ahead of its expiry is resolved again in the background
+/// meanwhile it is still served, so busy hosts never miss. Background
+/// resolutions run on a thread of the cache, one at a time. Concurrent
+/// lookups of a host share one resolution, whether they block or not.
+class DnsCache {
+ public:
+  typedef std::vector<asio::ip::tcp::endpoint> Endpoints;
+  typedef std::shared_ptr<const Endpoints> EndpointsPtr;
+
+  /// Called with the outcome of AsyncResolve(), `endpoints` is null on
+  /// failure.
+  typedef std::function<void(const Status& status, EndpointsPtr endpoints)>
+      Callback;
+
+  struct Options {
+    Options()
+        : ttl(std::chrono::seconds(60)),
+          negative_ttl(std::chrono::seconds(5)),
+          refresh_ahead(std::chrono::seconds(10)),
+          max_entries(1024) {}
+
+    std::chrono::milliseconds ttl;
+    /// How long a failed resolution is remembered, zero disables it.
+    std::chrono::milliseconds negative_ttl;
+    /// Refresh entries used this close to their expiry, zero disables it.
+    std::chrono::milliseconds refresh_ahead;
+    size_t max_entries;
+  };
+
+  DnsCache(const DnsCache&) = delete;
+  DnsCache& operator=(const DnsCache&) = delete;
+
+  explicit DnsCache(const Options& options = Options());
+  ~DnsCache();
+
+  /// The cache used by TcpClient, http::Client and http::AsyncClient unless
+  /// told otherwise.
+  static DnsCache& Default();
+
+  /// Resolve `host` and `port`, blocking on a miss. A host being resolved
+  /// already is waited for.
+  Status Resolve(const std::string& host, const std::string& port,
+                 EndpointsPtr* endpoints);
+
+  /// Resolve without blocking, `cb` is posted to `io_context` either way.
+  /// The io_context is kept running meanwhile, it must outlive the call.
+  void AsyncResolve(asio::io_context& io_context, const std::string& host,
+                    const std::string& port, Callback cb);
+
+  /// The cached outcome if any, false on a miss, never blocks. A miss starts
+  /// a background resolution.
+  bool Lookup(const std::string& host, const std::string& port,
+              Status* status, EndpointsPtr* endpoints);
+
+  void Clear();
+
+  size_t entries() const;
+
+  /// Resolutions done so far, i.e. the misses and refreshes.
+  uint64_t resolutions() const;
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Waiter {
+    /// Keeps the io_context of the caller running until called back.
+    asio::executor_work_guard<asio::io_context::executor_type> work;
+    Callback cb;
+  };
+
+  struct Entry {
+    Entry() : resolved(false), resolving(false) {}
+
+    /// Whether `status` and `endpoints` are set.
+    bool resolved;
+    Status status;
+    EndpointsPtr endpoints;
+    Clock::time_point expires;
+
+    bool resolving;
+    std::vector<Waiter> waiters;
+  };
+
+  /// The entry of `key`, made if needed, with mutex_ held.
+  Entry& Slot(const std::string& key);
+
+  /// Look `key` up, with mutex_ held. True if a result is usable, a
+  /// background resolution is started if needed.
+  bool Find(const std::string& key, const std::string& host,
+            const std::string& port, Status* status, EndpointsPtr* endpoints);
+
+  /// Start a background resolution, with mutex_ held.
+  void StartResolve(Entry* entry, const std::string& key,
+                    const std::string& host, const std::string& port);
+
+  /// Store an outcome and call back whoever waited for it.
+  void Store(const std::string& key, const Status& status,
+             const EndpointsPtr& endpoints);
+
+  /// Make room for an entry, with mutex_ held.
+  void Evict();
+
+  /// Resolve synchronously, counting it.
+  Status DoResolve(const std::string& host, const std::string& port,
+                   EndpointsPtr* endpoints);
+
+  Options options_;
+
+  mutable std::mutex mutex_;
+  /// Signalled when a resolution is stored.
+  std::condition_variable resolved_;
+  std::unordered_map<std::string, Entry> entries_;
+  uint64_t resolutions_;
+
+  /// Background resolutions, the thread starts with the first one.
+  asio::io_context worker_;
+  asio::executor_work_guard<asio::io_context::executor_type> work_;
+  std::thread thread_;
+};
+
+}  // namespace net
+}  // namespace cppboot
+
+#endif  // CPPBOOT_NET_DNS_CACHE_H_
@@ -0,0 +1,140 @@
+#include "cppboot/net/dns_cache.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+namespace {
+
+using cppboot::net::DnsCache;
+
+TEST(DnsCache, Resolve) {
+  DnsCache cache;
+  DnsCache::EndpointsPtr endpoints;
+  auto st = cache.Resolve("127.0.0.1", "80", &endpoints);
+  ASSERT_TRUE(st) << st.ToString();
+  ASSERT_EQ(endpoints->size(), 1);
+  ASSERT_EQ(endpoints->front().port(), 80);
+
+  DnsCache::EndpointsPtr again;
+  ASSERT_TRUE(cache.Resolve("127.0.0.1", "80", &again));
+  ASSERT_EQ(again, endpoints);
+  ASSERT_EQ(cache.resolutions(), 1);
+  ASSERT_EQ(cache.entries(), 1);
+
+  ASSERT_TRUE(cache.Resolve("127.0.0.1", "81", &again));
+  ASSERT_EQ(cache.resolutions(), 2);
+}
+
+TEST(DnsCache, ConcurrentResolveSharesOne) {
+  DnsCache cache;
+  cppboot::Status st;
+  DnsCache::EndpointsPtr first;
+  // In flight on the worker, the blocking calls wait for it.
+  ASSERT_FALSE(cache.Lookup("localhost", "80", &st, &first));
+
+  std::vector<std::thread> threads;
+  std::vector<DnsCache::EndpointsPtr> results(8);
+  for (size_t i = 0; i < results.size(); i++) {
+    threads.emplace_back([&cache, &results, i]() {
+      cache.Resolve("localhost", "80", &results[i]);
+    });
+  }
+  for (auto& t : threads) t.join();
+
+  ASSERT_EQ(cache.resolutions(), 1);
+  for (auto& r : results) {
+    ASSERT_TRUE(r);
+    ASSERT_EQ(r, results[0]);
+  }
+}
+
+TEST(DnsCache, NegativeCaching) {
+  DnsCache cache;
+  DnsCache::EndpointsPtr endpoints;
+  auto st = cache.Resolve("nonexistent.invalid", "80", &endpoints);
+  ASSERT_TRUE(cppboot::IsUnavailable(st)) << st.ToString();
+  ASSERT_FALSE(endpoints);
+
+  st = cache.Resolve("nonexistent.invalid", "80", &endpoints);
+  ASSERT_TRUE(cppboot::IsUnavailable(st)) << st.ToString();
+  ASSERT_EQ(cache.resolutions(), 1);
+}
+
+TEST(DnsCache, Expiry) {
+  DnsCache::Options options;
+  options.ttl = std::chrono::milliseconds(20);
+  options.refresh_ahead = std::chrono::milliseconds(0);
+  DnsCache cache(options);
+
+  DnsCache::EndpointsPtr endpoints;
+  ASSERT_TRUE(cache.Resolve("127.0.0.1", "80", &endpoints));
+  std::this_thread::sleep_for(std::chrono::milliseconds(30));
+  ASSERT_TRUE(cache.Resolve("127.0.0.1", "80", &endpoints));
+  ASSERT_EQ(cache.resolutions(), 2);
+}
+
+TEST(DnsCache, RefreshAhead) {
+  DnsCache::Options options;
+  options.ttl = std::chrono::milliseconds(200);
+  options.refresh_ahead = std::chrono::milliseconds(150);
+  DnsCache cache(options);
+
+  DnsCache::EndpointsPtr first;
+  ASSERT_TRUE(cache.Resolve("127.0.0.1", "80", &first));
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  // Served from the cache, refreshed in the background.
+  cppboot::Status st;
+  DnsCache::EndpointsPtr endpoints;
+  ASSERT_TRUE(cache.Lookup("127.0.0.1", "80", &st, &endpoints));
+  ASSERT_EQ(endpoints, first);
+  for (int i = 0; i < 100 && cache.resolutions() < 2; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  ASSERT_EQ(cache.resolutions(), 2);
+
+  // The refreshed entry outlives the first one.
+  std::this_thread::sleep_for(std::chrono::milliseconds(150));
+  ASSERT_TRUE(cache.Lookup("127.0.0.1", "80", &st, &endpoints));
+  ASSERT_NE(endpoints, first);
+}
+
+TEST(DnsCache, AsyncResolve) {
+  DnsCache cache;
+  asio::io_context io_context;
+
+  // Concurrent lookups share one resolution.
+  int calls = 0;
+  for (int i = 0; i < 3; i++) {
+    cache.AsyncResolve(io_context, "127.0.0.1", "80",
+                       [&](const cppboot::Status& status,
+                           DnsCache::EndpointsPtr endpoints) {
+                         calls++;
+                         ASSERT_TRUE(status) << status.ToString();
+                         ASSERT_EQ(endpoints->size(), 1);
+                       });
+  }
+
+  // A miss does not block.
+  cppboot::Status st;
+  DnsCache::EndpointsPtr endpoints;
+  ASSERT_FALSE(cache.Lookup("127.0.0.1", "81", &st, &endpoints));
+
+  auto work = asio::make_work_guard(io_context);
+  std::thread thread([&]() { io_context.run(); });
+  for (int i = 0; i < 100 && calls < 3; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  work.reset();
+  thread.join();
+
+  ASSERT_EQ(calls, 3);
+  ASSERT_EQ(cache.resolutions(), 2);
+  ASSERT_TRUE(cache.Lookup("127.0.0.1", "81", &st, &endpoints));
+  ASSERT_TRUE(st);
+}
+
+}  // namespace
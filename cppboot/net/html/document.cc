@@ -1,7 +1,5 @@
 #include "cppboot/net/html/document.h"
 
-#include <sstream>
-
 namespace cppboot {
 namespace html {
 
@@ -19,18 +17,24 @@ Document::Document(const std::string& title)
     : title_(title), body_(new Element("body")) {}
 
 std::string Document::Dump() const noexcept {
-  std::stringstream ss;
-  ss << "<!DOCTYPE html>\n";
-  ss << "<html>\n";
-  ss << "<head>\n";
-  ss << "<meta charset=\"UTF-8\">\n";
-  ss << style;
-  ss << "<title>" << title_ << "</title>\n";
-  ss << "</head>\n";
-  body_->Dump(ss, 0);
-  ss << "</html>\n";
+  std::string out;
+  Render(&out);
+  return out;
+}
 
-  return ss.str();
+void Document::Render(std::string* out) const {
+  out->append(
+      "<!DOCTYPE html>\n"
+      "<html>\n"
+      "<head>\n"
+      "<meta charset=\"UTF-8\">\n");
+  out->append(style);
+  out->append("<title>");
+  out->append(title_);
+  out->append("</title>\n");
+  out->append("</head>\n");
+  body_->Render(out, 0);
+  out->append("</html>\n");
 }
 
 }  // namespace html
@@ -17,6 +17,10 @@ class Document {
   ElementPtr body() { return body_; }
   std::string Dump() const noexcept;
 
+  /// Append the page to `out`, e.g. the content of a Response whose memory
+  /// is reused.
+  void Render(std::string* out) const;
+
  public:
   std::string title_;
   ElementPtr body_;
@@ -16,32 +16,42 @@ Element* Element::AddChild(Element* e) {
   return e;
 }
 
-void Element::Dump(std::stringstream& ss, int depth) {
+void Element::Render(std::string* out, int depth) const {
   //
   // IF NO text_: <NAME ATTRIBUTE>TEXT</NAME>
   // IF NO children_: <NAME ATTRIBUTE>
   // IF HAS children_: <NAME ATTR>CHILDREN</NAME>
   //
-  std::string prefix(depth, '\t');
-
-  ss << prefix << "<" << name_;
-  for (auto i : attr_) {
-    ss << " " << i.first << "=\"" << i.second << "\"";
+  out->append(depth, '\t');
+  out->push_back('<');
+  out->append(name_);
+  for (const auto& i : attr_) {
+    out->push_back(' ');
+    out->append(i.first);
+    out->append("=\"");
+    out->append(i.second);
+    out->push_back('"');
   }
-  ss << ">";
+  out->push_back('>');
 
   if (!children_.empty()) {
-    ss << "\n";
-    for (auto i : children_) {
-      i->Dump(ss, depth + 1);
+    out->push_back('\n');
+    for (const auto& i : children_) {
+      i->Render(out, depth + 1);
     }
-    ss << prefix << "</" << name_ << ">\n";
+    out->append(depth, '\t');
+    out->append("</");
+    out->append(name_);
+    out->append(">\n");
   } else if (!text_.empty()) {
-    ss << text_ << "</" << name_ << ">\n";
+    out->append(text_);
+    out->append("</");
+    out->append(name_);
+    out->append(">\n");
   } else {
-    ss << "\n";
+    out->push_back('\n');
   }
-};
+}
 
 }  // namespace html
-}  // namespace cppboot
\ No newline at end of file
+}  // namespace cppboot
@@ -2,7 +2,6 @@
 #define CPPBOOT_NET_HTML_ELEMENTS_ELEMENT_H_
 
 #include <string>
-#include <sstream>
 #include <vector>
 #include <map>
 #include <memory>
@@ -27,7 +26,9 @@ class Element {
 
   Element* AddChild(Element* e);
 
-  virtual void Dump(std::stringstream& ss, int depth);
+  /// Append the element and its children to `out`, indented by `depth`
+  /// tabs.
+  virtual void Render(std::string* out, int depth) const;
 
  protected:
   std::string name_;
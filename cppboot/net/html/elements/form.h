@@ -19,16 +19,25 @@ class Input : public Element {
         const std::string& value)
       : Element(""), id_(id), label_(label), value_(value) {}
 
-  void Dump(std::stringstream& ss, int depth) {
+  void Render(std::string* out, int depth) const override {
     //
     // <label for="fname">First name:</label>
     // <input type="text" id="fname" name="fname" value="John"><br>
     //
-    std::string prefix(depth, '\t');
-
-    ss << prefix << "<label for=\"" << id_ << "\">" << label_ << "</label>\n";
-    ss << prefix << "<input type=\"text\" id=\"" << id_ << "\" name=\"" << id_
-       << "\" value=\"" << value_ << "\"><br>\n";
+    out->append(depth, '\t');
+    out->append("<label for=\"");
+    out->append(id_);
+    out->append("\">");
+    out->append(label_);
+    out->append("</label>\n");
+    out->append(depth, '\t');
+    out->append("<input type=\"text\" id=\"");
+    out->append(id_);
+    out->append("\" name=\"");
+    out->append(id_);
+    out->append("\" value=\"");
+    out->append(value_);
+    out->append("\"><br>\n");
   }
 
  private:
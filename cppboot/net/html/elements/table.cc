@@ -3,7 +3,7 @@
 namespace cppboot {
 namespace html {
 
-void Table::Dump(std::stringstream& ss, int depth) {
+void Table::Render(std::string* out, int depth) const {
   /*
   <table>
       <tr>
@@ -23,26 +23,37 @@ void Table::Dump(std::stringstream& ss, int depth) {
       </tr>
       </table>
   */
-  std::string prefix(depth, '\t');
-  ss << prefix << "<table>\n";
+  out->append(depth, '\t');
+  out->append("<table>\n");
 
   if (!heads_.empty()) {
-    ss << prefix << "\t<tr>\n";
-    for (size_t i = 0; i < heads_.size(); i++) {
-      ss << prefix << "\t\t<th>" << heads_[i] << "</th>\n";
+    out->append(depth + 1, '\t');
+    out->append("<tr>\n");
+    for (const auto& head : heads_) {
+      out->append(depth + 2, '\t');
+      out->append("<th>");
+      out->append(head);
+      out->append("</th>\n");
     }
-    ss << prefix << "\t</tr>\n";
+    out->append(depth + 1, '\t');
+    out->append("</tr>\n");
   }
 
-  for (auto row : data_) {
-    ss << prefix << "\t<tr>\n";
+  for (const auto& row : data_) {
+    out->append(depth + 1, '\t');
+    out->append("<tr>\n");
     for (size_t i = 0; i < heads_.size() && i < row.size(); i++) {
-      ss << prefix << "\t\t<td>" << row[i] << "</td>\n";
+      out->append(depth + 2, '\t');
+      out->append("<td>");
+      out->append(row[i]);
+      out->append("</td>\n");
     }
-    ss << prefix << "\t</tr>\n";
+    out->append(depth + 1, '\t');
+    out->append("</tr>\n");
   }
-  ss << prefix << "</table>\n";
+  out->append(depth, '\t');
+  out->append("</table>\n");
 }
 
 }  // namespace html
-}  // namespace cppboot
\ No newline at end of file
+}  // namespace cppboot
@@ -2,6 +2,7 @@
 #define CPPBOOT_NET_HTML_ELEMENTS_TABLE_H_
 
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "element.h"
@@ -15,8 +16,9 @@ class Table : public Element {
 
   explicit Table(const Row& heads) : Element("table"), heads_(heads) {}
   void AddRow(const Row& row) { data_.push_back(row); }
+  void AddRow(Row&& row) { data_.push_back(std::move(row)); }
 
-  void Dump(std::stringstream& ss, int depth);
+  void Render(std::string* out, int depth) const override;
 
  private:
   Row heads_;
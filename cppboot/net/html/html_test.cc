@@ -1,5 +1,99 @@
 #include "gmock/gmock.h"
 
+#include <string>
+
+#include "cppboot/net/html/document.h"
+#include "cppboot/net/http/response.h"
+
 namespace {
-TEST(Html, nothing) {}
-}  // namespace
\ No newline at end of file
+
+using cppboot::html::Document;
+using cppboot::html::Element;
+using cppboot::html::Form;
+using cppboot::html::Input;
+using cppboot::html::Link;
+using cppboot::html::SubmitButton;
+using cppboot::html::Table;
+using cppboot::http::Response;
+
+const char kReport[] =
+    "<!DOCTYPE html>\n"
+    "<html>\n"
+    "<head>\n"
+    "<meta charset=\"UTF-8\">\n"
+    "<style>\n"
+    "table, th, td {\n"
+    "  border: 1px solid black;\n"
+    "  border-collapse: collapse;\n"
+    "}\n"
+    "</style>\n"
+    "<title>Report</title>\n"
+    "</head>\n"
+    "<body>\n"
+    "\t<h1>Sales</h1>\n"
+    "\t<p>\n"
+    "\t\t<a href=\"/\" target=\"_blank\">home</a>\n"
+    "\t</p>\n"
+    "\t<table>\n"
+    "\t\t<tr>\n"
+    "\t\t\t<th>Company</th>\n"
+    "\t\t\t<th>Country</th>\n"
+    "\t\t</tr>\n"
+    "\t\t<tr>\n"
+    "\t\t\t<td>Alfreds</td>\n"
+    "\t\t\t<td>Germany</td>\n"
+    "\t\t</tr>\n"
+    "\t\t<tr>\n"
+    "\t\t\t<td>Centro</td>\n"
+    "\t\t\t<td>Mexico</td>\n"
+    "\t\t</tr>\n"
+    "\t</table>\n"
+    "\t<form action=\"/search\">\n"
+    "\t\t<label for=\"q\">Query:</label>\n"
+    "\t\t<input type=\"text\" id=\"q\" name=\"q\" value=\"cats\"><br>\n"
+    "\t\t<input type=\"submit\" value=\"Go\">\n"
+    "\t</form>\n"
+    "\t<br>\n"
+    "</body>\n"
+    "</html>\n";
+
+void BuildReport(Document* doc) {
+  doc->body()->AddChild(new Element("h1", "Sales"));
+  Element* p = doc->body()->AddChild(new Element("p"));
+  p->AddChild(new Link("home", "/"));
+  Table* table = new Table({"Company", "Country"});
+  table->AddRow({"Alfreds", "Germany"});
+  Table::Row row = {"Centro", "Mexico", "extra"};
+  table->AddRow(row);
+  doc->body()->AddChild(table);
+  Element* form = doc->body()->AddChild(new Form("/search"));
+  form->AddChild(new Input("q", "Query:", "cats"));
+  form->AddChild(new SubmitButton("Go"));
+  doc->body()->AddChild(new Element("br"));
+}
+
+TEST(Html, Render) {
+  Document doc("Report");
+  BuildReport(&doc);
+  ASSERT_EQ(doc.Dump(), kReport);
+
+  std::string out = "prefix";
+  doc.Render(&out);
+  ASSERT_EQ(out, std::string("prefix") + kReport);
+}
+
+TEST(Html, WriteHtml) {
+  Document doc("Report");
+  BuildReport(&doc);
+
+  Response rep;
+  rep.content = std::string(4096, 'x');
+  rep.WriteHtml(Response::ok, doc);
+  ASSERT_EQ(rep.status, Response::ok);
+  ASSERT_EQ(rep.content, kReport);
+  ASSERT_EQ(rep.header("Content-Type"), "text/html");
+  // The memory of the previous content is reused.
+  ASSERT_GE(rep.content.capacity(), 4096);
+}
+
+}  // namespace
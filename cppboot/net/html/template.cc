@@ -0,0 +1,349 @@
+#include "cppboot/net/html/template.h"
+
+#include <sys/stat.h>
+
+#include <cmath>
+
+#include "cppboot/base/fmt.h"
+#include "cppboot/base/fs.h"
+#include "cppboot/base/str_util.h"
+
+namespace cppboot {
+namespace html {
+
+namespace {
+
+void AppendEscaped(string_view s, std::string* out) {
+  size_t start = 0;
+  for (size_t i = 0; i < s.size(); i++) {
+    const char* replacement;
+    switch (s[i]) {
+      case '&':
+        replacement = "&amp;";
+        break;
+      case '<':
+        replacement = "&lt;";
+        break;
+      case '>':
+        replacement = "&gt;";
+        break;
+      case '"':
+        replacement = "&quot;";
+        break;
+      case '\'':
+        replacement = "&#39;";
+        break;
+      default:
+        continue;
+    }
+    out->append(s.data() + start, i - start);
+    out->append(replacement);
+    start = i + 1;
+  }
+  out->append(s.data() + start, s.size() - start);
+}
+
+void AppendValue(const json& value, bool escape, std::string* out) {
+  switch (value.type()) {
+    case json::value_t::null:
+      return;
+    case json::value_t::string: {
+      const std::string& s = value.get_ref<const std::string&>();
+      if (escape) {
+        AppendEscaped(s, out);
+      } else {
+        out->append(s);
+      }
+      return;
+    }
+    case json::value_t::boolean:
+      out->append(value.get<bool>() ? "true" : "false");
+      return;
+    case json::value_t::number_integer: {
+      int64_t n = value.get<int64_t>();
+      if (n < 0) out->push_back('-');
+      StrAppendUInt(*out, n < 0 ? 0 - static_cast<uint64_t>(n) : n);
+      return;
+    }
+    case json::value_t::number_unsigned:
+      StrAppendUInt(*out, value.get<uint64_t>());
+      return;
+    case json::value_t::number_float: {
+      // Formatted like dump() does, in place.
+      double d = value.get<double>();
+      if (!std::isfinite(d)) {
+        out->append("null");
+        return;
+      }
+      char buf[64];
+      out->append(buf, nlohmann::detail::to_chars(buf, buf + sizeof(buf), d));
+      return;
+    }
+    default:
+      if (escape) {
+        AppendEscaped(value.dump(), out);
+      } else {
+        out->append(value.dump());
+      }
+      return;
+  }
+}
+
+bool IsTruthy(const json* value) {
+  if (!value) return false;
+  switch (value->type()) {
+    case json::value_t::null:
+      return false;
+    case json::value_t::boolean:
+      return value->get<bool>();
+    case json::value_t::array:
+      return !value->empty();
+    case json::value_t::string:
+      return !value->get_ref<const std::string&>().empty();
+    default:
+      return true;
+  }
+}
+
+/// The parts of the dotted `name`, none for ".".
+std::vector<std::string> SplitName(string_view name) {
+  std::vector<std::string> path;
+  if (name == ".") return path;
+  size_t start = 0;
+  while (true) {
+    size_t dot = name.find('.', start);
+    path.push_back(name.substr(start, dot - start).str());
+    if (dot == string_view::npos) break;
+    start = dot + 1;
+  }
+  return path;
+}
+
+/// Line of `pos` in `s`, for errors.
+size_t LineOf(string_view s, size_t pos) {
+  return std::count(s.begin(), s.begin() + pos, '\n') + 1;
+}
+
+}  // namespace
+
+Status Template::Parse(string_view source, Template* tmpl) {
+  Template t;
+  t.source_.assign(source.data(), source.size());
+  string_view src(t.source_);
+
+  // The blocks not closed yet, and their names.
+  std::vector<std::pair<size_t, string_view>> open;
+  size_t pos = 0;
+  while (pos < src.size()) {
+    size_t start = src.find("{{", pos);
+    size_t text_end = start == string_view::npos ? src.size() : start;
+    if (text_end > pos) {
+      Op op;
+      op.kind = kText;
+      op.offset = pos;
+      op.size = text_end - pos;
+      op.end = 0;
+      t.ops_.push_back(std::move(op));
+    }
+    if (start == string_view::npos) break;
+
+    bool triple = src.substr(start, 3) == "{{{";
+    string_view close_tag = triple ? "}}}" : "}}";
+    size_t tag_start = start + close_tag.size();
+    size_t close = src.find(close_tag, tag_start);
+    if (close == string_view::npos) {
+      return InvalidArgumentError(
+          cppboot::format("Unclosed tag on line {}", LineOf(src, start)));
+    }
+    string_view tag = StrTrim(src.substr(tag_start, close - tag_start));
+    pos = close + close_tag.size();
+
+    OpKind kind = triple ? kRaw : kEscaped;
+    if (!triple && !tag.empty()) {
+      switch (tag[0]) {
+        case '!':
+          continue;
+        case '&':
+          kind = kRaw;
+          break;
+        case '#':
+          kind = kSection;
+          break;
+        case '^':
+          kind = kInverted;
+          break;
+        case '/': {
+          string_view name = StrTrim(tag.substr(1));
+          if (open.empty() || open.back().second != name) {
+            return InvalidArgumentError(cppboot::format(
+                "Unexpected {{{{/{}}}}} on line {}", name,
+                LineOf(src, start)));
+          }
+          t.ops_[open.back().first].end = t.ops_.size();
+          open.pop_back();
+          continue;
+        }
+      }
+      if (kind != kEscaped) tag = StrTrim(tag.substr(1));
+    }
+    if (tag.empty()) {
+      return InvalidArgumentError(
+          cppboot::format("Empty tag on line {}", LineOf(src, start)));
+    }
+
+    Op op;
+    op.kind = kind;
+    op.offset = 0;
+    op.size = 0;
+    op.path = SplitName(tag);
+    op.end = 0;
+    if (kind == kSection || kind == kInverted) {
+      if (open.size() == kMaxDepth) {
+        return InvalidArgumentError(cppboot::format(
+            "Blocks nested too deeply on line {}", LineOf(src, start)));
+      }
+      open.emplace_back(t.ops_.size(), tag);
+    }
+    t.ops_.push_back(std::move(op));
+  }
+
+  if (!open.empty()) {
+    return InvalidArgumentError(
+        cppboot::format("Unclosed block {}", open.back().second));
+  }
+  *tmpl = std::move(t);
+  return OkStatus();
+}
+
+void Template::Render(const json& data, std::string* out) const {
+  const json* scopes[kMaxDepth + 1];
+  scopes[0] = &data;
+  RenderOps(0, ops_.size(), scopes, 1, out);
+}
+
+void Template::RenderOps(size_t begin, size_t end, const json** scopes,
+                         size_t depth, std::string* out) const {
+  for (size_t i = begin; i < end;) {
+    const Op& op = ops_[i];
+    switch (op.kind) {
+      case kText:
+        out->append(source_, op.offset, op.size);
+        i++;
+        break;
+      case kEscaped:
+      case kRaw: {
+        const json* value = Lookup(op, scopes, depth);
+        if (value) AppendValue(*value, op.kind == kEscaped, out);
+        i++;
+        break;
+      }
+      case kSection: {
+        const json* value = Lookup(op, scopes, depth);
+        if (value && value->is_array()) {
+          for (const auto& element : *value) {
+            scopes[depth] = &element;
+            RenderOps(i + 1, op.end, scopes, depth + 1, out);
+          }
+        } else if (IsTruthy(value)) {
+          scopes[depth] = value->is_object() ? value : scopes[depth - 1];
+          RenderOps(i + 1, op.end, scopes, depth + 1, out);
+        }
+        i = op.end;
+        break;
+      }
+      case kInverted:
+        if (!IsTruthy(Lookup(op, scopes, depth))) {
+          RenderOps(i + 1, op.end, scopes, depth, out);
+        }
+        i = op.end;
+        break;
+    }
+  }
+}
+
+const json* Template::Lookup(const Op& op, const json* const* scopes,
+                             size_t depth) {
+  if (op.path.empty()) return scopes[depth - 1];
+
+  // The first part is looked up in the scopes, the rest in what it found.
+  const json* value = nullptr;
+  for (size_t d = depth; d-- > 0;) {
+    if (!scopes[d]->is_object()) continue;
+    auto it = scopes[d]->find(op.path[0]);
+    if (it != scopes[d]->end()) {
+      value = &*it;
+      break;
+    }
+  }
+  for (size_t i = 1; value && i < op.path.size(); i++) {
+    if (!value->is_object()) return nullptr;
+    auto it = value->find(op.path[i]);
+    value = it != value->end() ? &*it : nullptr;
+  }
+  return value;
+}
+
+TemplateSet::TemplateSet(const std::string& dir, bool reload)
+    : dir_(dir), reload_(reload) {}
+
+TemplateSet::TemplateSet(const EmbeddedFiles& files)
+    : reload_(false), files_(files) {}
+
+Status TemplateSet::Get(const std::string& name, TemplatePtr* tmpl) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(name);
+  if (it != entries_.end() && !reload_) {
+    *tmpl = it->second.tmpl;
+    return OkStatus();
+  }
+
+  if (dir_.empty()) {
+    const EmbeddedFile* file = files_.Find(name);
+    if (!file) return NotFoundError("No template " + name);
+    auto parsed = std::make_shared<Template>();
+    auto st = Template::Parse(file->data, parsed.get());
+    if (!st) return st;
+    entries_[name].tmpl = parsed;
+    *tmpl = std::move(parsed);
+    return OkStatus();
+  }
+
+  if (name.find("..") != std::string::npos) {
+    return InvalidArgumentError("Invalid template name " + name);
+  }
+  std::string path = PathJoin(dir_, name);
+  struct stat st;
+  if (::stat(path.c_str(), &st) != 0) {
+    return NotFoundError("No template " + path);
+  }
+  if (it != entries_.end() && it->second.ino == st.st_ino &&
+      it->second.size == st.st_size && it->second.mtime == st.st_mtime) {
+    *tmpl = it->second.tmpl;
+    return OkStatus();
+  }
+
+  auto parsed = std::make_shared<Template>();
+  auto status = Template::Parse(ReadFile(path), parsed.get());
+  if (!status) {
+    return InvalidArgumentError(path + ": " + status.message().str());
+  }
+  Entry& entry = entries_[name];
+  entry.tmpl = parsed;
+  entry.ino = st.st_ino;
+  entry.size = st.st_size;
+  entry.mtime = st.st_mtime;
+  *tmpl = std::move(parsed);
+  return OkStatus();
+}
+
+Status TemplateSet::Render(const std::string& name, const json& data,
+                           std::string* out) {
+  TemplatePtr tmpl;
+  auto st = Get(name, &tmpl);
+  if (!st) return st;
+  tmpl->Render(data, out);
+  return OkStatus();
+}
+
+}  // namespace html
+}  // namespace cppboot
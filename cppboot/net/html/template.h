@@ -0,0 +1,136 @@
+#ifndef CPPBOOT_NET_HTML_TEMPLATE_H_
+#define CPPBOOT_NET_HTML_TEMPLATE_H_
+
+#include <sys/types.h>
+#include <time.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "cppboot/base/embed.h"
+#include "cppboot/base/json.h"
+#include "cppboot/base/status.h"
+#include "cppboot/base/string_view.h"
+
+namespace cppboot {
+namespace html {
+
+/// An HTML template, parsed once into a list of literal spans and slots
+/// filled from JSON data:
+///
+///   {{name}}        the value of "name", HTML-escaped
+///   {{{name}}}      the value unescaped, also {{& name}}
+///   {{#items}}      the block up to {{/items}} for each element of the
+///                   array "items", once if it is an object or true
+///   {{^items}}      the block if "items" is missing, false, null or empty
+///   {{! comment}}   nothing
+///
+/// Names may be dotted, "user.name", and "." is the current element. A name
+/// is looked up in the elements the blocks iterate over, innermost first,
+/// then in the data. Missing values render as nothing.
+///
+/// Rendering appends the spans and values to the output, and allocates
+/// nothing else, except for array and object values, which are rendered as
+/// JSON text.
+class Template {
+ public:
+  /// Nesting limit of blocks.
+  enum { kMaxDepth = 32 };
+
+  Template() = default;
+
+  /// Parse `source` into `tmpl`.
+  static Status Parse(string_view source, Template* tmpl);
+
+  /// Append the template filled with `data` to `out`.
+  void Render(const json& data, std::string* out) const;
+
+  std::string Render(const json& data) const {
+    std::string out;
+    Render(data, &out);
+    return out;
+  }
+
+ private:
+  enum OpKind {
+    kText,
+    kEscaped,
+    kRaw,
+    kSection,
+    kInverted,
+  };
+
+  struct Op {
+    OpKind kind;
+    /// The span of kText in `source_`.
+    size_t offset;
+    size_t size;
+    /// The dotted name of a slot or block split at the dots, empty for ".".
+    std::vector<std::string> path;
+    /// Past the last op of a block.
+    size_t end;
+  };
+
+  void RenderOps(size_t begin, size_t end, const json** scopes, size_t depth,
+                 std::string* out) const;
+
+  /// The value of `op`, null if missing.
+  static const json* Lookup(const Op& op, const json* const* scopes,
+                            size_t depth);
+
+  std::string source_;
+  std::vector<Op> ops_;
+};
+
+typedef std::shared_ptr<const Template> TemplatePtr;
+
+/// Templates by name, parsed on first use.
+///
+/// In development they are read from a directory, and with `reload` a
+/// template whose file changed is parsed again, checked on every Get(). In
+/// production they are compiled into the program with
+///
+///   cppboot_embed_files(server templates BASE_DIR templates FILES ...)
+///
+/// and read from cppboot::embedded::templates().
+class TemplateSet {
+ public:
+  TemplateSet(const TemplateSet&) = delete;
+  TemplateSet& operator=(const TemplateSet&) = delete;
+
+  /// Templates in the files under `dir`, named by their relative path.
+  explicit TemplateSet(const std::string& dir, bool reload = false);
+
+  /// Templates embedded at build time.
+  explicit TemplateSet(const EmbeddedFiles& files);
+
+  /// The template `name`. May be called from any thread.
+  Status Get(const std::string& name, TemplatePtr* tmpl);
+
+  /// Render the template `name` with `data`, appending to `out`.
+  Status Render(const std::string& name, const json& data, std::string* out);
+
+ private:
+  struct Entry {
+    TemplatePtr tmpl;
+    /// Identity of the file it was parsed from.
+    ino_t ino;
+    off_t size;
+    time_t mtime;
+  };
+
+  std::string dir_;
+  bool reload_;
+  EmbeddedFiles files_;
+
+  std::mutex mutex_;
+  std::map<std::string, Entry> entries_;
+};
+
+}  // namespace html
+}  // namespace cppboot
+
+#endif  // CPPBOOT_NET_HTML_TEMPLATE_H_
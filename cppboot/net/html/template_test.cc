@@ -0,0 +1,158 @@
+#include "gmock/gmock.h"
+
+#include <stdint.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+
+#include "cppboot/base/fs.h"
+#include "cppboot/net/html/template.h"
+#if CPPBOOT_TEST_EMBED
+#include "html_test_templates.h"
+#endif
+
+namespace {
+
+using cppboot::json;
+using cppboot::html::Template;
+using cppboot::html::TemplatePtr;
+using cppboot::html::TemplateSet;
+
+std::string Render(const std::string& source, const json& data) {
+  Template tmpl;
+  auto st = Template::Parse(source, &tmpl);
+  EXPECT_TRUE(st) << st.ToString();
+  return tmpl.Render(data);
+}
+
+TEST(Template, Slots) {
+  json data = {{"name", "<b>Tom & Jerry</b>"},
+               {"count", 3},
+               {"ok", true},
+               {"user", {{"email", "tom@example.com"}}}};
+  ASSERT_EQ(Render("Hi {{name}}!", data),
+            "Hi &lt;b&gt;Tom &amp; Jerry&lt;/b&gt;!");
+  ASSERT_EQ(Render("{{{name}}}|{{& name}}", data),
+            "<b>Tom & Jerry</b>|<b>Tom & Jerry</b>");
+  ASSERT_EQ(Render("{{ count }} {{ok}} {{user.email}}", data),
+            "3 true tom@example.com");
+  ASSERT_EQ(Render("[{{missing}}{{user.missing}}{{! note }}]", data), "[]");
+  ASSERT_EQ(Render("no tags", data), "no tags");
+  ASSERT_EQ(Render("", data), "");
+}
+
+TEST(Template, Numbers) {
+  json data = {{"negative", INT64_MIN},
+               {"unsigned", UINT64_MAX},
+               {"float", 2.5},
+               {"whole", 3.0}};
+  // As JSON writes them.
+  ASSERT_EQ(Render("{{negative}} {{unsigned}} {{float}} {{whole}}", data),
+            "-9223372036854775808 18446744073709551615 2.5 3.0");
+}
+
+TEST(Template, Sections) {
+  json data = {
+      {"title", "Todo"},
+      {"items", {{{"name", "a"}, {"done", true}}, {{"name", "b"}}}},
+      {"tags", {"x", "y"}},
+      {"none", json::array()},
+      {"user", {{"name", "tom"}}},
+  };
+  ASSERT_EQ(Render("{{#items}}{{name}}{{#done}}!{{/done}} {{/items}}", data),
+            "a! b ");
+  // Outer names are visible inside blocks.
+  ASSERT_EQ(Render("{{#items}}{{title}}.{{name}} {{/items}}", data),
+            "Todo.a Todo.b ");
+  ASSERT_EQ(Render("{{#tags}}<{{.}}>{{/tags}}", data), "<x><y>");
+  ASSERT_EQ(Render("{{#user}}{{name}}{{/user}}", data), "tom");
+  ASSERT_EQ(Render("{{#none}}x{{/none}}{{^none}}empty{{/none}}", data),
+            "empty");
+  ASSERT_EQ(Render("{{^missing}}no{{/missing}}{{^title}}x{{/title}}", data),
+            "no");
+}
+
+TEST(Template, ParseErrors) {
+  Template tmpl;
+  ASSERT_FALSE(Template::Parse("a {{b", &tmpl));
+  ASSERT_FALSE(Template::Parse("{{#a}}x", &tmpl));
+  ASSERT_FALSE(Template::Parse("{{#a}}x{{/b}}", &tmpl));
+  ASSERT_FALSE(Template::Parse("x{{/a}}", &tmpl));
+  ASSERT_FALSE(Template::Parse("{{}}", &tmpl));
+  auto st = Template::Parse("line\n{{#a}}\n", &tmpl);
+  ASSERT_THAT(st.ToString(), ::testing::HasSubstr("Unclosed block a"));
+  st = Template::Parse("line\n\n{{oops", &tmpl);
+  ASSERT_THAT(st.ToString(), ::testing::HasSubstr("line 3"));
+}
+
+TEST(Template, AppendsToOutput) {
+  Template tmpl;
+  ASSERT_TRUE(Template::Parse("<p>{{x}}</p>", &tmpl));
+  std::string out = "<body>";
+  tmpl.Render({{"x", 1}}, &out);
+  tmpl.Render({{"x", 2}}, &out);
+  ASSERT_EQ(out, "<body><p>1</p><p>2</p>");
+}
+
+TEST(TemplateSet, Reload) {
+  std::string dir = cppboot::GetTempPath("template_set_test");
+  cppboot::RemoveAll(dir).IgnoreError();
+  ASSERT_TRUE(cppboot::MkdirAll(dir));
+  std::string path = cppboot::PathJoin(dir, "page.html");
+  ASSERT_TRUE(cppboot::WriteFile(path, "v1 {{x}}"));
+
+  TemplateSet fixed(dir);
+  TemplateSet reloading(dir, true);
+  std::string out;
+  ASSERT_TRUE(fixed.Render("page.html", {{"x", 1}}, &out));
+  ASSERT_TRUE(reloading.Render("page.html", {{"x", 1}}, &out));
+  ASSERT_EQ(out, "v1 1v1 1");
+
+  TemplatePtr first, same;
+  ASSERT_TRUE(reloading.Get("page.html", &first));
+  ASSERT_TRUE(reloading.Get("page.html", &same));
+  ASSERT_EQ(first, same);
+
+  // Another size, so the change is seen within the same second.
+  ASSERT_TRUE(cppboot::WriteFile(path, "v22 {{x}}"));
+  out.clear();
+  ASSERT_TRUE(fixed.Render("page.html", {{"x", 2}}, &out));
+  ASSERT_TRUE(reloading.Render("page.html", {{"x", 2}}, &out));
+  ASSERT_EQ(out, "v1 2v22 2");
+
+  // A broken template is reported, the file named.
+  ASSERT_TRUE(cppboot::WriteFile(path, "{{#x}}"));
+  auto st = reloading.Render("page.html", json::object(), &out);
+  ASSERT_FALSE(st);
+  ASSERT_THAT(st.ToString(), ::testing::HasSubstr("page.html"));
+
+  ASSERT_FALSE(fixed.Get("missing.html", &first));
+  ASSERT_FALSE(fixed.Get("../page.html", &first));
+  cppboot::RemoveAll(dir).IgnoreError();
+}
+
+#if CPPBOOT_TEST_EMBED
+TEST(TemplateSet, Embedded) {
+  auto files = cppboot::embedded::html_test_templates();
+  ASSERT_EQ(files.size(), 1);
+  ASSERT_TRUE(files.Find("page.html"));
+  ASSERT_FALSE(files.Find("other.html"));
+
+  TemplateSet templates(files);
+  std::string out;
+  json data = {{"title", "List"},
+               {"items", {{{"name", "a"}}, {{"name", "b"}}}}};
+  ASSERT_TRUE(templates.Render("page.html", data, &out));
+  ASSERT_EQ(out,
+            "<h1>List</h1>\n"
+            "<ul>\n"
+            "  <li>a</li>\n"
+            "  <li>b</li>\n"
+            "</ul>\n");
+  TemplatePtr tmpl;
+  ASSERT_FALSE(templates.Get("missing.html", &tmpl));
+}
+#endif  // CPPBOOT_TEST_EMBED
+
+}  // namespace
@@ -0,0 +1,509 @@
+#include "cppboot/net/http/async_client.h"
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+#include "cppboot/net/http/response_parser.h"
+
+namespace cppboot {
+namespace http {
+
+using asio::ip::tcp;
+
+namespace {
+
+const size_t kReadBufferSize = 16 * 1024;
+
+}  // namespace
+
+struct AsyncClient::Host {
+  Host() : active(0) {}
+
+  /// Requests holding a connection.
+  size_t active;
+  /// Requests waiting for one.
+  std::deque<std::shared_ptr<Call>> queue;
+  /// Idle connections, the most recently used last.
+  std::vector<std::unique_ptr<tcp::socket>> idle;
+};
+
+/// Everything the requests share, they keep it alive while their handlers
+/// are pending.
+struct AsyncClient::State {
+  State(asio::io_context& io_context, const Options& options)
+      : io_context(io_context), options(options), next_id(1) {}
+
+  asio::io_context& io_context;
+  Options options;
+  std::atomic<uint64_t> next_id;
+
+  std::map<std::string, Host> hosts;
+
+  /// Requests not finished yet. Registered by the thread calling Do(), so
+  /// that a Cancel() right after it finds the request.
+  std::mutex calls_mutex;
+  std::map<uint64_t, std::weak_ptr<Call>> calls;
+};
+
+/// One request, from waiting for a connection to calling back.
+class AsyncClient::Call : public std::enable_shared_from_this<Call> {
+ public:
+  Call(const std::shared_ptr<State>& state, uint64_t id, const Request& req,
+       const Timeouts& timeouts, const BodySink* sink, Callback cb,
+       Response* out)
+      : state_(state),
+        id_(id),
+        req_(req),
+        timeouts_(timeouts),
+        cb_(std::move(cb)),
+        out_(out ? out : &resp_),
+        resolver_(state->io_context),
+        total_timer_(state->io_context),
+        io_timer_(state->io_context),
+        timer_seq_(0),
+        parser_(req.method),
+        buffer_(kReadBufferSize),
+        launched_(false),
+        reused_(false),
+        received_(false),
+        streamed_(false),
+        paused_(false),
+        done_(false) {
+    if (sink) {
+      sink_ = *sink;
+      parser_.set_body_sink(&sink_);
+    }
+  }
+
+  void Start() {
+    // Cancelled before it started.
+    if (done_) return;
+
+    if (!req_.url.IsValid()) {
+      Finish(InvalidArgumentError("Invalid url"));
+      return;
+    }
+    if (req_.body_source && req_.body_source.size < 0) {
+      Finish(InvalidArgumentError("Body of unknown size"));
+      return;
+    }
+
+    if (timeouts_.total.count() > 0) {
+      auto self(shared_from_this());
+      total_timer_.expires_after(timeouts_.total);
+      total_timer_.async_wait([this, self](std::error_code ec) {
+        if (!ec) Finish(DeadlineExceededError("Request timed out"));
+      });
+    }
+
+    Host& host = state_->hosts[req_.url.host];
+    size_t limit = state_->options.max_conns_per_host;
+    if (limit == 0 || host.active < limit) {
+      host.active++;
+      Launch();
+    } else {
+      host.queue.push_back(shared_from_this());
+    }
+  }
+
+  /// Run the request on an idle connection or a new one.
+  void Launch() {
+    launched_ = true;
+    auto& idle = state_->hosts[req_.url.host].idle;
+    if (!idle.empty()) {
+      socket_ = std::move(idle.back());
+      idle.pop_back();
+      reused_ = true;
+      Send();
+    } else {
+      Connect();
+    }
+  }
+
+  void Finish(const Status& status) {
+    if (done_) return;
+
+    if (launched_) {
+      Host& host = state_->hosts[req_.url.host];
+      if (status && parser_.keep_alive() &&
+          host.idle.size() < state_->options.max_idle_per_host) {
+        host.idle.push_back(std::move(socket_));
+      }
+      host.active--;
+    }
+    Stop();
+    {
+      std::lock_guard<std::mutex> lock(state_->calls_mutex);
+      state_->calls.erase(id_);
+    }
+    if (launched_) Next(state_->hosts[req_.url.host]);
+
+    if (cb_) cb_(status, out_);
+  }
+
+  /// Stop without calling back.
+  void Stop() {
+    done_ = true;
+    asio::error_code ignored_ec;
+    total_timer_.cancel(ignored_ec);
+    io_timer_.cancel(ignored_ec);
+    resolver_.cancel();
+    if (socket_) socket_->close(ignored_ec);
+    work_.reset();
+    parked_.reset();
+  }
+
+  void Pause() { paused_ = true; }
+
+  void Resume() {
+    paused_ = false;
+    if (parked_ && !done_) {
+      auto self = std::move(parked_);
+      work_.reset();
+      Read();
+    }
+  }
+
+  bool done() const { return done_; }
+
+ private:
+  void Connect() {
+    auto self(shared_from_this());
+    socket_.reset(new tcp::socket(state_->io_context));
+    Arm(timeouts_.connect, "Connect timed out");
+    if (auto dns_cache = state_->options.dns_cache) {
+      dns_cache->AsyncResolve(
+          state_->io_context, req_.url.hostname(), req_.url.port(),
+          [this, self](const Status& status,
+                       net::DnsCache::EndpointsPtr endpoints) {
+            if (done_) return;
+            if (!status) {
+              Finish(status);
+              return;
+            }
+            ConnectTo(endpoints);
+          });
+      return;
+    }
+
+    resolver_.async_resolve(
+        req_.url.hostname(), req_.url.port(),
+        [this, self](std::error_code ec, tcp::resolver::results_type results) {
+          if (done_) return;
+          if (ec) {
+            Finish(UnavailableError(ec.message()));
+            return;
+          }
+          auto endpoints = std::make_shared<net::DnsCache::Endpoints>();
+          for (auto& r : results) endpoints->push_back(r.endpoint());
+          ConnectTo(endpoints);
+        });
+  }
+
+  void ConnectTo(const net::DnsCache::EndpointsPtr& endpoints) {
+    auto self(shared_from_this());
+    asio::async_connect(
+        *socket_, *endpoints,
+        [this, self, endpoints](std::error_code ec, const tcp::endpoint&) {
+          if (done_) return;
+          if (ec) {
+            Finish(UnavailableError(ec.message()));
+            return;
+          }
+          socket_->set_option(tcp::no_delay(true), ec);
+          Send();
+        });
+  }
+
+  void Send() {
+    auto self(shared_from_this());
+    request_.consume(request_.size());
+    req_.to_buffers(&request_, state_->options.max_idle_per_host > 0);
+    Arm(timeouts_.read, "Read timed out");
+    asio::async_write(*socket_, request_,
+                      [this, self](std::error_code ec, std::size_t) {
+                        if (done_) return;
+                        if (ec) {
+                          Retry(UnavailableError(ec.message()));
+                          return;
+                        }
+                        if (req_.body_source) {
+                          SendBody();
+                        } else {
+                          Read();
+                        }
+                      });
+  }
+
+  /// Send the next piece of the request's body_source, then read.
+  void SendBody() {
+    auto self(shared_from_this());
+    streamed_ = true;
+    req_.body_source.read([this, self](const Status& status,
+                                       string_view data) {
+      asio::dispatch(state_->io_context, [this, self, status, data]() {
+        if (done_) return;
+        if (!status) {
+          Finish(status);
+          return;
+        }
+        if (data.empty()) {
+          Read();
+          return;
+        }
+
+        Arm(timeouts_.read, "Read timed out");
+        asio::async_write(*socket_, asio::buffer(data.data(), data.size()),
+                          [this, self](std::error_code ec, std::size_t) {
+                            if (done_) return;
+                            if (ec) {
+                              Finish(UnavailableError(ec.message()));
+                              return;
+                            }
+                            SendBody();
+                          });
+      });
+    });
+  }
+
+  void Read() {
+    auto self(shared_from_this());
+    Arm(timeouts_.read, "Read timed out");
+    socket_->async_read_some(
+        asio::buffer(buffer_),
+        [this, self](std::error_code ec, std::size_t bytes_transferred) {
+          if (done_) return;
+
+          ResponseParser::result_type result;
+          if (ec == asio::error::eof) {
+            result = parser_.eof();
+          } else if (ec) {
+            Retry(UnavailableError(ec.message()));
+            return;
+          } else {
+            received_ = true;
+            std::tie(result, std::ignore) = parser_.parse(
+                *out_, buffer_.data(), buffer_.data() + bytes_transferred);
+          }
+
+          if (result == ResponseParser::bad) {
+            if (!parser_.sink_status()) {
+              Finish(parser_.sink_status());
+            } else if (ec) {
+              Retry(UnavailableError("Incomplete response"));
+            } else {
+              Finish(InvalidArgumentError("Invalid response"));
+            }
+          } else if (result == ResponseParser::good) {
+            Finish(OkStatus());
+          } else if (paused_) {
+            // No handler is pending meanwhile, hold the call and the
+            // io_context until Resume().
+            Arm(std::chrono::milliseconds(0), nullptr);
+            parked_ = self;
+            work_.reset(new Work(state_->io_context.get_executor()));
+          } else {
+            Read();
+          }
+        });
+  }
+
+  /// A pooled connection may have been closed by the server meanwhile, send
+  /// once more on a new one if nothing was received. Only idempotent
+  /// requests, the server may have run the request before closing.
+  void Retry(const Status& status) {
+    if (!reused_ || received_ || streamed_ || !req_.IsIdempotent()) {
+      Finish(status);
+      return;
+    }
+
+    reused_ = false;
+    parser_.reset(req_.method);
+    Connect();
+  }
+
+  /// (Re)start the timer of the current step.
+  void Arm(std::chrono::milliseconds timeout, const char* message) {
+    asio::error_code ignored_ec;
+    if (timeout.count() <= 0) {
+      ++timer_seq_;
+      io_timer_.cancel(ignored_ec);
+      return;
+    }
+
+    // A handler may already be queued when the timer is moved, the
+    // sequence number tells that it is stale.
+    auto self(shared_from_this());
+    unsigned seq = ++timer_seq_;
+    io_timer_.expires_after(timeout);
+    io_timer_.async_wait([this, self, message, seq](std::error_code ec) {
+      if (!ec && seq == timer_seq_) Finish(DeadlineExceededError(message));
+    });
+  }
+
+  /// Launch the first live request waiting for `host`.
+  void Next(Host& host) {
+    while (!host.queue.empty()) {
+      std::shared_ptr<Call> next = host.queue.front();
+      host.queue.pop_front();
+      if (!next->done()) {
+        host.active++;
+        next->Launch();
+        return;
+      }
+    }
+  }
+
+  std::shared_ptr<State> state_;
+  uint64_t id_;
+  Request req_;
+  Timeouts timeouts_;
+  Callback cb_;
+  BodySink sink_;
+  Response resp_;
+  Response* out_;
+
+  tcp::resolver resolver_;
+  std::unique_ptr<tcp::socket> socket_;
+  asio::steady_timer total_timer_;
+  asio::steady_timer io_timer_;
+  unsigned timer_seq_;
+  asio::streambuf request_;
+  ResponseParser parser_;
+  std::vector<char> buffer_;
+
+  bool launched_;
+  /// Whether `socket_` came from the pool.
+  bool reused_;
+  /// Whether any response byte arrived.
+  bool received_;
+  /// Whether the body_source was read from, it can not be sent again.
+  bool streamed_;
+  bool paused_;
+  bool done_;
+
+  /// While paused with a read due: the call itself, and work keeping the
+  /// io_context running.
+  typedef asio::executor_work_guard<asio::io_context::executor_type> Work;
+  std::shared_ptr<Call> parked_;
+  std::unique_ptr<Work> work_;
+};
+
+AsyncClient::AsyncClient(asio::io_context& io_context, const Options& options)
+    : state_(std::make_shared<State>(io_context, options)) {}
+
+AsyncClient::~AsyncClient() {
+  std::map<uint64_t, std::weak_ptr<Call>> calls;
+  {
+    std::lock_guard<std::mutex> lock(state_->calls_mutex);
+    calls.swap(state_->calls);
+  }
+  for (auto& i : calls) {
+    if (auto call = i.second.lock()) call->Stop();
+  }
+  state_->hosts.clear();
+}
+
+uint64_t AsyncClient::Do(const Request& req, Callback cb) {
+  return Start(req, state_->options.timeouts, nullptr, std::move(cb),
+               nullptr);
+}
+
+uint64_t AsyncClient::Do(const Request& req, const Timeouts& timeouts,
+                         Callback cb) {
+  return Start(req, timeouts, nullptr, std::move(cb), nullptr);
+}
+
+uint64_t AsyncClient::Do(const Request& req, const Timeouts& timeouts,
+                         const BodySink& sink, Callback cb) {
+  return Start(req, timeouts, &sink, std::move(cb), nullptr);
+}
+
+void AsyncClient::Cancel(uint64_t id) {
+  WithCall(id, [](Call* call) { call->Finish(CancelledError("Cancelled")); });
+}
+
+void AsyncClient::Pause(uint64_t id) {
+  WithCall(id, [](Call* call) { call->Pause(); });
+}
+
+void AsyncClient::Resume(uint64_t id) {
+  WithCall(id, [](Call* call) { call->Resume(); });
+}
+
+void AsyncClient::WithCall(uint64_t id, std::function<void(Call*)> f) {
+  // Dispatched, so that a callback pausing its own request takes effect
+  // before the next read.
+  std::weak_ptr<State> weak_state = state_;
+  asio::dispatch(state_->io_context, [weak_state, id, f]() {
+    auto state = weak_state.lock();
+    if (!state) return;
+
+    std::shared_ptr<Call> call;
+    {
+      std::lock_guard<std::mutex> lock(state->calls_mutex);
+      auto it = state->calls.find(id);
+      if (it == state->calls.end()) return;
+      call = it->second.lock();
+    }
+    if (call) f(call.get());
+  });
+}
+
+void AsyncClient::DoAll(const std::vector<Request>& reqs, BatchCallback cb) {
+  struct Batch {
+    std::vector<Result> results;
+    size_t left;
+    BatchCallback cb;
+  };
+
+  auto batch = std::make_shared<Batch>();
+  batch->results.resize(reqs.size());
+  batch->left = reqs.size();
+  batch->cb = std::move(cb);
+  if (reqs.empty()) {
+    asio::post(state_->io_context, [batch]() { batch->cb(batch->results); });
+    return;
+  }
+
+  for (size_t i = 0; i < reqs.size(); i++) {
+    Start(reqs[i], state_->options.timeouts, nullptr,
+          [batch, i](const Status& status, Response*) {
+            batch->results[i].status = status;
+            if (--batch->left == 0) batch->cb(batch->results);
+          },
+          &batch->results[i].response);
+  }
+}
+
+std::vector<AsyncClient::Result> AsyncClient::FetchAll(
+    const std::vector<Request>& reqs, const Options& options) {
+  asio::io_context io_context(1);
+  std::vector<Result> results;
+  {
+    AsyncClient client(io_context, options);
+    client.DoAll(reqs, [&](std::vector<Result>& r) { results.swap(r); });
+    io_context.run();
+  }
+  return results;
+}
+
+uint64_t AsyncClient::Start(const Request& req, const Timeouts& timeouts,
+                            const BodySink* sink, Callback cb, Response* out) {
+  uint64_t id = state_->next_id++;
+  auto call = std::make_shared<Call>(state_, id, req, timeouts, sink,
+                                     std::move(cb), out);
+  {
+    std::lock_guard<std::mutex> lock(state_->calls_mutex);
+    state_->calls[id] = call;
+  }
+  asio::post(state_->io_context, [call]() { call->Start(); });
+  return id;
+}
+
+}  // namespace http
+}  // namespace cppboot
@@ -0,0 +1,122 @@
+#ifndef CPPBOOT_NET_HTTP_ASYNC_CLIENT_H_
+#define CPPBOOT_NET_HTTP_ASYNC_CLIENT_H_
+
+#include <stdint.h>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "asio.hpp"
+
+#include "cppboot/base/status.h"
+#include "cppboot/net/dns_cache.h"
+#include "cppboot/net/http/body_sink.h"
+#include "cppboot/net/http/request.h"
+#include "cppboot/net/http/response.h"
+
+namespace cppboot {
+namespace http {
+
+/// HTTP/1.1 client driven by an io_context, so one thread keeps many
+/// requests in flight. Connections are pooled per host like Client does, and
+/// at most Options::max_conns_per_host requests run per host at a time, the
+/// others wait in order.
+///
+/// The io_context should be run by a single thread. Do(), DoAll() and
+/// Cancel() may be called from any thread, callbacks run on the io_context.
+/// Destroy the client on that thread or when the io_context is not running:
+/// requests still in flight are then dropped without calling back.
+///
+/// Unlike Client::Do(), any complete response succeeds, check its status.
+class AsyncClient {
+ public:
+  /// Deadlines of a request, zero disables one. A deadline that passes
+  /// fails the request with DeadlineExceededError.
+  struct Timeouts {
+    Timeouts() : connect(0), read(0), total(0) {}
+
+    /// Resolving the host and connecting to it.
+    std::chrono::milliseconds connect;
+    /// Sending the request, then waiting for each piece of the response.
+    std::chrono::milliseconds read;
+    /// The whole request, including waiting for a connection to the host.
+    std::chrono::milliseconds total;
+  };
+
+  struct Options {
+    Options()
+        : max_conns_per_host(6),
+          max_idle_per_host(4),
+          dns_cache(&net::DnsCache::Default()) {}
+
+    Timeouts timeouts;
+    /// Requests in flight per host, 0 is unlimited.
+    size_t max_conns_per_host;
+    /// Idle connections kept per host, 0 closes each after its request.
+    size_t max_idle_per_host;
+    /// Resolves host names without blocking, nullptr resolves each time a
+    /// connection is made.
+    net::DnsCache* dns_cache;
+  };
+
+  /// Called once with the outcome, `resp` is valid during the call.
+  typedef std::function<void(const Status& status, Response* resp)> Callback;
+
+  struct Result {
+    Status status;
+    Response response;
+  };
+  /// Called once all requests of a batch finished, results in request order.
+  typedef std::function<void(std::vector<Result>& results)> BatchCallback;
+
+  AsyncClient(const AsyncClient&) = delete;
+  AsyncClient& operator=(const AsyncClient&) = delete;
+
+  explicit AsyncClient(asio::io_context& io_context,
+                       const Options& options = Options());
+  ~AsyncClient();
+
+  /// Start `req`, the returned id can cancel it.
+  uint64_t Do(const Request& req, Callback cb);
+  uint64_t Do(const Request& req, const Timeouts& timeouts, Callback cb);
+
+  /// Stream the body into `sink` instead of Response::content.
+  uint64_t Do(const Request& req, const Timeouts& timeouts,
+              const BodySink& sink, Callback cb);
+
+  /// Fail the request `id` with CancelledError, unless it already finished.
+  void Cancel(uint64_t id);
+
+  /// Stop reading the response of `id` after the piece being delivered, e.g.
+  /// from a BodySink whose consumer is full, until Resume(). The read
+  /// timeout does not run meanwhile, the total one does.
+  void Pause(uint64_t id);
+  void Resume(uint64_t id);
+
+  /// Start all `reqs` at once and gather their results.
+  void DoAll(const std::vector<Request>& reqs, BatchCallback cb);
+
+  /// Run `reqs` concurrently on a private io_context and wait for all.
+  static std::vector<Result> FetchAll(const std::vector<Request>& reqs,
+                                      const Options& options = Options());
+
+ private:
+  class Call;
+  struct Host;
+  struct State;
+
+  uint64_t Start(const Request& req, const Timeouts& timeouts,
+                 const BodySink* sink, Callback cb, Response* out);
+
+  /// Run `f` on the request `id` on the io_context, if it is in flight.
+  void WithCall(uint64_t id, std::function<void(Call*)> f);
+
+  std::shared_ptr<State> state_;
+};
+
+}  // namespace http
+}  // namespace cppboot
+
+#endif  // CPPBOOT_NET_HTTP_ASYNC_CLIENT_H_
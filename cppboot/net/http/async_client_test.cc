@@ -0,0 +1,232 @@
+#include "gmock/gmock.h"
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "asio.hpp"
+
+#include "cppboot/net/http/async_client.h"
+
+namespace {
+
+using asio::ip::tcp;
+using cppboot::http::AsyncClient;
+using cppboot::http::Request;
+using cppboot::http::Response;
+
+/// A keep-alive server with a thread per connection. "GET /<ms>/<body>"
+/// answers <body> after <ms> milliseconds, "<text>*<n>" repeats <text>.
+class SlowServer {
+ public:
+  explicit SlowServer(unsigned short port)
+      : acceptor_(io_context_,
+                  tcp::endpoint(asio::ip::address_v4::loopback(), port)),
+        active_(0),
+        max_active_(0),
+        stopped_(false) {
+    thread_ = std::thread([this]() { Run(); });
+  }
+
+  ~SlowServer() {
+    stopped_ = true;
+    tcp::socket socket(io_context_);
+    asio::error_code ec;
+    socket.connect(acceptor_.local_endpoint(), ec);
+    thread_.join();
+    for (auto& t : conns_) t.join();
+  }
+
+  int max_active() const { return max_active_; }
+
+ private:
+  void Run() {
+    for (;;) {
+      std::shared_ptr<tcp::socket> socket(new tcp::socket(io_context_));
+      asio::error_code ec;
+      acceptor_.accept(*socket, ec);
+      if (ec || stopped_) return;
+      conns_.emplace_back([this, socket]() { Serve(socket.get()); });
+    }
+  }
+
+  void Serve(tcp::socket* socket) {
+    asio::streambuf buf;
+    asio::error_code ec;
+    for (;;) {
+      size_t n = asio::read_until(*socket, buf, "\r\n\r\n", ec);
+      if (ec) return;
+      std::string head(static_cast<const char*>(buf.data().data()), n);
+      buf.consume(n);
+
+      int active = ++active_;
+      int max = max_active_;
+      while (active > max && !max_active_.compare_exchange_weak(max, active)) {
+      }
+
+      // "GET /<ms>/<body> HTTP/1.1"
+      size_t slash = head.find('/', 5);
+      int ms = atoi(head.c_str() + 5);
+      std::string body = head.substr(slash + 1, head.find(' ', 5) - slash - 1);
+      size_t star = body.find('*');
+      if (star != std::string::npos) {
+        std::string text = body.substr(0, star);
+        int n = atoi(body.c_str() + star + 1);
+        body.clear();
+        for (int i = 0; i < n; i++) body += text;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+      --active_;
+
+      std::string reply = "HTTP/1.1 200 OK\r\nContent-Length: " +
+                          std::to_string(body.size()) + "\r\n\r\n" + body;
+      asio::write(*socket, asio::buffer(reply), ec);
+      if (ec) return;
+    }
+  }
+
+  asio::io_context io_context_;
+  tcp::acceptor acceptor_;
+  std::atomic<int> active_;
+  std::atomic<int> max_active_;
+  std::atomic<bool> stopped_;
+  std::thread thread_;
+  std::vector<std::thread> conns_;
+};
+
+std::string Url(int ms, const std::string& body) {
+  return "http://127.0.0.1:59994/" + std::to_string(ms) + "/" + body;
+}
+
+TEST(AsyncClient, FetchAllLimitsConnectionsPerHost) {
+  SlowServer server(59994);
+
+  std::vector<Request> reqs;
+  for (int i = 0; i < 8; i++) {
+    reqs.emplace_back("GET", Url(20, "r" + std::to_string(i)));
+  }
+
+  AsyncClient::Options options;
+  options.max_conns_per_host = 2;
+  auto results = AsyncClient::FetchAll(reqs, options);
+
+  ASSERT_EQ(results.size(), 8);
+  for (int i = 0; i < 8; i++) {
+    ASSERT_TRUE(results[i].status) << results[i].status.ToString();
+    ASSERT_EQ(results[i].response.status, Response::ok);
+    ASSERT_EQ(results[i].response.content, "r" + std::to_string(i));
+  }
+  ASSERT_EQ(server.max_active(), 2);
+}
+
+TEST(AsyncClient, ReadTimeout) {
+  SlowServer server(59994);
+  asio::io_context io_context;
+  AsyncClient client(io_context);
+
+  AsyncClient::Timeouts timeouts;
+  timeouts.read = std::chrono::milliseconds(30);
+  cppboot::Status st;
+  client.Do(Request("GET", Url(300, "late")), timeouts,
+            [&](const cppboot::Status& status, Response*) { st = status; });
+
+  auto start = std::chrono::steady_clock::now();
+  io_context.run();
+  ASSERT_TRUE(cppboot::IsDeadlineExceeded(st)) << st.ToString();
+  ASSERT_LT(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(250));
+}
+
+TEST(AsyncClient, Cancel) {
+  SlowServer server(59994);
+  asio::io_context io_context;
+  AsyncClient client(io_context);
+
+  int calls = 0;
+  cppboot::Status slow_st, started_st;
+  auto id = client.Do(Request("GET", Url(300, "slow")),
+                      [&](const cppboot::Status& status, Response*) {
+                        calls++;
+                        slow_st = status;
+                      });
+  client.Do(Request("GET", Url(0, "fast")),
+            [&](const cppboot::Status& status, Response* resp) {
+              calls++;
+              ASSERT_TRUE(status) << status.ToString();
+              ASSERT_EQ(resp->content, "fast");
+              client.Cancel(id);
+
+              // Cancelled on the io_context right after it was started.
+              auto started = client.Do(
+                  Request("GET", Url(0, "never")),
+                  [&](const cppboot::Status& status, Response*) {
+                    calls++;
+                    started_st = status;
+                  });
+              client.Cancel(started);
+            });
+
+  io_context.run();
+  ASSERT_EQ(calls, 3);
+  ASSERT_TRUE(cppboot::IsCancelled(slow_st)) << slow_st.ToString();
+  ASSERT_TRUE(cppboot::IsCancelled(started_st)) << started_st.ToString();
+}
+
+TEST(AsyncClient, ConnectError) {
+  asio::io_context io_context;
+  AsyncClient client(io_context);
+
+  cppboot::Status st;
+  client.Do(Request("GET", "http://127.0.0.1:1/"),
+            [&](const cppboot::Status& status, Response*) { st = status; });
+  io_context.run();
+  ASSERT_TRUE(cppboot::IsUnavailable(st)) << st.ToString();
+}
+
+TEST(AsyncClient, StreamWithBackpressure) {
+  SlowServer server(59994);
+  asio::io_context io_context;
+  AsyncClient client(io_context);
+
+  // Pause after the first piece, resume a while later.
+  uint64_t id = 0;
+  size_t pieces = 0, received = 0;
+  int64_t total = 0;
+  cppboot::http::BodySink sink;
+  sink.on_data = [&](cppboot::string_view data) {
+    if (pieces++ == 0) client.Pause(id);
+    received += data.size();
+    return cppboot::OkStatus();
+  };
+  sink.on_progress = [&](uint64_t, int64_t t) { total = t; };
+
+  size_t pieces_while_paused = 0;
+  asio::steady_timer timer(io_context, std::chrono::milliseconds(50));
+  timer.async_wait([&](std::error_code) {
+    pieces_while_paused = pieces;
+    client.Resume(id);
+  });
+
+  cppboot::Status st;
+  Response resp;
+  id = client.Do(Request("GET", Url(0, "0123456789*100000")),
+                 AsyncClient::Timeouts(), sink,
+                 [&](const cppboot::Status& status, Response* r) {
+                   st = status;
+                   resp.status = r->status;
+                   ASSERT_TRUE(r->content.empty());
+                 });
+  io_context.run();
+
+  ASSERT_TRUE(st) << st.ToString();
+  ASSERT_EQ(resp.status, Response::ok);
+  ASSERT_EQ(pieces_while_paused, 1);
+  ASSERT_GT(pieces, 1);
+  ASSERT_EQ(received, 1000000);
+  ASSERT_EQ(total, 1000000);
+}
+
+}  // namespace
@@ -0,0 +1,26 @@
+#include "cppboot/net/http/body_sink.h"
+
+#include <errno.h>
+#include <unistd.h>
+
+namespace cppboot {
+namespace http {
+
+BodySink BodySink::ToFd(int fd) {
+  BodySink sink;
+  sink.on_data = [fd](string_view data) {
+    while (!data.empty()) {
+      ssize_t n = ::write(fd, data.data(), data.size());
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        return ErrnoToStatus(errno, "failed to write body");
+      }
+      data.remove_prefix(n);
+    }
+    return OkStatus();
+  };
+  return sink;
+}
+
+}  // namespace http
+}  // namespace cppboot
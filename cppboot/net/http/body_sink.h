@@ -0,0 +1,60 @@
+#ifndef CPPBOOT_NET_HTTP_BODY_SINK_H_
+#define CPPBOOT_NET_HTTP_BODY_SINK_H_
+
+#include <stdint.h>
+
+#include <functional>
+
+#include "cppboot/base/status.h"
+#include "cppboot/base/string_view.h"
+
+namespace cppboot {
+namespace http {
+
+struct Response;
+
+/// Receives a response body as it arrives instead of Response::content, so
+/// downloads take constant memory. The next bytes are only read once
+/// `on_data` returned, a slow consumer thus slows down the sender.
+struct BodySink {
+  /// Called with each piece of the body, a failure aborts the request.
+  typedef std::function<Status(string_view data)> DataFunc;
+  /// Called after each piece with the bytes received so far and the total,
+  /// -1 if the response does not tell it.
+  typedef std::function<void(uint64_t received, int64_t total)> ProgressFunc;
+  /// Called once the status line and headers arrived, before the body.
+  typedef std::function<void(const Response& resp)> HeadFunc;
+
+  DataFunc on_data;
+  ProgressFunc on_progress;
+  HeadFunc on_head;
+
+  /// A sink writing to the file descriptor `fd`, which stays open.
+  static BodySink ToFd(int fd);
+};
+
+/// Produces a body while it is sent, after the in-memory content of the
+/// message, e.g. a request body relayed from a client. The next piece is only
+/// asked for once the previous one was sent.
+struct BodySource {
+  /// Called with the next piece, empty at the end. The piece must stay valid
+  /// until the next read.
+  typedef std::function<void(const Status& status, string_view data)>
+      ReadCallback;
+  typedef std::function<void(ReadCallback cb)> ReadFunc;
+
+  BodySource() : size(-1) {}
+
+  explicit operator bool() const noexcept { return read != nullptr; }
+
+  /// Produce the next piece and pass it to `cb`, now or later from any
+  /// thread.
+  ReadFunc read;
+  /// Bytes produced in total, -1 if unknown.
+  int64_t size;
+};
+
+}  // namespace http
+}  // namespace cppboot
+
+#endif  // CPPBOOT_NET_HTTP_BODY_SINK_H_
@@ -1,14 +1,14 @@
 #include "cppboot/net/http/client.h"
 
+#include <future>
 #include <string>
-#include <sstream>
-#include <iostream>
 
 #include "asio.hpp"
 #include "cppboot/base/fmt.h"
 #include "cppboot/base/log.h"
 #include "cppboot/base/str_util.h"
 #include "cppboot/net/http/response.h"
+#include "cppboot/net/http/response_parser.h"
 #include "cppboot/net/http/url.h"
 
 namespace cppboot {
@@ -16,10 +16,18 @@ namespace http {
 
 using asio::ip::tcp;
 
+namespace {
+
+Client& DefaultClient() {
+  static Client client;
+  return client;
+}
+
+}  // namespace
+
 Status Get(const std::string& url, Response* resp) {
   Request req("GET", url);
-  Client client;
-  return client.Do(req, resp);
+  return DefaultClient().Do(req, resp);
 }
 
 Status Post(const std::string& url, const std::string& content,
@@ -28,8 +36,7 @@ Status Post(const std::string& url, const std::string& content,
   req.content = content;
   req.set_header("Content-Type", "text/plain");
 
-  Client client;
-  return client.Do(req, resp);
+  return DefaultClient().Do(req, resp);
 }
 
 Status PostJson(const std::string& url, const json& data, Response* resp) {
@@ -37,116 +44,186 @@ Status PostJson(const std::string& url, const json& data, Response* resp) {
   req.content = data.dump();
   req.set_header("Content-Type", "application/json");
 
-  Client client;
-  return client.Do(req, resp);
+  return DefaultClient().Do(req, resp);
 }
 
 Status PostForm(const std::string& url, const FormData& data, Response* resp) {
   Request req("POST", url);
-  req.content = data.Encode();
-  req.set_header("Content-Type", "text/html");
+  data.Encode(&req.content);
+  req.set_header("Content-Type", "application/x-www-form-urlencoded");
 
-  Client client;
-  return client.Do(req, resp);
+  return DefaultClient().Do(req, resp);
 }
 
-Client::Client() : socket_(io_context_) {}
+Client::Client()
+    : max_idle_per_host_(kDefaultMaxIdlePerHost),
+      dns_cache_(&net::DnsCache::Default()) {}
 
 Client::~Client() {}
 
-Status Client::Do(const Request& req, Response* resp) {
-  auto endpoints = GetEndpointFromUrl(req.url);
+void Client::set_max_idle_per_host(size_t n) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  max_idle_per_host_ = n;
+  for (auto& i : idle_) {
+    if (i.second.size() > n) i.second.resize(n);
+  }
+}
 
-  // Try each endpoint until we successfully establish a connection.
-  asio::connect(socket_, endpoints);
-  asio::streambuf request;
-  req.to_buffers(&request);
-  asio::write(socket_, request);
+size_t Client::idle_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t n = 0;
+  for (auto& i : idle_) n += i.second.size();
+  return n;
+}
 
-  return ReadResponse(resp);
+Status Client::Do(const Request& req, Response* resp) {
+  return Do(req, resp, nullptr);
 }
 
-tcp::resolver::results_type Client::GetEndpointFromUrl(
-    const cppboot::http::Url& url) {
-  // Get a list of endpoints corresponding to the server name.
-  tcp::resolver resolver(io_context_);
-  tcp::resolver::results_type endpoints;
-
-  auto colon = url.host.find_last_of(":");
-  if (colon > 0) {
-    auto host = url.host.substr(0, colon);
-    if (host.empty()) host = "0.0.0.0";
-    return resolver.resolve(host, url.host.substr(colon + 1));
-  }
-  return resolver.resolve(url.host, url.scheme);
+Status Client::Do(const Request& req, Response* resp, const BodySink& sink) {
+  return Do(req, resp, &sink);
 }
 
-Status Client::ReadResponse(Response* resp) {
-  try {
-    // Read the response status line. The response streambuf will automatically
-    // grow to accommodate the entire line. The growth may be limited by passing
-    // a maximum size to the streambuf constructor.
-    asio::streambuf response;
-    asio::read_until(socket_, response, "\r\n");
-
-    // Check that response is OK.
-    std::istream response_stream(&response);
-    std::string http_version;
-    response_stream >> http_version;
-    unsigned int status_code;
-    response_stream >> status_code;
-    std::string status_message;
-    std::getline(response_stream, status_message);
-    if (!response_stream || http_version.substr(0, 5) != "HTTP/") {
-      return cppboot::InvalidArgumentError("Invalid response");
+Status Client::Do(const Request& req, Response* resp, const BodySink* sink) {
+  if (!req.url.IsValid()) {
+    return InvalidArgumentError("Invalid url");
+  }
+  if (req.body_source && req.body_source.size < 0) {
+    return InvalidArgumentError("Body of unknown size");
+  }
+
+  bool keep_alive_requested;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    keep_alive_requested = max_idle_per_host_ > 0;
+  }
+
+  for (bool retried = false;; retried = true) {
+    // The retry takes a new connection, the pool may hold more stale ones.
+    std::unique_ptr<Conn> conn;
+    if (!retried) conn = TakeIdle(req.url.host);
+    bool reused = conn != nullptr;
+    if (!conn) {
+      conn.reset(new Conn(io_context_));
+      auto st = Connect(req.url, conn.get());
+      if (!st) return st;
     }
 
-    if (status_code != 200) {
-      return cppboot::InvalidArgumentError(cppboot::format(
-          "Response returned with status code {}", status_code));
+    bool received = false;
+    bool keep_alive = false;
+    auto st = RoundTrip(conn.get(), req, resp, sink, keep_alive_requested,
+                        &received, &keep_alive);
+    // The server may have run the request before closing the connection,
+    // and a streamed body can not be sent twice.
+    if (!st && reused && !received && req.IsIdempotent() &&
+        !req.body_source) {
+      continue;
     }
 
-    Response reply;
-    reply.status = Response::ok;
-    // Read the response headers, which are terminated by a blank line.
-    asio::read_until(socket_, response, "\r\n\r\n");
-
-    // Process the response headers.
-    std::string header;
-    while (std::getline(response_stream, header) && header != "\r") {
-      auto colon = header.find_first_of(":");
-      if (colon != header.npos) {
-        resp->set_header(header.substr(0, colon),
-                         cppboot::StrTrim(header.substr(colon + 1)).str());
-      } else {
-        CPPBOOT_LOG(DEBUG, "{}", header);
-      }
+    if (keep_alive) PutIdle(req.url.host, std::move(conn));
+    if (st && resp->status != Response::ok) {
+      return InvalidArgumentError(cppboot::format(
+          "Response returned with status code {}",
+          static_cast<int>(resp->status)));
     }
+    return st;
+  }
+}
 
-    std::stringstream content;
+Status Client::Connect(const Url& url, Conn* conn) {
+  // Get a list of endpoints corresponding to the server name.
+  asio::error_code ec;
+  if (dns_cache_) {
+    net::DnsCache::EndpointsPtr endpoints;
+    auto st = dns_cache_->Resolve(url.hostname(), url.port(), &endpoints);
+    if (!st) return st;
+    // Try each endpoint until we successfully establish a connection.
+    asio::connect(conn->socket, *endpoints, ec);
+  } else {
+    tcp::resolver resolver(io_context_);
+    auto endpoints = resolver.resolve(url.hostname(), url.port(), ec);
+    if (ec) return UnavailableError(ec.message());
+    asio::connect(conn->socket, endpoints, ec);
+  }
+  if (ec) return UnavailableError(ec.message());
+  conn->socket.set_option(tcp::no_delay(true), ec);
+  return OkStatus();
+}
 
-    // Write whatever content we already have to output.
-    if (response.size() > 0) {
-      content << &response;
+Status Client::RoundTrip(Conn* conn, const Request& req, Response* resp,
+                         const BodySink* sink, bool keep_alive_requested,
+                         bool* received, bool* keep_alive) {
+  asio::error_code ec;
+  asio::streambuf request;
+  req.to_buffers(&request, keep_alive_requested);
+  asio::write(conn->socket, request, ec);
+  if (ec) return UnavailableError(ec.message());
+  if (req.body_source) {
+    auto st = SendBody(conn, req.body_source);
+    if (!st) return st;
+  }
+
+  ResponseParser parser(req.method);
+  parser.set_body_sink(sink);
+  char buffer[16 * 1024];
+  for (;;) {
+    size_t n = conn->socket.read_some(asio::buffer(buffer), ec);
+    ResponseParser::result_type result;
+    if (ec == asio::error::eof) {
+      result = parser.eof();
+    } else if (ec) {
+      return UnavailableError(ec.message());
+    } else {
+      *received = true;
+      std::tie(result, std::ignore) =
+          parser.parse(*resp, buffer, buffer + n);
     }
 
-    // Read until EOF, writing data to output as we go.
-    asio::error_code error;
-    while (asio::read(socket_, response, asio::transfer_at_least(1), error)) {
-      content << &response;
+    if (result == ResponseParser::bad) {
+      if (!parser.sink_status()) return parser.sink_status();
+      return InvalidArgumentError(ec ? "Incomplete response"
+                                     : "Invalid response");
     }
-    if (error != asio::error::eof) {
-      throw asio::system_error(error);
+    if (result == ResponseParser::good) {
+      *keep_alive = parser.keep_alive() && !ec;
+      return OkStatus();
     }
+  }
+}
 
-    resp->status = cppboot::http::Response::ok;
-    resp->content = content.str();
-  } catch (std::exception& e) {
-    return cppboot::CancelledError(e.what());
+Status Client::SendBody(Conn* conn, const BodySource& source) {
+  for (;;) {
+    std::promise<Status> done;
+    string_view data;
+    source.read([&](const Status& status, string_view piece) {
+      data = piece;
+      done.set_value(status);
+    });
+    auto st = done.get_future().get();
+    if (!st || data.empty()) return st;
+
+    asio::error_code ec;
+    asio::write(conn->socket, asio::buffer(data.data(), data.size()), ec);
+    if (ec) return UnavailableError(ec.message());
   }
+}
+
+std::unique_ptr<Client::Conn> Client::TakeIdle(const std::string& host) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = idle_.find(host);
+  if (it == idle_.end() || it->second.empty()) return nullptr;
+
+  std::unique_ptr<Conn> conn = std::move(it->second.back());
+  it->second.pop_back();
+  return conn;
+}
 
-  return cppboot::OkStatus();
+void Client::PutIdle(const std::string& host, std::unique_ptr<Conn> conn) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& conns = idle_[host];
+  if (conns.size() >= max_idle_per_host_) return;
+  conns.push_back(std::move(conn));
 }
 
 }  // namespace http
-}  // namespace cppboot
\ No newline at end of file
+}  // namespace cppboot
@@ -1,12 +1,18 @@
 #ifndef CPPBOOT_NET_HTTP_CLIENT_H_
 #define CPPBOOT_NET_HTTP_CLIENT_H_
 
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include "asio.hpp"
 
 #include "cppboot/base/status.h"
 #include "cppboot/base/json.h"
+#include "cppboot/net/dns_cache.h"
+#include "cppboot/net/http/body_sink.h"
 #include "cppboot/net/http/request.h"
 #include "cppboot/net/http/response.h"
 
@@ -15,24 +21,74 @@ namespace http {
 
 // TODO: add https support
 
+/// The free functions share one Client, hence its pooled connections.
 Status Get(const std::string& url, Response* resp);
 Status Post(const std::string& url, const std::string& content, Response* resp);
 Status PostJson(const std::string& url, const json& data, Response* resp);
 Status PostForm(const std::string& url, const FormData& data, Response* resp);
 
+/// Blocking HTTP/1.1 client. Connections are kept alive and pooled per
+/// host: a request reuses an idle connection to its host when there is one,
+/// and gives it back once the whole response has been read. An idempotent
+/// request, see Request::IsIdempotent(), that fails on a reused connection
+/// before any response byte arrived, e.g. because the server closed it
+/// meanwhile, is retried once on a new connection.
+///
+/// Do() may be called from several threads, each request then takes its
+/// own connection.
 class Client {
  public:
+  enum { kDefaultMaxIdlePerHost = 4 };
+
   Client();
   ~Client();
+
+  /// Idle connections kept per host, 0 closes each after its request.
+  void set_max_idle_per_host(size_t n);
+
+  /// Resolve host names through `cache`, net::DnsCache::Default() unless
+  /// set. nullptr resolves each time a connection is made.
+  void set_dns_cache(net::DnsCache* cache) { dns_cache_ = cache; }
+
   Status Do(const Request& req, Response* resp);
 
+  /// Stream the body into `sink` instead of `resp->content`.
+  Status Do(const Request& req, Response* resp, const BodySink& sink);
+
+  /// Number of pooled idle connections.
+  size_t idle_count() const;
+
  private:
-  asio::ip::tcp::resolver::results_type GetEndpointFromUrl(
-      const cppboot::http::Url& url);
-  Status ReadResponse(Response* resp);
+  struct Conn {
+    explicit Conn(asio::io_context& io_context) : socket(io_context) {}
+
+    asio::ip::tcp::socket socket;
+  };
+
+  Status Do(const Request& req, Response* resp, const BodySink* sink);
+
+  /// Send `req` on `conn` and read the response. `*received` tells whether
+  /// any response byte arrived, `*keep_alive` whether `conn` can be reused.
+  /// The server is asked to close the connection unless
+  /// `keep_alive_requested`.
+  Status RoundTrip(Conn* conn, const Request& req, Response* resp,
+                   const BodySink* sink, bool keep_alive_requested,
+                   bool* received, bool* keep_alive);
+
+  /// Send the pieces of `source`, waiting for each one.
+  static Status SendBody(Conn* conn, const BodySource& source);
+
+  std::unique_ptr<Conn> TakeIdle(const std::string& host);
+  void PutIdle(const std::string& host, std::unique_ptr<Conn> conn);
+  Status Connect(const Url& url, Conn* conn);
 
   asio::io_context io_context_;
-  asio::ip::tcp::socket socket_;
+
+  mutable std::mutex mutex_;
+  /// Idle connections by "host:port", the most recently used last.
+  std::map<std::string, std::vector<std::unique_ptr<Conn>>> idle_;
+  size_t max_idle_per_host_;
+  net::DnsCache* dns_cache_;
 };
 
 }  // namespace http
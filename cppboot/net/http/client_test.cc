@@ -0,0 +1,200 @@
+#include "gmock/gmock.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+
+#include "asio.hpp"
+
+#include "cppboot/net/http/client.h"
+
+namespace {
+
+using asio::ip::tcp;
+using cppboot::http::Client;
+using cppboot::http::Request;
+using cppboot::http::Response;
+
+/// A keep-alive server handling one connection at a time.
+class KeepAliveServer {
+ public:
+  explicit KeepAliveServer(unsigned short port)
+      : acceptor_(io_context_, tcp::endpoint(asio::ip::address_v4::loopback(),
+                                             port)),
+        accepts_(0),
+        stopped_(false) {
+    thread_ = std::thread([this]() { Run(); });
+  }
+
+  ~KeepAliveServer() {
+    // Closing the acceptor does not wake up a blocking accept, connecting
+    // does.
+    stopped_ = true;
+    tcp::socket socket(io_context_);
+    asio::error_code ec;
+    socket.connect(acceptor_.local_endpoint(), ec);
+    thread_.join();
+  }
+
+  int accepts() const { return accepts_; }
+
+ private:
+  void Run() {
+    for (;;) {
+      tcp::socket socket(io_context_);
+      asio::error_code ec;
+      acceptor_.accept(socket, ec);
+      if (ec || stopped_) return;
+      accepts_++;
+
+      asio::streambuf buf;
+      for (;;) {
+        size_t n = asio::read_until(socket, buf, "\r\n\r\n", ec);
+        if (ec) break;
+        std::string head(static_cast<const char*>(buf.data().data()), n);
+        buf.consume(n);
+
+        if (head.compare(0, 10, "GET /fixed") == 0) {
+          asio::write(socket, asio::buffer(std::string(
+                                  "HTTP/1.1 200 OK\r\n"
+                                  "Content-Length: 5\r\n\r\nfixed")));
+        } else if (head.compare(0, 12, "GET /chunked") == 0) {
+          asio::write(socket, asio::buffer(std::string(
+                                  "HTTP/1.1 200 OK\r\n"
+                                  "Transfer-Encoding: chunked\r\n\r\n"
+                                  "3;ext=1\r\nchu\r\n4\r\nnked\r\n0\r\n"
+                                  "X-Trailer: 1\r\n\r\n")));
+        } else if (head.compare(0, 8, "GET /bye") == 0) {
+          // Drop the connection without announcing it.
+          asio::write(socket, asio::buffer(std::string(
+                                  "HTTP/1.1 200 OK\r\n"
+                                  "Content-Length: 3\r\n\r\nbye")));
+          break;
+        } else {
+          asio::write(socket, asio::buffer(std::string(
+                                  "HTTP/1.1 404 Not Found\r\n"
+                                  "Content-Length: 4\r\n\r\nnone")));
+        }
+      }
+    }
+  }
+
+  asio::io_context io_context_;
+  tcp::acceptor acceptor_;
+  std::atomic<int> accepts_;
+  std::atomic<bool> stopped_;
+  std::thread thread_;
+};
+
+TEST(Client, ReusesConnection) {
+  KeepAliveServer server(59995);
+  Client client;
+
+  for (int i = 0; i < 3; i++) {
+    Response resp;
+    auto st = client.Do(Request("GET", "http://127.0.0.1:59995/fixed"), &resp);
+    ASSERT_TRUE(st) << st.ToString();
+    ASSERT_EQ(resp.content, "fixed");
+
+    st = client.Do(Request("GET", "http://127.0.0.1:59995/chunked"), &resp);
+    ASSERT_TRUE(st) << st.ToString();
+    ASSERT_EQ(resp.content, "chunked");
+    ASSERT_EQ(resp.header("Transfer-Encoding"), "chunked");
+  }
+
+  // Error responses are drained and keep the connection too.
+  Response resp;
+  auto st = client.Do(Request("GET", "http://127.0.0.1:59995/none"), &resp);
+  ASSERT_FALSE(st);
+  ASSERT_EQ(resp.status, Response::not_found);
+
+  ASSERT_EQ(server.accepts(), 1);
+  ASSERT_EQ(client.idle_count(), 1);
+}
+
+TEST(Client, RetriesClosedConnection) {
+  KeepAliveServer server(59995);
+  Client client;
+
+  Response resp;
+  auto st = client.Do(Request("GET", "http://127.0.0.1:59995/bye"), &resp);
+  ASSERT_TRUE(st) << st.ToString();
+  ASSERT_EQ(resp.content, "bye");
+  ASSERT_EQ(client.idle_count(), 1);
+
+  // The pooled connection is closed by now, the request goes to a new one.
+  st = client.Do(Request("GET", "http://127.0.0.1:59995/fixed"), &resp);
+  ASSERT_TRUE(st) << st.ToString();
+  ASSERT_EQ(resp.content, "fixed");
+  ASSERT_EQ(server.accepts(), 2);
+
+  // A POST is not, the server may have run it before closing.
+  st = client.Do(Request("GET", "http://127.0.0.1:59995/bye"), &resp);
+  ASSERT_TRUE(st) << st.ToString();
+  st = client.Do(Request("POST", "http://127.0.0.1:59995/fixed"), &resp);
+  ASSERT_FALSE(st);
+  ASSERT_EQ(server.accepts(), 2);
+  ASSERT_EQ(client.idle_count(), 0);
+}
+
+TEST(Client, StreamIntoSink) {
+  KeepAliveServer server(59995);
+  Client client;
+
+  std::string body;
+  std::vector<int64_t> totals;
+  cppboot::http::BodySink sink;
+  sink.on_data = [&](cppboot::string_view data) {
+    body.append(data.data(), data.size());
+    return cppboot::OkStatus();
+  };
+  sink.on_progress = [&](uint64_t received, int64_t total) {
+    ASSERT_EQ(received, body.size());
+    totals.push_back(total);
+  };
+
+  Response resp;
+  auto st = client.Do(Request("GET", "http://127.0.0.1:59995/chunked"),
+                      &resp, sink);
+  ASSERT_TRUE(st) << st.ToString();
+  ASSERT_EQ(body, "chunked");
+  ASSERT_TRUE(resp.content.empty());
+  ASSERT_THAT(totals, ::testing::Each(-1));
+
+  // A failing sink aborts the request and drops the connection.
+  sink.on_data = [](cppboot::string_view) {
+    return cppboot::ResourceExhaustedError("disk full");
+  };
+  st = client.Do(Request("GET", "http://127.0.0.1:59995/fixed"), &resp, sink);
+  ASSERT_TRUE(cppboot::IsResourceExhausted(st)) << st.ToString();
+  ASSERT_EQ(client.idle_count(), 0);
+
+  // Into a file.
+  FILE* file = ::tmpfile();
+  ASSERT_TRUE(file);
+  st = client.Do(Request("GET", "http://127.0.0.1:59995/fixed"), &resp,
+                 cppboot::http::BodySink::ToFd(fileno(file)));
+  ASSERT_TRUE(st) << st.ToString();
+  char buf[16] = {};
+  ASSERT_EQ(::pread(fileno(file), buf, sizeof(buf), 0), 5);
+  ASSERT_STREQ(buf, "fixed");
+  ::fclose(file);
+}
+
+TEST(Client, WithoutKeepAlive) {
+  KeepAliveServer server(59995);
+  Client client;
+  client.set_max_idle_per_host(0);
+
+  for (int i = 0; i < 2; i++) {
+    Response resp;
+    auto st = client.Do(Request("GET", "http://127.0.0.1:59995/fixed"), &resp);
+    ASSERT_TRUE(st) << st.ToString();
+    ASSERT_EQ(resp.content, "fixed");
+  }
+  ASSERT_EQ(client.idle_count(), 0);
+}
+
+}  // namespace
@@ -0,0 +1,251 @@
+#include "cppboot/net/http/compress.h"
+
+#include <stdlib.h>
+
+#if CPPBOOT_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#if CPPBOOT_HAVE_BROTLI
+#include <brotli/decode.h>
+#include <brotli/encode.h>
+#endif
+
+#include "cppboot/base/str_util.h"
+#include "cppboot/net/http/request.h"
+#include "cppboot/net/http/response.h"
+
+namespace cppboot {
+namespace http {
+
+namespace {
+
+/// q-value of `name` in the Accept-Encoding header `accept`, -1 if `name`
+/// is not listed.
+double QValue(string_view accept, string_view name) {
+  while (!accept.empty()) {
+    size_t comma = accept.find(',');
+    auto item = accept.substr(0, comma);
+    accept = comma == string_view::npos ? string_view()
+                                        : accept.substr(comma + 1);
+
+    size_t semicolon = item.find(';');
+    if (!EqualsIgnoreCase(StrTrim(item.substr(0, semicolon)), name)) {
+      continue;
+    }
+    if (semicolon == string_view::npos) return 1;
+
+    auto param = StrTrim(item.substr(semicolon + 1));
+    if (!StartsWithIgnoreCase(param, "q=")) return 1;
+    return ::atof(param.substr(2).str().c_str());
+  }
+  return -1;
+}
+
+#if CPPBOOT_HAVE_ZLIB
+bool Gzip(string_view in, int level, std::string* out) {
+  z_stream zs = {};
+  // 16 + MAX_WBITS writes a gzip header instead of a zlib one.
+  if (deflateInit2(&zs, level, Z_DEFLATED, 16 + MAX_WBITS, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return false;
+  }
+
+  out->resize(deflateBound(&zs, in.size()));
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+  zs.avail_in = in.size();
+  zs.next_out = reinterpret_cast<Bytef*>(&(*out)[0]);
+  zs.avail_out = out->size();
+  int ret = deflate(&zs, Z_FINISH);
+  out->resize(zs.total_out);
+  deflateEnd(&zs);
+  return ret == Z_STREAM_END;
+}
+
+bool Gunzip(string_view in, std::string* out) {
+  z_stream zs = {};
+  if (inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK) return false;
+
+  char buf[16 * 1024];
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+  zs.avail_in = in.size();
+  int ret;
+  do {
+    zs.next_out = reinterpret_cast<Bytef*>(buf);
+    zs.avail_out = sizeof(buf);
+    ret = inflate(&zs, Z_NO_FLUSH);
+    out->append(buf, sizeof(buf) - zs.avail_out);
+  } while (ret == Z_OK);
+  inflateEnd(&zs);
+  return ret == Z_STREAM_END;
+}
+#endif
+
+#if CPPBOOT_HAVE_BROTLI
+bool Brotli(string_view in, int quality, std::string* out) {
+  size_t size = BrotliEncoderMaxCompressedSize(in.size());
+  if (size == 0) return false;
+
+  out->resize(size);
+  if (!BrotliEncoderCompress(
+          quality, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_GENERIC, in.size(),
+          reinterpret_cast<const uint8_t*>(in.data()), &size,
+          reinterpret_cast<uint8_t*>(&(*out)[0]))) {
+    return false;
+  }
+  out->resize(size);
+  return true;
+}
+
+bool Unbrotli(string_view in, std::string* out) {
+  BrotliDecoderState* s =
+      BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+  if (!s) return false;
+
+  uint8_t buf[16 * 1024];
+  size_t avail_in = in.size();
+  auto next_in = reinterpret_cast<const uint8_t*>(in.data());
+  BrotliDecoderResult ret;
+  do {
+    size_t avail_out = sizeof(buf);
+    uint8_t* next_out = buf;
+    ret = BrotliDecoderDecompressStream(s, &avail_in, &next_in, &avail_out,
+                                        &next_out, nullptr);
+    out->append(reinterpret_cast<char*>(buf), sizeof(buf) - avail_out);
+  } while (ret == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT);
+  BrotliDecoderDestroyInstance(s);
+  return ret == BROTLI_DECODER_RESULT_SUCCESS;
+}
+#endif
+
+}  // namespace
+
+const char* EncodingName(ContentEncoding encoding) {
+  switch (encoding) {
+    case kGzip:
+      return "gzip";
+    case kBrotli:
+      return "br";
+    default:
+      return "identity";
+  }
+}
+
+const char* EncodingSuffix(ContentEncoding encoding) {
+  switch (encoding) {
+    case kGzip:
+      return ".gz";
+    case kBrotli:
+      return ".br";
+    default:
+      return "";
+  }
+}
+
+bool IsEncodingSupported(ContentEncoding encoding) {
+  switch (encoding) {
+    case kGzip:
+      return CPPBOOT_HAVE_ZLIB;
+    case kBrotli:
+      return CPPBOOT_HAVE_BROTLI;
+    default:
+      return true;
+  }
+}
+
+bool AcceptsEncoding(string_view accept, ContentEncoding encoding) {
+  if (encoding == kIdentity) return true;
+
+  double q = QValue(accept, EncodingName(encoding));
+  if (q < 0 && encoding == kGzip) q = QValue(accept, "x-gzip");
+  if (q < 0) q = QValue(accept, "*");
+  return q > 0;
+}
+
+ContentEncoding PreferredEncoding(string_view accept) {
+  if (accept.empty()) return kIdentity;
+
+  for (auto encoding : {kBrotli, kGzip}) {
+    if (IsEncodingSupported(encoding) && AcceptsEncoding(accept, encoding)) {
+      return encoding;
+    }
+  }
+  return kIdentity;
+}
+
+bool IsCompressible(string_view content_type) {
+  content_type = StrTrim(content_type.substr(0, content_type.find(';')));
+  return StartsWithIgnoreCase(content_type, "text/") ||
+         EndsWithIgnoreCase(content_type, "/json") ||
+         EndsWithIgnoreCase(content_type, "+json") ||
+         EndsWithIgnoreCase(content_type, "/javascript") ||
+         EndsWithIgnoreCase(content_type, "/xml") ||
+         EndsWithIgnoreCase(content_type, "+xml");
+}
+
+bool Compress(ContentEncoding encoding, string_view in, int level,
+              std::string* out) {
+  switch (encoding) {
+#if CPPBOOT_HAVE_ZLIB
+    case kGzip:
+      return Gzip(in, level, out);
+#endif
+#if CPPBOOT_HAVE_BROTLI
+    case kBrotli:
+      return Brotli(in, level, out);
+#endif
+    case kIdentity:
+      out->assign(in.data(), in.size());
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool Decompress(ContentEncoding encoding, string_view in, std::string* out) {
+  switch (encoding) {
+#if CPPBOOT_HAVE_ZLIB
+    case kGzip:
+      return Gunzip(in, out);
+#endif
+#if CPPBOOT_HAVE_BROTLI
+    case kBrotli:
+      return Unbrotli(in, out);
+#endif
+    case kIdentity:
+      out->assign(in.data(), in.size());
+      return true;
+    default:
+      return false;
+  }
+}
+
+void CompressResponse(const CompressOptions& options, const Request& req,
+                      Response* rep) {
+  if (!options.enabled || rep->status != Response::ok || rep->file_body ||
+      rep->body_source || rep->takeover ||
+      rep->shared_content || rep->static_content.data() ||
+      rep->content.size() < options.min_size ||
+      !rep->header("Content-Encoding").empty() ||
+      !IsCompressible(rep->header("Content-Type"))) {
+    return;
+  }
+
+  auto encoding = PreferredEncoding(req.header("Accept-Encoding"));
+  if (encoding == kIdentity) return;
+
+  int level =
+      encoding == kGzip ? options.gzip_level : options.brotli_quality;
+  std::string out;
+  if (!Compress(encoding, rep->content, level, &out) ||
+      out.size() >= rep->content.size()) {
+    return;
+  }
+
+  rep->content.swap(out);
+  rep->set_header("Content-Length", std::to_string(rep->content.size()));
+  rep->set_header("Content-Encoding", EncodingName(encoding));
+  rep->set_header("Vary", "Accept-Encoding");
+}
+
+}  // namespace http
+}  // namespace cppboot
@@ -0,0 +1,65 @@
+#ifndef CPPBOOT_NET_HTTP_COMPRESS_H_
+#define CPPBOOT_NET_HTTP_COMPRESS_H_
+
+#include <string>
+
+#include "cppboot/base/string_view.h"
+
+namespace cppboot {
+namespace http {
+
+struct Request;
+struct Response;
+
+/// Content codings of Accept-Encoding and Content-Encoding.
+enum ContentEncoding { kIdentity, kGzip, kBrotli };
+
+/// When and how hard responses are compressed.
+struct CompressOptions {
+  /// Compress at all, precompressed files are still served if disabled.
+  bool enabled = true;
+  /// Bodies smaller than this are not worth a compressor.
+  size_t min_size = 1024;
+  /// zlib level, 1 (fastest) to 9 (smallest).
+  int gzip_level = 6;
+  /// Brotli quality, 0 (fastest) to 11 (smallest).
+  int brotli_quality = 5;
+};
+
+/// "gzip", "br" or "identity".
+const char* EncodingName(ContentEncoding encoding);
+
+/// File name suffix of a precompressed file, ".gz" or ".br".
+const char* EncodingSuffix(ContentEncoding encoding);
+
+/// Whether this build can produce `encoding`.
+bool IsEncodingSupported(ContentEncoding encoding);
+
+/// Whether the Accept-Encoding header `accept` allows `encoding`, honoring
+/// q-values and "*".
+bool AcceptsEncoding(string_view accept, ContentEncoding encoding);
+
+/// The best supported coding allowed by `accept`, brotli first.
+ContentEncoding PreferredEncoding(string_view accept);
+
+/// Whether a body of `content_type` usually shrinks, i.e. text, JSON,
+/// JavaScript, XML and SVG.
+bool IsCompressible(string_view content_type);
+
+/// Compress `in` into `out`, `level` is the gzip level or brotli quality.
+bool Compress(ContentEncoding encoding, string_view in, int level,
+              std::string* out);
+
+/// Decompress `in` into `out`.
+bool Decompress(ContentEncoding encoding, string_view in, std::string* out);
+
+/// Compress the in-memory body of `rep` if `req` accepts it and the body is
+/// large and compressible enough. Replies that are already encoded, partial
+/// or streamed from a file are left alone.
+void CompressResponse(const CompressOptions& options, const Request& req,
+                      Response* rep);
+
+}  // namespace http
+}  // namespace cppboot
+
+#endif  // CPPBOOT_NET_HTTP_COMPRESS_H_
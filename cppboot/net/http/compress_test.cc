@@ -0,0 +1,89 @@
+#include "gmock/gmock.h"
+
+#include "cppboot/net/http/compress.h"
+#include "cppboot/net/http/request.h"
+#include "cppboot/net/http/response.h"
+
+using cppboot::http::kBrotli;
+using cppboot::http::kGzip;
+using cppboot::http::kIdentity;
+
+TEST(Compress, AcceptsEncoding) {
+  using cppboot::http::AcceptsEncoding;
+  ASSERT_TRUE(AcceptsEncoding("gzip, deflate, br", kGzip));
+  ASSERT_TRUE(AcceptsEncoding("gzip, deflate, br", kBrotli));
+  ASSERT_TRUE(AcceptsEncoding("GZIP;q=0.5", kGzip));
+  ASSERT_FALSE(AcceptsEncoding("gzip;q=0, br", kGzip));
+  ASSERT_FALSE(AcceptsEncoding("deflate", kGzip));
+  ASSERT_TRUE(AcceptsEncoding("x-gzip", kGzip));
+  ASSERT_TRUE(AcceptsEncoding("*", kBrotli));
+  ASSERT_FALSE(AcceptsEncoding("br;q=0, *", kBrotli));
+  ASSERT_TRUE(AcceptsEncoding("", kIdentity));
+}
+
+TEST(Compress, PreferredEncoding) {
+  using cppboot::http::PreferredEncoding;
+  ASSERT_EQ(PreferredEncoding(""), kIdentity);
+  ASSERT_EQ(PreferredEncoding("deflate"), kIdentity);
+  ASSERT_EQ(PreferredEncoding("gzip"), kGzip);
+  if (cppboot::http::IsEncodingSupported(kBrotli)) {
+    ASSERT_EQ(PreferredEncoding("gzip, br"), kBrotli);
+  }
+}
+
+TEST(Compress, IsCompressible) {
+  using cppboot::http::IsCompressible;
+  ASSERT_TRUE(IsCompressible("text/html"));
+  ASSERT_TRUE(IsCompressible("application/json; charset=utf-8"));
+  ASSERT_TRUE(IsCompressible("image/svg+xml"));
+  ASSERT_FALSE(IsCompressible("image/png"));
+  ASSERT_FALSE(IsCompressible(""));
+}
+
+TEST(Compress, RoundTrip) {
+  std::string data;
+  for (int i = 0; i < 1000; i++) data += "{\"id\":" + std::to_string(i) + "},";
+
+  for (auto encoding : {kGzip, kBrotli}) {
+    if (!cppboot::http::IsEncodingSupported(encoding)) continue;
+
+    std::string compressed, decompressed;
+    ASSERT_TRUE(cppboot::http::Compress(encoding, data, 6, &compressed));
+    ASSERT_LT(compressed.size(), data.size() / 4);
+    ASSERT_TRUE(
+        cppboot::http::Decompress(encoding, compressed, &decompressed));
+    ASSERT_EQ(decompressed, data);
+  }
+}
+
+TEST(Compress, CompressResponse) {
+  cppboot::http::CompressOptions options;
+  cppboot::http::Request req;
+  req.set_header("Accept-Encoding", "gzip");
+
+  std::string text(2000, 'a');
+  cppboot::http::Response rep;
+  rep.WriteText(rep.ok, text);
+  cppboot::http::CompressResponse(options, req, &rep);
+  ASSERT_EQ(rep.header("Content-Encoding"), "gzip");
+  ASSERT_EQ(rep.header("Vary"), "Accept-Encoding");
+  ASSERT_EQ(rep.header("Content-Length"), std::to_string(rep.content.size()));
+
+  std::string decompressed;
+  ASSERT_TRUE(cppboot::http::Decompress(kGzip, rep.content, &decompressed));
+  ASSERT_EQ(decompressed, text);
+
+  // Too small.
+  cppboot::http::Response small;
+  small.WriteText(small.ok, "hello");
+  cppboot::http::CompressResponse(options, req, &small);
+  ASSERT_EQ(small.header("Content-Encoding"), "");
+  ASSERT_EQ(small.content, "hello");
+
+  // Not accepted.
+  cppboot::http::Request plain;
+  cppboot::http::Response rep2;
+  rep2.WriteText(rep2.ok, text);
+  cppboot::http::CompressResponse(options, plain, &rep2);
+  ASSERT_EQ(rep2.content, text);
+}
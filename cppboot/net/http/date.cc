@@ -0,0 +1,52 @@
+#include "cppboot/net/http/date.h"
+
+#include <string.h>
+
+namespace cppboot {
+namespace http {
+
+namespace {
+
+size_t FormatHttpDate(time_t t, char* buf, size_t size) {
+  struct tm tm;
+  gmtime_r(&t, &tm);
+  return strftime(buf, size, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+}
+
+}  // namespace
+
+std::string FormatHttpDate(time_t t) {
+  char buf[32];
+  return std::string(buf, FormatHttpDate(t, buf, sizeof(buf)));
+}
+
+string_view CurrentHttpDate() {
+  thread_local time_t last = -1;
+  thread_local char buf[32];
+  thread_local size_t length = 0;
+
+  time_t now = ::time(nullptr);
+  if (now != last) {
+    length = FormatHttpDate(now, buf, sizeof(buf));
+    last = now;
+  }
+  return string_view(buf, length);
+}
+
+bool ParseHttpDate(string_view s, time_t* t) {
+  char buf[32];
+  if (s.empty() || s.length() >= sizeof(buf)) return false;
+  memcpy(buf, s.data(), s.length());
+  buf[s.length()] = '\0';
+
+  struct tm tm;
+  memset(&tm, 0, sizeof(tm));
+  const char* end = strptime(buf, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+  if (!end || *end != '\0') return false;
+
+  *t = timegm(&tm);
+  return true;
+}
+
+}  // namespace http
+}  // namespace cppboot
@@ -0,0 +1,26 @@
+#ifndef CPPBOOT_NET_HTTP_DATE_H_
+#define CPPBOOT_NET_HTTP_DATE_H_
+
+#include <time.h>
+#include <string>
+
+#include "cppboot/base/string_view.h"
+
+namespace cppboot {
+namespace http {
+
+/// Format `t` as an IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT".
+std::string FormatHttpDate(time_t t);
+
+/// The current time as an IMF-fixdate for the Date header. It is formatted
+/// at most once per second and thread, the view is valid until the next call
+/// on the same thread.
+string_view CurrentHttpDate();
+
+/// Parse an IMF-fixdate, returns false if `s` is not a valid date.
+bool ParseHttpDate(string_view s, time_t* t);
+
+}  // namespace http
+}  // namespace cppboot
+
+#endif  // CPPBOOT_NET_HTTP_DATE_H_
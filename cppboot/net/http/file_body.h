@@ -0,0 +1,72 @@
+#ifndef CPPBOOT_NET_HTTP_FILE_BODY_H_
+#define CPPBOOT_NET_HTTP_FILE_BODY_H_
+
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cppboot {
+namespace http {
+
+class FileIoService;
+
+/// A response body streamed from an open file with sendfile(2), so the file
+/// is never loaded into memory. The body is a list of file slices, each one
+/// preceded by an optional literal head, followed by an optional tail. This
+/// covers whole files as well as single and multipart byte ranges.
+class FileBody {
+ public:
+  struct Part {
+    std::string head;
+    off_t offset;
+    size_t length;
+  };
+
+  FileBody(const FileBody&) = delete;
+  FileBody& operator=(const FileBody&) = delete;
+
+  /// Take the ownership of `fd`.
+  explicit FileBody(int fd) noexcept : fd_(fd), io_service_(nullptr) {}
+  ~FileBody() {
+    if (fd_ >= 0) ::close(fd_);
+  }
+
+  int fd() const noexcept { return fd_; }
+
+  /// Where disk reads are prefetched before sending, may be null.
+  FileIoService* io_service() const noexcept { return io_service_; }
+  void set_io_service(FileIoService* io) noexcept { io_service_ = io; }
+
+  void AddPart(const std::string& head, off_t offset, size_t length) {
+    Part part = {head, offset, length};
+    parts_.push_back(part);
+  }
+
+  const std::vector<Part>& parts() const noexcept { return parts_; }
+
+  const std::string& tail() const noexcept { return tail_; }
+  void set_tail(const std::string& tail) { tail_ = tail; }
+
+  /// Total number of bytes of the body.
+  size_t size() const noexcept {
+    size_t n = tail_.size();
+    for (auto& i : parts_) n += i.head.size() + i.length;
+    return n;
+  }
+
+ private:
+  int fd_;
+  FileIoService* io_service_;
+  std::vector<Part> parts_;
+  std::string tail_;
+};
+
+typedef std::shared_ptr<FileBody> FileBodyPtr;
+
+}  // namespace http
+}  // namespace cppboot
+
+#endif  // CPPBOOT_NET_HTTP_FILE_BODY_H_
@@ -1,73 +1,178 @@
 #include "cppboot/net/http/form_data.h"
 
-#include <sstream>
+#include <string.h>
+
+#include <algorithm>
+
+#include "cppboot/net/http/url.h"
 
 namespace cppboot {
 namespace http {
 
 namespace {
 
-// TODO: depulicate
-std::string GetNextToken(const char** next, const char* end, char quota) {
-  const char* p = *next;
-  const char* start = p;
+const size_t npos = static_cast<size_t>(-1);
 
-  if (p >= end) return std::string();
+}  // namespace
 
-  while (p != end && *p != quota) p++;
-  std::string token(start, p - start);
+FormData::FormData() noexcept : pending_(0) {}
 
-  *next = ++p;
-  return token;
+size_t FormData::size() const {
+  Split();
+  return entries_.size();
 }
 
-}  // namespace
+string_view FormData::key(size_t i) const {
+  Split();
+  return string_view(buf_.data() + entries_[i].key, entries_[i].key_size);
+}
 
-void FormData::Set(const char* key, const std::string& value) noexcept {
-  if (key && *key) values_[key] = value;
+string_view FormData::value(size_t i) const {
+  Split();
+  return string_view(buf_.data() + entries_[i].value, entries_[i].value_size);
 }
 
-std::string FormData::Get(const char* key) const noexcept {
-  if (key && *key) {
-    auto it = values_.find(key);
-    if (it != values_.end()) return it->second;
+string_view FormData::Get(string_view key) const {
+  size_t i = Find(key);
+  return i == npos ? string_view() : value(i);
+}
+
+std::vector<string_view> FormData::GetAll(string_view key) const {
+  std::vector<string_view> values;
+  for (size_t i = 0; i < size(); i++) {
+    if (this->key(i) == key) values.push_back(value(i));
   }
-  return {};
+  return values;
 }
 
-Status FormData::Parse(string_view query) noexcept {
-  const char* next = query.data();
-  const char* end = query.data() + query.length();
+bool FormData::Has(string_view key) const {
+  return Find(key) != npos;
+}
 
-  for (;;) {
-    auto param = GetNextToken(&next, end, '&');
-    if (param.empty()) {
-      break;
-    }
-    auto sep = param.find('=');
-    if (sep == param.npos) {
-      values_[param] = "";
-    } else {
-      values_[param.substr(0, sep)] = param.substr(sep + 1);
-    }
+void FormData::Set(string_view key, string_view value) {
+  if (Aliases(key) || Aliases(value)) {
+    std::string k = key.str(), v = value.str();
+    Set(k, v);
+    return;
+  }
+
+  Del(key);
+  Add(key, value);
+}
+
+void FormData::Add(string_view key, string_view value) {
+  if (Aliases(key) || Aliases(value)) {
+    std::string k = key.str(), v = value.str();
+    Add(k, v);
+    return;
+  }
+
+  Split();
+  Entry entry = {buf_.size(), key.size(), buf_.size() + key.size(),
+                 value.size()};
+  buf_.append(key.data(), key.size());
+  buf_.append(value.data(), value.size());
+  entries_.push_back(entry);
+  pending_ = buf_.size();
+}
+
+void FormData::Del(string_view key) {
+  Split();
+  entries_.erase(std::remove_if(entries_.begin(), entries_.end(),
+                                [&](const Entry& e) {
+                                  return string_view(buf_.data() + e.key,
+                                                     e.key_size) == key;
+                                }),
+                 entries_.end());
+}
+
+void FormData::clear() noexcept {
+  buf_.clear();
+  entries_.clear();
+  pending_ = 0;
+}
+
+Status FormData::Parse(string_view query) {
+  if (Aliases(query)) {
+    std::string copy = query.str();
+    return Parse(copy);
   }
+
+  Split();
+  buf_.append(query.data(), query.size());
   return OkStatus();
 }
 
-std::string FormData::Encode() const noexcept {
-  std::stringstream ss;
-  bool add_delimiter = false;
+std::string FormData::Encode() const {
+  std::string out;
+  Encode(&out);
+  return out;
+}
 
-  for (auto i : values_) {
-    if (add_delimiter)
-      ss << "&";
-    else
-      add_delimiter = true;
+void FormData::Encode(std::string* out) const {
+  Split();
+  if (entries_.empty()) return;
 
-    ss << i.first << "=" << i.second;
+  std::vector<size_t> order(entries_.size());
+  size_t size = entries_.size() * 2 - 1;
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+    size += QueryEscapedSize(key(i)) + QueryEscapedSize(value(i));
   }
-  return ss.str();
+  std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+    return key(a) < key(b);
+  });
+
+  out->reserve(out->size() + size);
+  for (size_t i : order) {
+    if (i != order.front()) out->push_back('&');
+    QueryEscape(key(i), out);
+    out->push_back('=');
+    QueryEscape(value(i), out);
+  }
+}
+
+void FormData::Split() const {
+  if (pending_ == buf_.size()) return;
+
+  char* base = &buf_[0];
+  char* p = base + pending_;
+  char* end = base + buf_.size();
+  while (p < end) {
+    char* amp = static_cast<char*>(memchr(p, '&', end - p));
+    if (!amp) amp = end;
+
+    if (amp != p) {
+      char* eq = static_cast<char*>(memchr(p, '=', amp - p));
+      if (!eq) eq = amp;
+
+      Entry entry = {static_cast<size_t>(p - base),
+                     UnescapeInPlace(p, eq - p, true),
+                     static_cast<size_t>(eq - base), 0};
+      if (eq != amp) {
+        entry.value++;
+        entry.value_size = UnescapeInPlace(eq + 1, amp - eq - 1, true);
+      }
+      entries_.push_back(entry);
+    }
+    p = amp + 1;
+  }
+  pending_ = buf_.size();
+}
+
+size_t FormData::Find(string_view key) const {
+  Split();
+  for (size_t i = 0; i < entries_.size(); i++) {
+    const Entry& e = entries_[i];
+    if (string_view(buf_.data() + e.key, e.key_size) == key) return i;
+  }
+  return npos;
+}
+
+bool FormData::Aliases(string_view s) const noexcept {
+  return !s.empty() && s.data() >= buf_.data() &&
+         s.data() < buf_.data() + buf_.size();
 }
 
 }  // namespace http
-}  // namespace cppboot
\ No newline at end of file
+}  // namespace cppboot
@@ -2,7 +2,7 @@
 #define CPPBOOT_NET_HTTP_PARAM_H_
 
 #include <string>
-#include <map>
+#include <vector>
 
 #include "cppboot/base/status.h"
 #include "cppboot/base/string_view.h"
@@ -13,18 +13,62 @@ namespace http {
 /**
  * @brief 来自query或form的kv数据
  *
+ * A key may have several values, kept in the order they were added.
+ *
+ * Parse() only copies its input, which is split and unescaped in place on
+ * the first lookup, so parameters that are never read cost one copy. Keys
+ * and values are offsets into a single buffer: copies of the object stay
+ * valid, but the views returned are invalidated by the next non-const call.
+ * As lookups may finish a pending Parse(), even const calls must not race,
+ * and they may throw std::bad_alloc.
  */
 class FormData {
  public:
-  void Set(const char* key, const std::string& value) noexcept;
-  std::string Get(const char* key) const noexcept;
+  FormData() noexcept;
+
+  /// Number of key/value pairs.
+  size_t size() const;
+  bool empty() const { return size() == 0; }
+
+  /// Key and value of the i-th pair.
+  string_view key(size_t i) const;
+  string_view value(size_t i) const;
+
+  /// The first value of `key`, empty if there is none.
+  string_view Get(string_view key) const;
+  std::vector<string_view> GetAll(string_view key) const;
+  bool Has(string_view key) const;
 
-  Status Parse(string_view query) noexcept;
-  std::string Encode() const noexcept;
+  /// Replace all values of `key` with `value`.
+  void Set(string_view key, string_view value);
+  /// Append a value to `key`.
+  void Add(string_view key, string_view value);
+  void Del(string_view key);
+  void clear() noexcept;
+
+  /// Add the pairs of the query string or form body `query`.
+  Status Parse(string_view query);
+
+  /// "k1=v1&k2=v2" escaped and sorted by key, the values of a key in order.
+  std::string Encode() const;
+  void Encode(std::string* out) const;
 
  private:
-  // TODO: values其实是个数据 std::vector<std::string>
-  std::map<std::string, std::string> values_;
+  struct Entry {
+    size_t key;
+    size_t key_size;
+    size_t value;
+    size_t value_size;
+  };
+
+  /// Split the input appended by Parse() from `pending_` on.
+  void Split() const;
+  size_t Find(string_view key) const;
+  bool Aliases(string_view s) const noexcept;
+
+  mutable std::string buf_;
+  mutable std::vector<Entry> entries_;
+  mutable size_t pending_;
 };
 
 }  // namespace http
@@ -30,4 +30,66 @@ TEST(FormData, ParseQuery) {
   ASSERT_EQ(f.Get("no-key"), "");
 }
 
+TEST(FormData, ParseUnescapesAfterSplitting) {
+  FormData f;
+  f.Parse("a=1%262&b=x+y%3D&c&=empty-key&&d=%4a%4B&e=100%&e=%g1");
+
+  ASSERT_EQ(f.size(), 7);
+  ASSERT_EQ(f.Get("a"), "1&2");
+  ASSERT_EQ(f.Get("b"), "x y=");
+  ASSERT_TRUE(f.Has("c"));
+  ASSERT_EQ(f.Get("c"), "");
+  ASSERT_EQ(f.Get(""), "empty-key");
+  ASSERT_EQ(f.Get("d"), "JK");
+
+  // Malformed escapes are kept.
+  auto e = f.GetAll("e");
+  ASSERT_EQ(e.size(), 2);
+  ASSERT_EQ(e[0], "100%");
+  ASSERT_EQ(e[1], "%g1");
+}
+
+TEST(FormData, MultiValue) {
+  FormData f;
+  f.Parse("k=1&k=2");
+  f.Add("k", "3");
+  f.Add("other", "x");
+
+  ASSERT_EQ(f.Get("k"), "1");
+  ASSERT_THAT(f.GetAll("k"), ::testing::ElementsAre("1", "2", "3"));
+  ASSERT_EQ(f.Encode(), "k=1&k=2&k=3&other=x");
+
+  f.Set("k", "4");
+  ASSERT_THAT(f.GetAll("k"), ::testing::ElementsAre("4"));
+  f.Del("other");
+  ASSERT_FALSE(f.Has("other"));
+  ASSERT_EQ(f.Encode(), "k=4");
+
+  // Views of the container may be added back to it.
+  f.Add(f.key(0), f.value(0));
+  ASSERT_EQ(f.Encode(), "k=4&k=4");
+}
+
+TEST(FormData, EncodeEscapes) {
+  FormData f;
+  f.Set("q", "a b&c=d/\xC3\xA9~");
+  f.Set("k y", "-_.");
+  ASSERT_EQ(f.Encode(), "k+y=-_.&q=a+b%26c%3Dd%2F%C3%A9~");
+
+  FormData g;
+  g.Parse(f.Encode());
+  ASSERT_EQ(g.Get("q"), f.Get("q"));
+  ASSERT_EQ(g.Get("k y"), "-_.");
+}
+
+TEST(FormData, CopyAfterParse) {
+  FormData f;
+  f.Parse("a=%41");
+  FormData g = f;
+  ASSERT_EQ(g.Get("a"), "A");
+  f.clear();
+  ASSERT_EQ(g.Get("a"), "A");
+  ASSERT_TRUE(f.empty());
+}
+
 }  // namespace
\ No newline at end of file
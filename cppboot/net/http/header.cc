@@ -0,0 +1,328 @@
+#include "cppboot/net/http/header.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "cppboot/base/str_util.h"
+
+namespace cppboot {
+namespace http {
+
+namespace {
+
+const char* const kHeaderNames[kNumHeaderIds] = {
+    "Accept",
+    "Accept-Encoding",
+    "Accept-Language",
+    "Accept-Ranges",
+    "Authorization",
+    "Cache-Control",
+    "Connection",
+    "Content-Disposition",
+    "Content-Encoding",
+    "Content-Length",
+    "Content-Range",
+    "Content-Type",
+    "Cookie",
+    "Date",
+    "ETag",
+    "Expect",
+    "Host",
+    "If-Modified-Since",
+    "If-None-Match",
+    "If-Range",
+    "Keep-Alive",
+    "Last-Modified",
+    "Location",
+    "Origin",
+    "Range",
+    "Referer",
+    "Retry-After",
+    "Server",
+    "Set-Cookie",
+    "Transfer-Encoding",
+    "Upgrade",
+    "User-Agent",
+    "Vary",
+    "X-Forwarded-For",
+};
+
+const size_t npos = static_cast<size_t>(-1);
+
+/// FNV-1a of the lower-cased `s`.
+uint32_t HashIgnoreCase(string_view s) noexcept {
+  uint32_t h = 2166136261u;
+  for (char c : s) {
+    if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+    h ^= static_cast<unsigned char>(c);
+    h *= 16777619u;
+  }
+  return h;
+}
+
+/// Open addressing table from the hash of a name to its HeaderId.
+struct IdTable {
+  enum { kSize = 128 };
+
+  IdTable() {
+    memset(slots, -1, sizeof(slots));
+    for (int i = 0; i < kNumHeaderIds; i++) {
+      uint32_t h = HashIgnoreCase(kHeaderNames[i]) & (kSize - 1);
+      while (slots[h] >= 0) h = (h + 1) & (kSize - 1);
+      slots[h] = static_cast<int8_t>(i);
+    }
+  }
+
+  HeaderId Lookup(string_view name, uint32_t hash) const noexcept {
+    for (uint32_t h = hash & (kSize - 1); slots[h] >= 0;
+         h = (h + 1) & (kSize - 1)) {
+      if (EqualsIgnoreCase(kHeaderNames[slots[h]], name)) {
+        return static_cast<HeaderId>(slots[h]);
+      }
+    }
+    return kOtherHeader;
+  }
+
+  int8_t slots[kSize];
+};
+
+HeaderId LookupHeaderId(string_view name, uint32_t hash) noexcept {
+  static const IdTable table;
+  return table.Lookup(name, hash);
+}
+
+}  // namespace
+
+HeaderId LookupHeaderId(string_view name) noexcept {
+  return LookupHeaderId(name, HashIgnoreCase(name));
+}
+
+string_view HeaderName(HeaderId id) noexcept {
+  return id < kNumHeaderIds ? kHeaderNames[id] : string_view();
+}
+
+Headers::Headers() noexcept
+    : fields_(inline_fields_),
+      size_(0),
+      capacity_(kInlineFields),
+      arena_(inline_bytes_),
+      arena_left_(kInlineBytes) {
+  memset(index_, 0, sizeof(index_));
+}
+
+Headers::Headers(std::initializer_list<Header> fields) : Headers() {
+  for (auto& i : fields) Add(i.name, i.value);
+}
+
+Headers::Headers(const Headers& other) : Headers() { *this = other; }
+
+Headers& Headers::operator=(const Headers& other) {
+  if (this == &other) return *this;
+
+  // Referenced strings are copied too, the copy may outlive the buffer they
+  // are in.
+  clear();
+  for (auto& i : other) {
+    Field field = i;
+    if (field.id == kOtherHeader) field.name = Copy(field.name);
+    field.value = Copy(field.value);
+    field.owned = true;
+    Push(field);
+  }
+  return *this;
+}
+
+Headers& Headers::operator=(std::initializer_list<Header> fields) {
+  // The fields may point into this container.
+  Headers headers(fields);
+  return *this = headers;
+}
+
+Headers::~Headers() {}
+
+string_view Headers::Get(HeaderId id) const noexcept {
+  size_t i = Find(id, string_view(), 0);
+  return i == npos ? string_view() : fields_[i].value;
+}
+
+string_view Headers::Get(string_view name) const noexcept {
+  uint32_t hash = HashIgnoreCase(name);
+  size_t i = Find(LookupHeaderId(name, hash), name, hash);
+  return i == npos ? string_view() : fields_[i].value;
+}
+
+bool Headers::Has(HeaderId id) const noexcept {
+  return Find(id, string_view(), 0) != npos;
+}
+
+bool Headers::Has(string_view name) const noexcept {
+  uint32_t hash = HashIgnoreCase(name);
+  return Find(LookupHeaderId(name, hash), name, hash) != npos;
+}
+
+void Headers::Add(string_view name, string_view value) {
+  uint32_t hash = HashIgnoreCase(name);
+  HeaderId id = LookupHeaderId(name, hash);
+  if (id != kOtherHeader) {
+    Add(id, value);
+    return;
+  }
+
+  Field field = {Copy(name), Copy(value), id, hash, true};
+  Push(field);
+}
+
+void Headers::Add(HeaderId id, string_view value) {
+  Field field = {HeaderName(id), Copy(value), id, 0, true};
+  Push(field);
+}
+
+void Headers::AddRef(string_view name, string_view value) {
+  uint32_t hash = HashIgnoreCase(name);
+  HeaderId id = LookupHeaderId(name, hash);
+  Field field = {name, value, id, hash, false};
+  if (id != kOtherHeader) {
+    field.name = HeaderName(id);
+    field.hash = 0;
+  }
+  Push(field);
+}
+
+void Headers::Set(HeaderId id, string_view value) {
+  size_t i = Find(id, string_view(), 0);
+  if (i == npos) {
+    Add(id, value);
+    return;
+  }
+
+  SetValue(i, value);
+  for (size_t j = size_ - 1; j > i; j--) {
+    if (fields_[j].id == id) Erase(j);
+  }
+}
+
+void Headers::Set(string_view name, string_view value) {
+  uint32_t hash = HashIgnoreCase(name);
+  HeaderId id = LookupHeaderId(name, hash);
+  if (id != kOtherHeader) {
+    Set(id, value);
+    return;
+  }
+
+  size_t i = Find(id, name, hash);
+  if (i == npos) {
+    Add(name, value);
+    return;
+  }
+
+  SetValue(i, value);
+  for (size_t j = size_ - 1; j > i; j--) {
+    const Field& f = fields_[j];
+    if (f.id == id && f.hash == hash && EqualsIgnoreCase(f.name, name)) {
+      Erase(j);
+    }
+  }
+}
+
+void Headers::SetValue(size_t i, string_view value) {
+  Field& field = fields_[i];
+  if (!field.owned && field.id == kOtherHeader) field.name = Copy(field.name);
+  field.value = Copy(value);
+  field.owned = true;
+}
+
+void Headers::Del(HeaderId id) {
+  for (size_t i = size_; i > 0; i--) {
+    if (fields_[i - 1].id == id) Erase(i - 1);
+  }
+}
+
+void Headers::Del(string_view name) {
+  uint32_t hash = HashIgnoreCase(name);
+  HeaderId id = LookupHeaderId(name, hash);
+  if (id != kOtherHeader) {
+    Del(id);
+    return;
+  }
+
+  for (size_t i = size_; i > 0; i--) {
+    const Field& f = fields_[i - 1];
+    if (f.id == id && f.hash == hash && EqualsIgnoreCase(f.name, name)) {
+      Erase(i - 1);
+    }
+  }
+}
+
+void Headers::clear() noexcept {
+  size_ = 0;
+  memset(index_, 0, sizeof(index_));
+  arena_ = inline_bytes_;
+  arena_left_ = kInlineBytes;
+  blocks_.clear();
+}
+
+size_t Headers::Find(HeaderId id, string_view name,
+                     uint32_t hash) const noexcept {
+  if (id != kOtherHeader) return index_[id] ? index_[id] - 1 : npos;
+
+  for (size_t i = 0; i < size_; i++) {
+    const Field& f = fields_[i];
+    if (f.id == id && f.hash == hash && EqualsIgnoreCase(f.name, name)) {
+      return i;
+    }
+  }
+  return npos;
+}
+
+void Headers::Push(const Field& field) {
+  if (size_ == capacity_) {
+    std::unique_ptr<Field[]> fields(new Field[capacity_ * 2]);
+    std::copy(fields_, fields_ + size_, fields.get());
+    heap_fields_.swap(fields);
+    fields_ = heap_fields_.get();
+    capacity_ *= 2;
+  }
+
+  fields_[size_] = field;
+  if (field.id != kOtherHeader && !index_[field.id] && size_ < UINT16_MAX) {
+    index_[field.id] = static_cast<uint16_t>(size_ + 1);
+  }
+  size_++;
+}
+
+void Headers::Erase(size_t i) {
+  std::copy(fields_ + i + 1, fields_ + size_, fields_ + i);
+  size_--;
+  Reindex();
+}
+
+void Headers::Reindex() noexcept {
+  memset(index_, 0, sizeof(index_));
+  for (size_t i = size_; i > 0; i--) {
+    HeaderId id = fields_[i - 1].id;
+    if (id != kOtherHeader && i <= UINT16_MAX) {
+      index_[id] = static_cast<uint16_t>(i);
+    }
+  }
+}
+
+string_view Headers::Copy(string_view s) {
+  if (s.empty()) return string_view();
+
+  if (s.size() > arena_left_) {
+    size_t size = std::max<size_t>(s.size(), 1024);
+    blocks_.emplace_back(new char[size]);
+    arena_ = blocks_.back().get();
+    arena_left_ = size;
+  }
+
+  memcpy(arena_, s.data(), s.size());
+  string_view copy(arena_, s.size());
+  arena_ += s.size();
+  arena_left_ -= s.size();
+  return copy;
+}
+
+}  // namespace http
+}  // namespace cppboot
@@ -1,14 +1,162 @@
 #ifndef CPPBOOT_NET_HTTP_HEADER_H_
 #define CPPBOOT_NET_HTTP_HEADER_H_
 
+#include <stdint.h>
+
+#include <initializer_list>
+#include <memory>
 #include <string>
+#include <vector>
+
+#include "cppboot/base/string_view.h"
 
 namespace cppboot {
 namespace http {
 
+/// A header field, the strings are not owned.
 struct Header {
-  std::string name;
-  std::string value;
+  string_view name;
+  string_view value;
+};
+
+/// Well-known header fields, stored in slots of Headers.
+enum HeaderId {
+  kAccept,
+  kAcceptEncoding,
+  kAcceptLanguage,
+  kAcceptRanges,
+  kAuthorization,
+  kCacheControl,
+  kConnection,
+  kContentDisposition,
+  kContentEncoding,
+  kContentLength,
+  kContentRange,
+  kContentType,
+  kCookie,
+  kDate,
+  kETag,
+  kExpect,
+  kHost,
+  kIfModifiedSince,
+  kIfNoneMatch,
+  kIfRange,
+  kKeepAlive,
+  kLastModified,
+  kLocation,
+  kOrigin,
+  kRange,
+  kReferer,
+  kRetryAfter,
+  kServer,
+  kSetCookie,
+  kTransferEncoding,
+  kUpgrade,
+  kUserAgent,
+  kVary,
+  kXForwardedFor,
+
+  kNumHeaderIds,
+  kOtherHeader = kNumHeaderIds,
+};
+
+/// The id of the header `name` compared case-insensitively, kOtherHeader if
+/// it is not a well-known one.
+HeaderId LookupHeaderId(string_view name) noexcept;
+
+/// Canonical name of a well-known header, e.g. "Content-Length".
+string_view HeaderName(HeaderId id) noexcept;
+
+/// Header fields in arrival order with case-insensitive lookup. Well-known
+/// fields are indexed by HeaderId, so getting them is O(1). The first
+/// kInlineFields fields and kInlineBytes bytes of copied names and values live
+/// inside the object, hence small messages do not allocate.
+///
+/// Names and values are copied by Add() and Set(). AddRef() references them
+/// instead, e.g. in the receive buffer of a connection, which then has to
+/// outlive the container. Copies of the container own all their strings.
+class Headers {
+ public:
+  enum {
+    kInlineFields = 16,
+    kInlineBytes = 256,
+  };
+
+  struct Field {
+    string_view name;
+    string_view value;
+    HeaderId id;
+    /// Case-insensitive hash of `name`, speeds up finding other headers.
+    uint32_t hash;
+    /// Whether `value` lives in the container.
+    bool owned;
+  };
+
+  Headers() noexcept;
+  Headers(std::initializer_list<Header> fields);
+  Headers(const Headers& other);
+  Headers& operator=(const Headers& other);
+  Headers& operator=(std::initializer_list<Header> fields);
+  ~Headers();
+
+  size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+
+  const Field* begin() const noexcept { return fields_; }
+  const Field* end() const noexcept { return fields_ + size_; }
+  const Field& operator[](size_t i) const noexcept { return fields_[i]; }
+
+  /// Value of the first field, empty if there is none.
+  string_view Get(HeaderId id) const noexcept;
+  string_view Get(string_view name) const noexcept;
+
+  bool Has(HeaderId id) const noexcept;
+  bool Has(string_view name) const noexcept;
+
+  /// Append a field, copying `name` and `value`.
+  void Add(string_view name, string_view value);
+  void Add(HeaderId id, string_view value);
+
+  /// Append a field referencing `name` and `value` without copying.
+  void AddRef(string_view name, string_view value);
+
+  /// Replace the value of the first field and remove the others, or append
+  /// one.
+  void Set(HeaderId id, string_view value);
+  void Set(string_view name, string_view value);
+
+  /// Replace the value of the i-th field.
+  void SetValue(size_t i, string_view value);
+
+  /// Remove all fields named `name`.
+  void Del(HeaderId id);
+  void Del(string_view name);
+
+  void clear() noexcept;
+
+ private:
+  size_t Find(HeaderId id, string_view name, uint32_t hash) const noexcept;
+  void Push(const Field& field);
+  void Erase(size_t i);
+  void Reindex() noexcept;
+  string_view Copy(string_view s);
+
+  /// Fields, either `inline_fields_` or `heap_fields_`.
+  Field* fields_;
+  size_t size_;
+  size_t capacity_;
+  std::unique_ptr<Field[]> heap_fields_;
+
+  /// Position + 1 of the first field of each HeaderId, 0 if absent.
+  uint16_t index_[kNumHeaderIds];
+
+  /// Bump allocator for copied strings, the blocks never move.
+  char* arena_;
+  size_t arena_left_;
+  std::vector<std::unique_ptr<char[]>> blocks_;
+
+  Field inline_fields_[kInlineFields];
+  char inline_bytes_[kInlineBytes];
 };
 
 }  // namespace http
@@ -0,0 +1,92 @@
+#include "gmock/gmock.h"
+
+#include "cppboot/net/http/header.h"
+
+using cppboot::http::Headers;
+
+TEST(Headers, LookupHeaderId) {
+  using cppboot::http::LookupHeaderId;
+  ASSERT_EQ(LookupHeaderId("Content-Length"), cppboot::http::kContentLength);
+  ASSERT_EQ(LookupHeaderId("content-length"), cppboot::http::kContentLength);
+  ASSERT_EQ(LookupHeaderId("HOST"), cppboot::http::kHost);
+  ASSERT_EQ(LookupHeaderId("X-Request-Id"), cppboot::http::kOtherHeader);
+  ASSERT_EQ(LookupHeaderId(""), cppboot::http::kOtherHeader);
+  for (int i = 0; i < cppboot::http::kNumHeaderIds; i++) {
+    auto id = static_cast<cppboot::http::HeaderId>(i);
+    ASSERT_EQ(LookupHeaderId(cppboot::http::HeaderName(id)), id);
+  }
+}
+
+TEST(Headers, GetSetDel) {
+  Headers h;
+  ASSERT_TRUE(h.empty());
+  h.Add("content-type", "text/plain");
+  h.Add("X-Trace", "1");
+  h.Add("x-trace", "2");
+
+  ASSERT_EQ(h.size(), 3);
+  ASSERT_EQ(h[0].name, "Content-Type");  // canonical
+  ASSERT_EQ(h[1].name, "X-Trace");
+  ASSERT_EQ(h.Get(cppboot::http::kContentType), "text/plain");
+  ASSERT_EQ(h.Get("CONTENT-TYPE"), "text/plain");
+  ASSERT_EQ(h.Get("X-TRACE"), "1");
+  ASSERT_FALSE(h.Has("X-Other"));
+  ASSERT_FALSE(h.Has(cppboot::http::kHost));
+
+  h.Set("x-trace", "3");
+  ASSERT_EQ(h.size(), 2);
+  ASSERT_EQ(h.Get("X-Trace"), "3");
+
+  h.Set(cppboot::http::kContentType, "text/html");
+  ASSERT_EQ(h.Get("Content-Type"), "text/html");
+
+  h.Del("Content-Type");
+  ASSERT_FALSE(h.Has(cppboot::http::kContentType));
+  ASSERT_EQ(h.size(), 1);
+  ASSERT_EQ(h.Get("X-Trace"), "3");
+
+  h.clear();
+  ASSERT_TRUE(h.empty());
+  ASSERT_FALSE(h.Has("X-Trace"));
+}
+
+TEST(Headers, GrowBeyondInline) {
+  Headers h;
+  std::string big(1000, 'v');
+  for (int i = 0; i < 100; i++) {
+    h.Add("X-" + std::to_string(i), big + std::to_string(i));
+  }
+  h.Add("Host", "example.com");
+  ASSERT_EQ(h.size(), 101);
+  ASSERT_EQ(h.Get("x-42"), big + "42");
+  ASSERT_EQ(h.Get(cppboot::http::kHost), "example.com");
+
+  Headers copy(h);
+  h.clear();
+  ASSERT_EQ(copy.Get("X-99"), big + "99");
+  ASSERT_EQ(copy.Get("Host"), "example.com");
+}
+
+TEST(Headers, CopyOwnedAndReferenced) {
+  std::string buffer = "X-Ref: value";
+  Headers h = {{"ETag", "\"1\""}};
+  h.AddRef(cppboot::string_view(buffer.data(), 5),
+           cppboot::string_view(buffer.data() + 7, 5));
+  ASSERT_EQ(h.Get("x-ref").data(), buffer.data() + 7);
+
+  Headers copy;
+  copy = h;
+  // Copies own the referenced strings too.
+  ASSERT_NE(copy.Get("X-Ref").data(), buffer.data() + 7);
+  ASSERT_EQ(copy.Get("X-Ref"), "value");
+  ASSERT_NE(copy.begin()[1].name.data(), buffer.data());
+  ASSERT_NE(copy.Get("ETag").data(), h.Get("ETag").data());  // copied
+  ASSERT_EQ(copy.Get("ETag"), "\"1\"");
+  buffer.assign(buffer.size(), '-');
+  ASSERT_EQ(copy.Get("X-Ref"), "value");
+
+  // Assigning fields that point into the container itself.
+  copy = {{"A", copy.Get("ETag")}, {"B", copy.Get("X-Ref")}};
+  ASSERT_EQ(copy.Get("A"), "\"1\"");
+  ASSERT_EQ(copy.Get("B"), "value");
+}
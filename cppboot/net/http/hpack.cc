@@ -0,0 +1,489 @@
+#include "cppboot/net/http/hpack.h"
+
+#include <string.h>
+
+namespace cppboot {
+namespace http {
+
+namespace {
+
+struct HuffmanCode {
+  uint32_t code;
+  uint8_t bits;
+};
+
+/// The code of each byte, then of EOS (RFC 7541 Appendix B).
+const HuffmanCode kHuffmanCodes[257] = {
+    {0x1ff8, 13}, {0x7fffd8, 23}, {0xfffffe2, 28}, {0xfffffe3, 28},
+    {0xfffffe4, 28}, {0xfffffe5, 28}, {0xfffffe6, 28}, {0xfffffe7, 28},
+    {0xfffffe8, 28}, {0xffffea, 24}, {0x3ffffffc, 30}, {0xfffffe9, 28},
+    {0xfffffea, 28}, {0x3ffffffd, 30}, {0xfffffeb, 28}, {0xfffffec, 28},
+    {0xfffffed, 28}, {0xfffffee, 28}, {0xfffffef, 28}, {0xffffff0, 28},
+    {0xffffff1, 28}, {0xffffff2, 28}, {0x3ffffffe, 30}, {0xffffff3, 28},
+    {0xffffff4, 28}, {0xffffff5, 28}, {0xffffff6, 28}, {0xffffff7, 28},
+    {0xffffff8, 28}, {0xffffff9, 28}, {0xffffffa, 28}, {0xffffffb, 28},
+    {0x14, 6}, {0x3f8, 10}, {0x3f9, 10}, {0xffa, 12}, {0x1ff9, 13}, {0x15, 6},
+    {0xf8, 8}, {0x7fa, 11}, {0x3fa, 10}, {0x3fb, 10}, {0xf9, 8}, {0x7fb, 11},
+    {0xfa, 8}, {0x16, 6}, {0x17, 6}, {0x18, 6}, {0x0, 5}, {0x1, 5}, {0x2, 5},
+    {0x19, 6}, {0x1a, 6}, {0x1b, 6}, {0x1c, 6}, {0x1d, 6}, {0x1e, 6}, {0x1f, 6},
+    {0x5c, 7}, {0xfb, 8}, {0x7ffc, 15}, {0x20, 6}, {0xffb, 12}, {0x3fc, 10},
+    {0x1ffa, 13}, {0x21, 6}, {0x5d, 7}, {0x5e, 7}, {0x5f, 7}, {0x60, 7},
+    {0x61, 7}, {0x62, 7}, {0x63, 7}, {0x64, 7}, {0x65, 7}, {0x66, 7}, {0x67, 7},
+    {0x68, 7}, {0x69, 7}, {0x6a, 7}, {0x6b, 7}, {0x6c, 7}, {0x6d, 7}, {0x6e, 7},
+    {0x6f, 7}, {0x70, 7}, {0x71, 7}, {0x72, 7}, {0xfc, 8}, {0x73, 7}, {0xfd, 8},
+    {0x1ffb, 13}, {0x7fff0, 19}, {0x1ffc, 13}, {0x3ffc, 14}, {0x22, 6},
+    {0x7ffd, 15}, {0x3, 5}, {0x23, 6}, {0x4, 5}, {0x24, 6}, {0x5, 5}, {0x25, 6},
+    {0x26, 6}, {0x27, 6}, {0x6, 5}, {0x74, 7}, {0x75, 7}, {0x28, 6}, {0x29, 6},
+    {0x2a, 6}, {0x7, 5}, {0x2b, 6}, {0x76, 7}, {0x2c, 6}, {0x8, 5}, {0x9, 5},
+    {0x2d, 6}, {0x77, 7}, {0x78, 7}, {0x79, 7}, {0x7a, 7}, {0x7b, 7},
+    {0x7ffe, 15}, {0x7fc, 11}, {0x3ffd, 14}, {0x1ffd, 13}, {0xffffffc, 28},
+    {0xfffe6, 20}, {0x3fffd2, 22}, {0xfffe7, 20}, {0xfffe8, 20}, {0x3fffd3, 22},
+    {0x3fffd4, 22}, {0x3fffd5, 22}, {0x7fffd9, 23}, {0x3fffd6, 22},
+    {0x7fffda, 23}, {0x7fffdb, 23}, {0x7fffdc, 23}, {0x7fffdd, 23},
+    {0x7fffde, 23}, {0xffffeb, 24}, {0x7fffdf, 23}, {0xffffec, 24},
+    {0xffffed, 24}, {0x3fffd7, 22}, {0x7fffe0, 23}, {0xffffee, 24},
+    {0x7fffe1, 23}, {0x7fffe2, 23}, {0x7fffe3, 23}, {0x7fffe4, 23},
+    {0x1fffdc, 21}, {0x3fffd8, 22}, {0x7fffe5, 23}, {0x3fffd9, 22},
+    {0x7fffe6, 23}, {0x7fffe7, 23}, {0xffffef, 24}, {0x3fffda, 22},
+    {0x1fffdd, 21}, {0xfffe9, 20}, {0x3fffdb, 22}, {0x3fffdc, 22},
+    {0x7fffe8, 23}, {0x7fffe9, 23}, {0x1fffde, 21}, {0x7fffea, 23},
+    {0x3fffdd, 22}, {0x3fffde, 22}, {0xfffff0, 24}, {0x1fffdf, 21},
+    {0x3fffdf, 22}, {0x7fffeb, 23}, {0x7fffec, 23}, {0x1fffe0, 21},
+    {0x1fffe1, 21}, {0x3fffe0, 22}, {0x1fffe2, 21}, {0x7fffed, 23},
+    {0x3fffe1, 22}, {0x7fffee, 23}, {0x7fffef, 23}, {0xfffea, 20},
+    {0x3fffe2, 22}, {0x3fffe3, 22}, {0x3fffe4, 22}, {0x7ffff0, 23},
+    {0x3fffe5, 22}, {0x3fffe6, 22}, {0x7ffff1, 23}, {0x3ffffe0, 26},
+    {0x3ffffe1, 26}, {0xfffeb, 20}, {0x7fff1, 19}, {0x3fffe7, 22},
+    {0x7ffff2, 23}, {0x3fffe8, 22}, {0x1ffffec, 25}, {0x3ffffe2, 26},
+    {0x3ffffe3, 26}, {0x3ffffe4, 26}, {0x7ffffde, 27}, {0x7ffffdf, 27},
+    {0x3ffffe5, 26}, {0xfffff1, 24}, {0x1ffffed, 25}, {0x7fff2, 19},
+    {0x1fffe3, 21}, {0x3ffffe6, 26}, {0x7ffffe0, 27}, {0x7ffffe1, 27},
+    {0x3ffffe7, 26}, {0x7ffffe2, 27}, {0xfffff2, 24}, {0x1fffe4, 21},
+    {0x1fffe5, 21}, {0x3ffffe8, 26}, {0x3ffffe9, 26}, {0xffffffd, 28},
+    {0x7ffffe3, 27}, {0x7ffffe4, 27}, {0x7ffffe5, 27}, {0xfffec, 20},
+    {0xfffff3, 24}, {0xfffed, 20}, {0x1fffe6, 21}, {0x3fffe9, 22},
+    {0x1fffe7, 21}, {0x1fffe8, 21}, {0x7ffff3, 23}, {0x3fffea, 22},
+    {0x3fffeb, 22}, {0x1ffffee, 25}, {0x1ffffef, 25}, {0xfffff4, 24},
+    {0xfffff5, 24}, {0x3ffffea, 26}, {0x7ffff4, 23}, {0x3ffffeb, 26},
+    {0x7ffffe6, 27}, {0x3ffffec, 26}, {0x3ffffed, 26}, {0x7ffffe7, 27},
+    {0x7ffffe8, 27}, {0x7ffffe9, 27}, {0x7ffffea, 27}, {0x7ffffeb, 27},
+    {0xffffffe, 28}, {0x7ffffec, 27}, {0x7ffffed, 27}, {0x7ffffee, 27},
+    {0x7ffffef, 27}, {0x7fffff0, 27}, {0x3ffffee, 26}, {0x3fffffff, 30},
+};
+
+const size_t kEos = 256;
+
+/// Decoding consumes four bits at a time. A state is an inner node of the
+/// code tree, the root being 0, and the four bits lead to the next one,
+/// emitting at most one byte on the way since codes are at least five bits
+/// long.
+class HuffmanDecoder {
+ public:
+  enum {
+    kEmit = 1,
+    /// The bits since the last byte are valid padding, a prefix of EOS
+    /// shorter than a byte.
+    kAccept = 2,
+    kFail = 4,
+  };
+
+  struct Transition {
+    uint8_t state;
+    uint8_t flags;
+    uint8_t byte;
+  };
+
+  static const HuffmanDecoder& Get() {
+    static const HuffmanDecoder decoder;
+    return decoder;
+  }
+
+  const Transition& Next(uint8_t state, unsigned nibble) const noexcept {
+    return transitions_[state][nibble];
+  }
+
+ private:
+  HuffmanDecoder() {
+    // Build the tree, a child is an inner node index or ~symbol.
+    struct Node {
+      int child[2];
+      int depth;
+      bool ones;
+    };
+    std::vector<Node> nodes(1);
+    nodes[0] = Node{{0, 0}, 0, true};
+    for (int sym = 0; sym <= static_cast<int>(kEos); sym++) {
+      const HuffmanCode& c = kHuffmanCodes[sym];
+      int cur = 0;
+      for (int i = c.bits - 1; i > 0; i--) {
+        int bit = (c.code >> i) & 1;
+        if (nodes[cur].child[bit] == 0) {
+          nodes[cur].child[bit] = static_cast<int>(nodes.size());
+          Node n = {{0, 0}, nodes[cur].depth + 1, nodes[cur].ones && bit};
+          nodes.push_back(n);
+        }
+        cur = nodes[cur].child[bit];
+      }
+      nodes[cur].child[c.code & 1] = ~sym;
+    }
+
+    for (size_t s = 0; s < nodes.size(); s++) {
+      for (unsigned nibble = 0; nibble < 16; nibble++) {
+        Transition& t = transitions_[s][nibble];
+        t.flags = 0;
+        t.byte = 0;
+        int cur = static_cast<int>(s);
+        for (int i = 3; i >= 0; i--) {
+          int next = nodes[cur].child[(nibble >> i) & 1];
+          if (next >= 0) {
+            cur = next;
+            continue;
+          }
+          if (~next == static_cast<int>(kEos)) {
+            t.flags = kFail;
+            break;
+          }
+          t.flags |= kEmit;
+          t.byte = static_cast<uint8_t>(~next);
+          cur = 0;
+        }
+        t.state = static_cast<uint8_t>(cur);
+        if (nodes[cur].ones && nodes[cur].depth < 8) t.flags |= kAccept;
+      }
+    }
+  }
+
+  /// There are 256 inner nodes for 257 symbols.
+  Transition transitions_[256][16];
+};
+
+const HpackField kStaticTable[] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+
+const size_t kStaticTableSize = sizeof(kStaticTable) / sizeof(kStaticTable[0]);
+
+/// Largest integer accepted, far above any sensible length or index.
+const uint64_t kMaxInteger = 1u << 28;
+
+void EncodeInteger(uint8_t flags, int prefix_bits, uint64_t value,
+                   std::string* out) {
+  uint64_t max_prefix = (1u << prefix_bits) - 1;
+  if (value < max_prefix) {
+    out->push_back(static_cast<char>(flags | value));
+    return;
+  }
+  out->push_back(static_cast<char>(flags | max_prefix));
+  value -= max_prefix;
+  while (value >= 128) {
+    out->push_back(static_cast<char>(0x80 | (value & 0x7f)));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+bool DecodeInteger(const uint8_t** p, const uint8_t* end, int prefix_bits,
+                   uint64_t* value) {
+  uint64_t max_prefix = (1u << prefix_bits) - 1;
+  *value = *(*p)++ & max_prefix;
+  if (*value < max_prefix) return true;
+
+  for (int shift = 0; *p < end; shift += 7) {
+    uint8_t b = *(*p)++;
+    *value += static_cast<uint64_t>(b & 0x7f) << shift;
+    if (*value > kMaxInteger) return false;
+    if (!(b & 0x80)) return true;
+  }
+  return false;
+}
+
+void EncodeString(string_view s, std::string* out) {
+  size_t huffman = HuffmanEncodedSize(s);
+  if (huffman < s.size()) {
+    EncodeInteger(0x80, 7, huffman, out);
+    HuffmanEncode(s, out);
+  } else {
+    EncodeInteger(0, 7, s.size(), out);
+    out->append(s.data(), s.size());
+  }
+}
+
+bool DecodeString(const uint8_t** p, const uint8_t* end, std::string* out) {
+  if (*p == end) return false;
+  bool huffman = **p & 0x80;
+  uint64_t length;
+  if (!DecodeInteger(p, end, 7, &length) ||
+      length > static_cast<uint64_t>(end - *p)) {
+    return false;
+  }
+
+  string_view s(reinterpret_cast<const char*>(*p), length);
+  *p += length;
+  out->clear();
+  if (huffman) return HuffmanDecode(s, out);
+  out->assign(s.data(), s.size());
+  return true;
+}
+
+/// Whether a response field is worth a slot of the dynamic table, values
+/// that change with each message are not.
+bool ShouldIndex(string_view name) noexcept {
+  static const char* const kVolatile[] = {
+      ":path",         "content-length", "content-range", "etag",
+      "last-modified", "location",       "authorization", "set-cookie",
+  };
+  for (const char* v : kVolatile) {
+    if (name == v) return false;
+  }
+  return true;
+}
+
+/// Fields that must never be indexed by any hop, RFC 7541 section 7.1.3.
+bool IsSensitive(string_view name) noexcept {
+  return name == "authorization" || name == "set-cookie";
+}
+
+}  // namespace
+
+void HuffmanEncode(string_view in, std::string* out) {
+  uint64_t bits = 0;
+  int n = 0;
+  for (unsigned char c : in) {
+    const HuffmanCode& code = kHuffmanCodes[c];
+    bits = (bits << code.bits) | code.code;
+    n += code.bits;
+    while (n >= 8) {
+      n -= 8;
+      out->push_back(static_cast<char>(bits >> n));
+    }
+    bits &= (uint64_t(1) << n) - 1;
+  }
+  // Padded with the most significant bits of EOS, all ones.
+  if (n > 0) out->push_back(static_cast<char>((bits << (8 - n)) | (0xff >> n)));
+}
+
+size_t HuffmanEncodedSize(string_view in) noexcept {
+  size_t bits = 0;
+  for (unsigned char c : in) bits += kHuffmanCodes[c].bits;
+  return (bits + 7) / 8;
+}
+
+bool HuffmanDecode(string_view in, std::string* out) {
+  const HuffmanDecoder& decoder = HuffmanDecoder::Get();
+  uint8_t state = 0;
+  bool accept = true;
+  for (unsigned char c : in) {
+    for (unsigned nibble : {static_cast<unsigned>(c >> 4), c & 0xfu}) {
+      const HuffmanDecoder::Transition& t = decoder.Next(state, nibble);
+      if (t.flags & HuffmanDecoder::kFail) return false;
+      if (t.flags & HuffmanDecoder::kEmit) {
+        out->push_back(static_cast<char>(t.byte));
+      }
+      state = t.state;
+      accept = t.flags & HuffmanDecoder::kAccept;
+    }
+  }
+  return accept;
+}
+
+const HpackField* HpackTable::Get(size_t index) const noexcept {
+  if (index == 0) return nullptr;
+  if (index <= kStaticTableSize) return &kStaticTable[index - 1];
+  index -= kStaticTableSize + 1;
+  return index < entries_.size() ? &entries_[index] : nullptr;
+}
+
+size_t HpackTable::Find(string_view name, string_view value,
+                        bool* exact) const noexcept {
+  size_t name_index = 0;
+  for (size_t i = 0; i < kStaticTableSize; i++) {
+    if (kStaticTable[i].name != name) continue;
+    if (kStaticTable[i].value == value) {
+      *exact = true;
+      return i + 1;
+    }
+    if (name_index == 0) name_index = i + 1;
+  }
+  for (size_t i = 0; i < entries_.size(); i++) {
+    if (entries_[i].name != name) continue;
+    if (entries_[i].value == value) {
+      *exact = true;
+      return kStaticTableSize + 1 + i;
+    }
+    if (name_index == 0) name_index = kStaticTableSize + 1 + i;
+  }
+  *exact = false;
+  return name_index;
+}
+
+void HpackTable::Add(string_view name, string_view value) {
+  size_t size = name.size() + value.size() + kEntryOverhead;
+  if (size > max_size_) {
+    // Too large, it empties the table.
+    Evict(max_size_);
+    return;
+  }
+
+  Evict(size);
+  entries_.push_front(HpackField{name.str(), value.str()});
+  size_ += size;
+}
+
+void HpackTable::set_max_size(size_t size) {
+  max_size_ = size;
+  Evict(0);
+}
+
+void HpackTable::Evict(size_t room) {
+  while (!entries_.empty() && size_ + room > max_size_) {
+    const HpackField& f = entries_.back();
+    size_ -= f.name.size() + f.value.size() + kEntryOverhead;
+    entries_.pop_back();
+  }
+}
+
+bool HpackDecoder::Decode(string_view block, std::vector<HpackField>* fields) {
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(block.data());
+  const uint8_t* end = p + block.size();
+  bool field_seen = false;
+  while (p < end) {
+    uint8_t b = *p;
+    uint64_t index;
+    if (b & 0x80) {
+      // Indexed field.
+      if (!DecodeInteger(&p, end, 7, &index)) return false;
+      const HpackField* f = table_.Get(index);
+      if (!f) return false;
+      fields->push_back(*f);
+      field_seen = true;
+      continue;
+    }
+
+    if ((b & 0xe0) == 0x20) {
+      // Dynamic table size update, only before the fields.
+      if (field_seen || !DecodeInteger(&p, end, 5, &index) ||
+          index > max_table_size_) {
+        return false;
+      }
+      table_.set_max_size(index);
+      continue;
+    }
+
+    // Literal field, with incremental indexing or not.
+    bool indexing = (b & 0xc0) == 0x40;
+    if (!DecodeInteger(&p, end, indexing ? 6 : 4, &index)) return false;
+    HpackField field;
+    if (index != 0) {
+      const HpackField* f = table_.Get(index);
+      if (!f) return false;
+      field.name = f->name;
+    } else if (!DecodeString(&p, end, &field.name)) {
+      return false;
+    }
+    if (!DecodeString(&p, end, &field.value)) return false;
+
+    if (indexing) table_.Add(field.name, field.value);
+    fields->push_back(std::move(field));
+    field_seen = true;
+  }
+  return true;
+}
+
+void HpackEncoder::set_max_table_size(size_t size) {
+  // Larger tables than the default are not used.
+  if (size > HpackTable::kDefaultSize) size = HpackTable::kDefaultSize;
+  if (size == table_.max_size()) return;
+  table_.set_max_size(size);
+  pending_size_update_ = true;
+}
+
+void HpackEncoder::Begin(std::string* out) {
+  if (pending_size_update_) {
+    EncodeInteger(0x20, 5, table_.max_size(), out);
+    pending_size_update_ = false;
+  }
+}
+
+void HpackEncoder::Add(string_view name, string_view value, std::string* out) {
+  bool exact;
+  size_t index = table_.Find(name, value, &exact);
+  if (index != 0 && exact) {
+    EncodeInteger(0x80, 7, index, out);
+    return;
+  }
+
+  bool indexing = ShouldIndex(name) &&
+                  name.size() + value.size() + HpackTable::kEntryOverhead <=
+                      table_.max_size() / 2;
+  if (indexing) {
+    EncodeInteger(0x40, 6, index, out);
+  } else {
+    EncodeInteger(IsSensitive(name) ? 0x10 : 0x00, 4, index, out);
+  }
+  if (index == 0) EncodeString(name, out);
+  EncodeString(value, out);
+  if (indexing) table_.Add(name, value);
+}
+
+}  // namespace http
+}  // namespace cppboot
@@ -0,0 +1,108 @@
+#ifndef CPPBOOT_NET_HTTP_HPACK_H_
+#define CPPBOOT_NET_HTTP_HPACK_H_
+
+#include <stdint.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "cppboot/base/string_view.h"
+
+namespace cppboot {
+namespace http {
+
+/// HPACK, the header compression of HTTP/2 (RFC 7541).
+
+/// Append the Huffman code of `in` to `out`.
+void HuffmanEncode(string_view in, std::string* out);
+
+/// Length of the Huffman code of `in`.
+size_t HuffmanEncodedSize(string_view in) noexcept;
+
+/// Append the decoded `in` to `out`, false if it is not a valid code.
+bool HuffmanDecode(string_view in, std::string* out);
+
+/// A decoded header field, the name is lowercase.
+struct HpackField {
+  std::string name;
+  std::string value;
+};
+
+/// The dynamic table shared by an encoder and the peer's decoder.
+class HpackTable {
+ public:
+  enum { kDefaultSize = 4096 };
+
+  /// Entry overhead counted against the size.
+  enum { kEntryOverhead = 32 };
+
+  HpackTable() : size_(0), max_size_(kDefaultSize) {}
+
+  /// Entry `index`, 1-based across the static table then this one, null if
+  /// there is none.
+  const HpackField* Get(size_t index) const noexcept;
+
+  /// Index of `name` with `value`, else of `name` alone with `*exact` false,
+  /// 0 if neither is found.
+  size_t Find(string_view name, string_view value, bool* exact) const noexcept;
+
+  void Add(string_view name, string_view value);
+
+  size_t size() const noexcept { return size_; }
+  size_t max_size() const noexcept { return max_size_; }
+  void set_max_size(size_t size);
+
+ private:
+  void Evict(size_t room);
+
+  /// Newest first.
+  std::deque<HpackField> entries_;
+  size_t size_;
+  size_t max_size_;
+};
+
+/// Decodes the header blocks of one connection.
+class HpackDecoder {
+ public:
+  HpackDecoder() : max_table_size_(HpackTable::kDefaultSize) {}
+
+  /// The table size the peer may use at most, as advertised in our
+  /// SETTINGS_HEADER_TABLE_SIZE.
+  void set_max_table_size(size_t size) noexcept { max_table_size_ = size; }
+
+  /// Decode a complete header block into `fields`, false if it is malformed,
+  /// a connection error.
+  bool Decode(string_view block, std::vector<HpackField>* fields);
+
+ private:
+  HpackTable table_;
+  size_t max_table_size_;
+};
+
+/// Encodes the header blocks of one connection. Fields are indexed in the
+/// dynamic table unless their value is unlikely to repeat, strings are
+/// Huffman coded when that is shorter.
+class HpackEncoder {
+ public:
+  HpackEncoder() : pending_size_update_(false) {}
+
+  /// The table size the peer's decoder accepts, from its
+  /// SETTINGS_HEADER_TABLE_SIZE. Announced at the start of the next block.
+  void set_max_table_size(size_t size);
+
+  /// Start a header block in `out`.
+  void Begin(std::string* out);
+
+  /// Append a field, `name` must be lowercase.
+  void Add(string_view name, string_view value, std::string* out);
+
+ private:
+  HpackTable table_;
+  bool pending_size_update_;
+};
+
+}  // namespace http
+}  // namespace cppboot
+
+#endif  // CPPBOOT_NET_HTTP_HPACK_H_
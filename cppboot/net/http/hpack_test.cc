@@ -0,0 +1,154 @@
+#include "gmock/gmock.h"
+
+#include "cppboot/net/http/hpack.h"
+
+namespace {
+
+using cppboot::http::HpackDecoder;
+using cppboot::http::HpackEncoder;
+using cppboot::http::HpackField;
+using cppboot::http::HuffmanDecode;
+using cppboot::http::HuffmanEncode;
+using cppboot::http::HuffmanEncodedSize;
+
+std::string Unhex(const std::string& hex) {
+  std::string out;
+  for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+    out.push_back(static_cast<char>(std::stoi(hex.substr(i, 2), nullptr, 16)));
+  }
+  return out;
+}
+
+typedef std::vector<std::pair<std::string, std::string>> FieldList;
+
+FieldList Pairs(const std::vector<HpackField>& fields) {
+  FieldList pairs;
+  for (auto& f : fields) pairs.emplace_back(f.name, f.value);
+  return pairs;
+}
+
+TEST(Hpack, Huffman) {
+  // RFC 7541 Appendix C.4.
+  struct {
+    const char* text;
+    const char* hex;
+  } cases[] = {
+      {"www.example.com", "f1e3c2e5f23a6ba0ab90f4ff"},
+      {"no-cache", "a8eb10649cbf"},
+      {"custom-key", "25a849e95ba97d7f"},
+      {"custom-value", "25a849e95bb8e8b4bf"},
+      {"", ""},
+  };
+  for (auto& c : cases) {
+    std::string encoded;
+    HuffmanEncode(c.text, &encoded);
+    ASSERT_EQ(encoded, Unhex(c.hex)) << c.text;
+    ASSERT_EQ(HuffmanEncodedSize(c.text), encoded.size());
+
+    std::string decoded;
+    ASSERT_TRUE(HuffmanDecode(encoded, &decoded));
+    ASSERT_EQ(decoded, c.text);
+  }
+
+  std::string all;
+  for (int c = 0; c < 256; c++) all.push_back(static_cast<char>(c));
+  std::string encoded, decoded;
+  HuffmanEncode(all, &encoded);
+  ASSERT_TRUE(HuffmanDecode(encoded, &decoded));
+  ASSERT_EQ(decoded, all);
+
+  // Padding that is not all ones, or longer than 7 bits.
+  ASSERT_FALSE(HuffmanDecode(std::string(1, '\0'), &decoded));
+  ASSERT_FALSE(HuffmanDecode(Unhex("f1e3c2e5f23a6ba0ab90f4fe"), &decoded));
+  ASSERT_FALSE(HuffmanDecode(Unhex("ffff"), &decoded));
+  // EOS itself.
+  ASSERT_FALSE(HuffmanDecode(Unhex("ffffffff"), &decoded));
+}
+
+TEST(Hpack, DecodeRequests) {
+  // RFC 7541 Appendix C.4, three requests sharing the dynamic table.
+  HpackDecoder decoder;
+  std::vector<HpackField> fields;
+  ASSERT_TRUE(decoder.Decode(Unhex("828684418cf1e3c2e5f23a6ba0ab90f4ff"),
+                             &fields));
+  ASSERT_EQ(Pairs(fields), (FieldList{{":method", "GET"},
+                                      {":scheme", "http"},
+                                      {":path", "/"},
+                                      {":authority", "www.example.com"}}));
+
+  fields.clear();
+  ASSERT_TRUE(decoder.Decode(Unhex("828684be5886a8eb10649cbf"), &fields));
+  ASSERT_EQ(Pairs(fields), (FieldList{{":method", "GET"},
+                                      {":scheme", "http"},
+                                      {":path", "/"},
+                                      {":authority", "www.example.com"},
+                                      {"cache-control", "no-cache"}}));
+
+  fields.clear();
+  ASSERT_TRUE(decoder.Decode(
+      Unhex("828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf"), &fields));
+  ASSERT_EQ(Pairs(fields), (FieldList{{":method", "GET"},
+                                      {":scheme", "https"},
+                                      {":path", "/index.html"},
+                                      {":authority", "www.example.com"},
+                                      {"custom-key", "custom-value"}}));
+}
+
+TEST(Hpack, DecodeErrors) {
+  HpackDecoder decoder;
+  decoder.set_max_table_size(256);
+  std::vector<HpackField> fields;
+
+  // No such index.
+  ASSERT_FALSE(decoder.Decode(Unhex("be"), &fields));
+  ASSERT_FALSE(decoder.Decode(Unhex("80"), &fields));
+  // Truncated string and integer.
+  ASSERT_FALSE(decoder.Decode(Unhex("408825a849"), &fields));
+  ASSERT_FALSE(decoder.Decode(Unhex("ff"), &fields));
+
+  // A size update up to the advertised size, before the fields only.
+  ASSERT_TRUE(decoder.Decode(Unhex("3fe101"), &fields));
+  ASSERT_FALSE(decoder.Decode(Unhex("3fe201"), &fields));
+  ASSERT_FALSE(decoder.Decode(Unhex("823fe101"), &fields));
+}
+
+TEST(Hpack, RoundTrip) {
+  HpackEncoder encoder;
+  HpackDecoder decoder;
+  FieldList response = {
+      {":status", "200"},
+      {"content-type", "text/html; charset=utf-8"},
+      {"date", "Mon, 21 Oct 2013 20:13:21 GMT"},
+      {"content-length", "1234"},
+      {"set-cookie", "id=a3fWa; Max-Age=2592000"},
+      {"x-long", std::string(300, 'z')},
+  };
+
+  size_t first = 0;
+  for (int i = 0; i < 3; i++) {
+    std::string block;
+    encoder.Begin(&block);
+    for (auto& f : response) encoder.Add(f.first, f.second, &block);
+    if (i == 0) first = block.size();
+
+    std::vector<HpackField> fields;
+    ASSERT_TRUE(decoder.Decode(block, &fields));
+    ASSERT_EQ(Pairs(fields), response);
+    // Later blocks mostly index the fields sent before.
+    if (i > 0) {
+      ASSERT_LT(block.size(), first / 2);
+    }
+  }
+
+  // A smaller table announced by the peer.
+  encoder.set_max_table_size(64);
+  std::string block;
+  encoder.Begin(&block);
+  encoder.Add("content-type", "text/html; charset=utf-8", &block);
+  ASSERT_EQ(block[0], '\x3f');
+  std::vector<HpackField> fields;
+  ASSERT_TRUE(decoder.Decode(block, &fields));
+  ASSERT_EQ(fields[0].value, "text/html; charset=utf-8");
+}
+
+}  // namespace
@@ -1,4 +1,6 @@
 #include "cppboot/net/http/request.h"
+
+#include "cppboot/base/str_util.h"
 #include "cppboot/net/http/url.h"
 
 namespace cppboot {
@@ -21,38 +23,64 @@ Request::Request(const std::string& method, const std::string& raw_url)
 
 Request::~Request() {}
 
-void Request::set_header(const std::string& name,
-                         const std::string& value) noexcept {
-  for (auto& i : headers) {
-    if (i.name == name) {
-      i.value = value;
-      return;
-    }
-  }
+void Request::Reset() noexcept {
+  method.clear();
+  uri.clear();
+  http_version_major = 0;
+  http_version_minor = 0;
+  headers.clear();
+  content.clear();
+  body_source = BodySource();
+  path.clear();
+  subpath.clear();
+  params.clear();
+  host.clear();
+  url.scheme.clear();
+  url.host.clear();
+  url.raw_path.clear();
+  url.raw_query.clear();
+  remote_address = asio::ip::address();
+  path_params = PathParams();
+}
 
-  Header h = {name, value};
-  headers.push_back(h);
+string_view Request::PathValue(string_view name) const noexcept {
+  for (size_t i = 0; i < path_params.size; i++) {
+    const PathParams::Entry& e = path_params.entries[i];
+    if (e.name == name) return string_view(path.data() + e.offset, e.length);
+  }
+  return string_view();
 }
 
-void Request::to_buffers(asio::streambuf* buf) const noexcept {
-  // Form the request. We specify the "TcpConnection: close" header so that the
-  // server will close the socket after transmitting the response. This will
-  // allow us to treat all data up until the EOF as the content.
+bool Request::IsIdempotent() const noexcept {
+  return method == "GET" || method == "HEAD" || method == "OPTIONS" ||
+         method == "TRACE" || method == "PUT" || method == "DELETE" ||
+         headers.Has("Idempotency-Key");
+}
 
+void Request::to_buffers(asio::streambuf* buf,
+                         bool keep_alive) const noexcept {
   std::ostream request_stream(buf);
   request_stream << method << " ";
-  if (url.raw_query.empty())
-    request_stream << url.raw_path;
-  else
-    request_stream << url.raw_path << "?" << url.raw_query;
+  request_stream << (url.raw_path.empty() ? "/" : url.raw_path);
+  if (!url.raw_query.empty()) request_stream << "?" << url.raw_query;
 
-  request_stream << " HTTP/1.0\r\n";
+  request_stream << " HTTP/1.1\r\n";
   request_stream << "Host: " << url.host << "\r\n";
-  request_stream << "Accept: */*\r\n";
-  if (!content.empty()) {
+  if (!headers.Has(kAccept)) request_stream << "Accept: */*\r\n";
+  for (auto& h : headers) {
+    if (h.id == kHost || h.id == kContentLength || h.id == kConnection) {
+      continue;
+    }
+    request_stream << h.name << ": " << h.value << "\r\n";
+  }
+  if (body_source && body_source.size >= 0) {
+    request_stream << "Content-Length: " << content.length() + body_source.size
+                   << "\r\n";
+  } else if (!content.empty() || method == "POST" || method == "PUT") {
     request_stream << "Content-Length: " << content.length() << "\r\n";
   }
-  request_stream << "TcpConnection: close\r\n\r\n";
+  if (!keep_alive) request_stream << "Connection: close\r\n";
+  request_stream << "\r\n";
   if (!content.empty()) {
     request_stream << content;
   }
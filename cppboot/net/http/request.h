@@ -6,6 +6,8 @@
 #include <map>
 
 #include "asio.hpp"
+#include "cppboot/base/string_view.h"
+#include "body_sink.h"
 #include "header.h"
 #include "form_data.h"
 #include "cppboot/net/http/url.h"
@@ -13,6 +15,33 @@
 namespace cppboot {
 namespace http {
 
+/// Path parameters captured by ServeMux, e.g. "id" of "/users/{id}". Values
+/// are stored as offsets into Request::path, so capturing them never allocates
+/// and they stay valid when the request is copied.
+struct PathParams {
+  enum { kMaxParams = 8 };
+
+  struct Entry {
+    string_view name;
+    size_t offset;
+    size_t length;
+  };
+
+  PathParams() : size(0) {}
+
+  bool Push(string_view name, size_t offset, size_t length) noexcept {
+    if (size >= kMaxParams) return false;
+    entries[size].name = name;
+    entries[size].offset = offset;
+    entries[size].length = length;
+    size++;
+    return true;
+  }
+
+  size_t size;
+  Entry entries[kMaxParams];
+};
+
 /// A request received from a client.
 
 struct Request {
@@ -20,10 +49,14 @@ struct Request {
   std::string uri;
   int http_version_major;
   int http_version_minor;
-  std::vector<Header> headers;
+  Headers headers;
 
   std::string content;
 
+  /// The rest of the body after `content`. A server sets it when the body
+  /// did not arrive with the head, clients stream it if its size is known.
+  BodySource body_source;
+
   std::string path;
   std::string subpath;
 
@@ -31,15 +64,46 @@ struct Request {
   std::string host;
   Url url;
 
+  /// Address of the client, set by the server.
+  asio::ip::address remote_address;
+
   Request();
   Request(const std::string& method, const std::string& raw_url);
   ~Request();
 
-  void set_header(const std::string& name, const std::string& value) noexcept;
+  /// Clear for the next request read into this object, keeping the memory
+  /// of the strings, so that parsing a request of a similar size does not
+  /// allocate.
+  void Reset() noexcept;
+
+  /// Value of the header `name`, compared case-insensitively.
+  string_view header(string_view name) const noexcept {
+    return headers.Get(name);
+  }
+
+  void set_header(string_view name, string_view value) {
+    headers.Set(name, value);
+  }
+
+  PathParams path_params;
+
+  /// First value of the query parameter `key`. The result points into
+  /// `params`.
+  string_view Param(string_view key) const { return params.Get(key); }
+
+  /// Value of the path parameter `name`, empty if it was not captured. The
+  /// result points into `path`.
+  string_view PathValue(string_view name) const noexcept;
 
-  std::string Param(const char* key) const noexcept { return params.Get(key); }
+  /// Whether sending the request twice has the effect of sending it once,
+  /// so that it may be retried: GET, HEAD, OPTIONS, TRACE, PUT and DELETE,
+  /// or any request carrying an Idempotency-Key.
+  bool IsIdempotent() const noexcept;
 
-  void to_buffers(asio::streambuf* buf) const noexcept;
+  /// Serialize as an HTTP/1.1 request, asking the server to close the
+  /// connection afterwards unless `keep_alive`. The Content-Length counts
+  /// `body_source`, which is sent afterwards.
+  void to_buffers(asio::streambuf* buf, bool keep_alive = true) const noexcept;
 };
 
 }  // namespace http
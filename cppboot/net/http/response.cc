@@ -1,16 +1,25 @@
 #include "cppboot/net/http/response.h"
 
+#include <map>
 #include <string>
 
+#include "cppboot/base/str_util.h"
+#include "cppboot/net/html/document.h"
+#include "cppboot/net/http/date.h"
+
 namespace cppboot {
 namespace http {
 
 namespace status_strings {
 
+// Upgrades only exist since HTTP/1.1.
+const std::string switching_protocols =
+    "HTTP/1.1 101 Switching Protocols\r\n";
 const std::string ok = "HTTP/1.0 200 OK\r\n";
 const std::string created = "HTTP/1.0 201 Created\r\n";
 const std::string accepted = "HTTP/1.0 202 Accepted\r\n";
 const std::string no_content = "HTTP/1.0 204 No Content\r\n";
+const std::string partial_content = "HTTP/1.0 206 Partial Content\r\n";
 const std::string multiple_choices = "HTTP/1.0 300 Multiple Choices\r\n";
 const std::string moved_permanently = "HTTP/1.0 301 Moved Permanently\r\n";
 const std::string moved_temporarily = "HTTP/1.0 302 Moved Temporarily\r\n";
@@ -19,48 +28,71 @@ const std::string bad_request = "HTTP/1.0 400 Bad Request\r\n";
 const std::string unauthorized = "HTTP/1.0 401 Unauthorized\r\n";
 const std::string forbidden = "HTTP/1.0 403 Forbidden\r\n";
 const std::string not_found = "HTTP/1.0 404 Not Found\r\n";
+const std::string method_not_allowed =
+    "HTTP/1.0 405 Method Not Allowed\r\n";
+const std::string request_timeout = "HTTP/1.0 408 Request Timeout\r\n";
+const std::string range_not_satisfiable =
+    "HTTP/1.0 416 Range Not Satisfiable\r\n";
+const std::string too_many_requests = "HTTP/1.0 429 Too Many Requests\r\n";
+const std::string request_header_fields_too_large =
+    "HTTP/1.0 431 Request Header Fields Too Large\r\n";
 const std::string internal_server_error =
     "HTTP/1.0 500 Internal Server Error\r\n";
 const std::string not_implemented = "HTTP/1.0 501 Not Implemented\r\n";
 const std::string bad_gateway = "HTTP/1.0 502 Bad Gateway\r\n";
 const std::string service_unavailable = "HTTP/1.0 503 Service Unavailable\r\n";
+const std::string empty;
 
-asio::const_buffer to_buffer(Response::status_type status) {
+const std::string& get(Response::status_type status) {
   switch (status) {
+    case Response::switching_protocols:
+      return switching_protocols;
     case Response::ok:
-      return asio::buffer(ok);
+      return ok;
     case Response::created:
-      return asio::buffer(created);
+      return created;
     case Response::accepted:
-      return asio::buffer(accepted);
+      return accepted;
     case Response::no_content:
-      return asio::buffer(no_content);
+      return no_content;
+    case Response::partial_content:
+      return partial_content;
     case Response::multiple_choices:
-      return asio::buffer(multiple_choices);
+      return multiple_choices;
     case Response::moved_permanently:
-      return asio::buffer(moved_permanently);
+      return moved_permanently;
     case Response::moved_temporarily:
-      return asio::buffer(moved_temporarily);
+      return moved_temporarily;
     case Response::not_modified:
-      return asio::buffer(not_modified);
+      return not_modified;
     case Response::bad_request:
-      return asio::buffer(bad_request);
+      return bad_request;
     case Response::unauthorized:
-      return asio::buffer(unauthorized);
+      return unauthorized;
     case Response::forbidden:
-      return asio::buffer(forbidden);
+      return forbidden;
     case Response::not_found:
-      return asio::buffer(not_found);
+      return not_found;
+    case Response::method_not_allowed:
+      return method_not_allowed;
+    case Response::request_timeout:
+      return request_timeout;
+    case Response::range_not_satisfiable:
+      return range_not_satisfiable;
+    case Response::too_many_requests:
+      return too_many_requests;
+    case Response::request_header_fields_too_large:
+      return request_header_fields_too_large;
     case Response::internal_server_error:
-      return asio::buffer(internal_server_error);
+      return internal_server_error;
     case Response::not_implemented:
-      return asio::buffer(not_implemented);
+      return not_implemented;
     case Response::bad_gateway:
-      return asio::buffer(bad_gateway);
+      return bad_gateway;
     case Response::service_unavailable:
-      return asio::buffer(service_unavailable);
+      return service_unavailable;
     default:
-      return asio::buffer(internal_server_error);
+      return empty;
   }
 }
 
@@ -73,18 +105,60 @@ const char crlf[] = {'\r', '\n'};
 
 }  // namespace misc_strings
 
-std::vector<asio::const_buffer> Response::to_buffers() {
+
+void Response::SerializeHead(std::string* out) const {
+  const std::string& status_line = status_strings::get(status);
+  if (!status_line.empty()) {
+    out->append(status_line);
+  } else {
+    // Relayed from another server, the reason phrase may be empty.
+    out->append("HTTP/1.0 ");
+    StrAppendUInt(*out, static_cast<int>(status));
+    out->append(" \r\n");
+  }
+
+  for (auto& h : headers) {
+    out->append(h.name.data(), h.name.size());
+    out->append(misc_strings::name_value_separator,
+                sizeof(misc_strings::name_value_separator));
+    out->append(h.value.data(), h.value.size());
+    out->append(misc_strings::crlf, sizeof(misc_strings::crlf));
+  }
+
+  if (!headers.Has(kDate)) {
+    out->append("Date: ");
+    auto date = CurrentHttpDate();
+    out->append(date.data(), date.size());
+    out->append(misc_strings::crlf, sizeof(misc_strings::crlf));
+  }
+
+  if (!headers.Has(kContentLength) && !takeover && AllowsBody(status) &&
+      !(body_source && body_source.size < 0)) {
+    size_t length = body().size() + (file_body ? file_body->size() : 0) +
+                    (body_source ? body_source.size : 0);
+    out->append("Content-Length: ");
+    StrAppendUInt(*out, length);
+    out->append(misc_strings::crlf, sizeof(misc_strings::crlf));
+  }
+
+  out->append(misc_strings::crlf, sizeof(misc_strings::crlf));
+}
+
+std::vector<asio::const_buffer> Response::to_buffers() const {
   std::vector<asio::const_buffer> buffers;
-  buffers.push_back(status_strings::to_buffer(status));
-  for (std::size_t i = 0; i < headers.size(); ++i) {
-    Header& h = headers[i];
-    buffers.push_back(asio::buffer(h.name));
+  const std::string& status_line = status_strings::get(status);
+  buffers.push_back(asio::buffer(status_line.empty()
+                                     ? status_strings::internal_server_error
+                                     : status_line));
+  for (auto& h : headers) {
+    buffers.push_back(asio::buffer(h.name.data(), h.name.size()));
     buffers.push_back(asio::buffer(misc_strings::name_value_separator));
-    buffers.push_back(asio::buffer(h.value));
+    buffers.push_back(asio::buffer(h.value.data(), h.value.size()));
     buffers.push_back(asio::buffer(misc_strings::crlf));
   }
   buffers.push_back(asio::buffer(misc_strings::crlf));
-  buffers.push_back(asio::buffer(content));
+  auto content = body();
+  buffers.push_back(asio::buffer(content.data(), content.size()));
   return buffers;
 }
 
@@ -106,6 +180,11 @@ const char no_content[] =
     "<head><title>No Content</title></head>"
     "<body><h1>204 Content</h1></body>"
     "</html>";
+const char partial_content[] =
+    "<html>"
+    "<head><title>Partial Content</title></head>"
+    "<body><h1>206 Partial Content</h1></body>"
+    "</html>";
 const char multiple_choices[] =
     "<html>"
     "<head><title>Multiple Choices</title></head>"
@@ -146,6 +225,31 @@ const char not_found[] =
     "<head><title>Not Found</title></head>"
     "<body><h1>404 Not Found</h1></body>"
     "</html>";
+const char method_not_allowed[] =
+    "<html>"
+    "<head><title>Method Not Allowed</title></head>"
+    "<body><h1>405 Method Not Allowed</h1></body>"
+    "</html>";
+const char request_timeout[] =
+    "<html>"
+    "<head><title>Request Timeout</title></head>"
+    "<body><h1>408 Request Timeout</h1></body>"
+    "</html>";
+const char range_not_satisfiable[] =
+    "<html>"
+    "<head><title>Range Not Satisfiable</title></head>"
+    "<body><h1>416 Range Not Satisfiable</h1></body>"
+    "</html>";
+const char too_many_requests[] =
+    "<html>"
+    "<head><title>Too Many Requests</title></head>"
+    "<body><h1>429 Too Many Requests</h1></body>"
+    "</html>";
+const char request_header_fields_too_large[] =
+    "<html>"
+    "<head><title>Request Header Fields Too Large</title></head>"
+    "<body><h1>431 Request Header Fields Too Large</h1></body>"
+    "</html>";
 const char internal_server_error[] =
     "<html>"
     "<head><title>Internal Server Error</title></head>"
@@ -167,7 +271,7 @@ const char service_unavailable[] =
     "<body><h1>503 Service Unavailable</h1></body>"
     "</html>";
 
-std::string to_string(Response::status_type status) {
+const char* to_string(Response::status_type status) {
   switch (status) {
     case Response::ok:
       return ok;
@@ -177,6 +281,8 @@ std::string to_string(Response::status_type status) {
       return accepted;
     case Response::no_content:
       return no_content;
+    case Response::partial_content:
+      return partial_content;
     case Response::multiple_choices:
       return multiple_choices;
     case Response::moved_permanently:
@@ -193,6 +299,16 @@ std::string to_string(Response::status_type status) {
       return forbidden;
     case Response::not_found:
       return not_found;
+    case Response::method_not_allowed:
+      return method_not_allowed;
+    case Response::request_timeout:
+      return request_timeout;
+    case Response::range_not_satisfiable:
+      return range_not_satisfiable;
+    case Response::too_many_requests:
+      return too_many_requests;
+    case Response::request_header_fields_too_large:
+      return request_header_fields_too_large;
     case Response::internal_server_error:
       return internal_server_error;
     case Response::not_implemented:
@@ -206,59 +322,112 @@ std::string to_string(Response::status_type status) {
   }
 }
 
+const Response::status_type statuses[] = {
+    Response::ok,
+    Response::created,
+    Response::accepted,
+    Response::no_content,
+    Response::partial_content,
+    Response::multiple_choices,
+    Response::moved_permanently,
+    Response::moved_temporarily,
+    Response::not_modified,
+    Response::bad_request,
+    Response::unauthorized,
+    Response::forbidden,
+    Response::not_found,
+    Response::method_not_allowed,
+    Response::request_timeout,
+    Response::range_not_satisfiable,
+    Response::too_many_requests,
+    Response::request_header_fields_too_large,
+    Response::internal_server_error,
+    Response::not_implemented,
+    Response::bad_gateway,
+    Response::service_unavailable,
+};
+
+/// The bodies are built once and shared by every stock reply.
+const std::shared_ptr<const std::string>& shared_body(
+    Response::status_type status) {
+  typedef std::map<int, std::shared_ptr<const std::string>> Bodies;
+  static const Bodies* bodies = [] {
+    Bodies* bodies = new Bodies();
+    for (auto i : statuses) {
+      (*bodies)[i] = std::make_shared<const std::string>(to_string(i));
+    }
+    return bodies;
+  }();
+
+  auto it = bodies->find(status);
+  if (it == bodies->end()) it = bodies->find(Response::internal_server_error);
+  return it->second;
+}
+
 }  // namespace stock_replies
 
 Response Response::stock_reply(Response::status_type status) {
   Response rep;
   rep.status = status;
-  rep.content = stock_replies::to_string(status);
-  rep.set_header("Content-Length", std::to_string(rep.content.size()));
-  rep.set_header("Content-Type", "text/html");
-  return rep;
-}
-
-std::string Response::header(const std::string& name) noexcept {
-  for (auto& i : headers) {
-    if (i.name == name) {
-      return i.value;
-    }
+  if (AllowsBody(status)) {
+    rep.shared_content = stock_replies::shared_body(status);
+    rep.headers.Add(kContentType, "text/html");
   }
-  return {};
+  return rep;
 }
 
-// TODO: duplicate
-void Response::set_header(const std::string& name,
-                          const std::string& value) noexcept {
-  for (auto& i : headers) {
-    if (i.name == name) {
-      i.value = value;
-      return;
-    }
-  }
-
-  Header h = {name, value};
-  headers.push_back(h);
+void Response::Reset() noexcept {
+  status = ok;
+  headers.clear();
+  content.clear();
+  shared_content.reset();
+  static_content = string_view();
+  file_body.reset();
+  body_source = BodySource();
+  defer_hook = nullptr;
+  takeover_hook = nullptr;
+  takeover = nullptr;
 }
 
 void Response::WriteText(status_type code, const std::string& body) {
   status = code;
   content = body;
-  set_header("Content-Length", std::to_string(content.size()));
-  set_header("Content-Type", "text/plain");
+  shared_content.reset();
+  static_content = string_view();
+  file_body.reset();
+  headers.Del(kContentLength);
+  headers.Set(kContentType, "text/plain");
 }
 
 void Response::WriteHtml(status_type code, const std::string& body) {
   status = code;
   content = body;
-  set_header("Content-Length", std::to_string(content.size()));
-  set_header("Content-Type", "text/html");
+  shared_content.reset();
+  static_content = string_view();
+  file_body.reset();
+  headers.Del(kContentLength);
+  headers.Set(kContentType, "text/html");
+}
+
+void Response::WriteHtml(status_type code, const html::Document& doc) {
+  status = code;
+  content.clear();
+  doc.Render(&content);
+  shared_content.reset();
+  static_content = string_view();
+  file_body.reset();
+  headers.Del(kContentLength);
+  headers.Set(kContentType, "text/html");
 }
 
 void Response::WriteJson(status_type code, const json& body) {
   status = code;
   content = body.dump();
-  set_header("Content-Length", std::to_string(content.size()));
-  set_header("Content-Type", "application/json");
+  shared_content.reset();
+  static_content = string_view();
+  file_body.reset();
+  headers.Del(kContentLength);
+  headers.Set(kContentType, "application/json");
 }
 
 }  // namespace http
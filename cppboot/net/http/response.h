@@ -3,10 +3,15 @@
 
 #include <string>
 #include <vector>
+#include <memory>
+#include <functional>
 #include <asio.hpp>
 
 #include "cppboot/base/json.h"
+#include "cppboot/base/string_view.h"
 
+#include "body_sink.h"
+#include "file_body.h"
 #include "header.h"
 
 namespace cppboot {
@@ -15,16 +20,22 @@ namespace html {
 class Document;
 }
 
+namespace net {
+class Conn;
+}
+
 namespace http {
 
 /// A reply to be sent to a client.
 struct Response {
   /// The status of the reply.
   enum status_type {
+    switching_protocols = 101,
     ok = 200,
     created = 201,
     accepted = 202,
     no_content = 204,
+    partial_content = 206,
     multiple_choices = 300,
     moved_permanently = 301,
     moved_temporarily = 302,
@@ -33,6 +44,11 @@ struct Response {
     unauthorized = 401,
     forbidden = 403,
     not_found = 404,
+    method_not_allowed = 405,
+    request_timeout = 408,
+    range_not_satisfiable = 416,
+    too_many_requests = 429,
+    request_header_fields_too_large = 431,
     internal_server_error = 500,
     not_implemented = 501,
     bad_gateway = 502,
@@ -40,22 +56,104 @@ struct Response {
   } status;
 
   /// The headers to be included in the reply.
-  std::vector<Header> headers;
+  Headers headers;
 
   /// The content to be sent in the reply.
   std::string content;
 
+  /// Immutable content shared with a cache. When set it is sent instead of
+  /// `content`, so cached bodies go out without being copied.
+  std::shared_ptr<const std::string> shared_content;
+
+  /// Immutable content outliving every reply, e.g. files embedded in the
+  /// program. When set it is sent instead of `content`, without a copy.
+  string_view static_content;
+
+  /// File streamed after `content` with sendfile(2), used for large files.
+  FileBodyPtr file_body;
+
+  /// Body produced while it is sent after `content`, e.g. relayed from
+  /// another server. Without a size the end of the connection delimits it.
+  BodySource body_source;
+
+  /// The in-memory body that will be sent, `shared_content`,
+  /// `static_content` or `content`.
+  string_view body() const noexcept {
+    if (shared_content) return *shared_content;
+    return static_content.data() ? static_content : string_view(content);
+  }
+
+  /// Append the status line and the headers to `out`, typically a scratch
+  /// buffer reused by the connection, the body is sent separately. A Date
+  /// header is added unless set, so is a Content-Length covering body(),
+  /// `file_body` and `body_source` unless the reply is taken over.
+  void SerializeHead(std::string* out) const;
+
   /// Convert the reply into a vector of buffers. The buffers do not own the
   /// underlying memory blocks, therefore the reply object must remain valid and
-  /// not be changed until the write operation has completed.
-  std::vector<asio::const_buffer> to_buffers();
-
-  /// Get a stock reply.
+  /// not be changed until the write operation has completed. Unlike
+  /// SerializeHead() no Date or Content-Length is added, and only the
+  /// in-memory body is included.
+  std::vector<asio::const_buffer> to_buffers() const;
+
+  /// False for the statuses that never carry a body, 1xx, 204 and 304.
+  static bool AllowsBody(int status) noexcept {
+    return status / 100 != 1 && status != no_content && status != not_modified;
+  }
+
+  typedef std::function<void()> DoneFunc;
+
+  /// Installed by the connection, see Defer().
+  std::function<DoneFunc()> defer_hook;
+
+  /// Finish the reply asynchronously, e.g. after reading a file on a
+  /// FileIoService. Must be called before the handler returns. The handler
+  /// then fills in the reply from any thread and calls the returned function
+  /// exactly once, the connection sends the reply from its own thread.
+  DoneFunc Defer() { return defer_hook ? defer_hook() : DoneFunc([] {}); }
+
+  /// Called with the socket of the connection once the head of the reply
+  /// was sent, and with what the client sent past the request. Returns the
+  /// connection now speaking another protocol on the socket, which calls
+  /// `closed` once it is done.
+  typedef std::function<std::shared_ptr<net::Conn>(
+      asio::ip::tcp::socket socket, string_view pending,
+      std::function<void()> closed)>
+      TakeoverFunc;
+
+  /// Installed by the connection if it can be taken over, see Takeover().
+  std::function<bool()> takeover_hook;
+
+  /// Set by Takeover(). The body, if any, is then whatever the new protocol
+  /// sends until the connection closes, so the head has no Content-Length.
+  TakeoverFunc takeover;
+
+  /// Hand the connection over to `fn` after this reply, typically a 101
+  /// Switching Protocols, or the head of an endless stream. Must be called
+  /// before the handler returns, the reply can not be deferred. Returns false
+  /// if the connection can not be taken over, e.g. it speaks HTTP/2.
+  bool Takeover(TakeoverFunc fn) {
+    if (!takeover_hook || !takeover_hook()) return false;
+    takeover = std::move(fn);
+    return true;
+  }
+
+  /// Clear for the next reply built in this object, keeping the memory of
+  /// `content` and `headers`.
+  void Reset() noexcept;
+
+  /// Get a stock reply, its body is preformatted and shared. Statuses that
+  /// do not allow a body get none.
   static Response stock_reply(status_type status);
 
-  std::string header(const std::string& name) noexcept;
+  /// Value of the header `name`, compared case-insensitively.
+  string_view header(string_view name) const noexcept {
+    return headers.Get(name);
+  }
 
-  void set_header(const std::string& name, const std::string& value) noexcept;
+  void set_header(string_view name, string_view value) {
+    headers.Set(name, value);
+  }
 
   /**
    * @brief set text into response body with "text/plain"
@@ -67,6 +165,9 @@ struct Response {
 
   void WriteHtml(status_type code, const std::string& body);
 
+  /// Render `doc` straight into `content`, reusing its memory.
+  void WriteHtml(status_type code, const html::Document& doc);
+
   /**
    * @brief JSON serializes into the response body with "application/json".
    *
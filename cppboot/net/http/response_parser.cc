@@ -0,0 +1,244 @@
+#include "cppboot/net/http/response_parser.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "cppboot/base/str_util.h"
+
+namespace cppboot {
+namespace http {
+
+namespace {
+
+/// Longest accepted chunk size or trailer line.
+const size_t kMaxLineSize = 4096;
+
+/// Largest body the content is sized for up front.
+const uint64_t kMaxReserve = 64 * 1024 * 1024;
+
+/// Parse the unsigned number `s` in `base`, false if it is not one.
+bool ParseSize(string_view s, int base, uint64_t* n) {
+  s = StrTrim(s);
+  if (s.empty() || s.size() > 16) return false;
+
+  char digits[17];
+  memcpy(digits, s.data(), s.size());
+  digits[s.size()] = '\0';
+  char* end;
+  *n = strtoull(digits, &end, base);
+  return end == digits + s.size() && isxdigit(digits[0]);
+}
+
+}  // namespace
+
+ResponseParser::ResponseParser(const std::string& method) : sink_(nullptr) {
+  reset(method);
+}
+
+void ResponseParser::reset(const std::string& method) {
+  state_ = head;
+  head_request_ = method == "HEAD";
+  keep_alive_ = false;
+  head_.clear();
+  line_.clear();
+  remaining_ = 0;
+  received_ = 0;
+  total_ = -1;
+  sink_status_ = OkStatus();
+}
+
+std::tuple<ResponseParser::result_type, const char*> ResponseParser::parse(
+    Response& resp, const char* begin, const char* end) {
+  bool too_long = false;
+  for (;;) {
+    switch (state_) {
+      case head: {
+        size_t old = head_.size();
+        size_t n = std::min<size_t>(end - begin, kMaxHeadSize + 4 - old);
+        head_.append(begin, n);
+        size_t pos = head_.find("\r\n\r\n", old < 3 ? 0 : old - 3);
+        if (pos == std::string::npos) {
+          if (head_.size() >= kMaxHeadSize + 4) {
+            return std::make_tuple(bad, begin);
+          }
+          return std::make_tuple(indeterminate, end);
+        }
+
+        begin += pos + 4 - old;
+        head_.resize(pos + 2);
+        if (!ParseHead(resp)) return std::make_tuple(bad, begin);
+        // Still in the head after an interim response.
+        if (state_ != head && sink_ && sink_->on_head) sink_->on_head(resp);
+        break;
+      }
+
+      case body_length:
+      case chunk_data: {
+        if (begin == end) return std::make_tuple(indeterminate, end);
+        size_t n = std::min<uint64_t>(end - begin, remaining_);
+        if (!Body(resp, begin, n)) return std::make_tuple(bad, begin);
+        begin += n;
+        remaining_ -= n;
+        if (remaining_ == 0) {
+          state_ = state_ == body_length ? done : chunk_data_end;
+        }
+        break;
+      }
+
+      case chunk_size: {
+        if (!ConsumeLine(&begin, end, &too_long)) {
+          if (too_long) return std::make_tuple(bad, begin);
+          return std::make_tuple(indeterminate, end);
+        }
+        // "<hex size>[;extensions]"
+        if (!ParseSize(string_view(line_).substr(0, line_.find(';')), 16,
+                       &remaining_)) {
+          return std::make_tuple(bad, begin);
+        }
+        line_.clear();
+        state_ = remaining_ == 0 ? trailers : chunk_data;
+        break;
+      }
+
+      case chunk_data_end:
+      case trailers: {
+        if (!ConsumeLine(&begin, end, &too_long)) {
+          if (too_long) return std::make_tuple(bad, begin);
+          return std::make_tuple(indeterminate, end);
+        }
+        // The data of a chunk is followed by an empty line, the trailers
+        // by one too.
+        bool empty = line_.empty();
+        line_.clear();
+        if (state_ == chunk_data_end) {
+          if (!empty) return std::make_tuple(bad, begin);
+          state_ = chunk_size;
+        } else if (empty) {
+          state_ = done;
+        }
+        break;
+      }
+
+      case body_until_eof:
+        if (begin != end && !Body(resp, begin, end - begin)) {
+          return std::make_tuple(bad, begin);
+        }
+        return std::make_tuple(indeterminate, end);
+
+      case done:
+        return std::make_tuple(good, begin);
+    }
+  }
+}
+
+ResponseParser::result_type ResponseParser::eof() {
+  if (state_ == body_until_eof) {
+    state_ = done;
+    return good;
+  }
+  return state_ == done ? good : bad;
+}
+
+bool ResponseParser::ParseHead(Response& resp) {
+  string_view head = head_;
+  size_t eol = head.find("\r\n");
+  string_view status_line = head.substr(0, eol);
+  head = head.substr(eol + 2);
+
+  // "HTTP/1.1 200 OK"
+  uint64_t status_code;
+  if (status_line.size() < 12 || !StartsWith(status_line, "HTTP/1.") ||
+      status_line[8] != ' ' ||
+      !ParseSize(status_line.substr(9, 3), 10, &status_code)) {
+    return false;
+  }
+  bool http11 = status_line[7] != '0';
+
+  resp.status = static_cast<Response::status_type>(status_code);
+  resp.headers.clear();
+  resp.content.clear();
+  while (!head.empty()) {
+    eol = head.find("\r\n");
+    string_view line = head.substr(0, eol);
+    head = eol == string_view::npos ? string_view() : head.substr(eol + 2);
+
+    size_t colon = line.find(':');
+    if (colon == string_view::npos || colon == 0) return false;
+    resp.headers.Add(line.substr(0, colon), StrTrim(line.substr(colon + 1)));
+  }
+  head_.clear();
+
+  // Interim responses, 100 Continue or 103 Early Hints, are followed by the
+  // final one. 101 Switching Protocols ends the HTTP response.
+  if (status_code / 100 == 1 && status_code != 101) return true;
+
+  string_view connection = resp.headers.Get(kConnection);
+  keep_alive_ = http11 ? !EqualsIgnoreCase(connection, "close")
+                       : EqualsIgnoreCase(connection, "keep-alive");
+
+  if (head_request_ || status_code == 101 || status_code == 204 ||
+      status_code == 304) {
+    total_ = 0;
+    state_ = done;
+    return true;
+  }
+
+  if (EndsWithIgnoreCase(StrTrim(resp.headers.Get(kTransferEncoding)),
+                         "chunked")) {
+    state_ = chunk_size;
+    return true;
+  }
+
+  string_view content_length = resp.headers.Get(kContentLength);
+  if (!content_length.empty()) {
+    if (!ParseSize(content_length, 10, &remaining_)) return false;
+    total_ = static_cast<int64_t>(remaining_);
+    if (!sink_) resp.content.reserve(std::min(remaining_, kMaxReserve));
+    state_ = remaining_ == 0 ? done : body_length;
+    return true;
+  }
+
+  // Without a length the body ends with the connection.
+  keep_alive_ = false;
+  state_ = body_until_eof;
+  return true;
+}
+
+bool ResponseParser::Body(Response& resp, const char* data, size_t size) {
+  received_ += size;
+  if (!sink_) {
+    resp.content.append(data, size);
+    return true;
+  }
+
+  if (sink_->on_data) {
+    sink_status_ = sink_->on_data(string_view(data, size));
+    if (!sink_status_) return false;
+  }
+  if (sink_->on_progress) sink_->on_progress(received_, total_);
+  return true;
+}
+
+bool ResponseParser::ConsumeLine(const char** p, const char* end,
+                                 bool* too_long) {
+  const char* nl =
+      static_cast<const char*>(memchr(*p, '\n', end - *p));
+  const char* stop = nl ? nl + 1 : end;
+  line_.append(*p, stop);
+  *p = stop;
+  if (line_.size() > kMaxLineSize) {
+    *too_long = true;
+    return false;
+  }
+  if (!nl) return false;
+
+  line_.pop_back();
+  if (!line_.empty() && line_.back() == '\r') line_.pop_back();
+  return true;
+}
+
+}  // namespace http
+}  // namespace cppboot
@@ -0,0 +1,101 @@
+#ifndef CPPBOOT_NET_HTTP_RESPONSE_PARSER_H_
+#define CPPBOOT_NET_HTTP_RESPONSE_PARSER_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <tuple>
+
+#include "cppboot/net/http/body_sink.h"
+#include "cppboot/net/http/response.h"
+
+namespace cppboot {
+namespace http {
+
+/// Incremental parser for HTTP/1.x responses received by a client, fed with
+/// the bytes as they arrive. The body is delimited by Content-Length, by
+/// chunked transfer encoding, or else by the end of the connection, see
+/// eof(). The body goes to Response::content, or to a BodySink.
+class ResponseParser {
+ public:
+  enum {
+    /// Longest accepted response head.
+    kMaxHeadSize = 64 * 1024,
+  };
+
+  /// Construct ready to parse a response to a `method` request.
+  explicit ResponseParser(const std::string& method = "GET");
+
+  /// Reset to parse the response to another `method` request, the sink is
+  /// kept.
+  void reset(const std::string& method);
+
+  /// Stream the body into `sink` instead of Response::content, nullptr to
+  /// stop. The sink must outlive the parse.
+  void set_body_sink(const BodySink* sink) noexcept { sink_ = sink; }
+
+  /// The failure of the sink after a bad parse, if it was the cause.
+  const Status& sink_status() const noexcept { return sink_status_; }
+
+  /// Result of parse.
+  enum result_type { good, bad, indeterminate };
+
+  /// Parse some data into `resp`. The result is good when the response is
+  /// complete, bad if the data is invalid, indeterminate when more data is
+  /// required. The pointer tells how much of the input has been consumed,
+  /// bytes after a complete response are left alone.
+  std::tuple<result_type, const char*> parse(Response& resp,
+                                             const char* begin,
+                                             const char* end);
+
+  /// The connection was closed by the server: good if that completes a
+  /// body without length, bad otherwise.
+  result_type eof();
+
+  /// Whether the connection may carry another request after a good parse.
+  bool keep_alive() const noexcept { return keep_alive_; }
+
+  /// Whether the status line and headers have been parsed.
+  bool head_done() const noexcept { return state_ > head; }
+
+ private:
+  /// Parse the status line and headers in `head_`.
+  bool ParseHead(Response& resp);
+
+  /// Deliver a piece of the body.
+  bool Body(Response& resp, const char* data, size_t size);
+
+  /// Consume a CRLF-terminated line into `line_`, true once it is complete.
+  bool ConsumeLine(const char** p, const char* end, bool* too_long);
+
+  enum state {
+    head,
+    body_length,
+    chunk_size,
+    chunk_data,
+    chunk_data_end,
+    trailers,
+    body_until_eof,
+    done,
+  } state_;
+
+  bool head_request_;
+  bool keep_alive_;
+  /// The head received so far.
+  std::string head_;
+  /// The chunk size or trailer line received so far.
+  std::string line_;
+  /// Bytes left of the body or of the current chunk.
+  uint64_t remaining_;
+  /// Body bytes received, and expected or -1 if unknown.
+  uint64_t received_;
+  int64_t total_;
+
+  const BodySink* sink_;
+  Status sink_status_;
+};
+
+}  // namespace http
+}  // namespace cppboot
+
+#endif  // CPPBOOT_NET_HTTP_RESPONSE_PARSER_H_
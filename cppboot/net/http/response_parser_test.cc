@@ -0,0 +1,134 @@
+#include "gmock/gmock.h"
+
+#include <tuple>
+
+#include "cppboot/net/http/response_parser.h"
+
+using cppboot::http::Response;
+using cppboot::http::ResponseParser;
+
+namespace {
+
+/// Feed `data` one byte at a time.
+ResponseParser::result_type ParseBytewise(ResponseParser& parser,
+                                          Response& resp,
+                                          const std::string& data) {
+  ResponseParser::result_type result = ResponseParser::indeterminate;
+  for (size_t i = 0; i < data.size(); i++) {
+    const char* p = data.data() + i;
+    std::tie(result, std::ignore) = parser.parse(resp, p, p + 1);
+    if (result != ResponseParser::indeterminate) break;
+  }
+  return result;
+}
+
+}  // namespace
+
+TEST(ResponseParser, ChunkedBytewise) {
+  ResponseParser parser;
+  Response resp;
+  auto result = ParseBytewise(parser, resp,
+                              "HTTP/1.1 201 Created\r\n"
+                              "Transfer-Encoding: chunked\r\n"
+                              "\r\n"
+                              "5;name=value\r\nhello\r\n"
+                              "1\r\n \r\n"
+                              "5\r\nworld\r\n"
+                              "0\r\n"
+                              "Trailer: 1\r\n"
+                              "\r\n");
+  ASSERT_EQ(result, ResponseParser::good);
+  ASSERT_EQ(resp.status, Response::created);
+  ASSERT_EQ(resp.content, "hello world");
+  ASSERT_TRUE(parser.keep_alive());
+}
+
+TEST(ResponseParser, ContentLengthLeavesNextResponse) {
+  std::string data =
+      "HTTP/1.1 200 OK\r\nContent-Length: 3\r\n\r\nabc"
+      "HTTP/1.1 204 No Content\r\n\r\n";
+  ResponseParser parser;
+  Response resp;
+  ResponseParser::result_type result;
+  const char* next;
+  std::tie(result, next) =
+      parser.parse(resp, data.data(), data.data() + data.size());
+  ASSERT_EQ(result, ResponseParser::good);
+  ASSERT_EQ(resp.content, "abc");
+
+  parser.reset("GET");
+  std::tie(result, next) =
+      parser.parse(resp, next, data.data() + data.size());
+  ASSERT_EQ(result, ResponseParser::good);
+  ASSERT_EQ(resp.status, Response::no_content);
+  ASSERT_EQ(next, data.data() + data.size());
+}
+
+TEST(ResponseParser, BodyUntilEof) {
+  ResponseParser parser;
+  Response resp;
+  ASSERT_EQ(ParseBytewise(parser, resp, "HTTP/1.0 200 OK\r\n\r\nrest"),
+            ResponseParser::indeterminate);
+  ASSERT_EQ(parser.eof(), ResponseParser::good);
+  ASSERT_EQ(resp.content, "rest");
+  ASSERT_FALSE(parser.keep_alive());
+
+  // A body with a length must not end early.
+  parser.reset("GET");
+  ASSERT_EQ(ParseBytewise(parser, resp,
+                          "HTTP/1.1 200 OK\r\nContent-Length: 9\r\n\r\nshort"),
+            ResponseParser::indeterminate);
+  ASSERT_EQ(parser.eof(), ResponseParser::bad);
+}
+
+TEST(ResponseParser, HeadHasNoBody) {
+  ResponseParser parser("HEAD");
+  Response resp;
+  ASSERT_EQ(ParseBytewise(parser, resp,
+                          "HTTP/1.1 200 OK\r\nContent-Length: 9\r\n\r\n"),
+            ResponseParser::good);
+  ASSERT_EQ(resp.header("Content-Length"), "9");
+}
+
+TEST(ResponseParser, SkipsInterimResponses) {
+  std::string data =
+      "HTTP/1.1 100 Continue\r\n\r\n"
+      "HTTP/1.1 103 Early Hints\r\nLink: </a.css>\r\n\r\n"
+      "HTTP/1.1 200 OK\r\nContent-Length: 3\r\n\r\nabc";
+  ResponseParser parser;
+  Response resp;
+  ResponseParser::result_type result;
+  const char* next;
+  std::tie(result, next) =
+      parser.parse(resp, data.data(), data.data() + data.size());
+  ASSERT_EQ(result, ResponseParser::good);
+  ASSERT_EQ(resp.status, Response::ok);
+  ASSERT_EQ(resp.content, "abc");
+  ASSERT_FALSE(resp.headers.Has("Link"));
+  ASSERT_EQ(next, data.data() + data.size());
+
+  parser.reset("GET");
+  ASSERT_EQ(ParseBytewise(parser, resp, data), ResponseParser::good);
+  ASSERT_EQ(resp.content, "abc");
+
+  // 101 is final.
+  parser.reset("GET");
+  ASSERT_EQ(ParseBytewise(parser, resp,
+                          "HTTP/1.1 101 Switching Protocols\r\n"
+                          "Upgrade: websocket\r\n\r\n"),
+            ResponseParser::good);
+  ASSERT_EQ(resp.status, 101);
+}
+
+TEST(ResponseParser, Invalid) {
+  ResponseParser parser;
+  Response resp;
+  ASSERT_EQ(ParseBytewise(parser, resp, "HTTP/2 200 OK\r\n\r\n"),
+            ResponseParser::bad);
+
+  parser.reset("GET");
+  ASSERT_EQ(ParseBytewise(parser, resp,
+                          "HTTP/1.1 200 OK\r\n"
+                          "Transfer-Encoding: chunked\r\n\r\nxyz\r\n"),
+            ResponseParser::bad);
+}
@@ -0,0 +1,112 @@
+#include "gmock/gmock.h"
+
+#include "cppboot/net/http/date.h"
+#include "cppboot/net/http/response.h"
+
+using cppboot::http::Response;
+
+TEST(Response, SerializeHead) {
+  Response rep;
+  rep.WriteText(Response::ok, "hello");
+  rep.set_header("Date", "Sun, 06 Nov 1994 08:49:37 GMT");
+
+  std::string head;
+  rep.SerializeHead(&head);
+  ASSERT_EQ(head,
+            "HTTP/1.0 200 OK\r\n"
+            "Content-Type: text/plain\r\n"
+            "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+            "Content-Length: 5\r\n"
+            "\r\n");
+
+  // The buffer is appended to, the caller reuses it.
+  head.clear();
+  rep.WriteText(Response::ok, "hello world");
+  rep.SerializeHead(&head);
+  ASSERT_THAT(head, ::testing::HasSubstr("Content-Length: 11\r\n"));
+}
+
+TEST(Response, SerializeHeadRelayed) {
+  // A status without a reason phrase here, a body of unknown length.
+  Response rep;
+  rep.status = static_cast<Response::status_type>(418);
+  rep.set_header("Date", "Sun, 06 Nov 1994 08:49:37 GMT");
+  rep.body_source.read = [](cppboot::http::BodySource::ReadCallback) {};
+
+  std::string head;
+  rep.SerializeHead(&head);
+  ASSERT_EQ(head,
+            "HTTP/1.0 418 \r\n"
+            "Date: Sun, 06 Nov 1994 08:49:37 GMT\r\n"
+            "\r\n");
+
+  head.clear();
+  rep.body_source.size = 10;
+  rep.SerializeHead(&head);
+  ASSERT_THAT(head, ::testing::HasSubstr("Content-Length: 10\r\n"));
+}
+
+TEST(Response, SerializeHeadAddsDate) {
+  Response rep;
+  rep.status = Response::not_modified;
+  rep.set_header("ETag", "\"1\"");
+
+  std::string head;
+  rep.SerializeHead(&head);
+  auto date = cppboot::http::CurrentHttpDate().str();
+  ASSERT_THAT(head, ::testing::HasSubstr("Date: " + date + "\r\n"));
+  ASSERT_THAT(head, ::testing::Not(::testing::HasSubstr("Content-Length")));
+
+  time_t t;
+  ASSERT_TRUE(cppboot::http::ParseHttpDate(date, &t));
+  ASSERT_LE(std::abs(t - ::time(nullptr)), 1);
+}
+
+TEST(Response, StockReplyIsShared) {
+  auto a = Response::stock_reply(Response::not_found);
+  auto b = Response::stock_reply(Response::not_found);
+  ASSERT_EQ(a.status, Response::not_found);
+  ASSERT_TRUE(a.shared_content);
+  ASSERT_EQ(a.shared_content.get(), b.shared_content.get());
+  ASSERT_THAT(a.body().str(), ::testing::HasSubstr("404 Not Found"));
+
+  std::string head;
+  a.SerializeHead(&head);
+  ASSERT_THAT(head, ::testing::StartsWith("HTTP/1.0 404 Not Found\r\n"));
+  ASSERT_THAT(head, ::testing::HasSubstr(
+                        "Content-Length: " +
+                        std::to_string(a.body().size()) + "\r\n"));
+
+  // Writing a body replaces the shared one.
+  a.WriteText(Response::ok, "ok");
+  ASSERT_EQ(a.body(), "ok");
+  ASSERT_THAT(b.body().str(), ::testing::HasSubstr("404 Not Found"));
+}
+
+TEST(Response, StockReplyWithoutBody) {
+  for (auto status : {Response::no_content, Response::not_modified}) {
+    auto rep = Response::stock_reply(status);
+    ASSERT_TRUE(rep.body().empty());
+    ASSERT_FALSE(rep.headers.Has("Content-Type"));
+
+    std::string head;
+    rep.SerializeHead(&head);
+    ASSERT_THAT(head, ::testing::Not(::testing::HasSubstr("Content-Length")));
+  }
+}
+
+TEST(Response, ToBuffers) {
+  Response rep;
+  rep.WriteText(Response::ok, "hello");
+  auto buffers = rep.to_buffers();
+
+  std::string data;
+  for (auto& b : buffers) {
+    data.append(static_cast<const char*>(b.data()), b.size());
+  }
+  ASSERT_EQ(data,
+            "HTTP/1.0 200 OK\r\n"
+            "Content-Type: text/plain\r\n"
+            "\r\n"
+            "hello");
+}
@@ -4,7 +4,10 @@
 namespace cppboot {
 namespace http {
 
-Server::Server() : io_context_(1), acceptor_(io_context_) {}
+Server::Server()
+    : io_context_(1), acceptor_(io_context_), connection_manager_(io_context_) {
+  connection_manager_.set_resume_callback([this]() { DoAccept(); });
+}
 
 Server::~Server() {}
 
@@ -12,6 +15,11 @@ void Server::Handle(const std::string& path, const ServeMux::Func& func) {
   request_handler_.set_handler(path, func);
 }
 
+void Server::Handle(const std::string& method, const std::string& path,
+                    const ServeMux::Func& func) {
+  request_handler_.set_handler(method, path, func);
+}
+
 Status Server::Listen(const std::string& address, const std::string& port) {
   asio::ip::tcp::resolver resolver(io_context_);
   asio::ip::tcp::endpoint endpoint = *resolver.resolve(address, port).begin();
@@ -28,9 +36,12 @@ Status Server::Listen(const std::string& address, const std::string& port) {
 void Server::Serve() { io_context_.run(); }
 
 void Server::Shutdown() {
-  acceptor_.close();
-  connection_manager_.StopAll();
-  io_context_.stop();
+  // The acceptor and connections belong to the thread running Serve().
+  asio::post(io_context_, [this]() {
+    acceptor_.close();
+    connection_manager_.StopAll();
+    io_context_.stop();
+  });
 }
 
 void Server::DoAccept() {
@@ -43,13 +54,29 @@ void Server::DoAccept() {
         }
 
         if (!ec) {
-          connection_manager_.Start(std::make_shared<TcpConnection>(
-              std::move(socket), connection_manager_, request_handler_));
+          connection_manager_.Start(connection_manager_.Create(
+              std::move(socket), request_handler_, compress_options_));
+          AcceptPending();
         }
 
+        // At max_connections, the next ones wait in the listen backlog
+        // until one ends.
+        if (connection_manager_.Pause()) return;
         DoAccept();  // Wait Next
       });
 }
 
+void Server::AcceptPending() {
+  acceptor_.non_blocking(true);
+  for (int i = 0; i < kMaxAcceptBatch; i++) {
+    if (connection_manager_.Pause()) return;
+    std::error_code ec;
+    asio::ip::tcp::socket socket = acceptor_.accept(ec);
+    if (ec) return;
+    connection_manager_.Start(connection_manager_.Create(
+        std::move(socket), request_handler_, compress_options_));
+  }
+}
+
 }  // namespace http
 }  // namespace cppboot
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include "cppboot/base/status.h"
 #include "cppboot/base/string_view.h"
 
+#include "cppboot/net/http/compress.h"
 #include "cppboot/net/http/server/connection_manager.h"
 #include "cppboot/net/http/server/serve_mux.h"
 #include "cppboot/net/http/request.h"
@@ -22,14 +23,42 @@ class Server {
   ~Server();
 
   void Handle(const std::string& path, const ServeMux::Func& func);
+  void Handle(const std::string& method, const std::string& path,
+              const ServeMux::Func& func);
   Status Listen(const std::string& address, const std::string& port);
+
+  /// Compression of in-memory bodies such as WriteJson() and WriteHtml(),
+  /// must be set before Listen().
+  void set_compress_options(const CompressOptions& options) {
+    compress_options_ = options;
+  }
+
+  /// What the server takes on, must be set before Listen().
+  void set_admission_options(const AdmissionOptions& options) {
+    connection_manager_.set_options(options);
+  }
+
+  /// Open connections and requests turned away, may be called from any
+  /// thread.
+  AdmissionStats admission_stats() const { return connection_manager_.stats(); }
+
   void Serve();
   void Shutdown();
 
+  /// The io_context running the connections, e.g. for a ReverseProxy.
+  asio::io_context& io_context() { return io_context_; }
+
  private:
   /// Perform an asynchronous accept operation.
   void DoAccept();
 
+  /// Accept the connections already waiting in the listen backlog, up to
+  /// kMaxAcceptBatch. Their requests then wait where the connection manager
+  /// sees them, instead of unseen in the backlog.
+  void AcceptPending();
+
+  enum { kMaxAcceptBatch = 64 };
+
   /// The io_context used to perform asynchronous operations.
   asio::io_context io_context_;
   /// Acceptor used to listen for incoming connections.
@@ -40,6 +69,8 @@ class Server {
 
   /// The handler for all incoming requests.
   ServeMux request_handler_;
+
+  CompressOptions compress_options_;
 };
 
 }  // namespace http
@@ -0,0 +1,61 @@
+#include "cppboot/net/http/server/admission.h"
+
+#include <math.h>
+
+namespace cppboot {
+namespace http {
+
+CoDel::CoDel(Clock::duration target, Clock::duration interval)
+    : target_(target),
+      interval_(interval),
+      dropping_(false),
+      count_(0),
+      last_count_(0) {}
+
+bool CoDel::ShouldDrop(Clock::duration sojourn,
+                       Clock::time_point now) noexcept {
+  bool ok_to_drop = OkToDrop(sojourn, now);
+
+  if (dropping_) {
+    if (!ok_to_drop) {
+      dropping_ = false;
+      return false;
+    }
+    if (now < drop_next_) return false;
+    count_++;
+    drop_next_ = ControlLaw(drop_next_);
+    return true;
+  }
+
+  if (!ok_to_drop) return false;
+
+  // Start shedding, at the rate reached last time if that was recent.
+  dropping_ = true;
+  uint32_t delta = count_ - last_count_;
+  count_ = delta > 1 && now - drop_next_ < 16 * interval_ ? delta : 1;
+  drop_next_ = ControlLaw(now);
+  last_count_ = count_;
+  return true;
+}
+
+bool CoDel::OkToDrop(Clock::duration sojourn,
+                     Clock::time_point now) noexcept {
+  if (sojourn < target_) {
+    first_above_time_ = Clock::time_point();
+    return false;
+  }
+  if (first_above_time_ == Clock::time_point()) {
+    first_above_time_ = now + interval_;
+    return false;
+  }
+  return now >= first_above_time_;
+}
+
+CoDel::Clock::time_point CoDel::ControlLaw(Clock::time_point t) const
+    noexcept {
+  return t + std::chrono::duration_cast<Clock::duration>(
+                 interval_ / sqrt(static_cast<double>(count_)));
+}
+
+}  // namespace http
+}  // namespace cppboot
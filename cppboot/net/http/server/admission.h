@@ -0,0 +1,113 @@
+#ifndef CPPBOOT_NET_HTTP_SERVER_ADMISSION_H_
+#define CPPBOOT_NET_HTTP_SERVER_ADMISSION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <chrono>
+
+namespace cppboot {
+namespace http {
+
+/// Limits on the work a Server takes on, so that past saturation it turns
+/// away what it can not serve in time instead of slowing down for everyone.
+struct AdmissionOptions {
+  AdmissionOptions()
+      : max_connections(0),
+        max_connections_per_ip(0),
+        max_queued_requests(1024),
+        target(std::chrono::milliseconds(5)),
+        interval(std::chrono::milliseconds(100)),
+        retry_after(std::chrono::seconds(1)),
+        header_timeout(std::chrono::seconds(20)),
+        body_timeout(std::chrono::seconds(20)),
+        min_rate(500) {}
+
+  /// Accepting pauses while this many connections are open, the next ones
+  /// wait in the listen backlog. Typically somewhat below RLIMIT_NOFILE, 0
+  /// for no limit.
+  size_t max_connections;
+  /// Requests on more connections from one client address get a 429, 0 for
+  /// no limit.
+  size_t max_connections_per_ip;
+  /// Requests waiting for their handler past this many get a 503.
+  size_t max_queued_requests;
+  /// CoDel: requests are shed while the queueing delay stays above
+  /// `target` for longer than `interval`.
+  std::chrono::milliseconds target;
+  std::chrono::milliseconds interval;
+  /// Sent as Retry-After with the requests turned away.
+  std::chrono::seconds retry_after;
+  /// Slow clients: the whole request head has to arrive within
+  /// `header_timeout`, and each piece of the body within `body_timeout` of
+  /// asking for it.
+  /// Reading the head or the body may take another second for every
+  /// `min_rate` bytes received, so clients sending slower than that on
+  /// average time out too. They get a 408 and are disconnected. 0 disables
+  /// a limit.
+  /// Over HTTP/2 the preface and the first SETTINGS frame are held to
+  /// `header_timeout` as well. Then, while no stream is open or a request
+  /// is incomplete, the client may wait at most `header_timeout` between
+  /// frames. It is disconnected without a 408.
+  std::chrono::milliseconds header_timeout;
+  std::chrono::milliseconds body_timeout;
+  size_t min_rate;
+};
+
+struct AdmissionStats {
+  /// Open connections, including the ones taken over.
+  size_t connections;
+  /// Requests shed with a 503, for a full queue or by CoDel.
+  uint64_t shed;
+  /// Requests turned away with a 429 for the limit per client address.
+  uint64_t rejected;
+  /// Times accepting paused at max_connections.
+  uint64_t accept_pauses;
+  /// Requests given up on with a 408, for header_timeout, body_timeout or
+  /// min_rate.
+  uint64_t timed_out;
+};
+
+/// The CoDel controller (RFC 8289), deciding from its queueing delay whether
+/// to shed a request taken off the queue. Once the delay has stayed above
+/// the target for an interval, requests are shed at a rate growing with the
+/// square root of the number shed, until the delay falls below the target.
+/// A queue that is merely busy keeps a low minimum delay and sheds nothing,
+/// one that stands is drained from its head, where requests are the oldest.
+class CoDel {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  CoDel(Clock::duration target, Clock::duration interval);
+
+  /// Whether to shed the request taken off the queue at `now` after waiting
+  /// `sojourn`.
+  bool ShouldDrop(Clock::duration sojourn, Clock::time_point now) noexcept;
+
+  /// Whether requests are being shed.
+  bool dropping() const noexcept { return dropping_; }
+
+ private:
+  /// Whether the delay has been above the target for an interval.
+  bool OkToDrop(Clock::duration sojourn, Clock::time_point now) noexcept;
+
+  /// When to shed the next request after one at `t`.
+  Clock::time_point ControlLaw(Clock::time_point t) const noexcept;
+
+  Clock::duration target_;
+  Clock::duration interval_;
+
+  /// When the delay will have been above the target for an interval, the
+  /// epoch if it is below.
+  Clock::time_point first_above_time_;
+  bool dropping_;
+  Clock::time_point drop_next_;
+  /// Requests shed since dropping started, and at the previous start.
+  uint32_t count_;
+  uint32_t last_count_;
+};
+
+}  // namespace http
+}  // namespace cppboot
+
+#endif  // CPPBOOT_NET_HTTP_SERVER_ADMISSION_H_
@@ -0,0 +1,346 @@
+#include "gmock/gmock.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cppboot/net/http/request.h"
+#include "cppboot/net/http/response.h"
+#include "cppboot/net/http/server.h"
+#include "cppboot/net/http/server/admission.h"
+
+namespace {
+
+using asio::ip::tcp;
+using cppboot::http::AdmissionOptions;
+using cppboot::http::BodySource;
+using cppboot::http::CoDel;
+using cppboot::http::Request;
+using cppboot::http::Response;
+using cppboot::http::Server;
+using std::chrono::milliseconds;
+
+/// Read the rest of a request body, then call `done` with the size read and
+/// the outcome.
+void ReadAll(BodySource source, size_t size,
+             std::function<void(size_t, const cppboot::Status&)> done) {
+  source.read([=](const cppboot::Status& status, cppboot::string_view data) {
+    if (!status || data.empty()) {
+      done(size, status);
+      return;
+    }
+    ReadAll(source, size + data.size(), done);
+  });
+}
+
+/// A server whose "/slow" handler blocks the event loop for a while, and
+/// whose "/upload" handler reads the request body.
+class TestServer {
+ public:
+  explicit TestServer(const AdmissionOptions& options) {
+    server_.set_admission_options(options);
+    server_.Handle("/", [](const Request&, Response* rep) {
+      rep->status = Response::ok;
+      rep->content = "ok";
+    });
+    server_.Handle("/slow", [](const Request&, Response* rep) {
+      std::this_thread::sleep_for(milliseconds(20));
+      rep->status = Response::ok;
+      rep->content = "slow";
+    });
+    server_.Handle("/upload", [](const Request& req, Response* rep) {
+      auto done = rep->Defer();
+      ReadAll(req.body_source, req.content.size(),
+              [rep, done](size_t size, const cppboot::Status& status) {
+                if (status) {
+                  rep->WriteText(Response::ok, std::to_string(size));
+                } else {
+                  rep->WriteText(Response::bad_request, status.ToString());
+                }
+                done();
+              });
+    });
+    auto st = server_.Listen("127.0.0.1", "59986");
+    EXPECT_TRUE(st) << st.ToString();
+    thread_ = std::thread([this]() { server_.Serve(); });
+  }
+
+  ~TestServer() {
+    server_.Shutdown();
+    thread_.join();
+  }
+
+  Server& server() { return server_; }
+
+  /// Wait until `n` connections are open.
+  bool WaitForConnections(size_t n) {
+    for (int i = 0; i < 200 && server_.admission_stats().connections != n;
+         i++) {
+      std::this_thread::sleep_for(milliseconds(10));
+    }
+    return server_.admission_stats().connections == n;
+  }
+
+ private:
+  Server server_;
+  std::thread thread_;
+};
+
+/// A client connection.
+class Client {
+ public:
+  Client() : socket_(io_context_) {
+    socket_.connect(tcp::endpoint(asio::ip::make_address("127.0.0.1"), 59986));
+  }
+
+  /// Send a request for `path` and return the whole response.
+  std::string Get(const std::string& path) {
+    Send("GET " + path + " HTTP/1.0\r\n\r\n");
+    return Read();
+  }
+
+  void Send(const std::string& data) {
+    asio::error_code ec;
+    asio::write(socket_, asio::buffer(data), ec);
+  }
+
+  /// Send `data` a byte every `delay`, until the server answers.
+  void Trickle(const std::string& data, milliseconds delay) {
+    for (char c : data) {
+      if (socket_.available() > 0) break;
+      Send(std::string(1, c));
+      std::this_thread::sleep_for(delay);
+    }
+  }
+
+  /// The response, read until the server closes the connection.
+  std::string Read() {
+    std::string response;
+    asio::error_code ec;
+    asio::read(socket_, asio::dynamic_buffer(response), ec);
+    return response;
+  }
+
+  void Close() { socket_.close(); }
+
+ private:
+  asio::io_context io_context_;
+  tcp::socket socket_;
+};
+
+TEST(CoDel, ShedsStandingQueue) {
+  CoDel codel(milliseconds(5), milliseconds(100));
+  CoDel::Clock::time_point now;
+
+  // A busy queue whose delay goes below the target is fine.
+  for (int i = 0; i < 100; i++) {
+    now += milliseconds(10);
+    ASSERT_FALSE(codel.ShouldDrop(milliseconds(i % 2 ? 50 : 1), now));
+  }
+  ASSERT_FALSE(codel.dropping());
+
+  // Above the target for an interval, one is shed.
+  ASSERT_FALSE(codel.ShouldDrop(milliseconds(20), now));
+  now += milliseconds(50);
+  ASSERT_FALSE(codel.ShouldDrop(milliseconds(20), now));
+  now += milliseconds(50);
+  ASSERT_TRUE(codel.ShouldDrop(milliseconds(20), now));
+  ASSERT_TRUE(codel.dropping());
+
+  // The next ones an interval later, then sooner and sooner.
+  now += milliseconds(99);
+  ASSERT_FALSE(codel.ShouldDrop(milliseconds(20), now));
+  now += milliseconds(1);
+  ASSERT_TRUE(codel.ShouldDrop(milliseconds(20), now));
+  now += milliseconds(70);
+  ASSERT_FALSE(codel.ShouldDrop(milliseconds(20), now));
+  now += milliseconds(1);
+  ASSERT_TRUE(codel.ShouldDrop(milliseconds(20), now));
+
+  // Until the delay falls below the target.
+  now += milliseconds(200);
+  ASSERT_FALSE(codel.ShouldDrop(milliseconds(1), now));
+  ASSERT_FALSE(codel.dropping());
+}
+
+TEST(Admission, ConnectionsPerIp) {
+  AdmissionOptions options;
+  options.max_connections_per_ip = 2;
+  options.retry_after = std::chrono::seconds(3);
+  TestServer server(options);
+
+  std::unique_ptr<Client> a(new Client), b(new Client);
+  ASSERT_TRUE(server.WaitForConnections(2));
+  std::string response = Client().Get("/");
+  ASSERT_THAT(response, ::testing::StartsWith("HTTP/1.0 429 "));
+  ASSERT_THAT(response, ::testing::HasSubstr("Retry-After: 3\r\n"));
+  ASSERT_EQ(server.server().admission_stats().rejected, 1);
+
+  ASSERT_THAT(a->Get("/"), ::testing::StartsWith("HTTP/1.0 200 "));
+  ASSERT_TRUE(server.WaitForConnections(1));
+  ASSERT_THAT(Client().Get("/"), ::testing::StartsWith("HTTP/1.0 200 "));
+}
+
+TEST(Admission, MaxConnections) {
+  AdmissionOptions options;
+  options.max_connections = 2;
+  TestServer server(options);
+
+  std::unique_ptr<Client> a(new Client), b(new Client);
+  ASSERT_TRUE(server.WaitForConnections(2));
+
+  // Waits in the listen backlog until one ends.
+  std::string response;
+  std::thread waiting([&response]() { response = Client().Get("/"); });
+  std::this_thread::sleep_for(milliseconds(100));
+  ASSERT_TRUE(response.empty());
+  ASSERT_EQ(server.server().admission_stats().connections, 2);
+  ASSERT_EQ(server.server().admission_stats().accept_pauses, 1);
+
+  a->Close();
+  waiting.join();
+  ASSERT_THAT(response, ::testing::StartsWith("HTTP/1.0 200 "));
+  b->Close();
+  ASSERT_TRUE(server.WaitForConnections(0));
+}
+
+TEST(Admission, ShedsWhenOverloaded) {
+  AdmissionOptions options;
+  options.max_queued_requests = 16;
+  options.target = milliseconds(5);
+  options.interval = milliseconds(50);
+  TestServer server(options);
+
+  // Requests arrive faster than the handler serves them.
+  const int kClients = 64;
+  std::vector<std::string> responses(kClients);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kClients; i++) {
+    threads.emplace_back([&responses, i]() {
+      responses[i] = Client().Get("/slow");
+    });
+  }
+  for (auto& t : threads) t.join();
+
+  int ok = 0, shed = 0;
+  for (auto& response : responses) {
+    if (response.compare(0, 13, "HTTP/1.0 200 ") == 0) {
+      ok++;
+    } else {
+      ASSERT_THAT(response, ::testing::StartsWith("HTTP/1.0 503 "));
+      ASSERT_THAT(response, ::testing::HasSubstr("Retry-After: 1\r\n"));
+      shed++;
+    }
+  }
+  ASSERT_GT(ok, 0);
+  ASSERT_GT(shed, 0);
+  ASSERT_EQ(server.server().admission_stats().shed, shed);
+}
+
+TEST(Admission, HeaderTimeout) {
+  AdmissionOptions options;
+  options.header_timeout = milliseconds(200);
+  TestServer server(options);
+
+  auto start = std::chrono::steady_clock::now();
+  Client client;
+  client.Send("GET / HTTP/1.0\r\n");
+  ASSERT_THAT(client.Read(), ::testing::StartsWith("HTTP/1.0 408 "));
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  ASSERT_GE(elapsed, milliseconds(200));
+  ASSERT_LT(elapsed, milliseconds(1000));
+  ASSERT_EQ(server.server().admission_stats().timed_out, 1);
+  ASSERT_TRUE(server.WaitForConnections(0));
+
+  ASSERT_THAT(Client().Get("/"), ::testing::StartsWith("HTTP/1.0 200 "));
+}
+
+TEST(Admission, HeaderTimeoutWithoutMinRate) {
+  AdmissionOptions options;
+  options.header_timeout = milliseconds(300);
+  options.min_rate = 0;
+  TestServer server(options);
+
+  // Every byte arrives well within the timeout, the whole head does not.
+  auto start = std::chrono::steady_clock::now();
+  Client client;
+  client.Trickle("GET / HTTP/1.0\r\nUser-Agent: slowloris\r\n\r\n",
+                 milliseconds(50));
+  ASSERT_THAT(client.Read(), ::testing::StartsWith("HTTP/1.0 408 "));
+  ASSERT_LT(std::chrono::steady_clock::now() - start, milliseconds(1000));
+  ASSERT_EQ(server.server().admission_stats().timed_out, 1);
+}
+
+TEST(Admission, MinRate) {
+  AdmissionOptions options;
+  options.header_timeout = milliseconds(300);
+  options.min_rate = 100;
+  TestServer server(options);
+
+  // Every byte arrives well within the timeout, but they come slower than
+  // 100 a second.
+  Client client;
+  client.Trickle("GET / HTTP/1.0\r\nUser-Agent: slowloris\r\n\r\n",
+                 milliseconds(50));
+  ASSERT_THAT(client.Read(), ::testing::StartsWith("HTTP/1.0 408 "));
+  ASSERT_EQ(server.server().admission_stats().timed_out, 1);
+
+  // Fast enough.
+  Client fast;
+  fast.Trickle("GET / HTTP/1.0\r\n\r\n", milliseconds(1));
+  ASSERT_THAT(fast.Read(), ::testing::StartsWith("HTTP/1.0 200 "));
+}
+
+TEST(Admission, H2Timeout) {
+  AdmissionOptions options;
+  options.header_timeout = milliseconds(200);
+  TestServer server(options);
+  const std::string preface("PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n", 24);
+  const std::string settings("\0\0\0\x04\0\0\0\0\0", 9);
+
+  // The preface without the SETTINGS that must follow.
+  auto start = std::chrono::steady_clock::now();
+  Client stalled;
+  stalled.Send(preface);
+  stalled.Read();
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  ASSERT_GE(elapsed, milliseconds(200));
+  ASSERT_LT(elapsed, milliseconds(1000));
+  ASSERT_EQ(server.server().admission_stats().timed_out, 1);
+
+  // A connection left idle.
+  start = std::chrono::steady_clock::now();
+  Client idle;
+  idle.Send(preface + settings);
+  idle.Read();
+  ASSERT_LT(std::chrono::steady_clock::now() - start, milliseconds(1000));
+  ASSERT_EQ(server.server().admission_stats().timed_out, 2);
+  ASSERT_TRUE(server.WaitForConnections(0));
+}
+
+TEST(Admission, BodyTimeout) {
+  AdmissionOptions options;
+  options.body_timeout = milliseconds(200);
+  TestServer server(options);
+
+  Client complete;
+  complete.Send("POST /upload HTTP/1.0\r\nContent-Length: 20\r\n\r\n");
+  std::this_thread::sleep_for(milliseconds(50));
+  complete.Send(std::string(20, 'x'));
+  std::string response = complete.Read();
+  ASSERT_THAT(response, ::testing::StartsWith("HTTP/1.0 200 "));
+  ASSERT_THAT(response, ::testing::EndsWith("\r\n\r\n20"));
+
+  // The handler's read fails, and the client gets a 408 whatever it replies.
+  Client stalled;
+  stalled.Send("POST /upload HTTP/1.0\r\nContent-Length: 100\r\n\r\n");
+  std::this_thread::sleep_for(milliseconds(50));
+  stalled.Send(std::string(10, 'x'));
+  ASSERT_THAT(stalled.Read(), ::testing::StartsWith("HTTP/1.0 408 "));
+  ASSERT_EQ(server.server().admission_stats().timed_out, 1);
+}
+
+}  // namespace
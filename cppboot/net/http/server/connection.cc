@@ -1,35 +1,274 @@
 #include "cppboot/net/http/server/connection.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
 #include <tuple>
 #include <algorithm>
 
+#include "cppboot/base/str_util.h"
 #include "cppboot/net/http/server/connection_manager.h"
+#include "cppboot/net/http/server/file_io_service.h"
 
 namespace cppboot {
 namespace http {
+
+namespace {
+
+/// Largest slice handed to the kernel at once, so one big download can not
+/// monopolize the event loop.
+const size_t kSendFileChunk = 1024 * 1024;
+
+/// Largest piece of a request body read at once.
+const size_t kBodyBufferSize = 16 * 1024;
+
+/// Whether `req` asks to switch to HTTP/2 over cleartext TCP.
+bool IsH2cUpgrade(const Request& req) {
+  return EqualsIgnoreCase(StrTrim(req.headers.Get(kUpgrade)), "h2c") &&
+         req.headers.Has("HTTP2-Settings") && !req.body_source;
+}
+
+/// Copy up to `count` bytes of `in_fd` at `*offset` to the non-blocking
+/// socket `out_fd` and advance `*offset`.
+ssize_t SendFile(int out_fd, int in_fd, off_t* offset, size_t count) {
+#ifdef __linux__
+  return ::sendfile(out_fd, in_fd, offset, count);
+#else
+  char buf[64 * 1024];
+  ssize_t n = ::pread(in_fd, buf, std::min(count, sizeof(buf)), *offset);
+  if (n <= 0) return n;
+  n = ::write(out_fd, buf, n);
+  if (n > 0) *offset += n;
+  return n;
+#endif
+}
+
+/// Block until the range is in the page cache.
+void Prefetch(int fd, off_t offset, size_t count) {
+#ifdef __linux__
+  ::readahead(fd, offset, count);
+#else
+  char buf[64 * 1024];
+  while (count > 0) {
+    ssize_t n = ::pread(fd, buf, std::min(count, sizeof(buf)), offset);
+    if (n <= 0) break;
+    offset += n;
+    count -= n;
+  }
+#endif
+}
+
+}  // namespace
+
 TcpConnection::TcpConnection(asio::ip::tcp::socket socket,
-                             ConnectionManager& manager, ServeMux& handler)
+                             ConnectionManager& manager, ServeMux& handler,
+                             const CompressOptions& compress_options)
     : socket_(std::move(socket)),
       connection_manager_(manager),
-      request_handler_(handler) {}
+      manager_index_(0),
+      over_limit_(false),
+      request_handler_(handler),
+      compress_options_(compress_options),
+      buffer_used_(0),
+      body_remaining_(0),
+      generation_(0),
+      read_phase_(kReadingHead),
+      read_pending_(false),
+      read_waited_(0),
+      read_bytes_(0),
+      timed_out_(false),
+      deferred_(false),
+      file_part_(0),
+      file_offset_(0),
+      file_remaining_(0),
+      file_prefetched_(0),
+      h2_writing_(false) {}
+
+void TcpConnection::Reset(asio::ip::tcp::socket socket) {
+  socket_ = std::move(socket);
+  remote_address_ = asio::ip::address();
+  over_limit_ = false;
+  buffer_used_ = 0;
+  request_.Reset();
+  body_remaining_ = 0;
+  generation_++;
+  read_phase_ = kReadingHead;
+  read_pending_ = false;
+  read_waited_ = Clock::duration(0);
+  read_bytes_ = 0;
+  timed_out_ = false;
+  request_parser_.reset();
+  reply_.Reset();
+  head_.clear();
+  deferred_ = false;
+  file_part_ = 0;
+  file_offset_ = 0;
+  file_remaining_ = 0;
+  file_prefetched_ = 0;
+  h2_.reset();
+  h2_out_.clear();
+  h2_writing_ = false;
+}
 
 void TcpConnection::Start() { DoRead(); }
 
-void TcpConnection::Stop() { socket_.close(); }
+void TcpConnection::Stop() {
+  socket_.close();
+  // What the reply holds, a file or e.g. an upstream connection, and the
+  // HTTP/2 session go now rather than when the connection is reused. Later,
+  // as they may be on the stack.
+  auto self(shared_from_this());
+  asio::post(socket_.get_executor(), [this, self]() {
+    reply_.file_body.reset();
+    reply_.body_source = BodySource();
+    h2_.reset();
+  });
+}
+
+void TcpConnection::Serve() {
+  // Small enough for std::function to store without allocating.
+  reply_.defer_hook = [this]() { return Defer(); };
+  reply_.takeover_hook = []() { return true; };
+  request_handler_.ServeHttp(request_, &reply_);
+  if (!deferred_) DoWrite();
+}
+
+void TcpConnection::Reject(Response::status_type status,
+                           std::chrono::seconds retry_after) {
+  reply_ = Response::stock_reply(status);
+  reply_.headers.Add(kRetryAfter, std::to_string(retry_after.count()));
+  DoWrite();
+}
+
+void TcpConnection::BeginRead(ReadPhase phase) {
+  if (phase != read_phase_) {
+    read_phase_ = phase;
+    read_waited_ = Clock::duration(0);
+    read_bytes_ = 0;
+  }
+  read_pending_ = true;
+  read_since_ = Clock::now();
+}
+
+void TcpConnection::EndRead(size_t n) {
+  if (!read_pending_) return;
+  read_pending_ = false;
+  read_waited_ += Clock::now() - read_since_;
+  read_bytes_ += n;
+}
+
+bool TcpConnection::TimedOut(const AdmissionOptions& options,
+                             Clock::time_point now) const {
+  if (!read_pending_) return false;
+  auto timeout = read_phase_ == kReadingBody ? options.body_timeout
+                                             : options.header_timeout;
+  if (timeout.count() == 0) return false;
+
+  auto waiting = now - read_since_;
+  if (waiting > timeout) return true;
+  // An HTTP/2 client may be idle that long between frames, however long
+  // the connection lives.
+  if (read_phase_ == kReadingFrame) return false;
+
+  // The head as a whole has to arrive within the timeout, the body only
+  // piece by piece unless there is a minimum rate. Either may take a second
+  // more for every min_rate bytes.
+  Clock::duration allowed = timeout;
+  if (options.min_rate > 0) {
+    allowed += std::chrono::milliseconds(read_bytes_ * 1000 /
+                                         options.min_rate);
+  } else if (read_phase_ == kReadingBody) {
+    return false;
+  }
+  return read_waited_ + waiting > allowed;
+}
+
+void TcpConnection::Timeout() {
+  timed_out_ = true;
+  read_pending_ = false;
+  asio::error_code ignored_ec;
+  socket_.cancel(ignored_ec);
+  // The handler reading the body gets an error instead, and its reply is
+  // replaced. An HTTP/2 connection is closed by its read handler.
+  if (read_phase_ == kReadingHead && !h2_) DoWrite();
+}
 
 void TcpConnection::DoRead() {
+  if (buffer_used_ == buffer_.size()) {
+    // The request head must fit into the buffer, it is parsed in place.
+    reply_ = Response::stock_reply(Response::request_header_fields_too_large);
+    DoWrite();
+    return;
+  }
+
+  BeginRead(kReadingHead);
   auto self(shared_from_this());
   socket_.async_read_some(
-      asio::buffer(buffer_),
+      asio::buffer(buffer_.data() + buffer_used_,
+                   buffer_.size() - buffer_used_),
       [this, self](std::error_code ec, std::size_t bytes_transferred) {
+        EndRead(bytes_transferred);
+        if (timed_out_) return;
         if (!ec) {
+          const char* begin = buffer_.data() + buffer_used_;
+          buffer_used_ += bytes_transferred;
+
           RequestParser::result_type result;
           std::tie(result, std::ignore) = request_parser_.parse(
-              request_, buffer_.data(), buffer_.data() + bytes_transferred);
+              request_, begin, begin + bytes_transferred);
 
-          if (result == RequestParser::good) {
-            request_handler_.ServeHttp(request_, &reply_);
-            DoWrite();
+          if (result == RequestParser::good && request_.method == "PRI" &&
+              request_.uri == "*" && request_.http_version_major == 2) {
+            // The start of the preface of a client knowing that we speak
+            // HTTP/2, the session checks the rest.
+            StartH2(nullptr, string_view());
+            bool ok = h2_->Feed(buffer_.data(), buffer_used_);
+            buffer_used_ = 0;
+            DoWriteH2();
+            if (ok) DoReadH2();
+          } else if (result == RequestParser::good) {
+            PrepareBody();
+            // With a body still to come the request is served over HTTP/1,
+            // the rest of it must not be taken for HTTP/2 frames.
+            if (IsH2cUpgrade(request_) && !request_.body_source.read) {
+              // The upgraded request is served as stream 1, its fields
+              // point into the buffer which is about to be reused.
+              std::unique_ptr<Request> upgrade(new Request);
+              upgrade->method = request_.method;
+              upgrade->uri = request_.uri;
+              upgrade->http_version_major = request_.http_version_major;
+              upgrade->http_version_minor = request_.http_version_minor;
+              upgrade->remote_address = request_.remote_address;
+              for (auto& f : request_.headers) {
+                if (f.id == kConnection || f.id == kUpgrade ||
+                    EqualsIgnoreCase(f.name, "HTTP2-Settings")) {
+                  continue;
+                }
+                upgrade->headers.Add(f.name, f.value);
+              }
+              if (request_.headers.Has(kContentLength)) {
+                upgrade->content = request_.content;
+              }
+              RequestParser::parse_uri(*upgrade);
+
+              if (StartH2(std::move(upgrade),
+                          request_.headers.Get("HTTP2-Settings"))) {
+                h2_out_ =
+                    "HTTP/1.1 101 Switching Protocols\r\n"
+                    "Connection: Upgrade\r\n"
+                    "Upgrade: h2c\r\n"
+                    "\r\n";
+                buffer_used_ = 0;
+                DoWriteH2();
+                DoReadH2();
+                return;
+              }
+            }
+            connection_manager_.Enqueue(shared_from_this());
           } else if (result == RequestParser::bad) {
             reply_ = Response::stock_reply(Response::bad_request);
             DoWrite();
@@ -42,22 +281,324 @@ void TcpConnection::DoRead() {
       });
 }
 
+void TcpConnection::PrepareBody() {
+  string_view value = request_.headers.Get(kContentLength);
+  if (value.empty() || value.size() > 18) return;
+
+  uint64_t length = 0;
+  for (char c : value) {
+    if (c < '0' || c > '9') return;
+    length = length * 10 + (c - '0');
+  }
+  if (request_.content.size() >= length) {
+    request_.content.resize(length);
+    return;
+  }
+
+  body_remaining_ = length - request_.content.size();
+  std::weak_ptr<TcpConnection> weak(shared_from_this());
+  uint64_t generation = generation_;
+  request_.body_source.size = static_cast<int64_t>(body_remaining_);
+  request_.body_source.read = [weak, generation](BodySource::ReadCallback cb) {
+    if (auto self = weak.lock()) {
+      self->ReadBody(generation, std::move(cb));
+    } else {
+      cb(CancelledError("Connection closed"), string_view());
+    }
+  };
+}
+
+void TcpConnection::ReadBody(uint64_t generation,
+                             BodySource::ReadCallback cb) {
+  auto self(shared_from_this());
+  asio::dispatch(socket_.get_executor(), [this, self, generation, cb]() {
+    // The source outlived its request, the socket is another client's.
+    if (generation != generation_) {
+      cb(CancelledError("Connection closed"), string_view());
+      return;
+    }
+    if (body_remaining_ == 0) {
+      cb(OkStatus(), string_view());
+      return;
+    }
+
+    body_buffer_.resize(kBodyBufferSize);
+    size_t n = std::min<uint64_t>(body_remaining_, body_buffer_.size());
+    BeginRead(kReadingBody);
+    socket_.async_read_some(
+        asio::buffer(body_buffer_.data(), n),
+        [this, self, cb](std::error_code ec, std::size_t bytes_transferred) {
+          EndRead(bytes_transferred);
+          if (timed_out_) {
+            cb(DeadlineExceededError("Request body too slow"), string_view());
+            return;
+          }
+          if (ec) {
+            cb(UnavailableError(ec.message()), string_view());
+            return;
+          }
+          body_remaining_ -= bytes_transferred;
+          cb(OkStatus(), string_view(body_buffer_.data(), bytes_transferred));
+        });
+  });
+}
+
+Response::DoneFunc TcpConnection::Defer() {
+  deferred_ = true;
+  auto self(shared_from_this());
+  return [this, self]() {
+    asio::post(socket_.get_executor(), [this, self]() { DoWrite(); });
+  };
+}
+
 void TcpConnection::DoWrite() {
+  if (timed_out_) reply_ = Response::stock_reply(Response::request_timeout);
+  CompressResponse(compress_options_, request_, &reply_);
+
+  head_.clear();
+  reply_.SerializeHead(&head_);
+  bool has_body = Response::AllowsBody(reply_.status);
+  auto body = has_body ? reply_.body() : string_view();
+  std::array<asio::const_buffer, 2> buffers = {
+      {asio::buffer(head_), asio::buffer(body.data(), body.size())}};
+
+  auto self(shared_from_this());
+  asio::async_write(socket_, buffers,
+                    [this, self, has_body](std::error_code ec, std::size_t) {
+                      if (!ec && reply_.takeover) {
+                        DoTakeover();
+                      } else if (!ec && has_body && reply_.file_body) {
+                        file_part_ = 0;
+                        DoWriteFilePart();
+                      } else if (!ec && has_body && reply_.body_source) {
+                        DoWriteSource();
+                      } else {
+                        Finish(ec);
+                      }
+                    });
+}
+
+void TcpConnection::DoWriteFilePart() {
   auto self(shared_from_this());
-  asio::async_write(socket_, reply_.to_buffers(),
+  const FileBody& body = *reply_.file_body;
+  if (file_part_ == body.parts().size()) {
+    asio::async_write(
+        socket_, asio::buffer(body.tail()),
+        [this, self](std::error_code ec, std::size_t) { Finish(ec); });
+    return;
+  }
+
+  const FileBody::Part& part = body.parts()[file_part_];
+  asio::async_write(socket_, asio::buffer(part.head),
                     [this, self](std::error_code ec, std::size_t) {
-                      if (!ec) {
-                        // Initiate graceful connection closure.
-                        asio::error_code ignored_ec;
-                        socket_.shutdown(asio::ip::tcp::socket::shutdown_both,
-                                         ignored_ec);
+                      if (ec) {
+                        Finish(ec);
+                        return;
                       }
+                      const FileBody::Part& part =
+                          reply_.file_body->parts()[file_part_];
+                      file_offset_ = part.offset;
+                      file_remaining_ = part.length;
+                      file_prefetched_ = part.offset;
+                      DoSendFile();
+                    });
+}
+
+void TcpConnection::DoSendFile() {
+  if (file_remaining_ == 0) {
+    file_part_++;
+    DoWriteFilePart();
+    return;
+  }
 
-                      if (ec != asio::error::operation_aborted) {
-                        connection_manager_.Stop(shared_from_this());
+  size_t count = std::min(file_remaining_, kSendFileChunk);
+  if (file_offset_ >= file_prefetched_ && DoPrefetch()) return;
+  if (file_prefetched_ > file_offset_) {
+    size_t prefetched = file_prefetched_ - file_offset_;
+    count = std::min(count, prefetched);
+  }
+
+  socket_.native_non_blocking(true);
+  ssize_t n = SendFile(socket_.native_handle(), reply_.file_body->fd(),
+                       &file_offset_, count);
+  if (n > 0) {
+    file_remaining_ -= n;
+    if (file_remaining_ == 0) {
+      file_part_++;
+      DoWriteFilePart();
+      return;
+    }
+  } else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+    // The file shrank or the peer is gone.
+    Finish(std::error_code(n == 0 ? EIO : errno, std::generic_category()));
+    return;
+  }
+
+  // Give other connections a turn and wait until the socket is writable.
+  auto self(shared_from_this());
+  socket_.async_wait(asio::ip::tcp::socket::wait_write,
+                     [this, self](std::error_code ec) {
+                       if (!ec)
+                         DoSendFile();
+                       else
+                         Finish(ec);
+                     });
+}
+
+void TcpConnection::DoWriteSource() {
+  auto self(shared_from_this());
+  reply_.body_source.read([this, self](const Status& status,
+                                       string_view data) {
+    asio::dispatch(socket_.get_executor(), [this, self, status, data]() {
+      if (!status) {
+        // Reset the connection, so the client can not take the truncated
+        // body for a complete one.
+        asio::error_code ignored_ec;
+        socket_.set_option(asio::socket_base::linger(true, 0), ignored_ec);
+        Finish(std::error_code(EIO, std::generic_category()));
+        return;
+      }
+      if (data.empty()) {
+        Finish(std::error_code());
+        return;
+      }
+
+      asio::async_write(socket_, asio::buffer(data.data(), data.size()),
+                        [this, self](std::error_code ec, std::size_t) {
+                          if (!ec)
+                            DoWriteSource();
+                          else
+                            Finish(ec);
+                        });
+    });
+  });
+}
+
+bool TcpConnection::DoPrefetch() {
+  FileIoService* io = reply_.file_body->io_service();
+  if (!io) return false;
+
+  auto self(shared_from_this());
+  int fd = reply_.file_body->fd();
+  off_t offset = file_offset_;
+  size_t count = std::min(file_remaining_, kSendFileChunk);
+  return io->Post([this, self, fd, offset, count]() {
+    Prefetch(fd, offset, count);
+    asio::post(socket_.get_executor(), [this, self, offset, count]() {
+      // Released if the connection stopped meanwhile.
+      if (!reply_.file_body) return;
+      file_prefetched_ = offset + count;
+      DoSendFile();
+    });
+  });
+}
+
+bool TcpConnection::StartH2(std::unique_ptr<Request> upgrade,
+                            string_view settings) {
+  auto executor = socket_.get_executor();
+  h2_.reset(new H2Session(
+      request_handler_, compress_options_,
+      [executor](std::function<void()> fn) {
+        asio::post(executor, std::move(fn));
+      },
+      [this]() { DoWriteH2(); }));
+  h2_->set_remote_address(request_.remote_address);
+  // Each stream is admitted like a request read over HTTP/1.
+  h2_->set_admit([this](H2Session::AdmitCallback cb) {
+    connection_manager_.Enqueue(shared_from_this(), std::move(cb));
+  });
+  if (!h2_->Start(settings, std::move(upgrade))) {
+    h2_.reset();
+    return false;
+  }
+  return true;
+}
+
+void TcpConnection::DoReadH2() {
+  // The preface and the first SETTINGS are due like a request head, after
+  // that each frame while the client owes us one. Streams waiting for their
+  // reply only are not timed.
+  if (!h2_->settings_received()) {
+    BeginRead(kReadingHead);
+  } else if (h2_->waiting_for_peer()) {
+    BeginRead(kReadingFrame);
+  }
+  auto self(shared_from_this());
+  socket_.async_read_some(
+      asio::buffer(buffer_),
+      [this, self](std::error_code ec, std::size_t bytes_transferred) {
+        EndRead(bytes_transferred);
+        if (timed_out_) {
+          connection_manager_.Stop(shared_from_this());
+          return;
+        }
+        if (ec) {
+          if (ec != asio::error::operation_aborted) {
+            connection_manager_.Stop(shared_from_this());
+          }
+          return;
+        }
+        bool ok = h2_->Feed(buffer_.data(), bytes_transferred);
+        DoWriteH2();
+        if (ok && !h2_->closed()) DoReadH2();
+      });
+}
+
+void TcpConnection::DoWriteH2() {
+  if (h2_writing_) return;
+  h2_->Produce(&h2_out_);
+  if (h2_out_.empty()) {
+    if (h2_->closed()) Finish(std::error_code());
+    return;
+  }
+
+  h2_writing_ = true;
+  auto self(shared_from_this());
+  asio::async_write(socket_, asio::buffer(h2_out_),
+                    [this, self](std::error_code ec, std::size_t) {
+                      h2_writing_ = false;
+                      h2_out_.clear();
+                      if (ec) {
+                        Finish(ec);
+                      } else {
+                        DoWriteH2();
                       }
                     });
 }
 
+void TcpConnection::DoTakeover() {
+  // What followed the request head, unless it was a body.
+  string_view pending;
+  if (!request_.headers.Has(kContentLength)) pending = request_.content;
+
+  // The manager keeps the new connection instead of this one, whose buffers
+  // are released.
+  auto executor = socket_.get_executor();
+  ConnectionManager* manager = &connection_manager_;
+  auto taken_over = std::make_shared<std::weak_ptr<net::Conn>>();
+  auto takeover = std::move(reply_.takeover);
+  reply_.takeover = nullptr;
+  auto conn = takeover(std::move(socket_), pending,
+                       [executor, manager, taken_over]() {
+                         asio::post(executor, [manager, taken_over]() {
+                           manager->Forget(taken_over->lock());
+                         });
+                       });
+  *taken_over = conn;
+  connection_manager_.Replace(shared_from_this(), std::move(conn));
+}
+
+void TcpConnection::Finish(std::error_code ec) {
+  if (!ec) {
+    // Initiate graceful connection closure.
+    asio::error_code ignored_ec;
+    socket_.shutdown(asio::ip::tcp::socket::shutdown_both, ignored_ec);
+  }
+
+  if (ec != asio::error::operation_aborted) {
+    connection_manager_.Stop(shared_from_this());
+  }
+}
+
 }  // namespace http
-}  // namespace cppboot
\ No newline at end of file
+}  // namespace cppboot
@@ -2,11 +2,17 @@
 #define CPPBOOT_NET_HTTP_CONNECTION_H_
 
 #include <array>
+#include <chrono>
 #include <memory>
+#include <vector>
 
 #include "asio.hpp"
 
+#include "cppboot/net/connection.h"
+#include "cppboot/net/http/compress.h"
 #include "cppboot/net/http/request.h"
+#include "cppboot/net/http/server/admission.h"
+#include "cppboot/net/http/server/h2_session.h"
 #include "cppboot/net/http/server/request_parser.h"
 #include "cppboot/net/http/server/serve_mux.h"
 #include "cppboot/net/http/response.h"
@@ -24,7 +30,12 @@ class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
 
   /// Construct a connection with the given socket.
   explicit TcpConnection(asio::ip::tcp::socket socket,
-                         ConnectionManager& manager, ServeMux& handler);
+                         ConnectionManager& manager, ServeMux& handler,
+                         const CompressOptions& compress_options);
+
+  /// Serve `socket` with this object once its previous connection ended,
+  /// reusing the memory of its buffers, request and reply.
+  void Reset(asio::ip::tcp::socket socket);
 
   /// Start the first asynchronous operation for the connection.
   void Start();
@@ -32,32 +43,156 @@ class TcpConnection : public std::enable_shared_from_this<TcpConnection> {
   /// Stop all asynchronous operations associated with the connection.
   void Stop();
 
+  /// Serve the request that was read, once admitted.
+  void Serve();
+
+  /// Turn the request that was read away with `status`, asking the client
+  /// to retry after `retry_after`.
+  void Reject(Response::status_type status, std::chrono::seconds retry_after);
+
  private:
+  friend class ConnectionManager;
+
+  typedef std::chrono::steady_clock Clock;
+
+  /// What is read from the client, for the deadlines of AdmissionOptions.
+  enum ReadPhase {
+    kReadingHead,
+    kReadingBody,
+    /// Between HTTP/2 frames.
+    kReadingFrame,
+  };
+
+  /// Note that a read of `phase` starts, or that the pending one received
+  /// `n` bytes.
+  void BeginRead(ReadPhase phase);
+  void EndRead(size_t n);
+
+  /// Whether the pending read is past the deadlines of `options` at `now`.
+  bool TimedOut(const AdmissionOptions& options, Clock::time_point now) const;
+
+  /// Give up on the request being read, it gets a 408.
+  void Timeout();
+
   /// Perform an asynchronous read operation.
   void DoRead();
+
+  /// Keep the part of the body that arrived with the head in the request,
+  /// and let its body_source read the rest.
+  void PrepareBody();
+
+  /// Read the next piece of the request body for the body_source of the
+  /// request served in `generation`, which fails once the connection was
+  /// reused for another one.
+  void ReadBody(uint64_t generation, BodySource::ReadCallback cb);
+
+  /// Called through Response::Defer(), the reply is sent once the returned
+  /// function has been called.
+  Response::DoneFunc Defer();
+
   /// Perform an asynchronous write operation.
   void DoWrite();
 
+  /// Send the head of the next file body part, or the tail after the last.
+  void DoWriteFilePart();
+
+  /// Stream the current file body part with sendfile(2).
+  void DoSendFile();
+
+  /// Send the next piece of the reply's body_source.
+  void DoWriteSource();
+
+  /// Read the next chunk into the page cache on the FileIoService, so that
+  /// sendfile(2) never waits for the disk. Returns false if not possible.
+  bool DoPrefetch();
+
+  /// Serve HTTP/2 from now on, with the upgraded request `upgrade` and its
+  /// HTTP2-Settings `settings` unless null. Returns false if the settings
+  /// are malformed.
+  bool StartH2(std::unique_ptr<Request> upgrade, string_view settings);
+
+  /// Read frames for the HTTP/2 session.
+  void DoReadH2();
+
+  /// Send what the HTTP/2 session produced, unless a write is in progress.
+  void DoWriteH2();
+
+  /// Hand the socket over to the Response::Takeover() function of the reply
+  /// that was just sent.
+  void DoTakeover();
+
+  /// Close the connection after the reply has been sent.
+  void Finish(std::error_code ec);
+
   /// Socket for the connection.
   asio::ip::tcp::socket socket_;
 
-  /// The manager for this connection.
+  /// The manager for this connection, and the position in its list.
   ConnectionManager& connection_manager_;
+  size_t manager_index_;
+
+  /// The client address counted for max_connections_per_ip, unspecified if
+  /// not counted, and whether it already had too many connections.
+  asio::ip::address remote_address_;
+  bool over_limit_;
 
   /// The handler used to process the incoming request.
   ServeMux& request_handler_;
 
-  /// Buffer for incoming data.
+  /// How replies are compressed before they are sent.
+  const CompressOptions& compress_options_;
+
+  /// Buffer for incoming data, the request headers point into it.
   std::array<char, 8192> buffer_;
+  size_t buffer_used_;
 
   /// The incoming request.
   Request request_;
 
+  /// Bytes of the request body not read yet, and where they are read to.
+  uint64_t body_remaining_;
+  /// Counts the sockets served by this object, tells body sources of an
+  /// earlier one apart.
+  uint64_t generation_;
+  std::vector<char> body_buffer_;
+
+  /// The current read phase, whether a read is pending and since when, and
+  /// how long the earlier reads of the phase waited for how many bytes.
+  ReadPhase read_phase_;
+  bool read_pending_;
+  Clock::time_point read_since_;
+  Clock::duration read_waited_;
+  uint64_t read_bytes_;
+
+  /// The request timed out, whatever its handler replies it gets a 408.
+  bool timed_out_;
+
   /// The parser for the incoming request.
   RequestParser request_parser_;
 
   /// The reply to be sent back to the client.
   Response reply_;
+
+  /// Status line and headers of `reply_`, reused across replies.
+  std::string head_;
+
+  /// The handler called Response::Defer() and will complete the reply later.
+  bool deferred_;
+
+  /// Progress of sending `reply_.file_body`.
+  size_t file_part_;
+  off_t file_offset_;
+  size_t file_remaining_;
+
+  /// End of the range already read into the page cache by the body's
+  /// FileIoService.
+  off_t file_prefetched_;
+
+  /// The HTTP/2 session once the connection switched to it, and the bytes
+  /// being written for it.
+  std::unique_ptr<H2Session> h2_;
+  std::string h2_out_;
+  bool h2_writing_;
 };
 
 typedef std::shared_ptr<TcpConnection> TcpConnectionPtr;
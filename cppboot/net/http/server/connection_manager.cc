@@ -1,24 +1,282 @@
 #include "cppboot/net/http/server/connection_manager.h"
 
+#include <algorithm>
+
 namespace cppboot {
 namespace http {
 
-ConnectionManager::ConnectionManager() {}
+namespace {
+
+/// Deadlines are enforced at most this late, or a quarter of the shortest
+/// timeout.
+const std::chrono::seconds kMaxSweepInterval(1);
+
+}  // namespace
+
+ConnectionManager::ConnectionManager(asio::io_context& io_context)
+    : io_context_(io_context),
+      paused_(false),
+      queue_head_(0),
+      queue_size_(0),
+      drain_posted_(false),
+      codel_(options_.target, options_.interval),
+      sweep_timer_(io_context),
+      sweeping_(false),
+      open_(0),
+      shed_(0),
+      rejected_(0),
+      accept_pauses_(0),
+      timed_out_(0) {}
+
+void ConnectionManager::set_options(const AdmissionOptions& options) {
+  options_ = options;
+  codel_ = CoDel(options.target, options.interval);
+  queue_.clear();
+}
+
+TcpConnectionPtr ConnectionManager::Create(
+    asio::ip::tcp::socket socket, ServeMux& handler,
+    const CompressOptions& compress_options) {
+  // The handlers of an ended connection may still run, it is only reused
+  // once the last one released it.
+  for (size_t i = idle_.size(); i-- > 0;) {
+    if (idle_[i].use_count() != 1) continue;
+    TcpConnectionPtr c = std::move(idle_[i]);
+    if (i + 1 < idle_.size()) idle_[i] = std::move(idle_.back());
+    idle_.pop_back();
+    c->Reset(std::move(socket));
+    return c;
+  }
+  return std::make_shared<TcpConnection>(std::move(socket), *this, handler,
+                                         compress_options);
+}
 
 void ConnectionManager::Start(TcpConnectionPtr c) {
-  connections_.insert(c);
+  c->manager_index_ = connections_.size();
+  connections_.push_back(c);
+  open_++;
+
+  std::error_code ec;
+  auto endpoint = c->socket_.remote_endpoint(ec);
+  if (!ec) c->request_.remote_address = endpoint.address();
+  if (options_.max_connections_per_ip > 0 && !ec) {
+    size_t& count = per_ip_[endpoint.address()];
+    if (count < options_.max_connections_per_ip) {
+      count++;
+      c->remote_address_ = endpoint.address();
+    } else {
+      c->over_limit_ = true;
+    }
+  }
+  if (!sweeping_) ScheduleSweep();
   c->Start();
 }
 
+bool ConnectionManager::Pause() {
+  if (options_.max_connections == 0 || open_ < options_.max_connections) {
+    return false;
+  }
+  if (!paused_) {
+    paused_ = true;
+    accept_pauses_++;
+  }
+  return true;
+}
+
+void ConnectionManager::Enqueue(TcpConnectionPtr c) {
+  Enqueue(std::move(c), H2Session::AdmitCallback());
+}
+
+void ConnectionManager::Enqueue(TcpConnectionPtr c,
+                                H2Session::AdmitCallback stream) {
+  if (c->over_limit_) {
+    rejected_++;
+    Reject(c, stream, Response::too_many_requests);
+    return;
+  }
+
+  if (queue_.empty()) {
+    queue_.resize(std::max<size_t>(options_.max_queued_requests, 1));
+  }
+  if (queue_size_ == queue_.size()) {
+    shed_++;
+    Reject(c, stream, Response::service_unavailable);
+    return;
+  }
+
+  Queued& queued = queue_[(queue_head_ + queue_size_) % queue_.size()];
+  queued.connection = std::move(c);
+  queued.stream = std::move(stream);
+  queued.since = Clock::now();
+  queue_size_++;
+  if (!drain_posted_) {
+    drain_posted_ = true;
+    asio::post(io_context_, [this]() { Drain(); });
+  }
+}
+
 void ConnectionManager::Stop(TcpConnectionPtr c) {
-  connections_.erase(c);
+  bool managed = Remove(c);
   c->Stop();
+  if (!managed) return;
+
+  Release(c->remote_address_);
+  open_--;
+  if (idle_.size() < kMaxIdle) idle_.push_back(std::move(c));
+  if (paused_ && !Pause()) {
+    paused_ = false;
+    if (resume_callback_) resume_callback_();
+  }
+}
+
+void ConnectionManager::Replace(TcpConnectionPtr c,
+                                std::shared_ptr<net::Conn> conn) {
+  if (!conn) {
+    Stop(std::move(c));
+    return;
+  }
+  if (!Remove(c)) return;
+
+  // The new connection counts for the client instead.
+  taken_over_[std::move(conn)] = c->remote_address_;
+  if (idle_.size() < kMaxIdle) idle_.push_back(std::move(c));
+}
+
+void ConnectionManager::Forget(const std::shared_ptr<net::Conn>& conn) {
+  auto it = taken_over_.find(conn);
+  if (it == taken_over_.end()) return;
+
+  Release(it->second);
+  taken_over_.erase(it);
+  open_--;
+  if (paused_ && !Pause()) {
+    paused_ = false;
+    if (resume_callback_) resume_callback_();
+  }
 }
 
 void ConnectionManager::StopAll() {
-  for (auto c : connections_) c->Stop();
+  for (auto& c : connections_) c->Stop();
   connections_.clear();
+  sweep_timer_.cancel();
+  sweeping_ = false;
+  idle_.clear();
+  for (auto& queued : queue_) {
+    queued.connection.reset();
+    queued.stream = nullptr;
+  }
+  queue_size_ = 0;
+  per_ip_.clear();
+  // Stopping one may post its Forget(), which then finds nothing.
+  auto taken_over = std::move(taken_over_);
+  taken_over_.clear();
+  for (auto& conn : taken_over) conn.first->Stop();
+  open_ = 0;
+}
+
+AdmissionStats ConnectionManager::stats() const {
+  AdmissionStats stats;
+  stats.connections = open_;
+  stats.shed = shed_;
+  stats.rejected = rejected_;
+  stats.accept_pauses = accept_pauses_;
+  stats.timed_out = timed_out_;
+  return stats;
+}
+
+void ConnectionManager::Reject(const TcpConnectionPtr& c,
+                               const H2Session::AdmitCallback& stream,
+                               Response::status_type status) {
+  if (stream) {
+    stream(status, options_.retry_after);
+  } else {
+    c->Reject(status, options_.retry_after);
+  }
+}
+
+bool ConnectionManager::Remove(const TcpConnectionPtr& c) {
+  size_t i = c->manager_index_;
+  if (i >= connections_.size() || connections_[i] != c) return false;
+  if (i + 1 < connections_.size()) {
+    connections_[i] = std::move(connections_.back());
+    connections_[i]->manager_index_ = i;
+  }
+  connections_.pop_back();
+  return true;
+}
+
+void ConnectionManager::Release(const asio::ip::address& address) {
+  // Connections over the limit, or made without one, were not counted.
+  if (address.is_unspecified()) return;
+  auto it = per_ip_.find(address);
+  if (it != per_ip_.end() && --it->second == 0) per_ip_.erase(it);
+}
+
+void ConnectionManager::Drain() {
+  drain_posted_ = false;
+  if (queue_size_ == 0) return;
+
+  Queued& queued = queue_[queue_head_];
+  TcpConnectionPtr c = std::move(queued.connection);
+  H2Session::AdmitCallback stream = std::move(queued.stream);
+  queued.stream = nullptr;
+  auto now = Clock::now();
+  auto sojourn = now - queued.since;
+  queue_head_ = (queue_head_ + 1) % queue_.size();
+  queue_size_--;
+
+  // One request per turn, the I/O of the others goes in between.
+  if (queue_size_ > 0) {
+    drain_posted_ = true;
+    asio::post(io_context_, [this]() { Drain(); });
+  }
+
+  if (codel_.ShouldDrop(sojourn, now)) {
+    shed_++;
+    Reject(c, stream, Response::service_unavailable);
+  } else if (stream) {
+    stream(Response::ok, std::chrono::seconds(0));
+  } else {
+    c->Serve();
+  }
+}
+
+ConnectionManager::Clock::duration ConnectionManager::SweepInterval() const {
+  Clock::duration interval = Clock::duration::zero();
+  for (auto timeout : {options_.header_timeout, options_.body_timeout}) {
+    if (timeout.count() == 0) continue;
+    Clock::duration quarter = timeout / 4;
+    if (interval == Clock::duration::zero() || quarter < interval) {
+      interval = quarter;
+    }
+  }
+  return std::min<Clock::duration>(interval, kMaxSweepInterval);
+}
+
+void ConnectionManager::Sweep() {
+  sweeping_ = false;
+  // Timing a connection out only cancels its reads or starts writing the
+  // 408, it stays in the list.
+  auto now = Clock::now();
+  for (auto& c : connections_) {
+    if (c->TimedOut(options_, now)) {
+      timed_out_++;
+      c->Timeout();
+    }
+  }
+  if (!connections_.empty()) ScheduleSweep();
+}
+
+void ConnectionManager::ScheduleSweep() {
+  auto interval = SweepInterval();
+  if (interval == Clock::duration::zero()) return;
+
+  sweeping_ = true;
+  sweep_timer_.expires_after(interval);
+  sweep_timer_.async_wait([this](std::error_code ec) {
+    if (!ec) Sweep();
+  });
 }
 
 }  // namespace http
-}  // namespace cppboot
\ No newline at end of file
+}  // namespace cppboot
@@ -1,8 +1,14 @@
 #ifndef CPPBOOT_NET_HTTP_CONNECTION_MANAGER_H_
 #define CPPBOOT_NET_HTTP_CONNECTION_MANAGER_H_
 
-#include <set>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 
+#include "cppboot/net/http/server/admission.h"
 #include "cppboot/net/http/server/connection.h"
 
 namespace cppboot {
@@ -10,26 +16,139 @@ namespace http {
 
 /// Manages open connections so that they may be cleanly stopped when the server
 /// needs to shut down.
+///
+/// Connections that ended are kept for reuse: a new one is served by an old
+/// TcpConnection, reset wholesale, whose buffers, request and reply keep
+/// their memory. Once warm, serving a request does not allocate.
+///
+/// It also decides what the server takes on, see AdmissionOptions. Parsed
+/// requests wait in a bounded queue, drained one handler at a time on the
+/// io_context so that I/O interleaves with them, and CoDel sheds them when
+/// the queueing delay shows the server can not keep up. A timer sweeps the
+/// connections for clients sending their request too slowly.
 class ConnectionManager {
  public:
+  /// Ended connections kept for reuse.
+  enum { kMaxIdle = 64 };
+
   ConnectionManager(const ConnectionManager&) = delete;
   ConnectionManager& operator=(const ConnectionManager&) = delete;
 
   /// Construct a connection manager.
-  ConnectionManager();
+  explicit ConnectionManager(asio::io_context& io_context);
+
+  /// Set the limits, before the first connection.
+  void set_options(const AdmissionOptions& options);
+
+  /// Called when a connection ends after Pause() returned true, accepting
+  /// may resume.
+  void set_resume_callback(const std::function<void()>& cb) {
+    resume_callback_ = cb;
+  }
+
+  /// A connection for `socket`, reusing one that ended if possible. All
+  /// connections of a manager serve the same `handler` and options.
+  TcpConnectionPtr Create(asio::ip::tcp::socket socket, ServeMux& handler,
+                          const CompressOptions& compress_options);
 
   /// Add the specified connection to the manager and start it.
   void Start(TcpConnectionPtr c);
 
+  /// Whether accepting has to pause for max_connections, until the resume
+  /// callback.
+  bool Pause();
+
+  /// Serve the request just read by `c` when its turn comes, or turn it
+  /// away.
+  void Enqueue(TcpConnectionPtr c);
+
+  /// The same for a stream of the HTTP/2 session of `c`, `stream` is called
+  /// with the outcome instead.
+  void Enqueue(TcpConnectionPtr c, H2Session::AdmitCallback stream);
+
   /// Stop the specified connection.
   void Stop(TcpConnectionPtr c);
 
+  /// Replace the connection `c` by `conn`, which took its socket over, until
+  /// Forget(). Stops `c` if `conn` is null.
+  void Replace(TcpConnectionPtr c, std::shared_ptr<net::Conn> conn);
+
+  /// Forget a connection that took a socket over and closed it.
+  void Forget(const std::shared_ptr<net::Conn>& conn);
+
   /// Stop all connections.
   void StopAll();
 
+  /// May be called from any thread.
+  AdmissionStats stats() const;
+
  private:
-  /// The managed connections.
-  std::set<TcpConnectionPtr> connections_;
+  typedef std::chrono::steady_clock Clock;
+
+  struct Queued {
+    TcpConnectionPtr connection;
+    /// Set for an HTTP/2 stream.
+    H2Session::AdmitCallback stream;
+    Clock::time_point since;
+  };
+
+  /// Turn the request of `c` away with `status`, or its HTTP/2 `stream`
+  /// if set.
+  void Reject(const TcpConnectionPtr& c,
+              const H2Session::AdmitCallback& stream,
+              Response::status_type status);
+
+  /// Remove `c` from the managed connections, false if it was not there.
+  bool Remove(const TcpConnectionPtr& c);
+
+  /// One connection less from `address`.
+  void Release(const asio::ip::address& address);
+
+  /// Serve the request at the head of the queue.
+  void Drain();
+
+  /// How often Sweep() runs, zero without read deadlines.
+  Clock::duration SweepInterval() const;
+
+  /// Time out the connections past their read deadlines, and schedule the
+  /// next sweep while there are connections.
+  void Sweep();
+  void ScheduleSweep();
+
+  asio::io_context& io_context_;
+  AdmissionOptions options_;
+  std::function<void()> resume_callback_;
+  bool paused_;
+
+  /// The managed connections, each knows its position.
+  std::vector<TcpConnectionPtr> connections_;
+
+  /// Ended connections, reusable once no handler refers to them anymore.
+  std::vector<TcpConnectionPtr> idle_;
+
+  /// The connections that took the socket of one over, and the address of
+  /// their client.
+  std::map<std::shared_ptr<net::Conn>, asio::ip::address> taken_over_;
+
+  /// Connections by client address, with max_connections_per_ip.
+  std::unordered_map<asio::ip::address, size_t> per_ip_;
+
+  /// The requests waiting for their handler, a ring of
+  /// max_queued_requests.
+  std::vector<Queued> queue_;
+  size_t queue_head_;
+  size_t queue_size_;
+  bool drain_posted_;
+  CoDel codel_;
+
+  asio::steady_timer sweep_timer_;
+  bool sweeping_;
+
+  std::atomic<size_t> open_;
+  std::atomic<uint64_t> shed_;
+  std::atomic<uint64_t> rejected_;
+  std::atomic<uint64_t> accept_pauses_;
+  std::atomic<uint64_t> timed_out_;
 };
 
 }  // namespace http
@@ -0,0 +1,250 @@
+#include "gmock/gmock.h"
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <new>
+#include <string>
+#include <thread>
+
+#include "cppboot/net/http/request.h"
+#include "cppboot/net/http/response.h"
+#include "cppboot/net/http/server.h"
+
+namespace {
+
+// The global allocation functions are replaced to count the allocations.
+
+/// Allocations made by the threads counting them, i.e. the server's.
+std::atomic<size_t> g_allocations(0);
+thread_local bool t_counting = false;
+
+}  // namespace
+
+void* operator new(size_t size) {
+  if (t_counting) g_allocations++;
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  if (t_counting) g_allocations++;
+  return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+  return operator new(size, tag);
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { free(p); }
+
+namespace {
+
+using asio::ip::tcp;
+using cppboot::string_view;
+using cppboot::http::BodySource;
+using cppboot::http::Request;
+using cppboot::http::Response;
+using cppboot::http::Server;
+
+/// Send `request` and return the whole response.
+std::string Fetch(const std::string& request) {
+  asio::io_context io_context;
+  tcp::socket socket(io_context);
+  socket.connect(tcp::endpoint(asio::ip::make_address("127.0.0.1"), 59987));
+  asio::write(socket, asio::buffer(request));
+  std::string response;
+  asio::error_code ec;
+  asio::read(socket, asio::dynamic_buffer(response), ec);
+  return response;
+}
+
+/// A server echoing the user name, the "tab" query parameter and the
+/// user agent, whose thread counts its allocations.
+class EchoServer {
+ public:
+  EchoServer() {
+    server_.Handle("/users/{name}", [](const Request& req, Response* rep) {
+      rep->status = Response::ok;
+      rep->set_header("Content-Type", "text/plain");
+      if (req.headers.Has("X-Request-Id")) {
+        rep->set_header("X-Request-Id", req.header("X-Request-Id"));
+      }
+      for (string_view s : {req.PathValue("name"), string_view(" "),
+                            req.Param("tab"), string_view(" "),
+                            req.header("User-Agent")}) {
+        rep->content.append(s.data(), s.size());
+      }
+    });
+    auto st = server_.Listen("127.0.0.1", "59987");
+    EXPECT_TRUE(st) << st.ToString();
+    thread_ = std::thread([this]() {
+      t_counting = true;
+      server_.Serve();
+    });
+  }
+
+  ~EchoServer() {
+    server_.Shutdown();
+    thread_.join();
+  }
+
+ private:
+  Server server_;
+  std::thread thread_;
+};
+
+TEST(ConnectionManager, NoAllocationPerRequest) {
+  EchoServer server;
+
+  const std::string long_request =
+      "GET /users/someone-with-a-long-name?tab=repositories&sort=updated "
+      "HTTP/1.1\r\n"
+      "Host: 127.0.0.1:59987\r\n"
+      "User-Agent: Mozilla/5.0 (X11; Linux x86_64) Gecko/20100101\r\n"
+      "Accept: text/html,application/xhtml+xml;q=0.9,*/*;q=0.8\r\n"
+      "Accept-Language: en-US,en;q=0.5\r\n"
+      "X-Request-Id: 0123456789abcdef0123456789abcdef\r\n"
+      "\r\n";
+  const std::string short_request =
+      "GET /users/me HTTP/1.1\r\n"
+      "Host: 127.0.0.1:59987\r\n"
+      "\r\n";
+
+  // Connections are reused, nothing of the previous request is left.
+  for (int i = 0; i < 20; i++) {
+    std::string response = Fetch(i % 2 ? short_request : long_request);
+    ASSERT_THAT(response, ::testing::StartsWith("HTTP/1.0 200 "));
+    if (i % 2) {
+      ASSERT_THAT(response, ::testing::EndsWith("\r\n\r\nme  "));
+      ASSERT_THAT(response,
+                  ::testing::Not(::testing::HasSubstr("X-Request-Id")));
+    } else {
+      ASSERT_THAT(response, ::testing::EndsWith(
+                                "\r\n\r\nsomeone-with-a-long-name "
+                                "repositories Mozilla/5.0 (X11; Linux "
+                                "x86_64) Gecko/20100101"));
+    }
+  }
+
+  size_t before = g_allocations;
+  for (int i = 0; i < 20; i++) Fetch(i % 2 ? short_request : long_request);
+  EXPECT_EQ(g_allocations - before, 0);
+}
+
+TEST(ConnectionManager, BodySourceOfEndedRequest) {
+  Server server;
+  BodySource stored;
+  Response::DoneFunc held;
+  std::atomic<bool> holding(false);
+  // Keeps the body source without reading it.
+  server.Handle("/keep", [&](const Request& req, Response* rep) {
+    stored = req.body_source;
+    rep->WriteText(Response::ok, "kept");
+  });
+  server.Handle("/hold", [&](const Request&, Response* rep) {
+    rep->WriteText(Response::ok, "held");
+    held = rep->Defer();
+    holding = true;
+  });
+  auto st = server.Listen("127.0.0.1", "59985");
+  ASSERT_TRUE(st) << st.ToString();
+  std::thread thread([&server]() { server.Serve(); });
+
+  asio::io_context io_context;
+  tcp::endpoint endpoint(asio::ip::make_address("127.0.0.1"), 59985);
+  {
+    tcp::socket a(io_context);
+    a.connect(endpoint);
+    asio::write(a, asio::buffer(std::string("POST /keep HTTP/1.0\r\n"
+                                            "Content-Length: 10\r\n\r\n"
+                                            "0123")));
+    std::string response;
+    asio::error_code ec;
+    asio::read(a, asio::dynamic_buffer(response), ec);
+    ASSERT_THAT(response, ::testing::EndsWith("\r\n\r\nkept"));
+  }
+
+  // The connection object is reused for another client's upload.
+  tcp::socket b(io_context);
+  b.connect(endpoint);
+  asio::write(b, asio::buffer(std::string("POST /hold HTTP/1.0\r\n"
+                                          "Content-Length: 10\r\n\r\n"
+                                          "abcd")));
+  for (int i = 0; i < 200 && !holding; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  ASSERT_TRUE(holding);
+
+  // Reading the stale source must not take the other client's bytes.
+  std::promise<std::pair<cppboot::Status, std::string>> read;
+  asio::post(server.io_context(), [&]() {
+    stored.read([&](const cppboot::Status& status, string_view data) {
+      read.set_value(std::make_pair(status, data.str()));
+    });
+  });
+  asio::write(b, asio::buffer(std::string("efghij")));
+  auto future = read.get_future();
+  ASSERT_EQ(future.wait_for(std::chrono::seconds(5)),
+            std::future_status::ready);
+  auto result = future.get();
+  ASSERT_TRUE(cppboot::IsCancelled(result.first))
+      << result.first.ToString() << " " << result.second;
+
+  asio::post(server.io_context(), [&]() { held(); });
+  std::string response;
+  asio::error_code ec;
+  asio::read(b, asio::dynamic_buffer(response), ec);
+  ASSERT_THAT(response, ::testing::EndsWith("\r\n\r\nheld"));
+
+  server.Shutdown();
+  thread.join();
+}
+
+TEST(ConnectionManager, ReleasesReplyBodyOfEndedRequest) {
+  Server server;
+  // Held by the body source only.
+  std::weak_ptr<int> weak;
+  server.Handle("/stream", [&weak](const Request&, Response* rep) {
+    auto token = std::make_shared<int>(0);
+    weak = token;
+    rep->status = Response::ok;
+    auto sent = std::make_shared<bool>(false);
+    rep->body_source.size = 4;
+    rep->body_source.read = [token, sent](BodySource::ReadCallback cb) {
+      cb(cppboot::OkStatus(), *sent ? string_view() : string_view("body"));
+      *sent = true;
+    };
+  });
+  auto st = server.Listen("127.0.0.1", "59984");
+  ASSERT_TRUE(st) << st.ToString();
+  std::thread thread([&server]() { server.Serve(); });
+
+  asio::io_context io_context;
+  tcp::socket socket(io_context);
+  socket.connect(tcp::endpoint(asio::ip::make_address("127.0.0.1"), 59984));
+  asio::write(socket, asio::buffer(std::string("GET /stream HTTP/1.0\r\n\r\n")));
+  std::string response;
+  asio::error_code ec;
+  asio::read(socket, asio::dynamic_buffer(response), ec);
+  ASSERT_THAT(response, ::testing::EndsWith("\r\n\r\nbody"));
+
+  // The ended connection, kept for reuse, no longer holds the source.
+  for (int i = 0; i < 200 && !weak.expired(); i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  ASSERT_TRUE(weak.expired());
+
+  server.Shutdown();
+  thread.join();
+}
+
+}  // namespace
@@ -0,0 +1,321 @@
+#include "cppboot/net/http/server/event_stream.h"
+
+#include <algorithm>
+
+#include "cppboot/base/str_util.h"
+#include "cppboot/net/http/request.h"
+#include "cppboot/net/http/response.h"
+
+namespace cppboot {
+namespace http {
+
+namespace {
+
+/// Events gathered into one write.
+const size_t kMaxWriteEvents = 64;
+
+bool IsSingleLine(string_view s) {
+  return s.find('\n') == string_view::npos &&
+         s.find('\r') == string_view::npos;
+}
+
+}  // namespace
+
+EventStream::EventStream(asio::io_context& io_context,
+                         const Options& options)
+    : io_context_(io_context),
+      options_(options),
+      heartbeat_timer_(io_context),
+      heartbeat_scheduled_(false),
+      subscribers_(0),
+      disconnected_(0),
+      coalesced_(0) {
+  if (options_.retry.count() > 0) {
+    auto retry = std::make_shared<Event>();
+    retry->text = "retry: " + std::to_string(options_.retry.count()) + "\n\n";
+    retry_ = std::move(retry);
+  }
+  auto heartbeat = std::make_shared<Event>();
+  heartbeat->text = ":\n\n";
+  heartbeat_ = std::move(heartbeat);
+}
+
+EventStream::~EventStream() {
+  for (auto& channel : channels_) {
+    for (auto& subscriber : channel.second) subscriber->stream_ = nullptr;
+  }
+}
+
+void EventStream::ServeHttp(const Request& req, Response* rep) {
+  Subscribe(req.path, req, rep);
+}
+
+void EventStream::Subscribe(string_view channel, const Request& req,
+                            Response* rep) {
+  if (req.method != "GET") {
+    *rep = Response::stock_reply(Response::method_not_allowed);
+    rep->headers.Add("Allow", "GET");
+    return;
+  }
+
+  std::string name = channel.str();
+  std::string last_event_id = StrTrim(req.headers.Get("Last-Event-ID")).str();
+  bool ok = rep->Takeover([this, name, last_event_id](
+                              asio::ip::tcp::socket socket, string_view,
+                              std::function<void()> closed) {
+    return Start(std::move(socket), name, last_event_id, std::move(closed));
+  });
+  if (!ok) {
+    *rep = Response::stock_reply(Response::not_implemented);
+    return;
+  }
+
+  rep->status = Response::ok;
+  rep->headers.Add(kContentType, "text/event-stream");
+  rep->headers.Add("Cache-Control", "no-cache");
+  // Keeps nginx from buffering the stream.
+  rep->headers.Add("X-Accel-Buffering", "no");
+}
+
+Status EventStream::Publish(string_view channel, string_view event,
+                            string_view data, string_view id) {
+  auto encoded = std::make_shared<Event>();
+  auto st = Encode(event, data, id, &encoded->text);
+  if (!st) return st;
+  encoded->name = event.str();
+
+  std::string name = channel.str();
+  EventPtr shared = std::move(encoded);
+  asio::post(io_context_, [this, name, shared]() { FanOut(name, shared); });
+  return OkStatus();
+}
+
+Status EventStream::Encode(string_view event, string_view data,
+                           string_view id, std::string* out) {
+  if (!IsSingleLine(event) || !IsSingleLine(id)) {
+    return InvalidArgumentError("Event type and id must be single lines");
+  }
+  out->reserve(out->size() + event.size() + id.size() + data.size() + 32);
+  if (!id.empty()) {
+    out->append("id: ");
+    out->append(id.data(), id.size());
+    out->push_back('\n');
+  }
+  if (!event.empty()) {
+    out->append("event: ");
+    out->append(event.data(), event.size());
+    out->push_back('\n');
+  }
+  // Lines end with CRLF, LF or CR.
+  size_t start = 0;
+  while (true) {
+    size_t end = start;
+    while (end < data.size() && data[end] != '\n' && data[end] != '\r') end++;
+    out->append("data: ");
+    out->append(data.data() + start, end - start);
+    out->push_back('\n');
+    if (end == data.size()) break;
+    if (data[end] == '\r' && end + 1 < data.size() && data[end + 1] == '\n') {
+      end++;
+    }
+    start = end + 1;
+  }
+  out->push_back('\n');
+  return OkStatus();
+}
+
+EventStream::Stats EventStream::stats() const {
+  Stats stats;
+  stats.subscribers = subscribers_;
+  stats.disconnected = disconnected_;
+  stats.coalesced = coalesced_;
+  return stats;
+}
+
+std::shared_ptr<net::Conn> EventStream::Start(asio::ip::tcp::socket socket,
+                                              std::string channel,
+                                              std::string last_event_id,
+                                              std::function<void()> closed) {
+  auto subscriber = std::make_shared<Subscriber>(
+      std::move(socket), this, std::move(channel), std::move(last_event_id),
+      std::move(closed));
+  channels_[subscriber->channel()].insert(subscriber);
+  subscribers_++;
+  ScheduleHeartbeat();
+
+  subscriber->set_conn_callback(conn_callback_);
+  subscriber->Start();
+  return subscriber;
+}
+
+void EventStream::FanOut(const std::string& channel, const EventPtr& event) {
+  auto it = channels_.find(channel);
+  if (it == channels_.end()) return;
+
+  Subscribers& subscribers = it->second;
+  for (auto sub = subscribers.begin(); sub != subscribers.end();) {
+    if ((*sub)->Push(event)) {
+      ++sub;
+      continue;
+    }
+    auto slow = *sub;
+    sub = subscribers.erase(sub);
+    subscribers_--;
+    disconnected_++;
+    slow->CloseSocket();
+  }
+  if (subscribers.empty()) channels_.erase(it);
+}
+
+void EventStream::Remove(const std::shared_ptr<Subscriber>& subscriber) {
+  auto it = channels_.find(subscriber->channel());
+  if (it == channels_.end() || it->second.erase(subscriber) == 0) return;
+  subscribers_--;
+  if (it->second.empty()) channels_.erase(it);
+}
+
+void EventStream::ScheduleHeartbeat() {
+  if (heartbeat_scheduled_ || options_.heartbeat.count() <= 0) return;
+  heartbeat_scheduled_ = true;
+  heartbeat_timer_.expires_after(options_.heartbeat);
+  heartbeat_timer_.async_wait([this](std::error_code ec) {
+    if (ec) return;
+    heartbeat_scheduled_ = false;
+    OnHeartbeat();
+  });
+}
+
+void EventStream::OnHeartbeat() {
+  if (channels_.empty()) return;
+  for (auto& channel : channels_) {
+    for (auto& subscriber : channel.second) {
+      if (subscriber->idle()) subscriber->Push(heartbeat_);
+    }
+  }
+  ScheduleHeartbeat();
+}
+
+EventStream::Subscriber::Subscriber(asio::ip::tcp::socket socket,
+                                    EventStream* stream, std::string channel,
+                                    std::string last_event_id,
+                                    std::function<void()> closed)
+    : socket_(std::move(socket)),
+      stream_(stream),
+      channel_(std::move(channel)),
+      last_event_id_(std::move(last_event_id)),
+      closed_(std::move(closed)),
+      writing_(false) {}
+
+EventStream::Subscriber::~Subscriber() = default;
+
+void EventStream::Subscriber::Start() {
+  state_ = kConnected;
+  if (stream_->retry_) Push(stream_->retry_);
+  if (conn_callback_) conn_callback_(shared_from_this());
+  DoRead();
+}
+
+void EventStream::Subscriber::Stop() {
+  auto self(this->self());
+  asio::dispatch(socket_.get_executor(), [this, self]() { CloseSocket(); });
+}
+
+void EventStream::Subscriber::Send(const void* data, size_t len) {
+  auto event = std::make_shared<Event>();
+  Encode(string_view(), string_view(static_cast<const char*>(data), len),
+         string_view(), &event->text)
+      .IgnoreError();
+  EventPtr shared = std::move(event);
+
+  auto self(this->self());
+  asio::dispatch(socket_.get_executor(), [this, self, shared]() {
+    if (state_ != kConnected || Push(shared)) return;
+    if (stream_) stream_->disconnected_++;
+    CloseSocket();
+  });
+}
+
+bool EventStream::Subscriber::Push(const EventPtr& event) {
+  if (state_ != kConnected) return true;
+
+  if (stream_ && queue_.size() >= stream_->options_.max_queued) {
+    if (stream_->options_.slow_policy == kDisconnect) return false;
+    stream_->coalesced_++;
+    auto same = std::find_if(queue_.rbegin(), queue_.rend(),
+                             [&event](const EventPtr& queued) {
+                               return queued->name == event->name;
+                             });
+    if (same != queue_.rend()) {
+      *same = event;
+      return true;
+    }
+    queue_.erase(queue_.begin());
+  }
+
+  queue_.push_back(event);
+  if (!writing_) DoWrite();
+  return true;
+}
+
+void EventStream::Subscriber::DoRead() {
+  auto self(this->self());
+  socket_.async_read_some(
+      asio::buffer(discard_),
+      [this, self](std::error_code ec, size_t) {
+        if (ec) {
+          if (ec != asio::error::operation_aborted) CloseSocket();
+          return;
+        }
+        DoRead();
+      });
+}
+
+void EventStream::Subscriber::DoWrite() {
+  if (queue_.empty() || state_ != kConnected) {
+    writing_ = false;
+    return;
+  }
+  writing_ = true;
+
+  if (queue_.size() <= kMaxWriteEvents) {
+    sending_.swap(queue_);
+  } else {
+    sending_.assign(queue_.begin(), queue_.begin() + kMaxWriteEvents);
+    queue_.erase(queue_.begin(), queue_.begin() + kMaxWriteEvents);
+  }
+  buffers_.clear();
+  for (auto& event : sending_) buffers_.push_back(asio::buffer(event->text));
+
+  auto self(this->self());
+  asio::async_write(socket_, buffers_,
+                    [this, self](std::error_code ec, size_t) {
+                      sending_.clear();
+                      if (ec) {
+                        writing_ = false;
+                        CloseSocket();
+                        return;
+                      }
+                      DoWrite();
+                    });
+}
+
+void EventStream::Subscriber::CloseSocket() {
+  if (state_ != kConnected) return;
+  state_ = kDisconnected;
+  std::error_code ignored;
+  socket_.shutdown(asio::ip::tcp::socket::shutdown_both, ignored);
+  socket_.close(ignored);
+  queue_.clear();
+
+  auto self(this->self());
+  if (stream_) stream_->Remove(self);
+  if (conn_callback_) conn_callback_(self);
+  if (closed_) {
+    auto closed = std::move(closed_);
+    closed_ = nullptr;
+    closed();
+  }
+}
+
+}  // namespace http
+}  // namespace cppboot
@@ -0,0 +1,222 @@
+#ifndef CPPBOOT_NET_HTTP_SERVER_EVENT_STREAM_H_
+#define CPPBOOT_NET_HTTP_SERVER_EVENT_STREAM_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "asio.hpp"
+
+#include "cppboot/base/status.h"
+#include "cppboot/base/string_view.h"
+#include "cppboot/net/connection.h"
+
+namespace cppboot {
+namespace http {
+
+struct Request;
+struct Response;
+
+/// Handler streaming Server-Sent Events (text/event-stream) published to
+/// named channels, e.g.
+///
+///   EventStream events(server.io_context());
+///   server.Handle("/prices", [&events](const Request& req, Response* rep) {
+///     events.Subscribe("prices", req, rep);
+///   });
+///   ...
+///   events.Publish("prices", "tick", R"({"AAPL": 187.2})");
+///
+/// A subscription keeps the connection open and takes it over from the
+/// server. An event is encoded once into a buffer shared by all subscribers
+/// of its channel, which only queue a reference to it. Publishing from any
+/// thread posts one fan-out to `io_context`, where every subscriber lives,
+/// so nothing is locked per subscriber.
+///
+/// A subscriber that does not keep up has at most Options::max_queued
+/// events queued behind the ones being written. Past that it is
+/// disconnected, its EventSource reconnects with the Last-Event-ID it got
+/// to. With kCoalesce the new event replaces the last queued one of the
+/// same type instead, or the oldest queued one is dropped, which suits
+/// channels where the latest value is all that matters.
+///
+/// Only HTTP/1 connections can subscribe, HTTP/2 ones get a 501. The stream
+/// must be destroyed after the server using it was shut down.
+class EventStream {
+ public:
+  enum SlowPolicy {
+    kDisconnect,
+    kCoalesce,
+  };
+
+  struct Options {
+    Options()
+        : max_queued(64),
+          slow_policy(kDisconnect),
+          heartbeat(std::chrono::seconds(15)),
+          retry(0) {}
+
+    /// Events queued per subscriber before `slow_policy` applies.
+    size_t max_queued;
+    SlowPolicy slow_policy;
+    /// A comment is sent to idle subscribers this often so that proxies
+    /// keep the connections open, zero for never.
+    std::chrono::milliseconds heartbeat;
+    /// Reconnection delay suggested to clients, zero to leave it to them.
+    std::chrono::milliseconds retry;
+  };
+
+  struct Stats {
+    size_t subscribers;
+    /// Subscribers disconnected for being too slow.
+    uint64_t disconnected;
+    /// Events dropped or replaced for slow subscribers.
+    uint64_t coalesced;
+  };
+
+  /// A subscribed connection, passed to the conn callback.
+  class Subscriber;
+
+  EventStream(const EventStream&) = delete;
+  EventStream& operator=(const EventStream&) = delete;
+
+  /// Serve subscribers on `io_context`, the one of the server.
+  explicit EventStream(asio::io_context& io_context,
+                       const Options& options = Options());
+  ~EventStream();
+
+  /// Called when a subscriber connects and when it disconnects, e.g. to send
+  /// it the current state with Send() or what it missed since its
+  /// last_event_id().
+  void set_conn_callback(const net::ConnCallback& cb) { conn_callback_ = cb; }
+
+  /// Subscribe to the channel named by the request path.
+  void ServeHttp(const Request& req, Response* rep);
+
+  /// Subscribe to `channel`.
+  void Subscribe(string_view channel, const Request& req, Response* rep);
+
+  /// Send an event of type `event`, "message" if empty, to the subscribers
+  /// of `channel`. Lines of `data` are sent as such. `id`, if any, is what
+  /// a reconnecting client sends back as Last-Event-ID. Fails if `event` or
+  /// `id` span lines.
+  Status Publish(string_view channel, string_view event, string_view data,
+                 string_view id = string_view());
+
+  /// Append the encoded event to `out`.
+  static Status Encode(string_view event, string_view data, string_view id,
+                       std::string* out);
+
+  Stats stats() const;
+
+ private:
+  struct Event {
+    /// The type, coalesced events replace queued ones of the same.
+    std::string name;
+    std::string text;
+  };
+
+  typedef std::shared_ptr<const Event> EventPtr;
+  typedef std::unordered_set<std::shared_ptr<Subscriber>> Subscribers;
+
+  /// Take the socket over for a subscriber of `channel`.
+  std::shared_ptr<net::Conn> Start(asio::ip::tcp::socket socket,
+                                   std::string channel,
+                                   std::string last_event_id,
+                                   std::function<void()> closed);
+
+  /// Queue `event` for the subscribers of `channel`, on the io_context.
+  void FanOut(const std::string& channel, const EventPtr& event);
+
+  void Remove(const std::shared_ptr<Subscriber>& subscriber);
+
+  void ScheduleHeartbeat();
+  void OnHeartbeat();
+
+  asio::io_context& io_context_;
+  Options options_;
+  net::ConnCallback conn_callback_;
+
+  /// Sent first if Options::retry is set, and as heartbeat.
+  EventPtr retry_;
+  EventPtr heartbeat_;
+
+  /// Subscribers by channel, only used on the io_context.
+  std::unordered_map<std::string, Subscribers> channels_;
+  asio::steady_timer heartbeat_timer_;
+  bool heartbeat_scheduled_;
+
+  std::atomic<size_t> subscribers_;
+  std::atomic<uint64_t> disconnected_;
+  std::atomic<uint64_t> coalesced_;
+};
+
+class EventStream::Subscriber : public net::Conn {
+ public:
+  Subscriber(asio::ip::tcp::socket socket, EventStream* stream,
+             std::string channel, std::string last_event_id,
+             std::function<void()> closed);
+  ~Subscriber();
+
+  /// Close the connection.
+  void Stop() override;
+
+  /// Send `data` to this subscriber alone, as an untyped event.
+  void Send(const void* data, size_t len) override;
+
+  const std::string& channel() const noexcept { return channel_; }
+
+  /// The Last-Event-ID the client reconnected with, if any.
+  const std::string& last_event_id() const noexcept {
+    return last_event_id_;
+  }
+
+ private:
+  friend class EventStream;
+
+  std::shared_ptr<Subscriber> self() {
+    return std::static_pointer_cast<Subscriber>(shared_from_this());
+  }
+
+  void Start();
+
+  /// Queue `event`, false if the subscriber is too slow and has to go.
+  bool Push(const EventPtr& event);
+
+  /// Whether nothing is being written.
+  bool idle() const noexcept { return !writing_; }
+
+  /// Wait for the client to hang up, it has nothing to say.
+  void DoRead();
+
+  void DoWrite();
+
+  void CloseSocket();
+
+  asio::ip::tcp::socket socket_;
+  /// Null once the stream is destroyed.
+  EventStream* stream_;
+  std::string channel_;
+  std::string last_event_id_;
+  std::function<void()> closed_;
+
+  std::vector<EventPtr> queue_;
+  /// Events being written.
+  std::vector<EventPtr> sending_;
+  std::vector<asio::const_buffer> buffers_;
+  bool writing_;
+
+  char discard_[16];
+};
+
+}  // namespace http
+}  // namespace cppboot
+
+#endif  // CPPBOOT_NET_HTTP_SERVER_EVENT_STREAM_H_
@@ -0,0 +1,251 @@
+#include "gmock/gmock.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "cppboot/net/http/request.h"
+#include "cppboot/net/http/response.h"
+#include "cppboot/net/http/server.h"
+#include "cppboot/net/http/server/event_stream.h"
+
+namespace {
+
+using asio::ip::tcp;
+using cppboot::http::EventStream;
+using cppboot::http::Request;
+using cppboot::http::Response;
+using cppboot::http::Server;
+using cppboot::net::Conn;
+using cppboot::net::ConnPtr;
+
+EventStream::Options SlowOptions(EventStream::SlowPolicy policy) {
+  EventStream::Options options;
+  options.max_queued = 4;
+  options.slow_policy = policy;
+  return options;
+}
+
+EventStream::Options FastOptions() {
+  EventStream::Options options;
+  options.heartbeat = std::chrono::milliseconds(50);
+  options.retry = std::chrono::milliseconds(2000);
+  return options;
+}
+
+/// A server with events on "/events", welcoming its subscribers, and with
+/// channels dropping or coalescing for slow subscribers.
+class EventServer {
+ public:
+  EventServer()
+      : events_(server_.io_context(), FastOptions()),
+        slow_(server_.io_context(), SlowOptions(EventStream::kDisconnect)),
+        latest_(server_.io_context(), SlowOptions(EventStream::kCoalesce)),
+        disconnected_(0) {
+    events_.set_conn_callback([this](const ConnPtr& conn) {
+      if (conn->state() == Conn::kConnected) {
+        auto subscriber = static_cast<EventStream::Subscriber*>(conn.get());
+        std::string welcome = "welcome " + subscriber->last_event_id();
+        conn->Send(welcome.data(), welcome.size());
+      } else {
+        disconnected_++;
+      }
+    });
+
+    server_.Handle("/events", std::bind(&EventStream::ServeHttp, &events_,
+                                        std::placeholders::_1,
+                                        std::placeholders::_2));
+    server_.Handle("/slow", [this](const Request& req, Response* rep) {
+      slow_.Subscribe("feed", req, rep);
+    });
+    server_.Handle("/latest", [this](const Request& req, Response* rep) {
+      latest_.Subscribe("feed", req, rep);
+    });
+    auto st = server_.Listen("127.0.0.1", "59988");
+    EXPECT_TRUE(st) << st.ToString();
+    thread_ = std::thread([this]() { server_.Serve(); });
+  }
+
+  ~EventServer() {
+    server_.Shutdown();
+    thread_.join();
+  }
+
+  EventStream& events() { return events_; }
+  EventStream& slow() { return slow_; }
+  EventStream& latest() { return latest_; }
+  int disconnected() const { return disconnected_; }
+
+ private:
+  Server server_;
+  EventStream events_;
+  EventStream slow_;
+  EventStream latest_;
+  std::atomic<int> disconnected_;
+  std::thread thread_;
+};
+
+/// Wait until `stream` has `n` subscribers.
+bool WaitForSubscribers(const EventStream& stream, size_t n) {
+  for (int i = 0; i < 200 && stream.stats().subscribers != n; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return stream.stats().subscribers == n;
+}
+
+/// A blocking EventSource.
+class Client {
+ public:
+  Client() : socket_(io_context_) {}
+
+  /// Subscribe to `path` and return the response head.
+  std::string Connect(const std::string& path,
+                      const std::string& extra_headers = std::string()) {
+    socket_.open(tcp::v4());
+    // Small buffers, to fall behind quickly when not reading.
+    socket_.set_option(tcp::socket::receive_buffer_size(4096));
+    socket_.connect(
+        tcp::endpoint(asio::ip::make_address("127.0.0.1"), 59988));
+    std::string request = "GET " + path +
+                          " HTTP/1.1\r\n"
+                          "Host: 127.0.0.1\r\n"
+                          "Accept: text/event-stream\r\n"
+                          "Accept-Encoding: gzip\r\n" +
+                          extra_headers + "\r\n";
+    asio::write(socket_, asio::buffer(request));
+
+    asio::error_code ec;
+    size_t n = asio::read_until(socket_, asio::dynamic_buffer(buffer_),
+                                "\r\n\r\n", ec);
+    if (ec) return std::string();
+    std::string head = buffer_.substr(0, n);
+    buffer_.erase(0, n);
+    return head;
+  }
+
+  /// The next event, skipping heartbeats unless `comments`, empty at the
+  /// end of the connection.
+  std::string Read(bool comments = false) {
+    while (true) {
+      asio::error_code ec;
+      size_t n = asio::read_until(socket_, asio::dynamic_buffer(buffer_),
+                                  "\n\n", ec);
+      if (ec) return std::string();
+      std::string event = buffer_.substr(0, n);
+      buffer_.erase(0, n);
+      if (comments || event != ":\n\n") return event;
+    }
+  }
+
+  void Close() { socket_.close(); }
+
+ private:
+  asio::io_context io_context_;
+  tcp::socket socket_;
+  std::string buffer_;
+};
+
+TEST(EventStream, Encode) {
+  std::string out;
+  ASSERT_TRUE(EventStream::Encode("", "hello", "", &out));
+  ASSERT_EQ(out, "data: hello\n\n");
+
+  out.clear();
+  ASSERT_TRUE(EventStream::Encode("tick", "a\nb\r\nc\rd", "42", &out));
+  ASSERT_EQ(out,
+            "id: 42\nevent: tick\n"
+            "data: a\ndata: b\ndata: c\ndata: d\n\n");
+
+  out.clear();
+  ASSERT_TRUE(EventStream::Encode("", "", "", &out));
+  ASSERT_EQ(out, "data: \n\n");
+
+  ASSERT_FALSE(EventStream::Encode("a\nb", "", "", &out));
+  ASSERT_FALSE(EventStream::Encode("", "", "1\r", &out));
+}
+
+TEST(EventStream, Publish) {
+  EventServer server;
+  Client a, b;
+  std::string head = a.Connect("/events");
+  ASSERT_THAT(head, ::testing::StartsWith("HTTP/1.0 200 "));
+  ASSERT_THAT(head, ::testing::HasSubstr("Content-Type: text/event-stream"));
+  ASSERT_THAT(head, ::testing::Not(::testing::HasSubstr("Content-Length")));
+  ASSERT_THAT(head,
+              ::testing::Not(::testing::HasSubstr("Content-Encoding")));
+  ASSERT_EQ(a.Read(), "retry: 2000\n\n");
+  ASSERT_EQ(a.Read(), "data: welcome \n\n");
+
+  b.Connect("/events", "Last-Event-ID: 7\r\n");
+  ASSERT_EQ(b.Read(), "retry: 2000\n\n");
+  ASSERT_EQ(b.Read(), "data: welcome 7\n\n");
+  ASSERT_TRUE(WaitForSubscribers(server.events(), 2));
+
+  ASSERT_TRUE(server.events().Publish("/events", "tick", "1\n2", "8"));
+  ASSERT_TRUE(server.events().Publish("/elsewhere", "", "lost"));
+  ASSERT_TRUE(server.events().Publish("/events", "", "{}"));
+  ASSERT_FALSE(server.events().Publish("/events", "bad\n", ""));
+  for (Client* client : {&a, &b}) {
+    ASSERT_EQ(client->Read(), "id: 8\nevent: tick\ndata: 1\ndata: 2\n\n");
+    ASSERT_EQ(client->Read(), "data: {}\n\n");
+  }
+
+  // Idle subscribers get heartbeats.
+  ASSERT_EQ(a.Read(true), ":\n\n");
+
+  // Subscribers going away are noticed.
+  a.Close();
+  ASSERT_TRUE(WaitForSubscribers(server.events(), 1));
+  for (int i = 0; i < 100 && server.disconnected() < 1; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ(server.disconnected(), 1);
+}
+
+TEST(EventStream, SlowSubscriberDisconnected) {
+  EventServer server;
+  Client client;
+  client.Connect("/slow");
+  ASSERT_TRUE(WaitForSubscribers(server.slow(), 1));
+
+  // Published faster than read, the queue fills up once the socket buffers
+  // are full.
+  std::string data(64 * 1024, 'x');
+  for (int i = 0; i < 400 && server.slow().stats().disconnected == 0; i++) {
+    ASSERT_TRUE(server.slow().Publish("feed", "", data));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  ASSERT_TRUE(WaitForSubscribers(server.slow(), 0));
+  ASSERT_EQ(server.slow().stats().disconnected, 1);
+
+  // What was written is still there, then the connection ends.
+  size_t events = 0;
+  while (!client.Read().empty()) events++;
+  ASSERT_GT(events, 0);
+}
+
+TEST(EventStream, SlowSubscriberCoalesced) {
+  EventServer server;
+  Client client;
+  client.Connect("/latest");
+  ASSERT_TRUE(WaitForSubscribers(server.latest(), 1));
+
+  std::string data(64 * 1024, 'x');
+  for (int i = 0; i < 400 && server.latest().stats().coalesced < 10; i++) {
+    ASSERT_TRUE(server.latest().Publish("feed", "tick", data));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  ASSERT_GE(server.latest().stats().coalesced, 10);
+  ASSERT_TRUE(server.latest().Publish("feed", "tick", "last"));
+
+  // Still subscribed, and the latest tick gets through.
+  std::string event;
+  do {
+    event = client.Read();
+    ASSERT_FALSE(event.empty());
+  } while (event != "event: tick\ndata: last\n\n");
+  ASSERT_EQ(server.latest().stats().subscribers, 1);
+  ASSERT_EQ(server.latest().stats().disconnected, 0);
+}
+
+}  // namespace
@@ -0,0 +1,98 @@
+#include "cppboot/net/http/server/file_cache.h"
+
+namespace cppboot {
+namespace http {
+
+FileCache::FileCache()
+    : max_bytes_(kDefaultMaxBytes),
+      max_entries_(kDefaultMaxEntries),
+      max_file_size_(kDefaultMaxFileSize),
+      bytes_(0) {}
+
+namespace {
+
+std::string Key(const std::string& path, const std::string& encoding) {
+  return encoding.empty() ? path : path + '\0' + encoding;
+}
+
+}  // namespace
+
+CachedFilePtr FileCache::Get(const std::string& path, const struct stat& st,
+                             const std::string& encoding) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto it = index_.find(Key(path, encoding));
+  if (it == index_.end()) return nullptr;
+
+  if (!(*it->second)->IsFresh(st)) {
+    Erase(it->second);
+    return nullptr;
+  }
+
+  lru_.splice(lru_.begin(), lru_, it->second);
+  return lru_.front();
+}
+
+void FileCache::Put(const CachedFilePtr& file) {
+  size_t size = file->content->size();
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (size > max_file_size_ || size > max_bytes_ || max_bytes_ == 0 ||
+      max_entries_ == 0) {
+    return;
+  }
+
+  auto key = Key(file->path, file->encoding);
+  auto it = index_.find(key);
+  if (it != index_.end()) Erase(it->second);
+
+  lru_.push_front(file);
+  index_[key] = lru_.begin();
+  bytes_ += size;
+  Evict();
+}
+
+void FileCache::Clear() {
+  std::lock_guard<std::mutex> guard(mutex_);
+  lru_.clear();
+  index_.clear();
+  bytes_ = 0;
+}
+
+size_t FileCache::bytes() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return bytes_;
+}
+
+size_t FileCache::entries() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return lru_.size();
+}
+
+size_t FileCache::max_file_size() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return max_file_size_;
+}
+
+void FileCache::set_limits(size_t max_bytes, size_t max_entries,
+                           size_t max_file_size) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  max_bytes_ = max_bytes;
+  max_entries_ = max_entries;
+  max_file_size_ = max_file_size;
+  Evict();
+}
+
+void FileCache::Erase(List::iterator it) {
+  bytes_ -= (*it)->content->size();
+  index_.erase(Key((*it)->path, (*it)->encoding));
+  lru_.erase(it);
+}
+
+void FileCache::Evict() {
+  while (!lru_.empty() &&
+         (bytes_ > max_bytes_ || lru_.size() > max_entries_)) {
+    Erase(std::prev(lru_.end()));
+  }
+}
+
+}  // namespace http
+}  // namespace cppboot
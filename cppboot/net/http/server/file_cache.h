@@ -0,0 +1,100 @@
+#ifndef CPPBOOT_NET_HTTP_SERVER_FILE_CACHE_H_
+#define CPPBOOT_NET_HTTP_SERVER_FILE_CACHE_H_
+
+#include <sys/stat.h>
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cppboot/net/http/header.h"
+
+namespace cppboot {
+namespace http {
+
+/// A file loaded into memory together with its prebuilt response headers.
+struct CachedFile {
+  std::string path;
+  std::shared_ptr<const std::string> content;
+
+  /// Content coding the entry was produced for, e.g. "gzip", empty for the
+  /// file as is. Compressed variants are cached next to the plain file.
+  std::string encoding;
+
+  std::string etag;
+  std::string last_modified;
+
+  /// Content-Length, Content-Type, ETag, Last-Modified and so on.
+  Headers headers;
+
+  /// Identity of the file on disk, a change means the entry is stale.
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  time_t mtime;
+
+  bool IsFresh(const struct stat& st) const noexcept {
+    return dev == st.st_dev && ino == st.st_ino && size == st.st_size &&
+           mtime == st.st_mtime;
+  }
+};
+
+typedef std::shared_ptr<const CachedFile> CachedFilePtr;
+
+/// LRU cache of file contents bounded by total bytes and entry count.
+class FileCache {
+ public:
+  enum {
+    kDefaultMaxBytes = 64 * 1024 * 1024,
+    kDefaultMaxEntries = 1024,
+    kDefaultMaxFileSize = 1024 * 1024,
+  };
+
+  FileCache(const FileCache&) = delete;
+  FileCache& operator=(const FileCache&) = delete;
+
+  FileCache();
+
+  /// Return the `encoding` variant of `path` if it still matches `st`, a
+  /// stale entry is dropped.
+  CachedFilePtr Get(const std::string& path, const struct stat& st,
+                    const std::string& encoding = std::string());
+
+  /// Insert or replace an entry, evicting the least recently used ones. Files
+  /// larger than max_file_size() are not cached.
+  void Put(const CachedFilePtr& file);
+
+  void Clear();
+
+  /// May be called from any thread, like the rest.
+  size_t bytes() const;
+  size_t entries() const;
+  size_t max_file_size() const;
+
+  /// Limits of the cache, a zero `max_bytes` disables caching.
+  void set_limits(size_t max_bytes, size_t max_entries, size_t max_file_size);
+
+ private:
+  typedef std::list<CachedFilePtr> List;
+
+  void Erase(List::iterator it);
+  void Evict();
+
+  mutable std::mutex mutex_;
+  size_t max_bytes_;
+  size_t max_entries_;
+  size_t max_file_size_;
+  size_t bytes_;
+
+  /// Most recently used first.
+  List lru_;
+  std::unordered_map<std::string, List::iterator> index_;
+};
+
+}  // namespace http
+}  // namespace cppboot
+
+#endif  // CPPBOOT_NET_HTTP_SERVER_FILE_CACHE_H_
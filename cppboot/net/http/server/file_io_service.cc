@@ -0,0 +1,57 @@
+#include "cppboot/net/http/server/file_io_service.h"
+
+namespace cppboot {
+namespace http {
+
+FileIoService::FileIoService(size_t threads, size_t max_pending)
+    : stopped_(false), max_pending_(max_pending) {
+  if (threads == 0) threads = 1;
+  for (size_t i = 0; i < threads; i++) {
+    threads_.emplace_back(&FileIoService::Run, this);
+  }
+}
+
+FileIoService::~FileIoService() {
+  Stop();
+  for (auto& t : threads_) t.join();
+}
+
+bool FileIoService::Post(Task task) {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (stopped_ || tasks_.size() >= max_pending_) return false;
+    tasks_.push_back(std::move(task));
+  }
+  cond_.notify_one();
+  return true;
+}
+
+void FileIoService::Stop() {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    stopped_ = true;
+  }
+  cond_.notify_all();
+}
+
+size_t FileIoService::pending() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return tasks_.size();
+}
+
+void FileIoService::Run() {
+  for (;;) {
+    Task task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [this] { return stopped_ || !tasks_.empty(); });
+      if (tasks_.empty()) return;  // stopped and drained
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+}  // namespace http
+}  // namespace cppboot
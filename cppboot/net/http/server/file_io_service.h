@@ -0,0 +1,59 @@
+#ifndef CPPBOOT_NET_HTTP_SERVER_FILE_IO_SERVICE_H_
+#define CPPBOOT_NET_HTTP_SERVER_FILE_IO_SERVICE_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cppboot {
+namespace http {
+
+/// Bounded thread pool for blocking disk I/O, so a cold read on slow storage
+/// never stalls the event loop of a connection. Tasks complete their work
+/// back on the connection's thread, see Response::Defer().
+class FileIoService {
+ public:
+  typedef std::function<void()> Task;
+
+  enum {
+    kDefaultThreads = 4,
+    kDefaultMaxPending = 1024,
+  };
+
+  FileIoService(const FileIoService&) = delete;
+  FileIoService& operator=(const FileIoService&) = delete;
+
+  explicit FileIoService(size_t threads = kDefaultThreads,
+                         size_t max_pending = kDefaultMaxPending);
+
+  /// Stop() and wait for the workers.
+  ~FileIoService();
+
+  /// Queue `task` to run on a worker, returns false if the queue is full or
+  /// the service is stopped.
+  bool Post(Task task);
+
+  /// Refuse new tasks, the queued ones still run.
+  void Stop();
+
+  size_t pending() const;
+
+ private:
+  void Run();
+
+  mutable std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<Task> tasks_;  // GUARDED_BY(mutex_)
+  bool stopped_;            // GUARDED_BY(mutex_)
+  size_t max_pending_;
+
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace http
+}  // namespace cppboot
+
+#endif  // CPPBOOT_NET_HTTP_SERVER_FILE_IO_SERVICE_H_
@@ -1,11 +1,20 @@
 #include "cppboot/net/http/server/file_server.h"
 
-#include <fstream>
-#include <sstream>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <string>
+#include <vector>
 
+#include "cppboot/base/fmt.h"
+#include "cppboot/base/str_util.h"
+#include "cppboot/net/http/compress.h"
+#include "cppboot/net/http/date.h"
 #include "cppboot/net/http/request.h"
 #include "cppboot/net/http/response.h"
+#include "cppboot/net/http/server/file_io_service.h"
 
 namespace cppboot {
 namespace http {
@@ -16,8 +25,15 @@ static const struct mapping {
   const char* extension;
   const char* mime_type;
 } mappings[] = {
-    {"gif", "image/gif"},  {"htm", "text/html"}, {"html", "text/html"},
-    {"jpg", "image/jpeg"}, {"png", "image/png"},
+    {"gif", "image/gif"},
+    {"htm", "text/html"},
+    {"html", "text/html"},
+    {"jpg", "image/jpeg"},
+    {"png", "image/png"},
+    {"css", "text/css"},
+    {"js", "application/javascript"},
+    {"json", "application/json"},
+    {"svg", "image/svg+xml"},
 };
 
 std::string ExtensionToType(const std::string& extension) {
@@ -30,6 +46,276 @@ std::string ExtensionToType(const std::string& extension) {
   return "text/plain";
 }
 
+std::shared_ptr<CachedFile> NewCachedFile(const std::string& path,
+                                          const struct stat& st,
+                                          const std::string& content_type,
+                                          ContentEncoding encoding) {
+  std::shared_ptr<CachedFile> file(new CachedFile());
+  file->path = path;
+  if (encoding != kIdentity) file->encoding = EncodingName(encoding);
+  file->etag = cppboot::format("\"{:x}-{:x}\"", (int64_t)st.st_mtime,
+                               (int64_t)st.st_size);
+  file->last_modified = FormatHttpDate(st.st_mtime);
+  file->headers.Add(kContentLength, std::to_string(st.st_size));
+  file->headers.Add(kContentType, content_type);
+  file->headers.Add(kETag, file->etag);
+  file->headers.Add(kLastModified, file->last_modified);
+  if (encoding != kIdentity) {
+    file->headers.Add(kContentEncoding, file->encoding);
+  } else {
+    file->headers.Add(kAcceptRanges, "bytes");
+  }
+  if (encoding != kIdentity || IsCompressible(content_type)) {
+    file->headers.Add(kVary, "Accept-Encoding");
+  }
+  file->dev = st.st_dev;
+  file->ino = st.st_ino;
+  file->size = st.st_size;
+  file->mtime = st.st_mtime;
+  return file;
+}
+
+CachedFilePtr LoadFile(const std::string& path, const std::string& full_path,
+                       const std::string& content_type,
+                       ContentEncoding encoding) {
+  int fd = ::open(full_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return nullptr;
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    ::close(fd);
+    return nullptr;
+  }
+
+  std::shared_ptr<std::string> content(new std::string(st.st_size, '\0'));
+  size_t done = 0;
+  while (done < content->size()) {
+    ssize_t n = ::read(fd, &(*content)[done], content->size() - done);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    done += n;
+  }
+  ::close(fd);
+  if (done != content->size()) return nullptr;  // changed while reading
+
+  auto file = NewCachedFile(path, st, content_type, encoding);
+  file->content = content;
+  return file;
+}
+
+/// The `encoding` variant of the plain `file`. If compression does not pay
+/// off the variant is the plain file, so it is not compressed again.
+CachedFilePtr CompressFile(const CachedFile& file, ContentEncoding encoding,
+                           int level) {
+  std::shared_ptr<CachedFile> variant(new CachedFile(file));
+  variant->encoding = EncodingName(encoding);
+
+  std::string out;
+  if (!Compress(encoding, *file.content, level, &out) ||
+      out.size() >= file.content->size()) {
+    return variant;
+  }
+
+  variant->content = std::make_shared<const std::string>(std::move(out));
+  variant->etag = file.etag;
+  variant->etag.insert(variant->etag.size() - 1, "-" + variant->encoding);
+  variant->headers.Set(kContentLength,
+                       std::to_string(variant->content->size()));
+  variant->headers.Set(kETag, variant->etag);
+  variant->headers.Del(kAcceptRanges);
+  variant->headers.Add(kContentEncoding, variant->encoding);
+  return variant;
+}
+
+bool EtagMatch(string_view header, const std::string& etag) {
+  if (StrTrim(header) == "*") return true;
+
+  while (!header.empty()) {
+    size_t comma = header.find(',');
+    auto tag = StrTrim(header.substr(0, comma));
+    if (StartsWith(tag, "W/")) tag.remove_prefix(2);  // weak comparison
+    if (tag == etag) return true;
+    if (comma == string_view::npos) break;
+    header.remove_prefix(comma + 1);
+  }
+  return false;
+}
+
+/// Ranges are served for plain files only, not for compressed ones.
+bool AcceptsRanges(const CachedFile& file) {
+  return file.headers.Has(kAcceptRanges);
+}
+
+bool IsNotModified(const Request& req, const CachedFile& file) {
+  auto if_none_match = req.header("If-None-Match");
+  if (!if_none_match.empty()) return EtagMatch(if_none_match, file.etag);
+
+  time_t since;
+  auto if_modified_since = req.header("If-Modified-Since");
+  if (ParseHttpDate(if_modified_since, &since)) return file.mtime <= since;
+  return false;
+}
+
+struct ByteRange {
+  off_t offset;
+  size_t length;
+};
+
+/// Parse the decimal offset of a byte range, an empty string yields -1.
+bool ParseOffset(string_view s, off_t* offset) {
+  if (s.empty() || s.length() > 18) {
+    *offset = -1;
+    return s.empty();
+  }
+
+  *offset = 0;
+  for (char c : s) {
+    if (c < '0' || c > '9') return false;
+    *offset = *offset * 10 + (c - '0');
+  }
+  return true;
+}
+
+/// Parse a "bytes=" Range header against a file of `size` bytes. Returns
+/// false if no range is satisfiable. A malformed header leaves `ranges` empty,
+/// meaning the whole file is sent.
+bool ParseRanges(string_view spec, off_t size, std::vector<ByteRange>* ranges) {
+  static const size_t kMaxRanges = 16;
+  static const string_view kUnit = "bytes=";
+
+  ranges->clear();
+  if (!StartsWith(spec, kUnit)) return true;
+  spec.remove_prefix(kUnit.length());
+
+  bool unsatisfiable = false;
+  while (!spec.empty()) {
+    size_t comma = spec.find(',');
+    auto r = StrTrim(spec.substr(0, comma));
+    spec.remove_prefix(comma == string_view::npos ? spec.length() : comma + 1);
+    if (r.empty()) continue;
+
+    size_t dash = r.find('-');
+    if (dash == string_view::npos) {
+      ranges->clear();
+      return true;
+    }
+
+    off_t first, last;
+    if (!ParseOffset(r.substr(0, dash), &first) ||
+        !ParseOffset(r.substr(dash + 1), &last)) {
+      ranges->clear();
+      return true;
+    }
+
+    if (first < 0) {
+      // Suffix range, the last `last` bytes.
+      if (last <= 0) {
+        unsatisfiable = true;
+        continue;
+      }
+      first = last < size ? size - last : 0;
+      last = size - 1;
+    } else if (last < 0 || last >= size) {
+      last = size - 1;
+    } else if (last < first) {
+      ranges->clear();
+      return true;
+    }
+
+    if (first >= size) {
+      unsatisfiable = true;
+      continue;
+    }
+
+    ByteRange range = {first, static_cast<size_t>(last - first + 1)};
+    ranges->push_back(range);
+    if (ranges->size() > kMaxRanges) {
+      ranges->clear();
+      return true;
+    }
+  }
+
+  return !ranges->empty() || !unsatisfiable;
+}
+
+/// If-Range asks for the ranges only if the representation is unchanged.
+bool IfRangeMatch(const Request& req, const CachedFile& file) {
+  auto if_range = req.header("If-Range");
+  if (if_range.empty()) return true;
+
+  time_t t;
+  if (ParseHttpDate(if_range, &t)) return t == file.mtime;
+  return if_range == file.etag;
+}
+
+std::string ContentRange(const ByteRange& range, off_t size) {
+  return cppboot::format("bytes {}-{}/{}", (int64_t)range.offset,
+                         (int64_t)(range.offset + range.length - 1),
+                         (int64_t)size);
+}
+
+/// Serve `file` from the memory it was embedded in.
+void ServeEmbedded(const Request& req, const EmbeddedFile& file,
+                   const std::string& content_type, Response* rep) {
+  string_view body = file.data;
+  ContentEncoding encoding = kIdentity;
+  auto accept = req.header("Accept-Encoding");
+  if (!accept.empty()) {
+    if (!file.brotli.empty() && AcceptsEncoding(accept, kBrotli)) {
+      body = file.brotli;
+      encoding = kBrotli;
+    } else if (!file.gzip.empty() && AcceptsEncoding(accept, kGzip)) {
+      body = file.gzip;
+      encoding = kGzip;
+    }
+  }
+
+  std::string etag = file.etag.str();
+  if (encoding != kIdentity) {
+    etag.insert(etag.size() - 1, std::string("-") + EncodingName(encoding));
+  }
+
+  rep->content.clear();
+  rep->shared_content.reset();
+  rep->file_body.reset();
+  rep->headers.clear();
+  auto if_none_match = req.header("If-None-Match");
+  if (!if_none_match.empty() && EtagMatch(if_none_match, etag)) {
+    rep->status = Response::not_modified;
+    rep->static_content = string_view();
+    rep->headers.Add(kETag, etag);
+    return;
+  }
+
+  std::vector<ByteRange> ranges;
+  auto range = req.header("Range");
+  if (!range.empty() && encoding == kIdentity &&
+      req.header("If-Range").empty() &&
+      !ParseRanges(range, body.size(), &ranges)) {
+    *rep = Response::stock_reply(Response::range_not_satisfiable);
+    rep->headers.Add(kContentRange,
+                     cppboot::format("bytes */{}", body.size()));
+    return;
+  }
+
+  rep->headers.Add(kContentType, content_type);
+  rep->headers.Add(kETag, etag);
+  if (encoding != kIdentity) {
+    rep->headers.Add(kContentEncoding, EncodingName(encoding));
+  }
+  if (!file.gzip.empty() || !file.brotli.empty()) {
+    rep->headers.Add(kVary, "Accept-Encoding");
+  }
+  if (ranges.size() == 1) {
+    rep->status = Response::partial_content;
+    rep->static_content = body.substr(ranges[0].offset, ranges[0].length);
+    rep->headers.Add(kContentRange, ContentRange(ranges[0], body.size()));
+    return;
+  }
+  rep->status = Response::ok;
+  rep->static_content = body;
+}
+
 }  // namespace
 
 void FileServer::ServeHttp(const Request& req, Response* rep) {
@@ -58,32 +344,224 @@ void FileServer::ServeHttp(const Request& req, Response* rep) {
 
   auto it = files_.find(request_path);
   if (it != files_.end()) {
-    rep->content = it->second;
+    rep->status = Response::ok;
+    rep->shared_content = it->second;
+    rep->headers.clear();
+    rep->headers.Add(kContentType, ExtensionToType(extension));
+    return;
+  }
+
+  for (auto& files : embedded_) {
+    auto file = files.Find(string_view(request_path).substr(1));
+    if (file) {
+      ServeEmbedded(req, *file, ExtensionToType(extension), rep);
+      return;
+    }
+  }
+
+  Target target;
+  target.path = request_path;
+  target.full_path = root_ + request_path;
+  if (::stat(target.full_path.c_str(), &target.st) != 0 ||
+      !S_ISREG(target.st.st_mode)) {
+    *rep = Response::stock_reply(Response::not_found);
+    return;
+  }
+  target.content_type = ExtensionToType(extension);
+  target.encoding = kIdentity;
+  target.compress = kIdentity;
+
+  // A precompressed sibling like "app.js.br" costs nothing to serve, it is
+  // used unless it is older than the file itself.
+  auto accept = req.header("Accept-Encoding");
+  for (auto encoding : {kBrotli, kGzip}) {
+    if (accept.empty()) break;
+    if (!AcceptsEncoding(accept, encoding)) continue;
+
+    struct stat st;
+    std::string sibling = target.full_path + EncodingSuffix(encoding);
+    if (::stat(sibling.c_str(), &st) == 0 && S_ISREG(st.st_mode) &&
+        st.st_mtime >= target.st.st_mtime) {
+      target.path += EncodingSuffix(encoding);
+      target.full_path = sibling;
+      target.st = st;
+      target.encoding = encoding;
+      break;
+    }
+  }
+
+  // Otherwise text files are compressed once and cached with the plain one.
+  size_t size = target.st.st_size;
+  if (target.encoding == kIdentity && compress_options_.enabled &&
+      size >= compress_options_.min_size &&
+      size <= cache_.max_file_size() && IsCompressible(target.content_type)) {
+    target.compress = PreferredEncoding(accept);
+  }
+
+  // Small files are served from the cache as long as the file on disk is
+  // unchanged, large ones are streamed with sendfile(2).
+  CachedFilePtr file;
+  if (size <= cache_.max_file_size()) {
+    file = cache_.Get(target.path, target.st,
+                      target.compress == kIdentity
+                          ? std::string()
+                          : EncodingName(target.compress));
+    if (!file && io_service_) {
+      LoadAsync(req, target, rep);
+      return;
+    }
+    if (!file) {
+      file = Load(target);
+      if (!file) {
+        *rep = Response::stock_reply(Response::not_found);
+        return;
+      }
+    }
   } else {
-    // Open the file to send back.
-    std::string full_path = root_ + request_path;
-    std::ifstream is(full_path.c_str(), std::ios::in | std::ios::binary);
-    if (!is) {
+    file = NewCachedFile(target.path, target.st, target.content_type,
+                         target.encoding);
+  }
+
+  ServeFile(req, file, target, rep);
+}
+
+CachedFilePtr FileServer::Load(const Target& target) {
+  CachedFilePtr file = cache_.Get(target.path, target.st);
+  if (!file) {
+    file = LoadFile(target.path, target.full_path, target.content_type,
+                    target.encoding);
+    if (!file) return nullptr;
+    cache_.Put(file);
+  }
+  if (target.compress == kIdentity) return file;
+
+  int level = target.compress == kGzip ? compress_options_.gzip_level
+                                       : compress_options_.brotli_quality;
+  auto variant = CompressFile(*file, target.compress, level);
+  cache_.Put(variant);
+  return variant;
+}
+
+void FileServer::ServeFile(const Request& req, const CachedFilePtr& file,
+                           const Target& target, Response* rep) {
+  const std::string& content_type = target.content_type;
+  if (IsNotModified(req, *file)) {
+    rep->status = Response::not_modified;
+    rep->content.clear();
+    rep->shared_content.reset();
+    rep->static_content = string_view();
+    rep->file_body.reset();
+    rep->headers.clear();
+    rep->headers.Add(kETag, file->etag);
+    rep->headers.Add(kLastModified, file->last_modified);
+    return;
+  }
+
+  std::vector<ByteRange> ranges;
+  auto range = req.header("Range");
+  if (!range.empty() && AcceptsRanges(*file) && IfRangeMatch(req, *file) &&
+      !ParseRanges(range, file->size, &ranges)) {
+    *rep = Response::stock_reply(Response::range_not_satisfiable);
+    rep->headers.Add(kContentRange,
+                     cppboot::format("bytes */{}", (int64_t)file->size));
+    return;
+  }
+
+  FileBodyPtr body;
+  if (!file->content) {
+    int fd = ::open(target.full_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
       *rep = Response::stock_reply(Response::not_found);
       return;
     }
-    char buf[512];
-    while (is.read(buf, sizeof(buf)).gcount() > 0)
-      rep->content.append(buf, is.gcount());
+    body = std::make_shared<FileBody>(fd);
+    body->set_io_service(io_service_);
   }
 
   // Fill out the reply to be sent to the client.
-  rep->status = Response::ok;
-  rep->headers.resize(2);
-  rep->headers[0].name = "Content-Length";
-  rep->headers[0].value = std::to_string(rep->content.size());
-  rep->headers[1].name = "Content-Type";
-  rep->headers[1].value = ExtensionToType(extension);
+  rep->content.clear();
+  rep->shared_content.reset();
+  rep->static_content = string_view();
+  rep->file_body = body;
+
+  if (ranges.empty()) {
+    rep->status = Response::ok;
+    rep->headers = file->headers;
+    if (body)
+      body->AddPart(std::string(), 0, file->size);
+    else
+      rep->shared_content = file->content;
+    return;
+  }
+
+  rep->status = Response::partial_content;
+  rep->headers.clear();
+  rep->headers.Add(kContentType, content_type);
+  rep->headers.Add(kETag, file->etag);
+  rep->headers.Add(kLastModified, file->last_modified);
+  rep->headers.Add(kAcceptRanges, "bytes");
+
+  if (ranges.size() == 1) {
+    rep->headers.Add(kContentLength, std::to_string(ranges[0].length));
+    rep->headers.Add(kContentRange, ContentRange(ranges[0], file->size));
+    if (body)
+      body->AddPart(std::string(), ranges[0].offset, ranges[0].length);
+    else
+      rep->content = file->content->substr(ranges[0].offset, ranges[0].length);
+    return;
+  }
+
+  // multipart/byteranges, every range gets its own part header.
+  std::string boundary = cppboot::format(
+      "CPPBOOT{:x}{:x}", (int64_t)file->mtime, (uintptr_t)rep);
+  rep->headers.Set(kContentType, "multipart/byteranges; boundary=" + boundary);
+
+  size_t length = 0;
+  for (auto& i : ranges) {
+    std::string head = cppboot::format(
+        "\r\n--{}\r\nContent-Type: {}\r\nContent-Range: {}\r\n\r\n", boundary,
+        content_type, ContentRange(i, file->size));
+    length += head.length() + i.length;
+    if (body) {
+      body->AddPart(head, i.offset, i.length);
+    } else {
+      rep->content += head;
+      rep->content.append(*file->content, i.offset, i.length);
+    }
+  }
+
+  std::string tail = "\r\n--" + boundary + "--\r\n";
+  length += tail.length();
+  if (body)
+    body->set_tail(tail);
+  else
+    rep->content += tail;
+  rep->headers.Add(kContentLength, std::to_string(length));
+}
+
+void FileServer::LoadAsync(const Request& req, const Target& target,
+                           Response* rep) {
+  auto done = rep->Defer();
+  bool posted = io_service_->Post([=, &req]() {
+    CachedFilePtr file = Load(target);
+    if (file) {
+      ServeFile(req, file, target, rep);
+    } else {
+      *rep = Response::stock_reply(Response::not_found);
+    }
+    done();
+  });
+
+  if (!posted) {
+    *rep = Response::stock_reply(Response::service_unavailable);
+    rep->headers.Add(kRetryAfter, "1");
+    done();
+  }
 }
 
 void FileServer::AddFile(const std::string& path, const std::string& content) {
-  files_[path] = content;
+  files_[path] = std::make_shared<const std::string>(content);
 }
 
 }  // namespace http
-}  // namespace cppboot
\ No newline at end of file
+}  // namespace cppboot
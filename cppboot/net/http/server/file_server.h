@@ -3,6 +3,12 @@
 
 #include <string>
 #include <map>
+#include <memory>
+#include <vector>
+
+#include "cppboot/base/embed.h"
+#include "cppboot/net/http/compress.h"
+#include "cppboot/net/http/server/file_cache.h"
 
 namespace cppboot {
 namespace http {
@@ -10,23 +16,79 @@ namespace http {
 struct Request;
 struct Response;
 
+class FileIoService;
+
 class FileServer final {
  public:
-  FileServer() noexcept {}
-  FileServer(const std::string& root) noexcept : root_(root) {}
+  FileServer() noexcept : io_service_(nullptr) {}
+  FileServer(const std::string& root) noexcept
+      : root_(root), io_service_(nullptr) {}
   ~FileServer() noexcept {}
 
   void ServeHttp(const Request& req, Response* rep);
 
   void AddFile(const std::string& path, const std::string& content);
 
+  /// Serve files compiled into the program, e.g. with
+  ///
+  ///   cppboot_embed_files(server site_assets BASE_DIR www COMPRESS FILES ...)
+  ///
+  /// and AddEmbedded(cppboot::embedded::site_assets()). They are found before
+  /// the files under root() and sent straight from read-only memory, with
+  /// the ETags and compressed variants computed by the build. A single byte
+  /// range is served from the plain file, other Range requests get all of it.
+  void AddEmbedded(const EmbeddedFiles& files) { embedded_.push_back(files); }
+
   std::string root() const noexcept { return root_; }
-  void set_root(const std::string& root) noexcept { root_ = root; }
+  void set_root(const std::string& root) noexcept {
+    root_ = root;
+    cache_.Clear();
+  }
+
+  /// Files read from root() are kept here, see FileCache::set_limits().
+  FileCache& cache() noexcept { return cache_; }
+
+  /// Read files on `io` instead of the connection's thread, so a slow disk
+  /// never blocks the event loop. Cache misses are completed through
+  /// Response::Defer() and large files are prefetched before sendfile(2).
+  void set_io_service(FileIoService* io) noexcept { io_service_ = io; }
+
+  /// Precompressed ".br" and ".gz" siblings are always served to clients
+  /// accepting them, other text files are compressed on the fly according to
+  /// `options` and cached.
+  const CompressOptions& compress_options() const noexcept {
+    return compress_options_;
+  }
+  void set_compress_options(const CompressOptions& options) {
+    compress_options_ = options;
+    cache_.Clear();
+  }
 
  private:
+  /// The file a request resolved to.
+  struct Target {
+    std::string path;  // relative to root(), the cache key
+    std::string full_path;
+    struct stat st;
+    std::string content_type;
+    ContentEncoding encoding;  // of the file on disk
+    ContentEncoding compress;  // to apply on the fly
+  };
+
+  /// Read the target through the cache, may be called from any thread.
+  CachedFilePtr Load(const Target& target);
+  void LoadAsync(const Request& req, const Target& target, Response* rep);
+  void ServeFile(const Request& req, const CachedFilePtr& file,
+                 const Target& target, Response* rep);
+
   std::string root_;
+  FileIoService* io_service_;
+  CompressOptions compress_options_;
+
+  std::map<std::string, std::shared_ptr<const std::string>> files_;
+  std::vector<EmbeddedFiles> embedded_;
 
-  std::map<std::string, std::string> files_;
+  FileCache cache_;
 };
 
 }  // namespace http
@@ -3,6 +3,7 @@
 #include "cppboot/base/fmt.h"
 #include "cppboot/base/status.h"
 
+#include "cppboot/net/http/server/file_io_service.h"
 #include "cppboot/net/http/server/file_server.h"
 #include "cppboot/net/http/server.h"
 
@@ -13,7 +14,9 @@ int main(int argc, char** argv) {
     return -1;
   }
 
+  cppboot::http::FileIoService io;
   cppboot::http::FileServer fileserver(argv[2]);
+  fileserver.set_io_service(&io);
   cppboot::http::Server server;
   server.Handle("/", [&](const cppboot::http::Request& req,
                          cppboot::http::Response* resp) {
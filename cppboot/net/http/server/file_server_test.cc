@@ -1,9 +1,17 @@
 #include "gmock/gmock.h"
 
+#include <future>
+
 #include "cppboot/base/fs.h"
+#if CPPBOOT_TEST_EMBED
+#include "file_server_test_assets.h"
+#endif
 
+#include "cppboot/net/http/compress.h"
+#include "cppboot/net/http/date.h"
 #include "cppboot/net/http/request.h"
 #include "cppboot/net/http/response.h"
+#include "cppboot/net/http/server/file_io_service.h"
 #include "cppboot/net/http/server/file_server.h"
 
 namespace {
@@ -32,8 +40,8 @@ TEST_F(FileServerText, should_serve_index_html) {
   fs.ServeHttp(req, &resp);
   ASSERT_EQ(resp.status, resp.ok);
   ASSERT_EQ(resp.header("Content-Type"), "text/html");
-  ASSERT_GT(resp.content.length(), 0);
-  ASSERT_EQ(resp.content.length(),
+  ASSERT_GT(resp.body().length(), 0);
+  ASSERT_EQ(resp.body().length(),
             cppboot::FileSize(fs.root() + "/dir1/dir2/index.html"));
 }
 
@@ -42,7 +50,7 @@ TEST_F(FileServerText, should_serve_txt) {
   fs.ServeHttp(req, &resp);
   ASSERT_EQ(resp.status, resp.ok);
   ASSERT_EQ(resp.header("Content-Type"), "text/plain");
-  ASSERT_EQ(resp.content, "Test Txt File");
+  ASSERT_EQ(resp.body(), "Test Txt File");
 }
 
 TEST_F(FileServerText, shoud_server_memory_file) {
@@ -52,7 +60,447 @@ TEST_F(FileServerText, shoud_server_memory_file) {
   fs.ServeHttp(req, &resp);
   ASSERT_EQ(resp.status, resp.ok);
   ASSERT_EQ(resp.header("Content-Type"), "text/plain");
-  ASSERT_EQ(resp.content, "I'am file");
+  ASSERT_EQ(resp.body(), "I'am file");
+}
+
+TEST_F(FileServerText, should_serve_from_cache) {
+  req.subpath = "/dir1/dir2/1.txt";
+  fs.ServeHttp(req, &resp);
+  ASSERT_EQ(fs.cache().entries(), 1);
+
+  cppboot::http::Response resp2;
+  fs.ServeHttp(req, &resp2);
+  ASSERT_EQ(resp2.status, resp2.ok);
+  ASSERT_EQ(resp2.shared_content.get(), resp.shared_content.get());
+  ASSERT_EQ(resp2.header("ETag"), resp.header("ETag"));
+  ASSERT_FALSE(resp2.header("Last-Modified").empty());
+}
+
+TEST_F(FileServerText, should_revalidate_by_etag) {
+  req.subpath = "/dir1/dir2/1.txt";
+  fs.ServeHttp(req, &resp);
+  auto etag = resp.header("ETag").str();
+  ASSERT_FALSE(etag.empty());
+
+  cppboot::http::Response resp2;
+  req.set_header("If-None-Match", "\"other\", W/" + etag);
+  fs.ServeHttp(req, &resp2);
+  ASSERT_EQ(resp2.status, resp2.not_modified);
+  ASSERT_EQ(resp2.body(), "");
+  ASSERT_EQ(resp2.header("ETag"), etag);
+
+  cppboot::http::Response resp3;
+  req.set_header("If-None-Match", "\"other\"");
+  fs.ServeHttp(req, &resp3);
+  ASSERT_EQ(resp3.status, resp3.ok);
+}
+
+TEST_F(FileServerText, should_revalidate_by_date) {
+  req.subpath = "/dir1/dir2/1.txt";
+  fs.ServeHttp(req, &resp);
+  time_t mtime;
+  ASSERT_TRUE(
+      cppboot::http::ParseHttpDate(resp.header("Last-Modified"), &mtime));
+
+  cppboot::http::Response resp2;
+  req.set_header("If-Modified-Since", cppboot::http::FormatHttpDate(mtime));
+  fs.ServeHttp(req, &resp2);
+  ASSERT_EQ(resp2.status, resp2.not_modified);
+
+  cppboot::http::Response resp3;
+  req.set_header("If-Modified-Since", cppboot::http::FormatHttpDate(mtime - 1));
+  fs.ServeHttp(req, &resp3);
+  ASSERT_EQ(resp3.status, resp3.ok);
+}
+
+TEST_F(FileServerText, should_serve_single_range) {
+  req.subpath = "/dir1/dir2/1.txt";
+  req.set_header("Range", "bytes=0-3");
+  fs.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.status, resp.partial_content);
+  ASSERT_EQ(resp.body(), "Test");
+  ASSERT_EQ(resp.header("Content-Length"), "4");
+  ASSERT_EQ(resp.header("Content-Range"), "bytes 0-3/13");
+
+  cppboot::http::Response resp2;
+  req.set_header("Range", "bytes=-4");
+  fs.ServeHttp(req, &resp2);
+  ASSERT_EQ(resp2.body(), "File");
+  ASSERT_EQ(resp2.header("Content-Range"), "bytes 9-12/13");
+
+  cppboot::http::Response resp3;
+  req.set_header("Range", "bytes=9-100");
+  fs.ServeHttp(req, &resp3);
+  ASSERT_EQ(resp3.body(), "File");
+}
+
+TEST_F(FileServerText, should_serve_multiple_ranges) {
+  req.subpath = "/dir1/dir2/1.txt";
+  req.set_header("Range", "bytes=0-3, 9-");
+  fs.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.status, resp.partial_content);
+
+  auto type = resp.header("Content-Type").str();
+  auto pos = type.find("boundary=");
+  ASSERT_NE(pos, std::string::npos);
+  auto boundary = type.substr(pos + 9);
+
+  std::string expected = "\r\n--" + boundary +
+                         "\r\nContent-Type: text/plain"
+                         "\r\nContent-Range: bytes 0-3/13\r\n\r\nTest"
+                         "\r\n--" +
+                         boundary +
+                         "\r\nContent-Type: text/plain"
+                         "\r\nContent-Range: bytes 9-12/13\r\n\r\nFile"
+                         "\r\n--" +
+                         boundary + "--\r\n";
+  ASSERT_EQ(resp.body(), expected);
+  ASSERT_EQ(resp.header("Content-Length"), std::to_string(expected.size()));
+}
+
+TEST_F(FileServerText, should_reject_unsatisfiable_range) {
+  req.subpath = "/dir1/dir2/1.txt";
+  req.set_header("Range", "bytes=13-");
+  fs.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.status, resp.range_not_satisfiable);
+  ASSERT_EQ(resp.header("Content-Range"), "bytes */13");
+
+  // Malformed ranges are ignored.
+  cppboot::http::Response resp2;
+  req.set_header("Range", "bytes=3-1");
+  fs.ServeHttp(req, &resp2);
+  ASSERT_EQ(resp2.status, resp2.ok);
+  ASSERT_EQ(resp2.body(), "Test Txt File");
+
+  // Also when only a later item is.
+  cppboot::http::Response resp3;
+  req.set_header("Range", "bytes=0-1,junk");
+  fs.ServeHttp(req, &resp3);
+  ASSERT_EQ(resp3.status, resp3.ok);
+  ASSERT_EQ(resp3.body(), "Test Txt File");
+}
+
+TEST_F(FileServerText, should_ignore_range_if_changed) {
+  req.subpath = "/dir1/dir2/1.txt";
+  req.set_header("Range", "bytes=0-3");
+  req.set_header("If-Range", "\"stale\"");
+  fs.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.status, resp.ok);
+  ASSERT_EQ(resp.body(), "Test Txt File");
+
+  cppboot::http::Response resp2;
+  req.set_header("If-Range", resp.header("ETag"));
+  fs.ServeHttp(req, &resp2);
+  ASSERT_EQ(resp2.status, resp2.partial_content);
+}
+
+TEST_F(FileServerText, should_stream_large_file) {
+  fs.cache().set_limits(1024, 16, 4);
+
+  req.subpath = "/dir1/dir2/1.txt";
+  fs.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.status, resp.ok);
+  ASSERT_EQ(resp.body(), "");
+  ASSERT_EQ(resp.header("Content-Length"), "13");
+  ASSERT_TRUE(resp.file_body);
+  ASSERT_EQ(resp.file_body->size(), 13);
+  ASSERT_EQ(fs.cache().entries(), 0);
+
+  cppboot::http::Response resp2;
+  req.set_header("Range", "bytes=5-7,9-");
+  fs.ServeHttp(req, &resp2);
+  ASSERT_EQ(resp2.status, resp2.partial_content);
+  ASSERT_TRUE(resp2.file_body);
+  ASSERT_EQ(resp2.file_body->parts().size(), 2);
+  ASSERT_EQ(resp2.file_body->parts()[0].offset, 5);
+  ASSERT_EQ(resp2.file_body->parts()[0].length, 3);
+  ASSERT_EQ(resp2.file_body->parts()[1].offset, 9);
+  ASSERT_EQ(resp2.file_body->parts()[1].length, 4);
+  ASSERT_EQ(resp2.header("Content-Length"),
+            std::to_string(resp2.file_body->size()));
+}
+
+TEST_F(FileServerText, should_load_on_io_service) {
+  cppboot::http::FileIoService io(1);
+  fs.set_io_service(&io);
+
+  std::promise<void> done;
+  resp.defer_hook = [&]() -> cppboot::http::Response::DoneFunc {
+    return [&]() { done.set_value(); };
+  };
+  req.subpath = "/dir1/dir2/1.txt";
+  fs.ServeHttp(req, &resp);
+  done.get_future().wait();
+  ASSERT_EQ(resp.status, resp.ok);
+  ASSERT_EQ(resp.body(), "Test Txt File");
+  ASSERT_EQ(fs.cache().entries(), 1);
+
+  // Cache hits are answered inline.
+  cppboot::http::Response resp2;
+  fs.ServeHttp(req, &resp2);
+  ASSERT_EQ(resp2.body(), "Test Txt File");
+}
+
+TEST(FileIoService, should_reject_when_stopped) {
+  cppboot::http::FileIoService io(2, 8);
+  std::promise<int> result;
+  ASSERT_TRUE(io.Post([&]() { result.set_value(42); }));
+  ASSERT_EQ(result.get_future().get(), 42);
+
+  io.Stop();
+  ASSERT_FALSE(io.Post([]() {}));
+  ASSERT_EQ(io.pending(), 0);
+}
+
+TEST(FileServer, should_reload_changed_file) {
+  auto root = cppboot::GetTempPath("cppboot_file_server_test");
+  cppboot::MkdirAll(root);
+  ASSERT_TRUE(cppboot::WriteFile(root + "/a.txt", "old"));
+
+  cppboot::http::FileServer fs(root);
+  cppboot::http::Request req;
+  req.subpath = "/a.txt";
+
+  cppboot::http::Response resp;
+  fs.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.body(), "old");
+
+  ASSERT_TRUE(cppboot::WriteFile(root + "/a.txt", "new content"));
+  cppboot::http::Response resp2;
+  fs.ServeHttp(req, &resp2);
+  ASSERT_EQ(resp2.body(), "new content");
+  ASSERT_EQ(fs.cache().entries(), 1);
+
+  cppboot::RemoveAll(root);
+}
+
+TEST(FileServer, should_serve_precompressed_file) {
+  auto root = cppboot::GetTempPath("cppboot_file_server_precompressed");
+  cppboot::MkdirAll(root);
+  std::string js(4096, 'x');
+  std::string gz;
+  ASSERT_TRUE(cppboot::http::Compress(cppboot::http::kGzip, js, 9, &gz));
+  ASSERT_TRUE(cppboot::WriteFile(root + "/app.js", js));
+  ASSERT_TRUE(cppboot::WriteFile(root + "/app.js.gz", gz));
+
+  cppboot::http::FileServer fs(root);
+  cppboot::http::Request req;
+  req.subpath = "/app.js";
+  req.set_header("Accept-Encoding", "gzip");
+
+  cppboot::http::Response resp;
+  fs.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.status, resp.ok);
+  ASSERT_EQ(resp.header("Content-Encoding"), "gzip");
+  ASSERT_EQ(resp.header("Content-Type"), "application/javascript");
+  ASSERT_EQ(resp.header("Vary"), "Accept-Encoding");
+  ASSERT_EQ(resp.body(), gz);
+
+  // Clients not accepting gzip get the plain file.
+  cppboot::http::Request plain;
+  plain.subpath = "/app.js";
+  cppboot::http::Response resp2;
+  fs.ServeHttp(plain, &resp2);
+  ASSERT_EQ(resp2.header("Content-Encoding"), "");
+  ASSERT_EQ(resp2.body(), js);
+  ASSERT_NE(resp2.header("ETag"), resp.header("ETag"));
+
+  cppboot::RemoveAll(root);
+}
+
+TEST(FileServer, should_compress_and_cache_variant) {
+  auto root = cppboot::GetTempPath("cppboot_file_server_compress");
+  cppboot::MkdirAll(root);
+  std::string css;
+  for (int i = 0; i < 200; i++) css += ".c" + std::to_string(i) + " {}\n";
+  ASSERT_TRUE(cppboot::WriteFile(root + "/a.css", css));
+
+  cppboot::http::FileServer fs(root);
+  cppboot::http::Request req;
+  req.subpath = "/a.css";
+  req.set_header("Accept-Encoding", "gzip");
+  req.set_header("Range", "bytes=0-9");
+
+  cppboot::http::Response resp;
+  fs.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.status, resp.ok);  // no ranges over compressed bodies
+  ASSERT_EQ(resp.header("Content-Encoding"), "gzip");
+  ASSERT_EQ(resp.header("Content-Length"), std::to_string(resp.body().size()));
+  ASSERT_LT(resp.body().size(), css.size());
+  ASSERT_EQ(fs.cache().entries(), 2);  // plain and gzip
+
+  std::string decompressed;
+  ASSERT_TRUE(cppboot::http::Decompress(cppboot::http::kGzip,
+                                        resp.body(), &decompressed));
+  ASSERT_EQ(decompressed, css);
+
+  cppboot::http::Response resp2;
+  fs.ServeHttp(req, &resp2);
+  ASSERT_EQ(resp2.shared_content.get(), resp.shared_content.get());
+
+  cppboot::http::CompressOptions options;
+  options.enabled = false;
+  fs.set_compress_options(options);
+  cppboot::http::Response resp3;
+  fs.ServeHttp(req, &resp3);
+  ASSERT_EQ(resp3.status, resp3.partial_content);
+  ASSERT_EQ(resp3.header("Content-Encoding"), "");
+
+  cppboot::RemoveAll(root);
+}
+
+#if CPPBOOT_TEST_EMBED
+TEST(EmbeddedFiles, should_find_every_file_by_hash) {
+  auto files = cppboot::embedded::file_server_test_assets();
+  ASSERT_EQ(files.size(), 4);
+  for (auto& file : files) {
+    ASSERT_EQ(files.Find(file.name), &file) << file.name;
+  }
+  ASSERT_EQ(files.Find(""), nullptr);
+  ASSERT_EQ(files.Find("index.htm"), nullptr);
+  ASSERT_EQ(files.Find("app.js.gz"), nullptr);  // a variant of app.js
+  ASSERT_EQ(files.Find("img/missing.gif"), nullptr);
+
+  // Sorted and searched in order without the index.
+  cppboot::EmbeddedFiles sorted(files.begin(), files.size());
+  ASSERT_EQ(sorted.Find("css/site.css"), files.Find("css/site.css"));
+  ASSERT_EQ(sorted.Find("css"), nullptr);
+}
+
+struct EmbeddedFileServer : public ::testing::Test {
+  cppboot::http::FileServer fs;
+  cppboot::http::Request req;
+  cppboot::http::Response resp;
+  cppboot::EmbeddedFiles files = cppboot::embedded::file_server_test_assets();
+
+  void SetUp() {
+    fs.set_root(cppboot::PathJoin(cppboot::Dir(__FILE__), "testdata/"));
+    fs.AddEmbedded(files);
+  }
+
+  std::string ReadTestFile(const std::string& name) {
+    return cppboot::ReadFile(
+        cppboot::PathJoin(cppboot::Dir(__FILE__), "testdata/www/" + name));
+  }
+};
+
+TEST_F(EmbeddedFileServer, should_serve_from_memory) {
+  req.subpath = "/";
+  fs.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.status, resp.ok);
+  ASSERT_EQ(resp.header("Content-Type"), "text/html");
+  ASSERT_EQ(resp.header("Content-Encoding"), "");
+  ASSERT_EQ(resp.body(), ReadTestFile("index.html"));
+  // Not copied.
+  ASSERT_EQ(resp.body().data(), files.Find("index.html")->data.data());
+  ASSERT_EQ(fs.cache().entries(), 0);
+
+  auto etag = resp.header("ETag").str();
+  ASSERT_EQ(etag.size(), 18);
+  ASSERT_EQ(etag, files.Find("index.html")->etag);
+
+  cppboot::http::Response resp2;
+  req.set_header("If-None-Match", etag);
+  fs.ServeHttp(req, &resp2);
+  ASSERT_EQ(resp2.status, resp2.not_modified);
+  ASSERT_TRUE(resp2.body().empty());
+
+  // Other files are still read from root().
+  cppboot::http::Request disk;
+  disk.subpath = "/dir1/dir2/1.txt";
+  cppboot::http::Response resp3;
+  fs.ServeHttp(disk, &resp3);
+  ASSERT_EQ(resp3.body(), "Test Txt File");
+}
+
+TEST_F(EmbeddedFileServer, should_serve_compressed_by_build) {
+  req.subpath = "/index.html";
+  req.set_header("Accept-Encoding", "gzip");
+  fs.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.status, resp.ok);
+  ASSERT_EQ(resp.header("Content-Encoding"), "gzip");
+  ASSERT_EQ(resp.header("Vary"), "Accept-Encoding");
+  ASSERT_NE(resp.header("ETag"), files.Find("index.html")->etag);
+
+  std::string decompressed;
+  ASSERT_TRUE(cppboot::http::Decompress(cppboot::http::kGzip, resp.body(),
+                                        &decompressed));
+  ASSERT_EQ(decompressed, ReadTestFile("index.html"));
+
+  // Not worth it for a binary file.
+  req.subpath = "/img/logo.gif";
+  cppboot::http::Response resp2;
+  fs.ServeHttp(req, &resp2);
+  ASSERT_EQ(resp2.header("Content-Type"), "image/gif");
+  ASSERT_EQ(resp2.header("Content-Encoding"), "");
+  ASSERT_EQ(resp2.body(), ReadTestFile("img/logo.gif"));
+}
+
+TEST_F(EmbeddedFileServer, should_serve_precompressed_siblings) {
+  req.subpath = "/app.js";
+  req.set_header("Accept-Encoding", "gzip, br");
+  fs.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.header("Content-Encoding"), "br");
+  ASSERT_EQ(resp.body(), ReadTestFile("app.js.br"));
+
+  req.set_header("Accept-Encoding", "gzip");
+  cppboot::http::Response resp2;
+  fs.ServeHttp(req, &resp2);
+  ASSERT_EQ(resp2.header("Content-Encoding"), "gzip");
+  ASSERT_EQ(resp2.body(), ReadTestFile("app.js.gz"));
+}
+
+TEST_F(EmbeddedFileServer, should_serve_single_range) {
+  req.subpath = "/css/site.css";
+  req.set_header("Range", "bytes=0-3");
+  fs.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.status, resp.partial_content);
+  ASSERT_EQ(resp.body(), "body");
+  ASSERT_EQ(resp.header("Content-Range"),
+            "bytes 0-3/" + std::to_string(ReadTestFile("css/site.css").size()));
+
+  req.set_header("Range", "bytes=1000-");
+  cppboot::http::Response resp2;
+  fs.ServeHttp(req, &resp2);
+  ASSERT_EQ(resp2.status, resp2.range_not_satisfiable);
+
+  req.set_header("Range", "bytes=0-0,2-2");
+  cppboot::http::Response resp3;
+  fs.ServeHttp(req, &resp3);
+  ASSERT_EQ(resp3.status, resp3.ok);
+  ASSERT_EQ(resp3.body(), ReadTestFile("css/site.css"));
+}
+
+#endif  // CPPBOOT_TEST_EMBED
+
+TEST(FileCache, should_evict_least_recently_used) {
+  cppboot::http::FileCache cache;
+  cache.set_limits(10, 2, 10);
+
+  struct stat st = {};
+  auto make = [&](const std::string& path, const std::string& content) {
+    std::shared_ptr<cppboot::http::CachedFile> f(
+        new cppboot::http::CachedFile());
+    f->path = path;
+    f->content = std::make_shared<const std::string>(content);
+    f->dev = st.st_dev;
+    f->ino = st.st_ino;
+    f->size = st.st_size;
+    f->mtime = st.st_mtime;
+    return f;
+  };
+
+  cache.Put(make("/a", "1234"));
+  cache.Put(make("/b", "1234"));
+  ASSERT_TRUE(cache.Get("/a", st));
+  cache.Put(make("/c", "1234"));
+  ASSERT_EQ(cache.entries(), 2);
+  ASSERT_TRUE(cache.Get("/a", st));
+  ASSERT_FALSE(cache.Get("/b", st));
+
+  cache.Put(make("/big", "12345678901"));
+  ASSERT_FALSE(cache.Get("/big", st));
+  ASSERT_EQ(cache.bytes(), 8);
 }
 
 }  // namespace
\ No newline at end of file
@@ -0,0 +1,1045 @@
+#include "cppboot/net/http/server/h2_session.h"
+
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "cppboot/base/str_util.h"
+#include "cppboot/net/http/date.h"
+#include "cppboot/net/http/request.h"
+#include "cppboot/net/http/response.h"
+#include "cppboot/net/http/server/request_parser.h"
+#include "cppboot/net/http/server/serve_mux.h"
+
+namespace cppboot {
+namespace http {
+
+namespace {
+
+enum FrameType {
+  kData = 0x0,
+  kHeaders = 0x1,
+  kPriority = 0x2,
+  kRstStream = 0x3,
+  kSettings = 0x4,
+  kPushPromise = 0x5,
+  kPing = 0x6,
+  kGoAway = 0x7,
+  kWindowUpdate = 0x8,
+  kContinuation = 0x9,
+};
+
+enum FrameFlag {
+  kEndStream = 0x1,
+  kAck = 0x1,
+  kEndHeaders = 0x4,
+  kPadded = 0x8,
+  kPriorityFlag = 0x20,
+};
+
+enum ErrorCode {
+  kNoError = 0x0,
+  kProtocolError = 0x1,
+  kInternalError = 0x2,
+  kFlowControlError = 0x3,
+  kStreamClosed = 0x5,
+  kFrameSizeError = 0x6,
+  kRefusedStream = 0x7,
+  kCancel = 0x8,
+  kCompressionError = 0x9,
+  kEnhanceYourCalm = 0xb,
+};
+
+enum Setting {
+  kHeaderTableSize = 0x1,
+  kEnablePush = 0x2,
+  kMaxConcurrentStreamsSetting = 0x3,
+  kInitialWindowSize = 0x4,
+  kMaxFrameSize = 0x5,
+};
+
+const size_t kFrameHeaderSize = 9;
+
+/// Frame size and flow-control window every peer starts with.
+const uint32_t kDefaultMaxFrameSize = 16384;
+const int64_t kDefaultWindow = 65535;
+const int64_t kMaxWindow = 0x7fffffff;
+
+/// What a client may send on the connection before its data is read, it is
+/// shared by all streams.
+const int64_t kConnectionWindow = 1024 * 1024;
+
+/// Largest header block accepted.
+const size_t kMaxHeaderBlock = 256 * 1024;
+
+/// Request body buffered before the handler is called with it, as much as
+/// the HTTP/1.0 connection reads at once.
+const size_t kBodyBufferSize = 16 * 1024;
+
+/// Response bodies produced per Produce() call, so one stream can not
+/// monopolize the event loop.
+const size_t kWriteBudget = 64 * 1024;
+
+uint32_t Read32(const char* p) noexcept {
+  const uint8_t* u = reinterpret_cast<const uint8_t*>(p);
+  return static_cast<uint32_t>(u[0]) << 24 | u[1] << 16 | u[2] << 8 | u[3];
+}
+
+void Append32(uint32_t v, std::string* out) {
+  out->push_back(static_cast<char>(v >> 24));
+  out->push_back(static_cast<char>(v >> 16));
+  out->push_back(static_cast<char>(v >> 8));
+  out->push_back(static_cast<char>(v));
+}
+
+/// Fields only meaningful for one HTTP/1 connection, banned in HTTP/2.
+bool IsConnectionSpecific(string_view name) noexcept {
+  static const char* const kNames[] = {"Connection", "Keep-Alive",
+                                       "Proxy-Connection", "Transfer-Encoding",
+                                       "Upgrade"};
+  for (const char* n : kNames) {
+    if (EqualsIgnoreCase(name, n)) return true;
+  }
+  return false;
+}
+
+/// Decode base64url without padding, as used by HTTP2-Settings.
+bool DecodeBase64Url(string_view in, std::string* out) {
+  uint32_t bits = 0;
+  int n = 0;
+  for (char c : in) {
+    int v;
+    if (c >= 'A' && c <= 'Z') {
+      v = c - 'A';
+    } else if (c >= 'a' && c <= 'z') {
+      v = c - 'a' + 26;
+    } else if (c >= '0' && c <= '9') {
+      v = c - '0' + 52;
+    } else if (c == '-' || c == '+') {
+      v = 62;
+    } else if (c == '_' || c == '/') {
+      v = 63;
+    } else if (c == '=') {
+      break;
+    } else {
+      return false;
+    }
+    bits = (bits << 6) | v;
+    n += 6;
+    if (n >= 8) {
+      n -= 8;
+      out->push_back(static_cast<char>(bits >> n));
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+const char H2Session::kPreface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+struct H2Session::Stream : public std::enable_shared_from_this<Stream> {
+  /// What is sent of the response body.
+  enum Phase { kMemory, kFile, kSource, kDone };
+
+  Stream(H2Session* session, uint32_t id, int64_t send_window)
+      : session(session),
+        id(id),
+        dispatched(false),
+        deferred(false),
+        remote_closed(false),
+        queued(false),
+        head_sent(false),
+        content_length(-1),
+        data_received(0),
+        recv_window(kDefaultWindow),
+        send_window(send_window),
+        phase(kMemory),
+        offset(0),
+        file_part(0),
+        source_reading(false),
+        source_end(false) {}
+
+  /// Null once the stream is closed, callbacks arriving later are dropped.
+  H2Session* session;
+  uint32_t id;
+
+  Request request;
+  Response response;
+
+  /// The handler was called, it deferred the reply.
+  bool dispatched;
+  bool deferred;
+  /// The peer ended the request.
+  bool remote_closed;
+  /// In H2Session::sending_.
+  bool queued;
+  bool head_sent;
+
+  /// The content-length of the request, -1 without, and the DATA received
+  /// so far, which must match it.
+  int64_t content_length;
+  int64_t data_received;
+
+  /// Request body received and not read yet, the piece being read, and the
+  /// reader waiting for more.
+  std::string body_in;
+  std::string body_out;
+  BodySource::ReadCallback body_reader;
+
+  int64_t recv_window;
+  int64_t send_window;
+
+  /// Progress of the response body: the offset into the memory body, a part
+  /// head then its file slice, the tail, or the source piece.
+  Phase phase;
+  size_t offset;
+  size_t file_part;
+  string_view source_data;
+  bool source_reading;
+  bool source_end;
+};
+
+H2Session::H2Session(ServeMux& handler, const CompressOptions& compress_options,
+                     PostFunc post, std::function<void()> wake)
+    : handler_(handler),
+      compress_options_(compress_options),
+      post_(std::move(post)),
+      wake_(std::move(wake)),
+      preface_received_(false),
+      settings_received_(false),
+      header_stream_(0),
+      header_flags_(0),
+      last_stream_id_(0),
+      reset_budget_(kResetBudget),
+      peer_initial_window_(kDefaultWindow),
+      peer_max_frame_size_(kDefaultMaxFrameSize),
+      recv_window_(kDefaultWindow),
+      send_window_(kDefaultWindow),
+      failed_(false),
+      goaway_received_(false) {}
+
+H2Session::~H2Session() {
+  for (auto& i : streams_) {
+    const StreamPtr& s = i.second;
+    s->session = nullptr;
+    if (s->body_reader) {
+      BodySource::ReadCallback cb;
+      cb.swap(s->body_reader);
+      cb(CancelledError("Connection closed"), string_view());
+    }
+  }
+}
+
+bool H2Session::Start(string_view settings, std::unique_ptr<Request> upgrade) {
+  std::string payload;
+  payload.push_back(0);
+  payload.push_back(kMaxConcurrentStreamsSetting);
+  Append32(kMaxConcurrentStreams, &payload);
+  WriteFrame(kSettings, 0, 0, payload);
+  WriteWindowUpdate(0, kConnectionWindow - kDefaultWindow);
+  recv_window_ = kConnectionWindow;
+  if (!upgrade) return true;
+
+  // The settings of the upgrade request are acknowledged by the 101.
+  payload.clear();
+  if (!DecodeBase64Url(settings, &payload) || payload.size() % 6 != 0 ||
+      ApplySettings(payload) != kNoError) {
+    return false;
+  }
+
+  auto s = std::make_shared<Stream>(this, 1, peer_initial_window_);
+  s->request = std::move(*upgrade);
+  s->remote_closed = true;
+  last_stream_id_ = 1;
+  streams_[1] = s;
+  Dispatch(s);
+  return true;
+}
+
+bool H2Session::waiting_for_peer() const noexcept {
+  if (streams_.empty()) return true;
+  for (auto& i : streams_) {
+    if (!i.second->remote_closed) return true;
+  }
+  return false;
+}
+
+bool H2Session::Feed(const char* data, size_t size) {
+  if (failed_) return false;
+  input_.append(data, size);
+
+  size_t pos = 0;
+  if (!preface_received_) {
+    size_t n = std::min<size_t>(input_.size(), kPrefaceSize);
+    if (memcmp(input_.data(), kPreface, n) != 0) return Fail(kProtocolError);
+    if (n < kPrefaceSize) return true;
+    preface_received_ = true;
+    pos = kPrefaceSize;
+  }
+
+  bool ok = true;
+  while (ok && input_.size() - pos >= kFrameHeaderSize) {
+    const char* p = input_.data() + pos;
+    uint32_t length = Read32(p) >> 8;
+    if (length > kDefaultMaxFrameSize) {
+      ok = Fail(kFrameSizeError);
+      break;
+    }
+    if (input_.size() - pos - kFrameHeaderSize < length) break;
+
+    uint8_t type = static_cast<uint8_t>(p[3]);
+    uint8_t flags = static_cast<uint8_t>(p[4]);
+    uint32_t id = Read32(p + 5) & 0x7fffffff;
+    ok = OnFrame(type, flags, id,
+                 string_view(p + kFrameHeaderSize, length));
+    pos += kFrameHeaderSize + length;
+  }
+  input_.erase(0, pos);
+  return ok;
+}
+
+void H2Session::Produce(std::string* out) {
+  size_t budget = kWriteBudget;
+  while (!failed_ && budget > 0 && send_window_ > 0 && !sending_.empty()) {
+    StreamPtr s = std::move(sending_.front());
+    sending_.pop_front();
+    s->queued = false;
+    if (!s->session || s->send_window <= 0) continue;
+
+    size_t max = static_cast<size_t>(std::min<int64_t>(
+        {static_cast<int64_t>(budget), peer_max_frame_size_, send_window_,
+         s->send_window}));
+    scratch_.clear();
+    if (!FillBody(s, max, &scratch_)) {
+      ResetStream(s, kInternalError);
+      continue;
+    }
+
+    bool end = s->phase == Stream::kDone;
+    // Else the body_source has not produced the next piece yet.
+    if (scratch_.empty() && !end) continue;
+
+    WriteFrame(kData, end ? kEndStream : 0, s->id, scratch_);
+    send_window_ -= scratch_.size();
+    s->send_window -= scratch_.size();
+    budget -= std::min(budget, scratch_.size() + kFrameHeaderSize);
+    if (end) {
+      FinishStream(s);
+    } else {
+      Schedule(s);
+    }
+  }
+
+  out->append(output_);
+  output_.clear();
+}
+
+bool H2Session::OnFrame(uint8_t type, uint8_t flags, uint32_t id,
+                        string_view payload) {
+  // The client preface ends with SETTINGS, and a header block is not
+  // interrupted.
+  if (!settings_received_ && type != kSettings) return Fail(kProtocolError);
+  if (header_stream_ != 0 && type != kContinuation) {
+    return Fail(kProtocolError);
+  }
+
+  switch (type) {
+    case kData:
+      return OnData(flags, id, payload);
+    case kHeaders:
+      return OnHeaders(flags, id, payload);
+    case kPriority:
+      // Priorities are advisory, all streams are served alike.
+      if (id == 0) return Fail(kProtocolError);
+      if (payload.size() != 5) return Fail(kFrameSizeError);
+      return true;
+    case kRstStream:
+      return OnRstStream(id, payload);
+    case kSettings:
+      return OnSettings(flags, id, payload);
+    case kPushPromise:
+      return Fail(kProtocolError);
+    case kPing:
+      if (id != 0) return Fail(kProtocolError);
+      if (payload.size() != 8) return Fail(kFrameSizeError);
+      if (!(flags & kAck)) WriteFrame(kPing, kAck, 0, payload);
+      return true;
+    case kGoAway:
+      if (id != 0) return Fail(kProtocolError);
+      goaway_received_ = true;
+      return true;
+    case kWindowUpdate:
+      return OnWindowUpdate(id, payload);
+    case kContinuation:
+      return OnContinuation(flags, id, payload);
+    default:
+      // Unknown frame types are ignored.
+      return true;
+  }
+}
+
+bool H2Session::OnSettings(uint8_t flags, uint32_t id, string_view payload) {
+  if (id != 0) return Fail(kProtocolError);
+  if (flags & kAck) {
+    return payload.empty() ? true : Fail(kFrameSizeError);
+  }
+  if (payload.size() % 6 != 0) return Fail(kFrameSizeError);
+
+  uint32_t code = ApplySettings(payload);
+  if (code != kNoError) return Fail(code);
+  settings_received_ = true;
+  WriteFrame(kSettings, kAck, 0, string_view());
+  return true;
+}
+
+uint32_t H2Session::ApplySettings(string_view payload) {
+  for (size_t i = 0; i + 6 <= payload.size(); i += 6) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(payload.data() + i);
+    uint16_t setting = static_cast<uint16_t>(p[0] << 8 | p[1]);
+    uint32_t value = Read32(payload.data() + i + 2);
+    switch (setting) {
+      case kHeaderTableSize:
+        encoder_.set_max_table_size(value);
+        break;
+      case kEnablePush:
+        if (value > 1) return kProtocolError;
+        break;
+      case kInitialWindowSize: {
+        if (value > kMaxWindow) return kFlowControlError;
+        int64_t delta = static_cast<int64_t>(value) - peer_initial_window_;
+        peer_initial_window_ = value;
+        for (auto& it : streams_) {
+          it.second->send_window += delta;
+          if (it.second->send_window > kMaxWindow) return kFlowControlError;
+          Schedule(it.second);
+        }
+        break;
+      }
+      case kMaxFrameSize:
+        if (value < kDefaultMaxFrameSize || value > 0xffffff) {
+          return kProtocolError;
+        }
+        peer_max_frame_size_ = value;
+        break;
+      default:
+        break;
+    }
+  }
+  return kNoError;
+}
+
+bool H2Session::OnHeaders(uint8_t flags, uint32_t id, string_view payload) {
+  if (id == 0 || !(id & 1)) return Fail(kProtocolError);
+
+  size_t pad = 0;
+  if (flags & kPadded) {
+    if (payload.empty()) return Fail(kFrameSizeError);
+    pad = static_cast<uint8_t>(payload[0]);
+    payload.remove_prefix(1);
+  }
+  if (flags & kPriorityFlag) {
+    if (payload.size() < 5) return Fail(kFrameSizeError);
+    payload.remove_prefix(5);
+  }
+  if (pad > payload.size()) return Fail(kProtocolError);
+  payload.remove_suffix(pad);
+
+  header_block_.assign(payload.data(), payload.size());
+  header_stream_ = id;
+  header_flags_ = flags;
+  return (flags & kEndHeaders) ? OnHeaderBlock() : true;
+}
+
+bool H2Session::OnContinuation(uint8_t flags, uint32_t id,
+                               string_view payload) {
+  if (header_stream_ == 0 || id != header_stream_) {
+    return Fail(kProtocolError);
+  }
+  header_block_.append(payload.data(), payload.size());
+  if (header_block_.size() > kMaxHeaderBlock) return Fail(kEnhanceYourCalm);
+  return (flags & kEndHeaders) ? OnHeaderBlock() : true;
+}
+
+bool H2Session::OnHeaderBlock() {
+  uint32_t id = header_stream_;
+  header_stream_ = 0;
+
+  // Decoded even if the stream is refused, the table is shared.
+  std::vector<HpackField> fields;
+  if (!decoder_.Decode(header_block_, &fields)) {
+    return Fail(kCompressionError);
+  }
+  bool end_stream = header_flags_ & kEndStream;
+
+  auto it = streams_.find(id);
+  if (it != streams_.end()) {
+    // Trailers, they end the request and are dropped.
+    StreamPtr s = it->second;
+    if (s->remote_closed) {
+      ResetStream(s, kStreamClosed);
+    } else if (!end_stream || !LengthMatches(*s)) {
+      ResetStream(s, kProtocolError);
+    } else {
+      EndRequestBody(s);
+    }
+    return true;
+  }
+
+  // A stream id can not be reused, nor go down.
+  if (id <= last_stream_id_) return Fail(kProtocolError);
+  last_stream_id_ = id;
+  if (streams_.size() >= kMaxConcurrentStreams) {
+    WriteRstStream(id, kRefusedStream);
+    return true;
+  }
+
+  auto s = std::make_shared<Stream>(this, id, peer_initial_window_);
+  if (!BuildRequest(s.get(), &fields) || (end_stream && !LengthMatches(*s))) {
+    WriteRstStream(id, kProtocolError);
+    return true;
+  }
+  streams_[id] = s;
+  if (end_stream) EndRequestBody(s);
+  return true;
+}
+
+bool H2Session::BuildRequest(Stream* s, std::vector<HpackField>* fields) {
+  Request& req = s->request;
+  req.http_version_major = 2;
+  req.http_version_minor = 0;
+  req.remote_address = remote_address_;
+
+  bool regular = false;
+  bool has_cookie = false;
+  std::string authority, cookie;
+  for (auto& f : *fields) {
+    if (f.name.empty()) return false;
+
+    if (f.name[0] == ':') {
+      // Pseudo-headers come first, once each.
+      if (regular) return false;
+      if (f.name == ":method" && req.method.empty()) {
+        req.method.swap(f.value);
+      } else if (f.name == ":path" && req.uri.empty()) {
+        req.uri.swap(f.value);
+      } else if (f.name == ":authority") {
+        authority.swap(f.value);
+      } else if (f.name != ":scheme") {
+        return false;
+      }
+      continue;
+    }
+
+    regular = true;
+    for (char c : f.name) {
+      if (c >= 'A' && c <= 'Z') return false;
+    }
+    if (IsConnectionSpecific(f.name)) return false;
+    if (f.name == "te" && f.value != "trailers") return false;
+
+    // Split for better compression, joined back for HTTP/1 handlers.
+    if (f.name == "cookie") {
+      if (has_cookie) cookie.append("; ");
+      cookie.append(f.value);
+      has_cookie = true;
+      continue;
+    }
+    req.headers.Add(f.name, f.value);
+  }
+
+  // CONNECT is not supported.
+  if (req.method.empty() || req.method == "CONNECT" || req.uri.empty()) {
+    return false;
+  }
+  if (!authority.empty() && !req.headers.Has(kHost)) {
+    req.headers.Add(kHost, authority);
+  }
+  if (has_cookie) req.headers.Add(kCookie, cookie);
+
+  string_view length = req.headers.Get(kContentLength);
+  if (!length.empty()) {
+    if (length.size() > 18) return false;
+    int64_t n = 0;
+    for (char c : length) {
+      if (c < '0' || c > '9') return false;
+      n = n * 10 + (c - '0');
+    }
+    s->content_length = n;
+  }
+  RequestParser::parse_uri(req);
+  return true;
+}
+
+bool H2Session::LengthMatches(const Stream& s) const noexcept {
+  return s.content_length < 0 || s.data_received == s.content_length;
+}
+
+void H2Session::Dispatch(const StreamPtr& s) {
+  s->dispatched = true;
+  Request& req = s->request;
+  size_t received = s->body_in.size();
+  if (req.content.empty()) {
+    req.content.swap(s->body_in);
+  } else {
+    req.content.append(s->body_in);
+  }
+  s->body_in.clear();
+  Consume(s.get(), received);
+
+  PostFunc post = post_;
+  if (!s->remote_closed) {
+    int64_t size = -1;
+    if (s->content_length >= 0) {
+      size = s->content_length - static_cast<int64_t>(req.content.size());
+    }
+
+    std::weak_ptr<Stream> weak(s);
+    req.body_source.size = size;
+    req.body_source.read = [weak, post](BodySource::ReadCallback cb) {
+      post([weak, cb]() {
+        auto s = weak.lock();
+        if (!s || !s->session) {
+          cb(CancelledError("Stream closed"), string_view());
+          return;
+        }
+        H2Session* session = s->session;
+        session->ReadRequestBody(s, cb);
+        session->wake_();
+      });
+    };
+  }
+
+  if (!admit_) {
+    Serve(s);
+    return;
+  }
+
+  // Called from the admission queue, or right away if the stream is turned
+  // away, back on the connection's thread either way.
+  std::weak_ptr<Stream> weak(s);
+  admit_([weak, post](Response::status_type status,
+                      std::chrono::seconds retry_after) {
+    post([weak, status, retry_after]() {
+      auto s = weak.lock();
+      if (!s || !s->session) return;
+      H2Session* session = s->session;
+      if (status == Response::ok) {
+        session->Serve(s);
+      } else {
+        s->response = Response::stock_reply(status);
+        s->response.headers.Add(kRetryAfter,
+                                std::to_string(retry_after.count()));
+        session->SendHead(s);
+      }
+      session->wake_();
+    });
+  });
+}
+
+void H2Session::Serve(const StreamPtr& s) {
+  PostFunc post = post_;
+  Stream* raw = s.get();
+  s->response.defer_hook = [raw, post]() {
+    raw->deferred = true;
+    auto s = raw->shared_from_this();
+    return Response::DoneFunc([s, post]() {
+      post([s]() {
+        if (H2Session* session = s->session) {
+          session->SendHead(s);
+          session->wake_();
+        }
+      });
+    });
+  };
+  handler_.ServeHttp(s->request, &s->response);
+  // It references the stream.
+  s->response.defer_hook = nullptr;
+  if (!s->deferred && s->session) SendHead(s);
+}
+
+void H2Session::EndRequestBody(const StreamPtr& s) {
+  s->remote_closed = true;
+  if (!s->dispatched) {
+    Dispatch(s);
+  } else if (s->body_reader) {
+    BodySource::ReadCallback cb;
+    cb.swap(s->body_reader);
+    ReadRequestBody(s, std::move(cb));
+  }
+}
+
+void H2Session::ReadRequestBody(const StreamPtr& s,
+                                BodySource::ReadCallback cb) {
+  if (!s->body_in.empty()) {
+    s->body_out.swap(s->body_in);
+    s->body_in.clear();
+    Consume(s.get(), s->body_out.size());
+    cb(OkStatus(), s->body_out);
+  } else if (s->remote_closed) {
+    cb(OkStatus(), string_view());
+  } else {
+    s->body_reader = std::move(cb);
+  }
+}
+
+bool H2Session::OnData(uint8_t flags, uint32_t id, string_view payload) {
+  if (id == 0) return Fail(kProtocolError);
+
+  // Padding counts against the windows too.
+  size_t size = payload.size();
+  if (flags & kPadded) {
+    if (payload.empty()) return Fail(kFrameSizeError);
+    size_t pad = static_cast<uint8_t>(payload[0]);
+    payload.remove_prefix(1);
+    if (pad > payload.size()) return Fail(kProtocolError);
+    payload.remove_suffix(pad);
+  }
+  if (static_cast<int64_t>(size) > recv_window_) {
+    return Fail(kFlowControlError);
+  }
+  recv_window_ -= size;
+
+  auto it = streams_.find(id);
+  if (it == streams_.end()) {
+    if (id > last_stream_id_) return Fail(kProtocolError);
+    // Sent before the peer learned that the stream is closed.
+    Consume(nullptr, size);
+    return true;
+  }
+
+  StreamPtr s = it->second;
+  if (s->remote_closed) {
+    Consume(nullptr, size);
+    ResetStream(s, kStreamClosed);
+    return true;
+  }
+  if (static_cast<int64_t>(size) > s->recv_window) {
+    Consume(nullptr, size);
+    ResetStream(s, kFlowControlError);
+    return true;
+  }
+  // A body longer or shorter than its content-length is malformed.
+  s->data_received += payload.size();
+  if (s->content_length >= 0 &&
+      (s->data_received > s->content_length ||
+       ((flags & kEndStream) && !LengthMatches(*s)))) {
+    Consume(nullptr, size);
+    ResetStream(s, kProtocolError);
+    return true;
+  }
+  s->recv_window -= size;
+  Consume(s.get(), size - payload.size());
+
+  s->body_in.append(payload.data(), payload.size());
+  if (flags & kEndStream) {
+    EndRequestBody(s);
+  } else if (!s->dispatched && s->body_in.size() >= kBodyBufferSize) {
+    Dispatch(s);
+  } else if (s->body_reader) {
+    BodySource::ReadCallback cb;
+    cb.swap(s->body_reader);
+    ReadRequestBody(s, std::move(cb));
+  }
+  return true;
+}
+
+bool H2Session::OnWindowUpdate(uint32_t id, string_view payload) {
+  if (payload.size() != 4) return Fail(kFrameSizeError);
+  uint32_t increment = Read32(payload.data()) & 0x7fffffff;
+
+  if (id == 0) {
+    if (increment == 0) return Fail(kProtocolError);
+    send_window_ += increment;
+    if (send_window_ > kMaxWindow) return Fail(kFlowControlError);
+    return true;
+  }
+
+  auto it = streams_.find(id);
+  if (it == streams_.end()) return true;
+  StreamPtr s = it->second;
+  if (increment == 0) {
+    ResetStream(s, kProtocolError);
+    return true;
+  }
+  s->send_window += increment;
+  if (s->send_window > kMaxWindow) {
+    ResetStream(s, kFlowControlError);
+    return true;
+  }
+  Schedule(s);
+  return true;
+}
+
+bool H2Session::OnRstStream(uint32_t id, string_view payload) {
+  if (id == 0) return Fail(kProtocolError);
+  if (payload.size() != 4) return Fail(kFrameSizeError);
+
+  auto it = streams_.find(id);
+  if (it == streams_.end()) {
+    return id > last_stream_id_ ? Fail(kProtocolError) : true;
+  }
+  ResetStream(it->second, -1);
+  if (--reset_budget_ < 0) return Fail(kEnhanceYourCalm);
+  return true;
+}
+
+void H2Session::SendHead(const StreamPtr& s) {
+  const Request& req = s->request;
+  Response& rep = s->response;
+  CompressResponse(compress_options_, req, &rep);
+
+  int status = static_cast<int>(rep.status);
+  scratch_.clear();
+  encoder_.Begin(&scratch_);
+  encoder_.Add(":status", std::to_string(status), &scratch_);
+
+  std::string name;
+  for (auto& f : rep.headers) {
+    if (IsConnectionSpecific(f.name)) continue;
+    name.assign(f.name.data(), f.name.size());
+    for (char& c : name) {
+      if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+    }
+    encoder_.Add(name, f.value, &scratch_);
+  }
+  if (!rep.headers.Has(kDate)) {
+    encoder_.Add("date", CurrentHttpDate(), &scratch_);
+  }
+
+  bool no_body = !Response::AllowsBody(status);
+  if (!rep.headers.Has(kContentLength) && !no_body &&
+      !(rep.body_source && rep.body_source.size < 0)) {
+    size_t length = rep.body().size() +
+                    (rep.file_body ? rep.file_body->size() : 0) +
+                    (rep.body_source ? rep.body_source.size : 0);
+    encoder_.Add("content-length", std::to_string(length), &scratch_);
+  }
+
+  bool body = !no_body && req.method != "HEAD" &&
+              (!rep.body().empty() || rep.file_body || rep.body_source);
+
+  // HEADERS then CONTINUATION frames, back to back.
+  string_view block(scratch_);
+  uint8_t type = kHeaders;
+  uint8_t flags = body ? 0 : kEndStream;
+  do {
+    string_view piece = block.substr(0, peer_max_frame_size_);
+    block.remove_prefix(piece.size());
+    WriteFrame(type, flags | (block.empty() ? kEndHeaders : 0), s->id, piece);
+    type = kContinuation;
+    flags = 0;
+  } while (!block.empty());
+
+  s->head_sent = true;
+  if (body) {
+    s->phase = Stream::kMemory;
+    Schedule(s);
+  } else {
+    s->phase = Stream::kDone;
+    FinishStream(s);
+  }
+}
+
+bool H2Session::FillBody(const StreamPtr& s, size_t max, std::string* out) {
+  const Response& rep = s->response;
+  while (max > 0) {
+    switch (s->phase) {
+      case Stream::kMemory: {
+        string_view body = rep.body();
+        size_t n = std::min(max, body.size() - s->offset);
+        out->append(body.data() + s->offset, n);
+        s->offset += n;
+        max -= n;
+        if (s->offset == body.size()) {
+          s->phase = Stream::kFile;
+          s->offset = 0;
+        }
+        break;
+      }
+
+      case Stream::kFile: {
+        if (!rep.file_body) {
+          s->phase = Stream::kSource;
+          break;
+        }
+
+        const FileBody& file = *rep.file_body;
+        if (s->file_part == file.parts().size()) {
+          const std::string& tail = file.tail();
+          size_t n = std::min(max, tail.size() - s->offset);
+          out->append(tail, s->offset, n);
+          s->offset += n;
+          max -= n;
+          if (s->offset == tail.size()) {
+            s->phase = Stream::kSource;
+            s->offset = 0;
+          }
+          break;
+        }
+
+        const FileBody::Part& part = file.parts()[s->file_part];
+        if (s->offset < part.head.size()) {
+          size_t n = std::min(max, part.head.size() - s->offset);
+          out->append(part.head, s->offset, n);
+          s->offset += n;
+          max -= n;
+          break;
+        }
+
+        size_t sent = s->offset - part.head.size();
+        if (sent == part.length) {
+          s->file_part++;
+          s->offset = 0;
+          break;
+        }
+        size_t n = std::min(max, part.length - sent);
+        size_t old = out->size();
+        out->resize(old + n);
+        ssize_t got = ::pread(file.fd(), &(*out)[old], n, part.offset + sent);
+        if (got <= 0) {
+          // The file shrank.
+          out->resize(old);
+          return false;
+        }
+        out->resize(old + got);
+        s->offset += got;
+        max -= got;
+        break;
+      }
+
+      case Stream::kSource: {
+        if (!rep.body_source) {
+          s->phase = Stream::kDone;
+          break;
+        }
+        if (s->offset < s->source_data.size()) {
+          size_t n = std::min(max, s->source_data.size() - s->offset);
+          out->append(s->source_data.data() + s->offset, n);
+          s->offset += n;
+          max -= n;
+          break;
+        }
+        if (s->source_end) {
+          s->phase = Stream::kDone;
+          break;
+        }
+        if (!s->source_reading) ReadSource(s);
+        return true;
+      }
+
+      case Stream::kDone:
+        return true;
+    }
+  }
+  return true;
+}
+
+void H2Session::ReadSource(const StreamPtr& s) {
+  s->source_reading = true;
+  s->source_data = string_view();
+  s->offset = 0;
+
+  StreamPtr self = s;
+  PostFunc post = post_;
+  s->response.body_source.read([self, post](const Status& status,
+                                            string_view data) {
+    post([self, status, data]() {
+      H2Session* session = self->session;
+      if (!session) return;
+      self->source_reading = false;
+      if (!status) {
+        session->ResetStream(self, kInternalError);
+      } else if (data.empty()) {
+        self->source_end = true;
+        session->Schedule(self);
+      } else {
+        self->source_data = data;
+        session->Schedule(self);
+      }
+      session->wake_();
+    });
+  });
+}
+
+void H2Session::Schedule(const StreamPtr& s) {
+  if (s->queued || !s->session || !s->head_sent ||
+      s->phase == Stream::kDone || s->source_reading || s->send_window <= 0) {
+    return;
+  }
+  s->queued = true;
+  sending_.push_back(s);
+}
+
+void H2Session::FinishStream(const StreamPtr& s) {
+  if (!s->remote_closed) {
+    // Replied before the whole request arrived, the rest is not wanted.
+    WriteRstStream(s->id, kNoError);
+    s->remote_closed = true;
+  }
+  if (reset_budget_ < kResetBudget) reset_budget_++;
+  ResetStream(s, -1);
+}
+
+void H2Session::ResetStream(const StreamPtr& stream, int code) {
+  // `stream` may be the one erased from streams_.
+  StreamPtr s(stream);
+  if (code >= 0) WriteRstStream(s->id, static_cast<uint32_t>(code));
+  s->session = nullptr;
+  streams_.erase(s->id);
+
+  // Credit the connection with what will never be read.
+  Consume(nullptr, s->body_in.size());
+  s->body_in.clear();
+  if (s->body_reader) {
+    BodySource::ReadCallback cb;
+    cb.swap(s->body_reader);
+    cb(CancelledError("Stream reset"), string_view());
+  }
+  s->response.body_source = BodySource();
+}
+
+void H2Session::Consume(Stream* s, size_t n) {
+  if (n == 0) return;
+  recv_window_ += n;
+  WriteWindowUpdate(0, static_cast<uint32_t>(n));
+  if (s && !s->remote_closed) {
+    s->recv_window += n;
+    WriteWindowUpdate(s->id, static_cast<uint32_t>(n));
+  }
+}
+
+bool H2Session::Fail(uint32_t code) {
+  if (!failed_) {
+    std::string payload;
+    Append32(last_stream_id_, &payload);
+    Append32(code, &payload);
+    WriteFrame(kGoAway, 0, 0, payload);
+    failed_ = true;
+  }
+  return false;
+}
+
+void H2Session::WriteFrame(uint8_t type, uint8_t flags, uint32_t id,
+                           string_view payload) {
+  Append32(static_cast<uint32_t>(payload.size()) << 8 | type, &output_);
+  output_.push_back(static_cast<char>(flags));
+  Append32(id, &output_);
+  output_.append(payload.data(), payload.size());
+}
+
+void H2Session::WriteWindowUpdate(uint32_t id, uint32_t increment) {
+  std::string payload;
+  Append32(increment, &payload);
+  WriteFrame(kWindowUpdate, 0, id, payload);
+}
+
+void H2Session::WriteRstStream(uint32_t id, uint32_t code) {
+  std::string payload;
+  Append32(code, &payload);
+  WriteFrame(kRstStream, 0, id, payload);
+}
+
+}  // namespace http
+}  // namespace cppboot
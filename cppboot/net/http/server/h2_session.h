@@ -0,0 +1,232 @@
+#ifndef CPPBOOT_NET_HTTP_SERVER_H2_SESSION_H_
+#define CPPBOOT_NET_HTTP_SERVER_H2_SESSION_H_
+
+#include <stdint.h>
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "asio.hpp"
+
+#include "cppboot/base/string_view.h"
+#include "cppboot/net/http/body_sink.h"
+#include "cppboot/net/http/compress.h"
+#include "cppboot/net/http/hpack.h"
+#include "cppboot/net/http/response.h"
+
+namespace cppboot {
+namespace http {
+
+class ServeMux;
+struct Request;
+
+/// The server side of an HTTP/2 connection over cleartext TCP, h2c
+/// (RFC 9113). The session does no I/O: the connection feeds it the bytes it
+/// reads and sends the bytes it produces, which lets tests drive it frame by
+/// frame.
+///
+/// Requests are multiplexed on streams and served by the same ServeMux
+/// handlers as HTTP/1.0, including deferred replies and all kinds of bodies.
+/// A request body arriving with its head is in Request::content, the rest is
+/// read through Request::body_source, and the peer may only send more once
+/// it has been read. Response bodies are sent round-robin across streams
+/// within the flow-control windows granted by the peer. Each stream goes
+/// through the same admission control as an HTTP/1 request, see set_admit().
+///
+/// All methods are called on the connection's thread.
+class H2Session {
+ public:
+  /// Runs a function later on the connection's thread.
+  typedef std::function<void(std::function<void()>)> PostFunc;
+
+  /// Called with Response::ok once a stream may be served, or with the
+  /// status it is turned away with and the Retry-After to send.
+  typedef std::function<void(Response::status_type status,
+                             std::chrono::seconds retry_after)>
+      AdmitCallback;
+
+  /// Queues a stream for admission, see ConnectionManager::Enqueue().
+  typedef std::function<void(AdmitCallback cb)> AdmitFunc;
+
+  /// The preface a client sends first.
+  static const char kPreface[];
+  enum { kPrefaceSize = 24 };
+
+  /// Streams a peer may open at once.
+  enum { kMaxConcurrentStreams = 100 };
+
+  /// Streams a peer may reset before their response is complete, each
+  /// complete response earns one back. Opening streams only to reset them,
+  /// the rapid reset attack, ends with GOAWAY ENHANCE_YOUR_CALM.
+  enum { kResetBudget = 100 };
+
+  H2Session(const H2Session&) = delete;
+  H2Session& operator=(const H2Session&) = delete;
+
+  /// Serve requests with `handler`. Replies completed outside of Feed(),
+  /// e.g. deferred ones, call `wake` so the connection calls Produce().
+  H2Session(ServeMux& handler, const CompressOptions& compress_options,
+            PostFunc post, std::function<void()> wake);
+  ~H2Session();
+
+  /// Address of the client, copied into the requests.
+  void set_remote_address(const asio::ip::address& address) {
+    remote_address_ = address;
+  }
+
+  /// Pass each stream through `admit` before its handler runs, streams are
+  /// served right away unless set.
+  void set_admit(AdmitFunc admit) { admit_ = std::move(admit); }
+
+  /// Send the server preface. After an upgrade from HTTP/1.1, `settings` is
+  /// the HTTP2-Settings header of `upgrade`, which is then served as stream
+  /// 1. Returns false if the settings are malformed.
+  bool Start(string_view settings = string_view(),
+             std::unique_ptr<Request> upgrade = nullptr);
+
+  /// Process bytes read from the peer, starting with the client preface.
+  /// Returns false on a connection error, the output then ends with a
+  /// GOAWAY frame and the connection is closed after sending it.
+  bool Feed(const char* data, size_t size);
+
+  /// Append the frames ready to be sent to `out`, at most about one write
+  /// worth of response bodies at a time.
+  void Produce(std::string* out);
+
+  /// Whether the connection is to be closed once the output is sent: after
+  /// an error, or when the peer went away and all streams are done.
+  bool closed() const noexcept {
+    return failed_ || (goaway_received_ && streams_.empty());
+  }
+
+  /// Number of open streams.
+  size_t streams() const noexcept { return streams_.size(); }
+
+  /// Whether the client preface and the first SETTINGS frame arrived.
+  bool settings_received() const noexcept { return settings_received_; }
+
+  /// Whether the session waits for the peer: no stream is open, or the
+  /// request of one has not arrived completely.
+  bool waiting_for_peer() const noexcept;
+
+ private:
+  struct Stream;
+  typedef std::shared_ptr<Stream> StreamPtr;
+
+  /// Handle the frame in `payload`, false on a connection error.
+  bool OnFrame(uint8_t type, uint8_t flags, uint32_t id, string_view payload);
+  bool OnSettings(uint8_t flags, uint32_t id, string_view payload);
+  /// Apply the settings in `payload`, returns an error code.
+  uint32_t ApplySettings(string_view payload);
+  bool OnHeaders(uint8_t flags, uint32_t id, string_view payload);
+  bool OnContinuation(uint8_t flags, uint32_t id, string_view payload);
+  bool OnHeaderBlock();
+  bool OnData(uint8_t flags, uint32_t id, string_view payload);
+  bool OnWindowUpdate(uint32_t id, string_view payload);
+  bool OnRstStream(uint32_t id, string_view payload);
+
+  /// Fill in the request of `s` from its header fields, false if they are
+  /// malformed.
+  bool BuildRequest(Stream* s, std::vector<HpackField>* fields);
+
+  /// Whether the DATA received on `s` matches its content-length, if any.
+  bool LengthMatches(const Stream& s) const noexcept;
+
+  /// Admit `s`, once its body has arrived or enough of it.
+  void Dispatch(const StreamPtr& s);
+
+  /// Call the handler of `s`.
+  void Serve(const StreamPtr& s);
+
+  /// The request body of `s` was closed by the peer.
+  void EndRequestBody(const StreamPtr& s);
+
+  /// Called by Request::body_source.
+  void ReadRequestBody(const StreamPtr& s, BodySource::ReadCallback cb);
+
+  /// Queue the response head of `s`, the reply is complete.
+  void SendHead(const StreamPtr& s);
+
+  /// Append up to `max` bytes of the response body of `s` to `out`.
+  /// Returns false if the body failed.
+  bool FillBody(const StreamPtr& s, size_t max, std::string* out);
+
+  /// Ask the response body_source of `s` for its next piece.
+  void ReadSource(const StreamPtr& s);
+
+  /// Queue `s` for DATA frames if it has some to send.
+  void Schedule(const StreamPtr& s);
+
+  /// The response of `s` was sent completely.
+  void FinishStream(const StreamPtr& s);
+
+  /// Abort `s`, sending RST_STREAM with `code` unless it is negative.
+  void ResetStream(const StreamPtr& s, int code);
+
+  /// Give the peer back flow-control credit for `n` bytes, on the connection
+  /// and unless null on `s`.
+  void Consume(Stream* s, size_t n);
+
+  /// Send GOAWAY with `code`, returns false for OnFrame().
+  bool Fail(uint32_t code);
+
+  void WriteFrame(uint8_t type, uint8_t flags, uint32_t id,
+                  string_view payload);
+  void WriteWindowUpdate(uint32_t id, uint32_t increment);
+  void WriteRstStream(uint32_t id, uint32_t code);
+
+  ServeMux& handler_;
+  const CompressOptions& compress_options_;
+  PostFunc post_;
+  std::function<void()> wake_;
+  AdmitFunc admit_;
+
+  asio::ip::address remote_address_;
+
+  HpackDecoder decoder_;
+  HpackEncoder encoder_;
+
+  /// Received bytes not processed yet.
+  std::string input_;
+  bool preface_received_;
+  bool settings_received_;
+
+  /// The header block being received and its HEADERS frame.
+  std::string header_block_;
+  uint32_t header_stream_;
+  uint8_t header_flags_;
+
+  std::map<uint32_t, StreamPtr> streams_;
+  /// Highest stream id opened by the peer.
+  uint32_t last_stream_id_;
+  /// Streams the peer may still reset, GOAWAY below zero.
+  int reset_budget_;
+
+  /// Streams with DATA to send, in round-robin order.
+  std::deque<StreamPtr> sending_;
+
+  /// Peer settings.
+  uint32_t peer_initial_window_;
+  uint32_t peer_max_frame_size_;
+
+  /// What the peer may still send on the connection, and what we may.
+  int64_t recv_window_;
+  int64_t send_window_;
+
+  /// Frames ready to be sent.
+  std::string output_;
+  std::string scratch_;
+
+  bool failed_;
+  bool goaway_received_;
+};
+
+}  // namespace http
+}  // namespace cppboot
+
+#endif  // CPPBOOT_NET_HTTP_SERVER_H2_SESSION_H_
@@ -0,0 +1,620 @@
+#include "gmock/gmock.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cppboot/net/http/hpack.h"
+#include "cppboot/net/http/request.h"
+#include "cppboot/net/http/response.h"
+#include "cppboot/net/http/server/h2_session.h"
+#include "cppboot/net/http/server/serve_mux.h"
+
+namespace {
+
+using cppboot::http::CompressOptions;
+using cppboot::http::H2Session;
+using cppboot::http::HpackDecoder;
+using cppboot::http::HpackEncoder;
+using cppboot::http::HpackField;
+using cppboot::http::Request;
+using cppboot::http::Response;
+using cppboot::http::ServeMux;
+
+enum {
+  kData = 0x0,
+  kHeaders = 0x1,
+  kRstStream = 0x3,
+  kSettings = 0x4,
+  kPing = 0x6,
+  kGoAway = 0x7,
+  kWindowUpdate = 0x8,
+  kContinuation = 0x9,
+};
+
+enum {
+  kEndStream = 0x1,
+  kAck = 0x1,
+  kEndHeaders = 0x4,
+};
+
+struct Frame {
+  uint8_t type;
+  uint8_t flags;
+  uint32_t id;
+  std::string payload;
+
+  uint32_t Get32(size_t offset = 0) const {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(payload.data());
+    return static_cast<uint32_t>(p[offset]) << 24 | p[offset + 1] << 16 |
+           p[offset + 2] << 8 | p[offset + 3];
+  }
+};
+
+std::string Frame32(uint32_t v) {
+  std::string s;
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    s.push_back(static_cast<char>(v >> shift));
+  }
+  return s;
+}
+
+std::string EncodeFrame(uint8_t type, uint8_t flags, uint32_t id,
+                        const std::string& payload) {
+  std::string s = Frame32(static_cast<uint32_t>(payload.size()) << 8 | type);
+  s.push_back(static_cast<char>(flags));
+  s += Frame32(id);
+  return s + payload;
+}
+
+/// A client driving a session, running its posted functions by hand.
+class Peer {
+ public:
+  explicit Peer(ServeMux& mux)
+      : session_(
+            mux, options_,
+            [this](std::function<void()> fn) { posted_.push_back(fn); },
+            [this]() { wakes_++; }),
+        wakes_(0) {}
+
+  H2Session& session() { return session_; }
+  int wakes() const { return wakes_; }
+
+  /// Start the session with the client preface and empty settings, then
+  /// take the server preface and the settings ACK.
+  void Connect() {
+    ASSERT_TRUE(session_.Start());
+    ASSERT_TRUE(Send(std::string(H2Session::kPreface, H2Session::kPrefaceSize) +
+                     EncodeFrame(kSettings, 0, 0, "")));
+    auto frames = Receive();
+    ASSERT_EQ(frames.size(), 3);
+    ASSERT_EQ(frames[0].type, kSettings);
+    ASSERT_EQ(frames[1].type, kWindowUpdate);
+    ASSERT_EQ(frames[2].type, kSettings);
+    ASSERT_EQ(frames[2].flags, kAck);
+  }
+
+  bool Send(const std::string& bytes) {
+    return session_.Feed(bytes.data(), bytes.size());
+  }
+
+  bool SendFrame(uint8_t type, uint8_t flags, uint32_t id,
+                 const std::string& payload) {
+    return Send(EncodeFrame(type, flags, id, payload));
+  }
+
+  bool SendRequest(uint32_t id, const std::string& method,
+                   const std::string& path, bool end_stream,
+                   const std::vector<HpackField>& extra = {}) {
+    std::string block;
+    encoder_.Begin(&block);
+    encoder_.Add(":method", method, &block);
+    encoder_.Add(":scheme", "http", &block);
+    encoder_.Add(":path", path, &block);
+    encoder_.Add(":authority", "example.com", &block);
+    for (auto& f : extra) encoder_.Add(f.name, f.value, &block);
+    return SendFrame(kHeaders, kEndHeaders | (end_stream ? kEndStream : 0),
+                     id, block);
+  }
+
+  void RunPosted() {
+    while (!posted_.empty()) {
+      auto fn = posted_.front();
+      posted_.erase(posted_.begin());
+      fn();
+    }
+  }
+
+  /// All frames the session has to send.
+  std::vector<Frame> Receive() {
+    std::string out;
+    for (;;) {
+      size_t before = out.size();
+      session_.Produce(&out);
+      if (out.size() == before) break;
+    }
+
+    std::vector<Frame> frames;
+    size_t pos = 0;
+    while (pos + 9 <= out.size()) {
+      Frame f;
+      const uint8_t* p = reinterpret_cast<const uint8_t*>(out.data() + pos);
+      size_t length = p[0] << 16 | p[1] << 8 | p[2];
+      f.type = p[3];
+      f.flags = p[4];
+      f.id = (p[5] << 24 | p[6] << 16 | p[7] << 8 | p[8]) & 0x7fffffff;
+      f.payload = out.substr(pos + 9, length);
+      frames.push_back(f);
+      pos += 9 + length;
+    }
+    EXPECT_EQ(pos, out.size());
+    return frames;
+  }
+
+  std::vector<HpackField> DecodeHeaders(const Frame& f) {
+    std::vector<HpackField> fields;
+    EXPECT_TRUE(decoder_.Decode(f.payload, &fields));
+    return fields;
+  }
+
+ private:
+  CompressOptions options_;
+  H2Session session_;
+  HpackEncoder encoder_;
+  HpackDecoder decoder_;
+  std::vector<std::function<void()>> posted_;
+  int wakes_;
+};
+
+std::string FieldValue(const std::vector<HpackField>& fields,
+                       const std::string& name) {
+  for (auto& f : fields) {
+    if (f.name == name) return f.value;
+  }
+  return "<none>";
+}
+
+/// Frames of `type` in `frames`.
+std::vector<Frame> OfType(const std::vector<Frame>& frames, uint8_t type) {
+  std::vector<Frame> out;
+  for (auto& f : frames) {
+    if (f.type == type) out.push_back(f);
+  }
+  return out;
+}
+
+TEST(H2Session, Get) {
+  ServeMux mux;
+  std::string seen;
+  mux.set_handler("/hello", [&seen](const Request& req, Response* resp) {
+    seen = req.method + " " + req.path + " " + req.header("Host").str() +
+           " " + req.Param("q").str() + " " + req.header("Cookie").str();
+    resp->WriteText(Response::ok, "hello");
+    resp->set_header("Connection", "close");
+  });
+
+  Peer peer(mux);
+  peer.Connect();
+  ASSERT_TRUE(peer.SendRequest(1, "GET", "/hello?q=1", true,
+                               {{"cookie", "a=1"}, {"cookie", "b=2"}}));
+  ASSERT_EQ(seen, "GET /hello example.com 1 a=1; b=2");
+
+  auto frames = peer.Receive();
+  ASSERT_EQ(frames.size(), 2);
+  ASSERT_EQ(frames[0].type, kHeaders);
+  ASSERT_EQ(frames[0].id, 1);
+  ASSERT_EQ(frames[0].flags, kEndHeaders);
+  auto fields = peer.DecodeHeaders(frames[0]);
+  ASSERT_EQ(fields[0].name, ":status");
+  ASSERT_EQ(fields[0].value, "200");
+  ASSERT_EQ(FieldValue(fields, "content-type"), "text/plain");
+  ASSERT_EQ(FieldValue(fields, "content-length"), "5");
+  ASSERT_EQ(FieldValue(fields, "connection"), "<none>");
+  ASSERT_NE(FieldValue(fields, "date"), "<none>");
+
+  ASSERT_EQ(frames[1].type, kData);
+  ASSERT_EQ(frames[1].flags, kEndStream);
+  ASSERT_EQ(frames[1].payload, "hello");
+  ASSERT_EQ(peer.session().streams(), 0);
+
+  // HEAD has no body, unknown paths get a 404 on their stream.
+  ASSERT_TRUE(peer.SendRequest(3, "HEAD", "/hello", true));
+  frames = peer.Receive();
+  ASSERT_EQ(frames.size(), 1);
+  ASSERT_EQ(frames[0].flags, kEndHeaders | kEndStream);
+  ASSERT_EQ(FieldValue(peer.DecodeHeaders(frames[0]), "content-length"), "5");
+
+  ASSERT_TRUE(peer.SendRequest(5, "GET", "/nowhere", true));
+  frames = peer.Receive();
+  ASSERT_EQ(FieldValue(peer.DecodeHeaders(frames[0]), ":status"), "404");
+
+  // PING is echoed.
+  ASSERT_TRUE(peer.SendFrame(kPing, 0, 0, "12345678"));
+  frames = peer.Receive();
+  ASSERT_EQ(frames.size(), 1);
+  ASSERT_EQ(frames[0].type, kPing);
+  ASSERT_EQ(frames[0].flags, kAck);
+  ASSERT_EQ(frames[0].payload, "12345678");
+}
+
+TEST(H2Session, MultiplexesWithinFlowControl) {
+  ServeMux mux;
+  mux.set_handler("/big", [](const Request& req, Response* resp) {
+    resp->WriteText(Response::ok, std::string(100 * 1024, req.Param("c")[0]));
+  });
+
+  Peer peer(mux);
+  peer.Connect();
+  ASSERT_TRUE(peer.SendRequest(1, "GET", "/big?c=a", true));
+  ASSERT_TRUE(peer.SendRequest(3, "GET", "/big?c=b", true));
+
+  // Both share the default connection window of 65535 bytes, in turns.
+  auto data = OfType(peer.Receive(), kData);
+  size_t total = 0;
+  std::string order;
+  for (auto& f : data) {
+    total += f.payload.size();
+    ASSERT_LE(f.payload.size(), 16384);
+    order.push_back(f.payload[0]);
+  }
+  ASSERT_EQ(total, 65535);
+  ASSERT_EQ(order.substr(0, 4), "abab");
+
+  // More credit for the connection, then each stream runs out of its own.
+  ASSERT_TRUE(peer.SendFrame(kWindowUpdate, 0, 0, Frame32(1 << 20)));
+  data = OfType(peer.Receive(), kData);
+  size_t a = 0, b = 0;
+  for (auto& f : data) (f.id == 1 ? a : b) += f.payload.size();
+  ASSERT_EQ(total + a + b, 2 * 65535);
+
+  ASSERT_TRUE(peer.SendFrame(kWindowUpdate, 0, 1, Frame32(1 << 20)));
+  ASSERT_TRUE(peer.SendFrame(kWindowUpdate, 0, 3, Frame32(1 << 20)));
+  data = OfType(peer.Receive(), kData);
+  ASSERT_FALSE(data.empty());
+  for (auto& f : data) total += f.payload.size();
+  ASSERT_EQ(total + a + b, 2 * 100 * 1024);
+  ASSERT_EQ(data.back().flags, kEndStream);
+  ASSERT_EQ(peer.session().streams(), 0);
+}
+
+TEST(H2Session, RequestBody) {
+  ServeMux mux;
+  std::string content;
+  std::shared_ptr<std::string> rest = std::make_shared<std::string>();
+  int64_t source_size = 0;
+  mux.set_handler("/upload", [&](const Request& req, Response* resp) {
+    content = req.content;
+    source_size = req.body_source.size;
+    if (!req.body_source) {
+      resp->WriteText(Response::ok, std::to_string(content.size()));
+      return;
+    }
+
+    auto done = resp->Defer();
+    auto source = req.body_source;
+    auto read = std::make_shared<std::function<void()>>();
+    *read = [=]() {
+      source.read([=](const cppboot::Status& status,
+                      cppboot::string_view data) {
+        ASSERT_TRUE(status);
+        if (data.empty()) {
+          resp->WriteText(Response::ok,
+                          std::to_string(content.size() + rest->size()));
+          done();
+          // It references itself.
+          *read = nullptr;
+          return;
+        }
+        rest->append(data.data(), data.size());
+        (*read)();
+      });
+    };
+    (*read)();
+  });
+
+  Peer peer(mux);
+  peer.Connect();
+
+  // A small body is complete when the handler runs.
+  ASSERT_TRUE(peer.SendRequest(1, "POST", "/upload", false));
+  ASSERT_TRUE(peer.SendFrame(kData, 0, 1, "abc"));
+  ASSERT_TRUE(peer.SendFrame(kData, kEndStream, 1, "def"));
+  ASSERT_EQ(content, "abcdef");
+  auto frames = peer.Receive();
+  ASSERT_EQ(OfType(frames, kData).back().payload, "6");
+  // The data was credited back on the connection only, the stream is done.
+  auto updates = OfType(frames, kWindowUpdate);
+  ASSERT_EQ(updates.size(), 1);
+  ASSERT_EQ(updates[0].id, 0);
+  ASSERT_EQ(updates[0].Get32(), 6);
+
+  // A large one is read through the body_source, the peer is credited as it
+  // is read.
+  ASSERT_TRUE(peer.SendRequest(3, "POST", "/upload", false,
+                               {{"content-length", "60000"}}));
+  ASSERT_TRUE(peer.SendFrame(kData, 0, 3, std::string(16384, 'x')));
+  ASSERT_EQ(content.size(), 16384);
+  ASSERT_EQ(source_size, 60000 - 16384);
+  ASSERT_TRUE(rest->empty());
+  ASSERT_TRUE(peer.SendFrame(kData, 0, 3, std::string(16384, 'y')));
+  peer.RunPosted();
+  ASSERT_EQ(rest->size(), 16384);
+  ASSERT_GT(peer.wakes(), 0);
+  ASSERT_TRUE(peer.SendFrame(kData, 0, 3, std::string(16384, 'z')));
+  ASSERT_EQ(rest->size(), 2 * 16384);
+  ASSERT_TRUE(peer.SendFrame(kData, kEndStream, 3,
+                             std::string(60000 - 3 * 16384, 'w')));
+  peer.RunPosted();
+  ASSERT_EQ(rest->size(), 60000 - 16384);
+
+  frames = peer.Receive();
+  size_t stream_credit = 0;
+  for (auto& f : OfType(frames, kWindowUpdate)) {
+    if (f.id == 3) stream_credit += f.Get32();
+  }
+  // Not for the last frame, which ended the stream.
+  ASSERT_EQ(stream_credit, 3 * 16384);
+  auto data = OfType(frames, kData);
+  ASSERT_EQ(data.size(), 1);
+  ASSERT_EQ(data[0].id, 3);
+  ASSERT_EQ(data[0].payload, "60000");
+}
+
+TEST(H2Session, DeferredAndReset) {
+  ServeMux mux;
+  std::vector<std::pair<Response*, Response::DoneFunc>> pending;
+  mux.set_handler("/slow", [&pending](const Request&, Response* resp) {
+    pending.emplace_back(resp, resp->Defer());
+  });
+
+  Peer peer(mux);
+  peer.Connect();
+  ASSERT_TRUE(peer.SendRequest(1, "GET", "/slow", true));
+  ASSERT_TRUE(peer.SendRequest(3, "GET", "/slow", true));
+  ASSERT_TRUE(peer.Receive().empty());
+  ASSERT_EQ(peer.session().streams(), 2);
+
+  // Stream 1 is cancelled by the peer, its reply goes nowhere.
+  ASSERT_TRUE(peer.SendFrame(kRstStream, 0, 1, Frame32(0x8)));
+  ASSERT_EQ(peer.session().streams(), 1);
+  for (auto& p : pending) {
+    p.first->WriteText(Response::ok, "late");
+    p.second();
+  }
+  ASSERT_TRUE(peer.Receive().empty());
+  peer.RunPosted();
+
+  auto frames = peer.Receive();
+  ASSERT_EQ(frames.size(), 2);
+  ASSERT_EQ(frames[0].id, 3);
+  ASSERT_EQ(frames[1].payload, "late");
+  ASSERT_EQ(peer.session().streams(), 0);
+}
+
+TEST(H2Session, TooManyStreams) {
+  ServeMux mux;
+  std::vector<Response::DoneFunc> pending;
+  mux.set_handler("/slow", [&pending](const Request&, Response* resp) {
+    pending.push_back(resp->Defer());
+  });
+
+  Peer peer(mux);
+  peer.Connect();
+  for (uint32_t i = 0; i <= H2Session::kMaxConcurrentStreams; i++) {
+    ASSERT_TRUE(peer.SendRequest(2 * i + 1, "GET", "/slow", true));
+  }
+  auto frames = peer.Receive();
+  ASSERT_EQ(frames.size(), 1);
+  ASSERT_EQ(frames[0].type, kRstStream);
+  ASSERT_EQ(frames[0].id, 2 * H2Session::kMaxConcurrentStreams + 1);
+  ASSERT_EQ(frames[0].Get32(), 0x7);
+  ASSERT_EQ(pending.size(), H2Session::kMaxConcurrentStreams);
+}
+
+TEST(H2Session, Admission) {
+  ServeMux mux;
+  int served = 0;
+  mux.set_handler("/", [&served](const Request&, Response* resp) {
+    served++;
+    resp->WriteText(Response::ok, "ok");
+  });
+
+  Peer peer(mux);
+  std::vector<H2Session::AdmitCallback> queued;
+  peer.session().set_admit(
+      [&queued](H2Session::AdmitCallback cb) { queued.push_back(cb); });
+  peer.Connect();
+  ASSERT_TRUE(peer.SendRequest(1, "GET", "/", true));
+  ASSERT_TRUE(peer.SendRequest(3, "GET", "/", true));
+  ASSERT_EQ(queued.size(), 2);
+  ASSERT_EQ(served, 0);
+  ASSERT_TRUE(peer.Receive().empty());
+
+  // Shed, then admitted.
+  queued[0](Response::service_unavailable, std::chrono::seconds(2));
+  queued[1](Response::ok, std::chrono::seconds(0));
+  peer.RunPosted();
+  ASSERT_EQ(served, 1);
+  ASSERT_EQ(peer.wakes(), 2);
+
+  auto headers = OfType(peer.Receive(), kHeaders);
+  ASSERT_EQ(headers.size(), 2);
+  auto fields = peer.DecodeHeaders(headers[0]);
+  ASSERT_EQ(headers[0].id, 1);
+  ASSERT_EQ(FieldValue(fields, ":status"), "503");
+  ASSERT_EQ(FieldValue(fields, "retry-after"), "2");
+  ASSERT_EQ(headers[1].id, 3);
+  ASSERT_EQ(FieldValue(peer.DecodeHeaders(headers[1]), ":status"), "200");
+  ASSERT_EQ(peer.session().streams(), 0);
+}
+
+TEST(H2Session, ConnectionErrors) {
+  ServeMux mux;
+  {
+    Peer peer(mux);
+    ASSERT_TRUE(peer.session().Start());
+    ASSERT_FALSE(peer.Send("GET / HTTP/1.1\r\n\r\n"));
+    auto frames = peer.Receive();
+    ASSERT_EQ(frames.back().type, kGoAway);
+    ASSERT_EQ(frames.back().Get32(4), 0x1);
+    ASSERT_TRUE(peer.session().closed());
+  }
+  {
+    // DATA on a stream never opened.
+    Peer peer(mux);
+    peer.Connect();
+    ASSERT_FALSE(peer.SendFrame(kData, 0, 7, "x"));
+    ASSERT_EQ(peer.Receive().back().type, kGoAway);
+  }
+  {
+    // A header block interrupted by another frame.
+    Peer peer(mux);
+    peer.Connect();
+    ASSERT_TRUE(peer.SendFrame(kHeaders, 0, 1, "\x82"));
+    ASSERT_FALSE(peer.SendFrame(kPing, 0, 0, "12345678"));
+    ASSERT_EQ(peer.Receive().back().type, kGoAway);
+  }
+  {
+    // An invalid HPACK block.
+    Peer peer(mux);
+    peer.Connect();
+    ASSERT_FALSE(peer.SendFrame(kHeaders, kEndHeaders, 1, "\xff"));
+    ASSERT_EQ(peer.Receive().back().Get32(4), 0x9);
+  }
+  {
+    // A stream id lower than one already used.
+    Peer peer(mux);
+    peer.Connect();
+    ASSERT_TRUE(peer.SendRequest(3, "GET", "/", true));
+    ASSERT_FALSE(peer.SendRequest(1, "GET", "/", true));
+    ASSERT_EQ(peer.Receive().back().Get32(4), 0x1);
+  }
+}
+
+TEST(H2Session, ContentLengthMismatch) {
+  ServeMux mux;
+  int served = 0;
+  mux.set_handler("/", [&served](const Request&, Response* resp) {
+    served++;
+    resp->WriteText(Response::ok, "ok");
+  });
+
+  Peer peer(mux);
+  peer.Connect();
+  // Shorter than announced.
+  ASSERT_TRUE(peer.SendRequest(1, "POST", "/", false,
+                               {{"content-length", "5"}}));
+  ASSERT_TRUE(peer.SendFrame(kData, kEndStream, 1, "abc"));
+  // Longer.
+  ASSERT_TRUE(peer.SendRequest(3, "POST", "/", false,
+                               {{"content-length", "2"}}));
+  ASSERT_TRUE(peer.SendFrame(kData, 0, 3, "abc"));
+  // Announced without any DATA.
+  ASSERT_TRUE(peer.SendRequest(5, "POST", "/", true,
+                               {{"content-length", "1"}}));
+  // Matching.
+  ASSERT_TRUE(peer.SendRequest(7, "POST", "/", false,
+                               {{"content-length", "3"}}));
+  ASSERT_TRUE(peer.SendFrame(kData, kEndStream, 7, "abc"));
+
+  auto frames = peer.Receive();
+  auto resets = OfType(frames, kRstStream);
+  ASSERT_EQ(resets.size(), 3);
+  for (size_t i = 0; i < resets.size(); i++) {
+    ASSERT_EQ(resets[i].id, 2 * i + 1);
+    ASSERT_EQ(resets[i].Get32(), 0x1);
+  }
+  ASSERT_EQ(served, 1);
+  ASSERT_EQ(OfType(frames, kData).back().id, 7);
+  ASSERT_EQ(peer.session().streams(), 0);
+}
+
+TEST(H2Session, RapidReset) {
+  ServeMux mux;
+  mux.set_handler("/", [](const Request&, Response* resp) {
+    resp->WriteText(Response::ok, "ok");
+  });
+
+  Peer peer(mux);
+  peer.Connect();
+  uint32_t id = 1;
+  for (int i = 0; i < H2Session::kResetBudget; i++, id += 2) {
+    ASSERT_TRUE(peer.SendRequest(id, "POST", "/", false));
+    ASSERT_TRUE(peer.SendFrame(kRstStream, 0, id, Frame32(0x8)));
+  }
+  // A complete response earns one reset back.
+  ASSERT_TRUE(peer.SendRequest(id, "GET", "/", true));
+  ASSERT_EQ(OfType(peer.Receive(), kData).size(), 1);
+  id += 2;
+  ASSERT_TRUE(peer.SendRequest(id, "POST", "/", false));
+  ASSERT_TRUE(peer.SendFrame(kRstStream, 0, id, Frame32(0x8)));
+  id += 2;
+  ASSERT_TRUE(peer.SendRequest(id, "POST", "/", false));
+  ASSERT_FALSE(peer.SendFrame(kRstStream, 0, id, Frame32(0x8)));
+  auto frames = peer.Receive();
+  ASSERT_EQ(frames.back().type, kGoAway);
+  ASSERT_EQ(frames.back().Get32(4), 0xb);
+  ASSERT_TRUE(peer.session().closed());
+}
+
+TEST(H2Session, Continuation) {
+  ServeMux mux;
+  std::string value;
+  mux.set_handler("/", [&value](const Request& req, Response* resp) {
+    value = req.header("x-big").str();
+    resp->set_header("x-big", value);
+    resp->WriteText(Response::ok, "");
+  });
+
+  Peer peer(mux);
+  peer.Connect();
+  HpackEncoder encoder;
+  std::string block;
+  encoder.Begin(&block);
+  encoder.Add(":method", "GET", &block);
+  encoder.Add(":scheme", "http", &block);
+  encoder.Add(":path", "/", &block);
+  // Not Huffman coded, so the block is larger than a frame.
+  encoder.Add("x-big", std::string(20000, '\xfe'), &block);
+  ASSERT_TRUE(peer.SendFrame(kHeaders, kEndStream, 1, block.substr(0, 10000)));
+  ASSERT_TRUE(peer.SendFrame(kContinuation, kEndHeaders, 1,
+                             block.substr(10000)));
+  ASSERT_EQ(value.size(), 20000);
+
+  // The response head is split the same way.
+  auto frames = peer.Receive();
+  ASSERT_EQ(frames.size(), 2);
+  ASSERT_EQ(frames[0].type, kHeaders);
+  ASSERT_EQ(frames[0].flags, kEndStream);
+  ASSERT_EQ(frames[1].type, kContinuation);
+  ASSERT_EQ(frames[1].flags, kEndHeaders);
+}
+
+TEST(H2Session, Upgrade) {
+  ServeMux mux;
+  mux.set_handler("/", [](const Request& req, Response* resp) {
+    resp->WriteText(Response::ok, req.method + " " + req.content);
+  });
+
+  Peer peer(mux);
+  std::unique_ptr<Request> req(new Request);
+  req->method = "POST";
+  req->uri = "/";
+  req->path = "/";
+  req->content = "body";
+  // SETTINGS_MAX_FRAME_SIZE 16384, SETTINGS_INITIAL_WINDOW_SIZE 2.
+  ASSERT_TRUE(peer.session().Start("AAUAAEAAAAQAAAAC", std::move(req)));
+
+  auto frames = peer.Receive();
+  ASSERT_EQ(frames[0].type, kSettings);
+  auto data = OfType(frames, kData);
+  ASSERT_EQ(data.size(), 1);
+  ASSERT_EQ(data[0].id, 1);
+  ASSERT_EQ(data[0].payload, "PO");
+
+  ASSERT_FALSE(Peer(mux).session().Start("AAUAAEA", std::unique_ptr<Request>(
+                                                       new Request)));
+}
+
+}  // namespace
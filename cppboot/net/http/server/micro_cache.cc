@@ -0,0 +1,314 @@
+#include "cppboot/net/http/server/micro_cache.h"
+
+#include "cppboot/base/str_util.h"
+#include "cppboot/net/http/request.h"
+
+namespace cppboot {
+namespace http {
+
+/// A background fetch, owning the copy of the request that triggered it.
+struct MicroCache::Revalidation {
+  Request request;
+  Response response;
+};
+
+MicroCache::MicroCache(asio::io_context& io_context, const Options& options)
+    : io_context_(io_context),
+      options_(options),
+      hits_(0),
+      stale_hits_(0),
+      misses_(0),
+      coalesced_(0) {}
+
+MicroCache::~MicroCache() = default;
+
+ServeMux::Func MicroCache::Wrap(ServeMux::Func handler) {
+  return [this, handler](const Request& req, Response* rep) {
+    Serve(handler, req, rep);
+  };
+}
+
+MicroCache::Stats MicroCache::stats() const {
+  Stats stats;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.entries = entries_.size();
+  }
+  stats.hits = hits_;
+  stats.stale_hits = stale_hits_;
+  stats.misses = misses_;
+  stats.coalesced = coalesced_;
+  return stats;
+}
+
+void MicroCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+}
+
+void MicroCache::Serve(const ServeMux::Func& handler, const Request& req,
+                       Response* rep) {
+  // A reply to credentials is only shared with the same credentials.
+  if ((req.method != "GET" && req.method != "HEAD") ||
+      (req.headers.Has(kAuthorization) && !Varies("Authorization")) ||
+      (req.headers.Has(kCookie) && !Varies("Cookie"))) {
+    handler(req, rep);
+    return;
+  }
+
+  ContentEncoding encoding;
+  std::string key = Key(req, &encoding);
+  auto now = Clock::now();
+  bool revalidate = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end() && now < it->second->expires) {
+      hits_++;
+      Fill(*it->second, rep);
+      return;
+    }
+    if (it != entries_.end() &&
+        now < it->second->expires + options_.stale_while_revalidate) {
+      stale_hits_++;
+      Fill(*it->second, rep);
+      revalidate = fetching_.emplace(key, std::vector<Waiter>()).second;
+      if (!revalidate) return;
+    } else {
+      auto fetch = fetching_.find(key);
+      if (fetch != fetching_.end()) {
+        coalesced_++;
+        fetch->second.push_back(Waiter{&req, rep, rep->Defer()});
+        return;
+      }
+      misses_++;
+      fetching_.emplace(key, std::vector<Waiter>());
+    }
+  }
+
+  if (revalidate) {
+    Revalidate(handler, key, encoding, req);
+  } else {
+    Fetch(handler, key, encoding, req, rep);
+  }
+}
+
+std::string MicroCache::Key(const Request& req,
+                            ContentEncoding* encoding) const {
+  *encoding = options_.compress.enabled
+                  ? PreferredEncoding(req.headers.Get(kAcceptEncoding))
+                  : kIdentity;
+
+  std::string key;
+  key.reserve(req.method.size() + req.path.size() + 16);
+  key.append(req.method);
+  key.push_back('\0');
+  key.append(req.path);
+  key.push_back('\0');
+  key.append(EncodingName(*encoding));
+  for (auto& name : options_.vary_params) {
+    string_view value = req.Param(name);
+    key.push_back('\0');
+    key.append(value.data(), value.size());
+  }
+  for (auto& name : options_.vary_headers) {
+    string_view value = req.headers.Get(name);
+    key.push_back('\0');
+    key.append(value.data(), value.size());
+  }
+  return key;
+}
+
+bool MicroCache::Varies(string_view name) const noexcept {
+  for (auto& header : options_.vary_headers) {
+    if (EqualsIgnoreCase(header, name)) return true;
+  }
+  return false;
+}
+
+void MicroCache::Fetch(const ServeMux::Func& handler, const std::string& key,
+                       ContentEncoding encoding, const Request& req,
+                       Response* rep) {
+  // The reply is complete when the handler returns, or once it called the
+  // function returned by Defer().
+  auto defer_hook = std::move(rep->defer_hook);
+  bool deferred = false;
+  rep->defer_hook = [this, &handler, &defer_hook, &deferred, &key, encoding,
+                     rep]() {
+    deferred = true;
+    Response::DoneFunc done =
+        defer_hook ? defer_hook() : Response::DoneFunc([] {});
+    ServeMux::Func h = handler;
+    std::string k = key;
+    return Response::DoneFunc([this, h, k, encoding, rep, done]() {
+      Complete(h, k, encoding, rep);
+      done();
+    });
+  };
+  handler(req, rep);
+  rep->defer_hook = std::move(defer_hook);
+  if (!deferred) Complete(handler, key, encoding, rep);
+}
+
+void MicroCache::Revalidate(const ServeMux::Func& handler,
+                            const std::string& key, ContentEncoding encoding,
+                            const Request& req) {
+  auto job = std::make_shared<Revalidation>();
+  job->request = req;
+  job->request.body_source = BodySource();
+
+  ServeMux::Func h = handler;
+  asio::post(io_context_, [this, h, key, encoding, job]() {
+    Response* rep = &job->response;
+    rep->defer_hook = [job]() { return Response::DoneFunc([job]() {}); };
+    Fetch(h, key, encoding, job->request, rep);
+    // A deferred reply keeps the job alive through its done function.
+    rep->defer_hook = nullptr;
+  });
+}
+
+void MicroCache::Complete(const ServeMux::Func& handler,
+                          const std::string& key, ContentEncoding encoding,
+                          Response* rep) {
+  EntryPtr entry = MakeEntry(*rep, encoding);
+  std::vector<Waiter> waiters;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto fetch = fetching_.find(key);
+    if (fetch != fetching_.end()) {
+      waiters.swap(fetch->second);
+      fetching_.erase(fetch);
+    }
+    if (entry) {
+      if (entries_.size() >= options_.max_entries && !entries_.count(key)) {
+        Evict(Clock::now());
+      }
+      if (options_.max_entries > 0) entries_[key] = entry;
+    } else {
+      entries_.erase(key);
+    }
+  }
+
+  if (entry) Fill(*entry, rep);
+  for (auto& waiter : waiters) {
+    if (entry) {
+      Fill(*entry, waiter.rep);
+      waiter.done();
+    } else {
+      ServeMux::Func h = handler;
+      asio::post(io_context_, [h, waiter]() { Run(h, waiter); });
+    }
+  }
+}
+
+void MicroCache::Run(const ServeMux::Func& handler, const Waiter& waiter) {
+  Response* rep = waiter.rep;
+  auto defer_hook = std::move(rep->defer_hook);
+  bool deferred = false;
+  Response::DoneFunc done = waiter.done;
+  rep->defer_hook = [&deferred, done]() {
+    deferred = true;
+    return done;
+  };
+  handler(*waiter.req, rep);
+  rep->defer_hook = std::move(defer_hook);
+  if (!deferred) done();
+}
+
+MicroCache::EntryPtr MicroCache::MakeEntry(const Response& rep,
+                                           ContentEncoding encoding) const {
+  switch (rep.status) {
+    case Response::ok:
+    case Response::moved_permanently:
+    case Response::moved_temporarily:
+    case Response::not_found:
+      break;
+    default:
+      return nullptr;
+  }
+  string_view cache_control = rep.headers.Get(kCacheControl);
+  if (rep.file_body || rep.body_source || rep.takeover ||
+      rep.headers.Has(kSetCookie) ||
+      cache_control.find("no-store") != string_view::npos ||
+      cache_control.find("private") != string_view::npos) {
+    return nullptr;
+  }
+  string_view body = rep.body();
+  if (body.size() > options_.max_body_size) return nullptr;
+
+  // The reply may only depend on what the key is made of.
+  string_view vary = rep.headers.Get(kVary);
+  bool vary_encoding = false;
+  for (string_view rest = vary; !rest.empty();) {
+    size_t comma = rest.find(',');
+    string_view name = rest.substr(0, comma);
+    rest.remove_prefix(comma == string_view::npos ? rest.size() : comma + 1);
+    while (!name.empty() && (name.front() == ' ' || name.front() == '\t')) {
+      name.remove_prefix(1);
+    }
+    while (!name.empty() && (name.back() == ' ' || name.back() == '\t')) {
+      name.remove_suffix(1);
+    }
+    if (EqualsIgnoreCase(name, "Accept-Encoding")) {
+      vary_encoding = true;
+    } else if (!name.empty() && (name == "*" || !Varies(name))) {
+      return nullptr;
+    }
+  }
+
+  auto entry = std::make_shared<Entry>();
+  entry->status = rep.status;
+  // Copied, the reply may reference what only lives as long as it.
+  for (auto& f : rep.headers) entry->headers.Add(f.name, f.value);
+  entry->expires = Clock::now() + options_.ttl;
+
+  const CompressOptions& compress = options_.compress;
+  if (rep.status == Response::ok && encoding != kIdentity &&
+      body.size() >= compress.min_size &&
+      !rep.headers.Has(kContentEncoding) &&
+      IsCompressible(rep.headers.Get(kContentType))) {
+    int level =
+        encoding == kGzip ? compress.gzip_level : compress.brotli_quality;
+    std::string out;
+    if (Compress(encoding, body, level, &out) && out.size() < body.size()) {
+      entry->headers.Set(kContentLength, std::to_string(out.size()));
+      entry->headers.Set(kContentEncoding, EncodingName(encoding));
+      if (vary.empty()) {
+        entry->headers.Set(kVary, "Accept-Encoding");
+      } else if (!vary_encoding) {
+        entry->headers.Set(kVary, vary.str() + ", Accept-Encoding");
+      }
+      entry->body = std::make_shared<const std::string>(std::move(out));
+    }
+  }
+  if (!entry->body) {
+    entry->body = rep.shared_content
+                      ? rep.shared_content
+                      : std::make_shared<const std::string>(body.str());
+  }
+  return entry;
+}
+
+void MicroCache::Fill(const Entry& entry, Response* rep) {
+  rep->status = entry.status;
+  rep->headers = entry.headers;
+  rep->content.clear();
+  rep->shared_content = entry.body;
+  rep->static_content = string_view();
+}
+
+void MicroCache::Evict(Clock::time_point now) {
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    if (now >= it->second->expires + options_.stale_while_revalidate) {
+      it = entries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  while (!entries_.empty() && entries_.size() >= options_.max_entries) {
+    entries_.erase(entries_.begin());
+  }
+}
+
+}  // namespace http
+}  // namespace cppboot
@@ -0,0 +1,170 @@
+#ifndef CPPBOOT_NET_HTTP_SERVER_MICRO_CACHE_H_
+#define CPPBOOT_NET_HTTP_SERVER_MICRO_CACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "asio.hpp"
+
+#include "cppboot/net/http/compress.h"
+#include "cppboot/net/http/header.h"
+#include "cppboot/net/http/response.h"
+#include "cppboot/net/http/server/serve_mux.h"
+
+namespace cppboot {
+namespace http {
+
+struct Request;
+
+/// Caches the replies of dynamic handlers for a short while, e.g.
+///
+///   MicroCache cache(server.io_context(), options);
+///   server.Handle("GET", "/api/prices", cache.Wrap(ServePrices));
+///
+/// GET and HEAD requests are keyed on their method, path, the query
+/// parameters and headers listed in the options, and the content coding
+/// negotiated from Accept-Encoding. A reply stays fresh for Options::ttl,
+/// then is still served for Options::stale_while_revalidate while one
+/// request refreshes it in the background. Requests for a key being
+/// fetched wait for that fetch instead of running the handler again, so a
+/// burst of them costs one handler call.
+///
+/// Requests with Authorization or Cookie bypass the cache unless the header
+/// is in Options::vary_headers. Replies 200, 301, 302 and 404 with an
+/// in-memory body are cached unless they set cookies, Cache-Control
+/// no-store or private, or Vary on a header the key does not include.
+/// Their body is compressed once when stored and shared by the replies
+/// served from the cache. Requests that waited for a reply which can not be
+/// cached run the handler themselves.
+///
+/// Handlers may Defer() their reply. Background fetches and the handler
+/// calls of waiting requests are posted to `io_context`, the one running
+/// the server.
+class MicroCache {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Options {
+    Options()
+        : ttl(std::chrono::seconds(1)),
+          stale_while_revalidate(0),
+          max_entries(1024),
+          max_body_size(1024 * 1024) {}
+
+    /// How long a reply is served without calling the handler.
+    std::chrono::milliseconds ttl;
+    /// How long past `ttl` a reply is still served while it is refreshed.
+    std::chrono::milliseconds stale_while_revalidate;
+    /// Query parameters and request headers the reply depends on.
+    std::vector<std::string> vary_params;
+    std::vector<std::string> vary_headers;
+    size_t max_entries;
+    /// Larger bodies are not cached.
+    size_t max_body_size;
+    CompressOptions compress;
+  };
+
+  struct Stats {
+    size_t entries;
+    /// Requests served from a fresh or stale entry.
+    uint64_t hits;
+    uint64_t stale_hits;
+    /// Requests that called the handler, and that waited for another one.
+    uint64_t misses;
+    uint64_t coalesced;
+  };
+
+  MicroCache(const MicroCache&) = delete;
+  MicroCache& operator=(const MicroCache&) = delete;
+
+  explicit MicroCache(asio::io_context& io_context,
+                      const Options& options = Options());
+  ~MicroCache();
+
+  /// `handler` behind the cache. The cache must outlive the result, and be
+  /// destroyed after the server using it was shut down.
+  ServeMux::Func Wrap(ServeMux::Func handler);
+
+  /// May be called from any thread.
+  Stats stats() const;
+
+  void Clear();
+
+ private:
+  struct Entry {
+    Response::status_type status;
+    Headers headers;
+    std::shared_ptr<const std::string> body;
+    /// Fresh until then, then stale for stale_while_revalidate.
+    Clock::time_point expires;
+  };
+  typedef std::shared_ptr<const Entry> EntryPtr;
+
+  /// A request waiting for the fetch of its key.
+  struct Waiter {
+    const Request* req;
+    Response* rep;
+    Response::DoneFunc done;
+  };
+
+  struct Revalidation;
+
+  void Serve(const ServeMux::Func& handler, const Request& req,
+             Response* rep);
+
+  /// The key of `req`, and the coding its reply is cached with.
+  std::string Key(const Request& req, ContentEncoding* encoding) const;
+
+  /// Whether the request header `name` is part of the key.
+  bool Varies(string_view name) const noexcept;
+
+  /// Call `handler` to fetch the reply for `key`, then Complete().
+  void Fetch(const ServeMux::Func& handler, const std::string& key,
+             ContentEncoding encoding, const Request& req, Response* rep);
+
+  /// Refresh the stale entry for `key` with a copy of `req`.
+  void Revalidate(const ServeMux::Func& handler, const std::string& key,
+                  ContentEncoding encoding, const Request& req);
+
+  /// Store the reply fetched for `key` if it can be cached, and complete
+  /// the waiting requests.
+  void Complete(const ServeMux::Func& handler, const std::string& key,
+                ContentEncoding encoding, Response* rep);
+
+  /// Call `handler` for a waiting request whose reply can not be shared.
+  static void Run(const ServeMux::Func& handler, const Waiter& waiter);
+
+  /// The entry for `rep`, null if it can not be cached.
+  EntryPtr MakeEntry(const Response& rep, ContentEncoding encoding) const;
+
+  static void Fill(const Entry& entry, Response* rep);
+
+  /// Make room for one more entry, called with `mutex_` held.
+  void Evict(Clock::time_point now);
+
+  asio::io_context& io_context_;
+  Options options_;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, EntryPtr> entries_;
+  /// Keys being fetched, and the requests waiting for them.
+  std::unordered_map<std::string, std::vector<Waiter>> fetching_;
+
+  std::atomic<uint64_t> hits_;
+  std::atomic<uint64_t> stale_hits_;
+  std::atomic<uint64_t> misses_;
+  std::atomic<uint64_t> coalesced_;
+};
+
+}  // namespace http
+}  // namespace cppboot
+
+#endif  // CPPBOOT_NET_HTTP_SERVER_MICRO_CACHE_H_
@@ -0,0 +1,330 @@
+#include "gmock/gmock.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cppboot/net/http/compress.h"
+#include "cppboot/net/http/request.h"
+#include "cppboot/net/http/response.h"
+#include "cppboot/net/http/server/micro_cache.h"
+#include "cppboot/net/http/server/request_parser.h"
+
+namespace {
+
+using cppboot::http::MicroCache;
+using cppboot::http::Request;
+using cppboot::http::RequestParser;
+using cppboot::http::Response;
+using std::chrono::milliseconds;
+
+Request MakeRequest(const std::string& method, const std::string& uri) {
+  Request req;
+  req.method = method;
+  req.uri = uri;
+  RequestParser::parse_uri(req);
+  return req;
+}
+
+/// A reply as the connection would hold it, noticing Defer().
+struct Reply {
+  Reply() : deferred(false), done(false) {
+    rep.defer_hook = [this]() {
+      deferred = true;
+      return Response::DoneFunc([this]() { done = true; });
+    };
+  }
+
+  std::string body() const { return rep.body().str(); }
+
+  Response rep;
+  bool deferred;
+  bool done;
+};
+
+/// Counts its calls and replies with the count.
+class CountingHandler {
+ public:
+  CountingHandler() : calls_(0) {}
+
+  void operator()(const Request& req, Response* rep) {
+    calls_++;
+    rep->status = Response::ok;
+    rep->set_header("Content-Type", "text/plain");
+    rep->content = req.path + " " + std::to_string(calls_);
+  }
+
+  int calls() const { return calls_; }
+
+ private:
+  int calls_;
+};
+
+TEST(MicroCache, Hit) {
+  asio::io_context io_context;
+  MicroCache::Options options;
+  options.vary_params = {"page"};
+  MicroCache cache(io_context, options);
+  CountingHandler handler;
+  auto serve = cache.Wrap(std::ref(handler));
+
+  Reply a, b, c, d;
+  serve(MakeRequest("GET", "/list?page=1"), &a.rep);
+  serve(MakeRequest("GET", "/list?page=1&other=x"), &b.rep);
+  ASSERT_EQ(a.body(), "/list 1");
+  ASSERT_EQ(b.body(), "/list 1");
+  // The body is shared, not copied.
+  ASSERT_EQ(a.rep.shared_content, b.rep.shared_content);
+  ASSERT_EQ(b.rep.header("Content-Type"), "text/plain");
+
+  serve(MakeRequest("GET", "/list?page=2"), &c.rep);
+  ASSERT_EQ(c.body(), "/list 2");
+
+  // Other methods are not cached.
+  serve(MakeRequest("POST", "/list?page=1"), &d.rep);
+  ASSERT_EQ(d.body(), "/list 3");
+
+  auto stats = cache.stats();
+  ASSERT_EQ(stats.entries, 2);
+  ASSERT_EQ(stats.hits, 1);
+  ASSERT_EQ(stats.misses, 2);
+}
+
+TEST(MicroCache, VaryHeaders) {
+  asio::io_context io_context;
+  MicroCache::Options options;
+  options.vary_headers = {"Accept-Language"};
+  MicroCache cache(io_context, options);
+  CountingHandler handler;
+  auto serve = cache.Wrap(std::ref(handler));
+
+  Request en = MakeRequest("GET", "/");
+  en.headers.Add("Accept-Language", "en");
+  Request fr = MakeRequest("GET", "/");
+  fr.headers.Add("Accept-Language", "fr");
+
+  Reply a, b, c;
+  serve(en, &a.rep);
+  serve(fr, &b.rep);
+  serve(en, &c.rep);
+  ASSERT_EQ(a.body(), "/ 1");
+  ASSERT_EQ(b.body(), "/ 2");
+  ASSERT_EQ(c.body(), "/ 1");
+}
+
+TEST(MicroCache, Credentials) {
+  asio::io_context io_context;
+  MicroCache::Options options;
+  options.vary_headers = {"cookie"};
+  MicroCache cache(io_context, options);
+  CountingHandler handler;
+  auto serve = cache.Wrap(std::ref(handler));
+
+  // Not shared, nor served from the cache.
+  Request authorized = MakeRequest("GET", "/");
+  authorized.headers.Add("Authorization", "Bearer secret");
+  Reply a, b, c;
+  serve(MakeRequest("GET", "/"), &a.rep);
+  serve(authorized, &b.rep);
+  serve(authorized, &c.rep);
+  ASSERT_EQ(a.body(), "/ 1");
+  ASSERT_EQ(b.body(), "/ 2");
+  ASSERT_EQ(c.body(), "/ 3");
+
+  // Listed, it is part of the key.
+  Request alice = MakeRequest("GET", "/");
+  alice.headers.Add("Cookie", "user=alice");
+  Request bob = MakeRequest("GET", "/");
+  bob.headers.Add("Cookie", "user=bob");
+  Reply d, e, f;
+  serve(alice, &d.rep);
+  serve(bob, &e.rep);
+  serve(alice, &f.rep);
+  ASSERT_EQ(d.body(), "/ 4");
+  ASSERT_EQ(e.body(), "/ 5");
+  ASSERT_EQ(f.body(), "/ 4");
+}
+
+TEST(MicroCache, ReplyVary) {
+  asio::io_context io_context;
+  MicroCache::Options options;
+  options.vary_headers = {"Accept-Language"};
+  MicroCache cache(io_context, options);
+  int calls = 0;
+  auto serve = cache.Wrap([&calls](const Request& req, Response* rep) {
+    calls++;
+    rep->WriteText(Response::ok, std::to_string(calls));
+    if (req.path == "/language") {
+      rep->set_header("Vary", "Accept-Encoding, accept-language");
+    } else if (req.path == "/agent") {
+      rep->set_header("Vary", "User-Agent");
+    } else {
+      rep->set_header("Vary", "*");
+    }
+  });
+
+  Reply a, b, c, d, e, f;
+  serve(MakeRequest("GET", "/language"), &a.rep);
+  serve(MakeRequest("GET", "/language"), &b.rep);
+  ASSERT_EQ(b.body(), "1");
+  // Not in the key, or anything.
+  serve(MakeRequest("GET", "/agent"), &c.rep);
+  serve(MakeRequest("GET", "/agent"), &d.rep);
+  ASSERT_EQ(d.body(), "3");
+  serve(MakeRequest("GET", "/any"), &e.rep);
+  serve(MakeRequest("GET", "/any"), &f.rep);
+  ASSERT_EQ(f.body(), "5");
+  ASSERT_EQ(cache.stats().entries, 1);
+}
+
+TEST(MicroCache, Expires) {
+  asio::io_context io_context;
+  MicroCache::Options options;
+  options.ttl = milliseconds(20);
+  MicroCache cache(io_context, options);
+  CountingHandler handler;
+  auto serve = cache.Wrap(std::ref(handler));
+
+  Reply a, b;
+  serve(MakeRequest("GET", "/"), &a.rep);
+  std::this_thread::sleep_for(milliseconds(30));
+  serve(MakeRequest("GET", "/"), &b.rep);
+  ASSERT_EQ(a.body(), "/ 1");
+  ASSERT_EQ(b.body(), "/ 2");
+}
+
+TEST(MicroCache, StaleWhileRevalidate) {
+  asio::io_context io_context;
+  MicroCache::Options options;
+  options.ttl = milliseconds(20);
+  options.stale_while_revalidate = std::chrono::seconds(10);
+  MicroCache cache(io_context, options);
+  CountingHandler handler;
+  auto serve = cache.Wrap(std::ref(handler));
+
+  Reply a;
+  serve(MakeRequest("GET", "/"), &a.rep);
+  std::this_thread::sleep_for(milliseconds(30));
+
+  // Stale replies are served right away, one refresh runs meanwhile.
+  Reply b, c;
+  serve(MakeRequest("GET", "/"), &b.rep);
+  serve(MakeRequest("GET", "/"), &c.rep);
+  ASSERT_EQ(b.body(), "/ 1");
+  ASSERT_EQ(c.body(), "/ 1");
+  ASSERT_FALSE(b.deferred);
+  ASSERT_EQ(handler.calls(), 1);
+
+  io_context.run();
+  ASSERT_EQ(handler.calls(), 2);
+  Reply d;
+  serve(MakeRequest("GET", "/"), &d.rep);
+  ASSERT_EQ(d.body(), "/ 2");
+  ASSERT_EQ(cache.stats().stale_hits, 2);
+}
+
+TEST(MicroCache, Coalesce) {
+  asio::io_context io_context;
+  MicroCache cache(io_context);
+  int calls = 0;
+  Response::DoneFunc finish;
+  auto serve = cache.Wrap([&calls, &finish](const Request&, Response* rep) {
+    calls++;
+    auto done = rep->Defer();
+    finish = [rep, done]() {
+      rep->status = Response::ok;
+      rep->content = "slow";
+      done();
+    };
+  });
+
+  Request req = MakeRequest("GET", "/slow");
+  std::vector<Reply> replies(3);
+  for (auto& reply : replies) serve(req, &reply.rep);
+  ASSERT_EQ(calls, 1);
+  for (auto& reply : replies) {
+    ASSERT_TRUE(reply.deferred);
+    ASSERT_FALSE(reply.done);
+  }
+
+  finish();
+  for (auto& reply : replies) {
+    ASSERT_TRUE(reply.done);
+    ASSERT_EQ(reply.body(), "slow");
+  }
+  ASSERT_EQ(cache.stats().coalesced, 2);
+
+  Reply cached;
+  serve(req, &cached.rep);
+  ASSERT_FALSE(cached.deferred);
+  ASSERT_EQ(cached.body(), "slow");
+  ASSERT_EQ(calls, 1);
+}
+
+TEST(MicroCache, NotCacheable) {
+  asio::io_context io_context;
+  MicroCache cache(io_context);
+  int calls = 0;
+  std::vector<Response::DoneFunc> pending;
+  auto serve = cache.Wrap([&calls, &pending](const Request&, Response* rep) {
+    calls++;
+    auto done = rep->Defer();
+    int call = calls;
+    pending.push_back([rep, done, call]() {
+      rep->status = Response::ok;
+      rep->set_header("Set-Cookie", "session=" + std::to_string(call));
+      done();
+    });
+  });
+
+  Request req = MakeRequest("GET", "/me");
+  Reply a, b;
+  serve(req, &a.rep);
+  serve(req, &b.rep);
+  ASSERT_EQ(calls, 1);
+
+  // The waiting request gets its own reply.
+  pending[0]();
+  ASSERT_TRUE(a.done);
+  ASSERT_FALSE(b.done);
+  io_context.run();
+  ASSERT_EQ(calls, 2);
+  pending[1]();
+  ASSERT_TRUE(b.done);
+  ASSERT_EQ(a.rep.header("Set-Cookie"), "session=1");
+  ASSERT_EQ(b.rep.header("Set-Cookie"), "session=2");
+  ASSERT_EQ(cache.stats().entries, 0);
+}
+
+TEST(MicroCache, Compressed) {
+  if (!cppboot::http::IsEncodingSupported(cppboot::http::kGzip)) return;
+
+  asio::io_context io_context;
+  MicroCache cache(io_context);
+  int calls = 0;
+  auto serve = cache.Wrap([&calls](const Request&, Response* rep) {
+    calls++;
+    rep->status = Response::ok;
+    rep->set_header("Content-Type", "application/json");
+    rep->content = "[" + std::string(4096, '1') + "]";
+  });
+
+  Request gzip = MakeRequest("GET", "/data");
+  gzip.headers.Add("Accept-Encoding", "gzip");
+  Reply a, b, c;
+  serve(gzip, &a.rep);
+  serve(gzip, &b.rep);
+  ASSERT_EQ(calls, 1);
+  ASSERT_EQ(b.rep.header("Content-Encoding"), "gzip");
+  ASSERT_LT(b.body().size(), 4096);
+  ASSERT_EQ(a.rep.shared_content, b.rep.shared_content);
+
+  // Clients not accepting it get their own variant.
+  serve(MakeRequest("GET", "/data"), &c.rep);
+  ASSERT_EQ(calls, 2);
+  ASSERT_TRUE(c.rep.header("Content-Encoding").empty());
+  ASSERT_EQ(c.body().size(), 4098);
+}
+
+}  // namespace
@@ -0,0 +1,91 @@
+#ifndef CPPBOOT_NET_HTTP_SERVER_MIDDLEWARE_H_
+#define CPPBOOT_NET_HTTP_SERVER_MIDDLEWARE_H_
+
+#include <type_traits>
+#include <utility>
+
+namespace cppboot {
+namespace http {
+
+struct Request;
+struct Response;
+
+/// Base of middlewares, doing nothing. A middleware hides either function:
+///
+///   struct RequireToken : Middleware {
+///     bool Before(const Request& req, Response* rep) {
+///       if (req.header("Authorization") == "Bearer secret") return true;
+///       *rep = Response::stock_reply(Response::unauthorized);
+///       return false;
+///     }
+///   };
+///
+/// The functions are not virtual, a chain calls those of the middleware's
+/// own type.
+struct Middleware {
+  /// Called before the rest of the chain, returns false to reply with `rep`
+  /// right away.
+  bool Before(const Request&, Response*) { return true; }
+
+  /// Called after the rest of the chain returned, to post-process `rep`.
+  /// The reply is as the handler left it, not finished yet if the handler
+  /// deferred it.
+  void After(const Request&, Response*) {}
+};
+
+/// A handler behind middlewares, composed into one object at compile time
+/// so that a request goes through them without allocating or any indirect
+/// call, see MakeChain().
+template <class Handler, class... Middlewares>
+class Chain;
+
+template <class Handler>
+class Chain<Handler> {
+ public:
+  explicit Chain(Handler handler) : handler_(std::move(handler)) {}
+
+  void operator()(const Request& req, Response* rep) { handler_(req, rep); }
+
+ private:
+  Handler handler_;
+};
+
+template <class Handler, class First, class... Rest>
+class Chain<Handler, First, Rest...> {
+ public:
+  Chain(Handler handler, First first, Rest... rest)
+      : first_(std::move(first)),
+        rest_(std::move(handler), std::move(rest)...) {}
+
+  void operator()(const Request& req, Response* rep) {
+    if (!first_.Before(req, rep)) return;
+    rest_(req, rep);
+    first_.After(req, rep);
+  }
+
+ private:
+  First first_;
+  Chain<Handler, Rest...> rest_;
+};
+
+/// `handler` behind `middlewares`, the first one outermost, e.g.
+///
+///   server.Handle("/admin/{page}",
+///                 MakeChain(ServeAdmin, RequireToken(), CountRequests(&n)));
+///
+/// The chain is stored in the route once, as a single ServeMux::Func.
+/// Middlewares are copied into it and keep their state across requests.
+template <class Handler, class... Middlewares>
+Chain<typename std::decay<Handler>::type,
+      typename std::decay<Middlewares>::type...>
+MakeChain(Handler&& handler, Middlewares&&... middlewares) {
+  return Chain<typename std::decay<Handler>::type,
+               typename std::decay<Middlewares>::type...>(
+      std::forward<Handler>(handler),
+      std::forward<Middlewares>(middlewares)...);
+}
+
+}  // namespace http
+}  // namespace cppboot
+
+#endif  // CPPBOOT_NET_HTTP_SERVER_MIDDLEWARE_H_
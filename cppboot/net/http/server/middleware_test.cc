@@ -0,0 +1,118 @@
+#include "gmock/gmock.h"
+
+#include <string>
+
+#include "cppboot/net/http/request.h"
+#include "cppboot/net/http/response.h"
+#include "cppboot/net/http/server/middleware.h"
+#include "cppboot/net/http/server/serve_mux.h"
+
+namespace {
+
+using cppboot::http::MakeChain;
+using cppboot::http::Middleware;
+using cppboot::http::Request;
+using cppboot::http::Response;
+using cppboot::http::ServeMux;
+
+/// Appends its name to the trace before and after the rest of the chain.
+struct Trace : Middleware {
+  Trace(const char* name, std::string* trace) : name(name), trace(trace) {}
+
+  bool Before(const Request&, Response*) {
+    *trace += std::string(name) + "<";
+    return true;
+  }
+
+  void After(const Request&, Response*) { *trace += std::string(">") + name; }
+
+  const char* name;
+  std::string* trace;
+};
+
+struct RequireToken : Middleware {
+  bool Before(const Request& req, Response* rep) {
+    if (req.header("Authorization") == "Bearer secret") return true;
+    *rep = Response::stock_reply(Response::unauthorized);
+    return false;
+  }
+};
+
+/// Counts the requests through it, its state lives in the chain.
+struct CountRequests : Middleware {
+  CountRequests() : count(0) {}
+
+  void After(const Request&, Response* rep) {
+    count++;
+    rep->set_header("X-Count", std::to_string(count));
+  }
+
+  int count;
+};
+
+void ServeHello(const Request&, Response* rep) {
+  rep->status = Response::ok;
+  rep->content = "hello";
+}
+
+TEST(Middleware, Order) {
+  std::string trace;
+  ServeMux mux;
+  mux.set_handler("/", MakeChain(
+                           [&trace](const Request& req, Response* rep) {
+                             trace += "handler";
+                             ServeHello(req, rep);
+                           },
+                           Trace("a", &trace), Trace("b", &trace)));
+
+  Request req;
+  req.path = "/";
+  Response rep;
+  mux.ServeHttp(req, &rep);
+  ASSERT_EQ(trace, "a<b<handler>b>a");
+  ASSERT_EQ(rep.content, "hello");
+}
+
+TEST(Middleware, ShortCircuit) {
+  std::string trace;
+  ServeMux mux;
+  mux.set_handler("/", MakeChain(ServeHello, Trace("a", &trace),
+                                 RequireToken(), Trace("b", &trace)));
+
+  Request req;
+  req.path = "/";
+  Response rep;
+  mux.ServeHttp(req, &rep);
+  ASSERT_EQ(rep.status, Response::unauthorized);
+  ASSERT_EQ(trace, "a<>a");
+
+  req.headers.Add("Authorization", "Bearer secret");
+  rep = Response();
+  trace.clear();
+  mux.ServeHttp(req, &rep);
+  ASSERT_EQ(rep.status, Response::ok);
+  ASSERT_EQ(trace, "a<b<>b>a");
+}
+
+TEST(Middleware, PostProcess) {
+  ServeMux mux;
+  mux.set_handler("/", MakeChain(ServeHello, CountRequests()));
+
+  Request req;
+  req.path = "/";
+  for (int i = 1; i <= 3; i++) {
+    Response rep;
+    mux.ServeHttp(req, &rep);
+    ASSERT_EQ(rep.header("X-Count"), std::to_string(i));
+  }
+}
+
+TEST(Middleware, NoMiddleware) {
+  auto chain = MakeChain(ServeHello);
+  Request req;
+  Response rep;
+  chain(req, &rep);
+  ASSERT_EQ(rep.content, "hello");
+}
+
+}  // namespace
@@ -1,24 +1,49 @@
 #include "cppboot/net/http/server/request_parser.h"
 #include "cppboot/net/http/request.h"
+#include "cppboot/net/http/url.h"
 
 namespace cppboot {
 namespace http {
 
-RequestParser::RequestParser() : state_(method_start) {}
+RequestParser::RequestParser()
+    : state_(method_start),
+      name_begin_(nullptr),
+      name_end_(nullptr),
+      value_begin_(nullptr),
+      folded_(false) {}
 
 void RequestParser::reset() { state_ = method_start; }
 
+void RequestParser::AddHeader(Request& req, const char* end) {
+  string_view value(value_begin_, end - value_begin_);
+  if (!folded_) {
+    req.headers.AddRef(string_view(name_begin_, name_end_ - name_begin_),
+                       value);
+    return;
+  }
+
+  // obs-fold, the lines are joined with a space into a copy.
+  size_t last = req.headers.size() - 1;
+  std::string joined = req.headers[last].value.str();
+  joined += ' ';
+  joined.append(value.data(), value.size());
+  req.headers.SetValue(last, joined);
+}
+
 void RequestParser::parse_uri(Request& req) {
-  auto sep = req.uri.find_first_of('?');
-  if (sep == std::string::npos) {
-    req.path = req.uri;
-  } else {
-    req.path = req.uri.substr(0, sep);
-    req.params.Parse(req.uri.substr(sep + 1));
+  auto sep = req.uri.find('?');
+  req.path.assign(req.uri, 0, sep);
+  if (!req.path.empty()) {
+    req.path.resize(UnescapeInPlace(&req.path[0], req.path.size(), false));
+  }
+  if (sep != std::string::npos) {
+    req.params.Parse(string_view(req.uri).substr(sep + 1));
   }
 }
 
-RequestParser::result_type RequestParser::consume(Request& req, char input) {
+RequestParser::result_type RequestParser::consume(Request& req,
+                                                  const char* p) {
+  char input = *p;
   switch (state_) {
     case method_start:
       if (!is_char(input) || is_ctl(input) || is_tspecial(input)) {
@@ -138,8 +163,8 @@ RequestParser::result_type RequestParser::consume(Request& req, char input) {
       } else if (!is_char(input) || is_ctl(input) || is_tspecial(input)) {
         return bad;
       } else {
-        req.headers.push_back(Header());
-        req.headers.back().name.push_back(input);
+        name_begin_ = p;
+        folded_ = false;
         state_ = header_name;
         return indeterminate;
       }
@@ -153,21 +178,23 @@ RequestParser::result_type RequestParser::consume(Request& req, char input) {
         return bad;
       } else {
         state_ = header_value;
-        req.headers.back().value.push_back(input);
+        value_begin_ = p;
+        folded_ = true;
         return indeterminate;
       }
     case header_name:
       if (input == ':') {
+        name_end_ = p;
         state_ = space_before_header_value;
         return indeterminate;
       } else if (!is_char(input) || is_ctl(input) || is_tspecial(input)) {
         return bad;
       } else {
-        req.headers.back().name.push_back(input);
         return indeterminate;
       }
     case space_before_header_value:
       if (input == ' ') {
+        value_begin_ = p + 1;
         state_ = header_value;
         return indeterminate;
       } else {
@@ -175,12 +202,12 @@ RequestParser::result_type RequestParser::consume(Request& req, char input) {
       }
     case header_value:
       if (input == '\r') {
+        AddHeader(req, p);
         state_ = expecting_newline_2;
         return indeterminate;
       } else if (is_ctl(input)) {
         return bad;
       } else {
-        req.headers.back().value.push_back(input);
         return indeterminate;
       }
     case expecting_newline_2:
@@ -230,31 +257,5 @@ bool RequestParser::is_tspecial(int c) {
 
 bool RequestParser::is_digit(int c) { return c >= '0' && c <= '9'; }
 
-bool RequestParser::UrlDecode(const std::string& in, std::string& out) {
-  out.clear();
-  out.reserve(in.size());
-  for (std::size_t i = 0; i < in.size(); ++i) {
-    if (in[i] == '%') {
-      if (i + 3 <= in.size()) {
-        int value = 0;
-        std::istringstream is(in.substr(i + 1, 2));
-        if (is >> std::hex >> value) {
-          out += static_cast<char>(value);
-          i += 2;
-        } else {
-          return false;
-        }
-      } else {
-        return false;
-      }
-    } else if (in[i] == '+') {
-      out += ' ';
-    } else {
-      out += in[i];
-    }
-  }
-  return true;
-}
-
 }  // namespace http
 }  // namespace cppboot
@@ -21,20 +21,19 @@ class RequestParser {
 
   /// Parse some data. The enum return value is good when a complete request has
   /// been parsed, bad if the data is invalid, indeterminate when more data is
-  /// required. The InputIterator return value indicates how much of the input
-  /// has been consumed.
-  template <typename InputIterator>
-  std::tuple<result_type, InputIterator> parse(Request& req,
-                                               InputIterator begin,
-                                               InputIterator end) {
+  /// required. The pointer return value indicates how much of the input has
+  /// been consumed.
+  ///
+  /// Header names and values reference the input instead of being copied, so
+  /// the data of all calls for one request has to be contiguous and stay
+  /// unchanged while the request is in use.
+  std::tuple<result_type, const char*> parse(Request& req, const char* begin,
+                                             const char* end) {
     while (begin != end) {
-      result_type result = consume(req, *begin++);
+      result_type result = consume(req, begin++);
       if (result == good || result == bad) {
         if (result == good) {
           req.content.assign(begin, end);
-          std::string url_decode;
-          UrlDecode(req.uri, url_decode);
-          req.uri = url_decode;
           parse_uri(req);
         }
         return std::make_tuple(result, begin);
@@ -43,13 +42,17 @@ class RequestParser {
     return std::make_tuple(indeterminate, begin);
   }
 
- private:
-  static bool UrlDecode(const std::string& in, std::string& out);
-
+  /// Set the decoded path of `req.uri` and keep its query to be parsed
+  /// lazily by `req.params`. The query is split before it is unescaped, so
+  /// an escaped '&' or '=' stays data.
   static void parse_uri(Request& req);
 
-  /// Handle the next character of input.
-  result_type consume(Request& req, char input);
+ private:
+  /// Handle the next character of input at `p`.
+  result_type consume(Request& req, const char* p);
+
+  /// Add the header that ends before `end`.
+  void AddHeader(Request& req, const char* end);
 
   /// Check if a byte is an HTTP character.
   static bool is_char(int c);
@@ -86,6 +89,13 @@ class RequestParser {
     expecting_newline_2,
     expecting_newline_3
   } state_;
+
+  /// The header being parsed.
+  const char* name_begin_;
+  const char* name_end_;
+  const char* value_begin_;
+  /// Whether the value continues a folded header line.
+  bool folded_;
 };
 
 }  // namespace http
@@ -0,0 +1,59 @@
+#include "gmock/gmock.h"
+
+#include <tuple>
+
+#include "cppboot/net/http/server/request_parser.h"
+
+using cppboot::http::Request;
+using cppboot::http::RequestParser;
+
+TEST(RequestParser, HeadersReferenceBuffer) {
+  std::string buffer =
+      "GET /a?x=1 HTTP/1.1\r\n"
+      "Host: example.com\r\n"
+      "X-Folded: one\r\n"
+      "  two\r\n"
+      "Accept-Encoding: gzip\r\n"
+      "\r\n";
+
+  // Split into two reads of the same buffer.
+  Request req;
+  RequestParser parser;
+  RequestParser::result_type result;
+  const char* begin = buffer.data();
+  const char* mid = begin + 30;
+  std::tie(result, std::ignore) = parser.parse(req, begin, mid);
+  ASSERT_EQ(result, RequestParser::indeterminate);
+  std::tie(result, std::ignore) =
+      parser.parse(req, mid, begin + buffer.size());
+  ASSERT_EQ(result, RequestParser::good);
+
+  ASSERT_EQ(req.method, "GET");
+  ASSERT_EQ(req.path, "/a");
+  ASSERT_EQ(req.headers.size(), 3);
+  ASSERT_EQ(req.header("host"), "example.com");
+  ASSERT_EQ(req.header("X-Folded"), "one two");
+  ASSERT_EQ(req.headers.Get(cppboot::http::kAcceptEncoding), "gzip");
+
+  auto host = req.header("Host");
+  ASSERT_GE(host.data(), buffer.data());
+  ASSERT_LT(host.data(), buffer.data() + buffer.size());
+}
+
+TEST(RequestParser, DecodesPathButSplitsQueryFirst) {
+  std::string buffer =
+      "GET /a%20b+c/%zz?q=a%26b%3Dc&name=J%C3%B6rg+M&q=2 HTTP/1.0\r\n"
+      "\r\n";
+
+  Request req;
+  RequestParser parser;
+  RequestParser::result_type result;
+  std::tie(result, std::ignore) =
+      parser.parse(req, buffer.data(), buffer.data() + buffer.size());
+  ASSERT_EQ(result, RequestParser::good);
+
+  ASSERT_EQ(req.path, "/a b+c/%zz");
+  ASSERT_EQ(req.Param("q"), "a&b=c");
+  ASSERT_EQ(req.Param("name"), "J\xC3\xB6rg M");
+  ASSERT_EQ(req.params.GetAll("q").size(), 2);
+}
@@ -0,0 +1,364 @@
+#include "cppboot/net/http/server/reverse_proxy.h"
+
+#include <algorithm>
+
+#include "cppboot/base/str_util.h"
+#include "cppboot/net/http/request.h"
+#include "cppboot/net/http/response.h"
+
+namespace cppboot {
+namespace http {
+
+namespace {
+
+/// Whether the field only concerns one connection and must not be relayed:
+/// the standard hop-by-hop fields and those listed by `connection`.
+bool IsHopByHop(const Headers::Field& f, string_view connection) {
+  switch (f.id) {
+    case kConnection:
+    case kKeepAlive:
+    case kTransferEncoding:
+    case kUpgrade:
+      return true;
+    case kOtherHeader:
+      break;
+    default:
+      return false;
+  }
+
+  static const char* const kNames[] = {"TE", "Trailer", "Proxy-Authenticate",
+                                       "Proxy-Authorization",
+                                       "Proxy-Connection"};
+  for (const char* name : kNames) {
+    if (EqualsIgnoreCase(f.name, name)) return true;
+  }
+
+  while (!connection.empty()) {
+    size_t comma = connection.find(',');
+    if (EqualsIgnoreCase(StrTrim(connection.substr(0, comma)), f.name)) {
+      return true;
+    }
+    connection = comma == string_view::npos ? string_view()
+                                            : connection.substr(comma + 1);
+  }
+  return false;
+}
+
+bool IsGatewayError(int status) {
+  return status == 502 || status == 503 || status == 504;
+}
+
+}  // namespace
+
+/// One relayed request. The body of the backend's response is handed to the
+/// connection piece by piece through the reply's body_source, and the
+/// backend is paused while the connection has not taken the last piece.
+class ReverseProxy::Exchange : public std::enable_shared_from_this<Exchange> {
+ public:
+  Exchange(ReverseProxy* proxy, Response* rep, Response::DoneFunc done)
+      : backend(nullptr),
+        retried(false),
+        proxy_(proxy),
+        id_(0),
+        rep_(rep),
+        done_(std::move(done)),
+        head_done_(false),
+        paused_(false),
+        finished_(false) {}
+
+  /// Start the request on `backend`.
+  void Send() {
+    req.url = Url(backend->url + uri);
+
+    auto self(shared_from_this());
+    BodySink sink;
+    sink.on_head = [self](const Response& resp) { self->OnHead(resp); };
+    sink.on_data = [self](string_view data) { return self->OnData(data); };
+
+    // Held while starting, so that the id is set before any callback.
+    std::lock_guard<std::mutex> guard(mutex_);
+    id_ = proxy_->client_.Do(
+        req, proxy_->options_.timeouts, sink,
+        [self](const Status& status, Response* resp) {
+          self->OnDone(status, resp);
+        });
+  }
+
+  /// The request to the backend, and the URI it is sent to.
+  Request req;
+  std::string uri;
+  Backend* backend;
+  bool retried;
+
+ private:
+  /// Cancels the backend request if the connection drops the reply body
+  /// before its end, e.g. because the client went away.
+  struct Reader {
+    explicit Reader(const std::shared_ptr<Exchange>& exchange)
+        : exchange(exchange) {}
+    ~Reader() { exchange->Abandon(); }
+
+    std::shared_ptr<Exchange> exchange;
+  };
+
+  void OnHead(const Response& resp) {
+    Response::DoneFunc done;
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      head_done_ = true;
+      rep_->status = resp.status;
+      string_view connection = resp.headers.Get(kConnection);
+      for (auto& f : resp.headers) {
+        if (!IsHopByHop(f, connection)) rep_->headers.Add(f.name, f.value);
+      }
+
+      int status = static_cast<int>(resp.status);
+      if (req.method != "HEAD" && status / 100 != 1 && status != 204 &&
+          status != 304) {
+        auto reader = std::make_shared<Reader>(shared_from_this());
+        rep_->body_source.read = [reader](BodySource::ReadCallback cb) {
+          reader->exchange->Read(std::move(cb));
+        };
+      }
+      rep_ = nullptr;
+      done.swap(done_);
+    }
+    done();
+  }
+
+  Status OnData(string_view data) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    pending_.append(data.data(), data.size());
+    if (reader_) {
+      BodySource::ReadCallback cb;
+      cb.swap(reader_);
+      sending_.swap(pending_);
+      pending_.clear();
+      lock.unlock();
+      cb(OkStatus(), sending_);
+    } else if (!paused_) {
+      paused_ = true;
+      lock.unlock();
+      proxy_->client_.Pause(id_);
+    }
+    return OkStatus();
+  }
+
+  void OnDone(const Status& status, Response* resp) {
+    bool failed = (!status && !IsCancelled(status)) ||
+                  (status && IsGatewayError(static_cast<int>(resp->status)));
+    proxy_->Release(backend, !failed);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    finished_ = true;
+    status_ = status;
+    if (!head_done_) {
+      // Nothing was relayed yet, try another backend or give up. The
+      // backend may have run the request before failing, only idempotent
+      // ones are sent twice.
+      if (failed && !retried && !req.body_source && req.IsIdempotent()) {
+        Backend* other = proxy_->Pick(backend);
+        if (other) {
+          backend = other;
+          retried = true;
+          finished_ = false;
+          lock.unlock();
+          Send();
+          return;
+        }
+      }
+
+      *rep_ = Response::stock_reply(Response::bad_gateway);
+      rep_ = nullptr;
+      Response::DoneFunc done;
+      done.swap(done_);
+      lock.unlock();
+      done();
+      return;
+    }
+
+    if (reader_) {
+      BodySource::ReadCallback cb;
+      cb.swap(reader_);
+      lock.unlock();
+      cb(status, string_view());
+    }
+  }
+
+  /// Called by the connection for the next piece of the body.
+  void Read(BodySource::ReadCallback cb) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!pending_.empty()) {
+      sending_.swap(pending_);
+      pending_.clear();
+      bool resume = paused_;
+      paused_ = false;
+      lock.unlock();
+      if (resume) proxy_->client_.Resume(id_);
+      cb(OkStatus(), sending_);
+    } else if (finished_) {
+      Status status = status_;
+      lock.unlock();
+      cb(status, string_view());
+    } else {
+      reader_ = std::move(cb);
+    }
+  }
+
+  void Abandon() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (finished_) return;
+    lock.unlock();
+    proxy_->client_.Cancel(id_);
+  }
+
+  ReverseProxy* proxy_;
+  uint64_t id_;
+
+  std::mutex mutex_;
+  /// The reply until its head is set.
+  Response* rep_;
+  Response::DoneFunc done_;
+  bool head_done_;
+  /// Whether the backend request is paused.
+  bool paused_;
+  bool finished_;
+  Status status_;
+  /// Body received from the backend, and the piece being sent.
+  std::string pending_;
+  std::string sending_;
+  /// The connection waiting for the next piece.
+  BodySource::ReadCallback reader_;
+};
+
+ReverseProxy::ReverseProxy(asio::io_context& io_context,
+                           const std::vector<std::string>& backends,
+                           const Options& options)
+    : options_(options),
+      client_(io_context,
+              [&options]() {
+                AsyncClient::Options client_options;
+                client_options.timeouts = options.timeouts;
+                client_options.max_conns_per_host = 0;
+                client_options.max_idle_per_host =
+                    options.max_idle_per_backend;
+                return client_options;
+              }()),
+      next_(0),
+      rng_(std::random_device()()) {
+  for (auto& url : backends) {
+    Backend b;
+    b.url = url;
+    // The request URI starts with a slash.
+    while (!b.url.empty() && b.url.back() == '/') b.url.pop_back();
+    b.outstanding = 0;
+    b.requests = 0;
+    b.fails = 0;
+    backends_.push_back(b);
+  }
+}
+
+ReverseProxy::~ReverseProxy() {}
+
+void ReverseProxy::ServeHttp(const Request& req, Response* rep) {
+  // Without a length the end of a request body can not be found.
+  if (req.headers.Has(kTransferEncoding)) {
+    *rep = Response::stock_reply(Response::not_implemented);
+    return;
+  }
+
+  Backend* backend = Pick(nullptr);
+  if (!backend) {
+    *rep = Response::stock_reply(Response::service_unavailable);
+    return;
+  }
+
+  auto exchange = std::make_shared<Exchange>(this, rep, rep->Defer());
+  exchange->backend = backend;
+  exchange->uri = req.uri;
+
+  Request& up = exchange->req;
+  up.method = req.method;
+  string_view connection = req.headers.Get(kConnection);
+  for (auto& f : req.headers) {
+    // The client sets the Host and Content-Length.
+    if (f.id == kHost || f.id == kContentLength || IsHopByHop(f, connection)) {
+      continue;
+    }
+    up.headers.Add(f.name, f.value);
+  }
+  string_view host = req.headers.Get(kHost);
+  if (!host.empty()) up.headers.Set("X-Forwarded-Host", host);
+  if (!req.remote_address.is_unspecified()) {
+    // Appended to the addresses of the proxies in front of this one.
+    std::string forwarded = req.headers.Get("X-Forwarded-For").str();
+    if (!forwarded.empty()) forwarded.append(", ");
+    forwarded.append(req.remote_address.to_string());
+    up.headers.Set("X-Forwarded-For", forwarded);
+  }
+  up.content = req.content;
+  up.body_source = req.body_source;
+
+  exchange->Send();
+}
+
+std::vector<ReverseProxy::BackendStats> ReverseProxy::stats() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto now = Clock::now();
+  std::vector<BackendStats> stats;
+  for (auto& b : backends_) {
+    BackendStats s = {b.url, b.outstanding, b.requests, b.down_until <= now};
+    stats.push_back(s);
+  }
+  return stats;
+}
+
+ReverseProxy::Backend* ReverseProxy::Pick(const Backend* exclude) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto now = Clock::now();
+  std::vector<Backend*> candidates;
+  for (auto& b : backends_) {
+    if (&b != exclude && b.down_until <= now) candidates.push_back(&b);
+  }
+  if (candidates.empty()) {
+    for (auto& b : backends_) {
+      if (&b != exclude) candidates.push_back(&b);
+    }
+  }
+  if (candidates.empty()) return nullptr;
+
+  Backend* best;
+  size_t n = candidates.size();
+  if (options_.balancer == kPowerOfTwoChoices && n > 1) {
+    size_t i = rng_() % n;
+    size_t j = (i + 1 + rng_() % (n - 1)) % n;
+    best = candidates[i]->outstanding <= candidates[j]->outstanding
+               ? candidates[i]
+               : candidates[j];
+  } else {
+    size_t start = next_++ % n;
+    best = candidates[start];
+    for (size_t k = 1; k < n; k++) {
+      Backend* b = candidates[(start + k) % n];
+      if (b->outstanding < best->outstanding) best = b;
+    }
+  }
+
+  best->outstanding++;
+  best->requests++;
+  return best;
+}
+
+void ReverseProxy::Release(Backend* backend, bool ok) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  backend->outstanding--;
+  if (ok) {
+    backend->fails = 0;
+  } else if (++backend->fails >= options_.max_fails) {
+    backend->fails = 0;
+    backend->down_until = Clock::now() + options_.fail_timeout;
+  }
+}
+
+}  // namespace http
+}  // namespace cppboot
@@ -0,0 +1,128 @@
+#ifndef CPPBOOT_NET_HTTP_SERVER_REVERSE_PROXY_H_
+#define CPPBOOT_NET_HTTP_SERVER_REVERSE_PROXY_H_
+
+#include <stdint.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "asio.hpp"
+
+#include "cppboot/net/http/async_client.h"
+
+namespace cppboot {
+namespace http {
+
+struct Request;
+struct Response;
+
+/// Handler relaying requests to a pool of backend servers, e.g.
+///
+///   ReverseProxy proxy(server.io_context(), {"http://10.0.0.1:8080",
+///                                            "http://10.0.0.2:8080"});
+///   server.Handle("/api/", std::bind(&ReverseProxy::ServeHttp, &proxy,
+///                                    _1, _2));
+///
+/// The request URI is kept as is. Bodies are streamed both ways, the
+/// response is relayed as it arrives and the backend is not read faster than
+/// the client takes it. Backend connections are kept alive and pooled.
+///
+/// Each request goes to the backend with the fewest requests in flight, or
+/// to the better of two random ones. Health is checked passively: a backend
+/// failing Options::max_fails requests in a row, by not answering or with a
+/// 502, 503 or 504, is left out for Options::fail_timeout. An idempotent
+/// request, see Request::IsIdempotent(), whose backend failed before
+/// answering is tried once on another one, unless its body was streamed
+/// already. When all backends are out, all are tried.
+///
+/// Backends see the client address in X-Forwarded-For, appended to the one
+/// the client sent, and the Host it asked for in X-Forwarded-Host.
+///
+/// The proxy must outlive the server using it.
+class ReverseProxy {
+ public:
+  enum Balancer {
+    kLeastOutstanding,
+    kPowerOfTwoChoices,
+  };
+
+  struct Options {
+    Options()
+        : balancer(kLeastOutstanding),
+          max_fails(3),
+          fail_timeout(std::chrono::seconds(10)),
+          max_idle_per_backend(32) {
+      timeouts.connect = std::chrono::seconds(5);
+      timeouts.read = std::chrono::seconds(60);
+    }
+
+    Balancer balancer;
+    size_t max_fails;
+    std::chrono::milliseconds fail_timeout;
+    AsyncClient::Timeouts timeouts;
+    size_t max_idle_per_backend;
+  };
+
+  struct BackendStats {
+    std::string url;
+    /// Requests in flight.
+    size_t outstanding;
+    /// Requests sent so far.
+    uint64_t requests;
+    bool healthy;
+  };
+
+  ReverseProxy(const ReverseProxy&) = delete;
+  ReverseProxy& operator=(const ReverseProxy&) = delete;
+
+  /// Relay to `backends`, e.g. "http://127.0.0.1:8080", using `io_context`
+  /// for the backend connections.
+  ReverseProxy(asio::io_context& io_context,
+               const std::vector<std::string>& backends,
+               const Options& options = Options());
+  ~ReverseProxy();
+
+  void ServeHttp(const Request& req, Response* rep);
+
+  std::vector<BackendStats> stats() const;
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Backend {
+    std::string url;
+    size_t outstanding;
+    uint64_t requests;
+    /// Failures in a row.
+    size_t fails;
+    /// Left out until then.
+    Clock::time_point down_until;
+  };
+
+  class Exchange;
+
+  /// Take a backend for a request other than `exclude`, nullptr if there
+  /// is none.
+  Backend* Pick(const Backend* exclude);
+
+  /// Give `backend` back after a request, `ok` unless it failed.
+  void Release(Backend* backend, bool ok);
+
+  Options options_;
+  AsyncClient client_;
+
+  mutable std::mutex mutex_;
+  std::vector<Backend> backends_;
+  /// Where the next least-outstanding scan starts, spreading ties.
+  size_t next_;
+  std::minstd_rand rng_;
+};
+
+}  // namespace http
+}  // namespace cppboot
+
+#endif  // CPPBOOT_NET_HTTP_SERVER_REVERSE_PROXY_H_
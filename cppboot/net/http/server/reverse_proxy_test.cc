@@ -0,0 +1,226 @@
+#include "gmock/gmock.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "cppboot/net/http/client.h"
+#include "cppboot/net/http/request.h"
+#include "cppboot/net/http/response.h"
+#include "cppboot/net/http/server.h"
+#include "cppboot/net/http/server/reverse_proxy.h"
+
+namespace {
+
+using cppboot::http::BodySource;
+using cppboot::http::Client;
+using cppboot::http::Request;
+using cppboot::http::Response;
+using cppboot::http::ReverseProxy;
+using cppboot::http::Server;
+
+/// Append the rest of a request body to `*out`, then call `done`.
+void ReadAll(BodySource source, std::shared_ptr<std::string> out,
+             std::function<void()> done) {
+  if (!source) {
+    done();
+    return;
+  }
+  source.read([=](const cppboot::Status& status, cppboot::string_view data) {
+    if (!status || data.empty()) {
+      done();
+      return;
+    }
+    out->append(data.data(), data.size());
+    ReadAll(source, out, done);
+  });
+}
+
+/// A backend answering its name on "/", 1MB on "/big", the size of the
+/// request body on "/echo", and its X-Forwarded-For on "/who".
+class Backend {
+ public:
+  Backend(const std::string& port, const std::string& name) : hits_(0) {
+    server_.Handle("/", [this, name](const Request&, Response* resp) {
+      hits_++;
+      resp->WriteText(Response::ok, name);
+    });
+    server_.Handle("/big", [](const Request&, Response* resp) {
+      resp->WriteText(Response::ok, std::string(1024 * 1024, 'x'));
+    });
+    server_.Handle("/who", [](const Request& req, Response* resp) {
+      resp->WriteText(Response::ok, req.header("X-Forwarded-For").str());
+    });
+    server_.Handle("/echo", [](const Request& req, Response* resp) {
+      auto body = std::make_shared<std::string>(req.content);
+      auto done = resp->Defer();
+      ReadAll(req.body_source, body, [resp, body, done]() {
+        resp->WriteText(Response::ok, std::to_string(body->size()));
+        done();
+      });
+    });
+
+    auto st = server_.Listen("127.0.0.1", port);
+    EXPECT_TRUE(st) << st.ToString();
+    thread_ = std::thread([this]() { server_.Serve(); });
+  }
+
+  ~Backend() {
+    server_.Shutdown();
+    thread_.join();
+  }
+
+  int hits() const { return hits_; }
+
+ private:
+  Server server_;
+  std::atomic<int> hits_;
+  std::thread thread_;
+};
+
+/// A server relaying everything to `backends`.
+class Front {
+ public:
+  Front(const std::vector<std::string>& backends,
+        const ReverseProxy::Options& options)
+      : proxy_(server_.io_context(), backends, options) {
+    server_.Handle("/", [this](const Request& req, Response* resp) {
+      proxy_.ServeHttp(req, resp);
+    });
+    auto st = server_.Listen("127.0.0.1", "59991");
+    EXPECT_TRUE(st) << st.ToString();
+    thread_ = std::thread([this]() { server_.Serve(); });
+  }
+
+  ~Front() {
+    server_.Shutdown();
+    thread_.join();
+  }
+
+  ReverseProxy& proxy() { return proxy_; }
+
+ private:
+  Server server_;
+  ReverseProxy proxy_;
+  std::thread thread_;
+};
+
+TEST(ReverseProxy, Balances) {
+  Backend b1("59993", "b1");
+  Backend b2("59992", "b2");
+
+  for (auto balancer : {ReverseProxy::kLeastOutstanding,
+                        ReverseProxy::kPowerOfTwoChoices}) {
+    ReverseProxy::Options options;
+    options.balancer = balancer;
+    Front front({"http://127.0.0.1:59993", "http://127.0.0.1:59992/"},
+                options);
+
+    int before1 = b1.hits(), before2 = b2.hits();
+    Client client;
+    for (int i = 0; i < 20; i++) {
+      Response resp;
+      auto st = client.Do(Request("GET", "http://127.0.0.1:59991/"), &resp);
+      ASSERT_TRUE(st) << st.ToString();
+      ASSERT_THAT(resp.content, ::testing::AnyOf("b1", "b2"));
+    }
+    ASSERT_EQ(b1.hits() - before1 + b2.hits() - before2, 20);
+    ASSERT_GE(b1.hits() - before1, 3);
+    ASSERT_GE(b2.hits() - before2, 3);
+  }
+}
+
+TEST(ReverseProxy, StreamsBodies) {
+  Backend b1("59993", "b1");
+  Front front({"http://127.0.0.1:59993"}, ReverseProxy::Options());
+  Client client;
+
+  Response resp;
+  auto st = client.Do(Request("GET", "http://127.0.0.1:59991/big"), &resp);
+  ASSERT_TRUE(st) << st.ToString();
+  ASSERT_EQ(resp.content, std::string(1024 * 1024, 'x'));
+
+  // Much more than arrives with the head.
+  Request req("POST", "http://127.0.0.1:59991/echo");
+  req.content.assign(200 * 1024, 'y');
+  st = client.Do(req, &resp);
+  ASSERT_TRUE(st) << st.ToString();
+  ASSERT_EQ(resp.content, std::to_string(200 * 1024));
+}
+
+TEST(ReverseProxy, EjectsFailingBackend) {
+  Backend b1("59993", "b1");
+  ReverseProxy::Options options;
+  options.max_fails = 1;
+  // Nothing listens on 59990.
+  Front front({"http://127.0.0.1:59993", "http://127.0.0.1:59990"}, options);
+  Client client;
+
+  for (int i = 0; i < 10; i++) {
+    Response resp;
+    auto st = client.Do(Request("GET", "http://127.0.0.1:59991/"), &resp);
+    ASSERT_TRUE(st) << st.ToString();
+    ASSERT_EQ(resp.content, "b1");
+  }
+
+  auto stats = front.proxy().stats();
+  ASSERT_EQ(stats.size(), 2);
+  ASSERT_TRUE(stats[0].healthy);
+  ASSERT_FALSE(stats[1].healthy);
+  ASSERT_EQ(stats[1].requests, 1);
+}
+
+TEST(ReverseProxy, BadGateway) {
+  Front front({"http://127.0.0.1:59990"}, ReverseProxy::Options());
+  Client client;
+
+  Response resp;
+  auto st = client.Do(Request("GET", "http://127.0.0.1:59991/"), &resp);
+  ASSERT_FALSE(st);
+  ASSERT_EQ(resp.status, Response::bad_gateway);
+}
+
+TEST(ReverseProxy, ForwardsClientAddress) {
+  Backend b1("59993", "b1");
+  Front front({"http://127.0.0.1:59993"}, ReverseProxy::Options());
+  Client client;
+
+  Response resp;
+  auto st = client.Do(Request("GET", "http://127.0.0.1:59991/who"), &resp);
+  ASSERT_TRUE(st) << st.ToString();
+  ASSERT_EQ(resp.content, "127.0.0.1");
+
+  Request req("GET", "http://127.0.0.1:59991/who");
+  req.set_header("X-Forwarded-For", "10.0.0.1");
+  st = client.Do(req, &resp);
+  ASSERT_TRUE(st) << st.ToString();
+  ASSERT_EQ(resp.content, "10.0.0.1, 127.0.0.1");
+}
+
+TEST(ReverseProxy, RetriesOnlyIdempotentRequests) {
+  Backend b1("59993", "b1");
+  // The first request goes to 59990, where nothing listens.
+  Front front({"http://127.0.0.1:59990", "http://127.0.0.1:59993"},
+              ReverseProxy::Options());
+  Client client;
+
+  // The backend might have run it.
+  Request req("POST", "http://127.0.0.1:59991/");
+  req.content = "data";
+  Response resp;
+  auto st = client.Do(req, &resp);
+  ASSERT_FALSE(st);
+  ASSERT_EQ(resp.status, Response::bad_gateway);
+  ASSERT_EQ(b1.hits(), 0);
+
+  // Round-robin, back to 59990 after this one.
+  st = client.Do(Request("GET", "http://127.0.0.1:59991/"), &resp);
+  ASSERT_TRUE(st) << st.ToString();
+
+  req.set_header("Idempotency-Key", "1");
+  st = client.Do(req, &resp);
+  ASSERT_TRUE(st) << st.ToString();
+  ASSERT_EQ(resp.content, "b1");
+}
+
+}  // namespace
@@ -1,6 +1,6 @@
 #include "cppboot/net/http/server/serve_mux.h"
 
-#include <sstream>
+#include <algorithm>
 
 #include "cppboot/base/log.h"
 #include "cppboot/base/str_util.h"
@@ -10,43 +10,225 @@
 namespace cppboot {
 namespace http {
 
-ServeMux::ServeMux() {}
+struct ServeMux::Node {
+  /// Static label of the edge leading to this node.
+  std::string prefix;
+  /// First byte of each static child, same order as `children`.
+  std::string indices;
+  std::vector<std::unique_ptr<Node>> children;
+
+  /// Parameter name of "{name}" and "{name...}" nodes.
+  std::string name;
+  std::unique_ptr<Node> param;
+  std::unique_ptr<Node> wildcard;
+
+  /// Handlers of the exact path ending at this node.
+  std::vector<FuncEntry> routes;
+  /// Handlers of the subtree pattern ending at this node.
+  std::vector<FuncEntry> subtree;
+};
+
+struct ServeMux::Match {
+  string_view path;
+  PathParams* params;
+
+  /// Longest subtree pattern seen on the way down.
+  const Node* subtree;
+  size_t subtree_len;
+  PathParams subtree_params;
+};
+
+ServeMux::ServeMux() : root_(new Node()) {}
+
+ServeMux::~ServeMux() {}
 
 void ServeMux::ServeHttp(Request& req, Response* resp) {
-  auto it = funcs_.find(req.path);
-  if (it != funcs_.end()) {
-    it->second.fn(req, resp);
+  Match m;
+  m.path = req.path;
+  m.params = &req.path_params;
+  m.subtree = nullptr;
+  m.subtree_len = 0;
+  req.path_params.size = 0;
+
+  const std::vector<FuncEntry>* entries;
+  const Node* n = Lookup(root_.get(), 0, &m);
+  if (n) {
+    entries = &n->routes;
+  } else if (m.subtree) {
+    entries = &m.subtree->subtree;
+    req.path_params = m.subtree_params;
+    req.subpath = req.path.substr(m.subtree_len - 1);
+  } else {
+    resp->WriteText(Response::not_found, "Not found");
     return;
   }
 
-  for (auto& i : prefix_funcs_) {
-    if (StartsWithIgnoreCase(req.path, i.pattern)) {
-      req.subpath = req.path.substr(i.pattern.length() - 1);
-      i.fn(req, resp);
-      return;
+  const FuncEntry* entry = FindEntry(*entries, req.method);
+  if (!entry) {
+    std::string allow;
+    for (auto& i : *entries) {
+      if (!allow.empty()) allow += ", ";
+      allow += i.method;
     }
+    resp->WriteText(Response::method_not_allowed, "Method not allowed");
+    resp->set_header("Allow", allow);
+    return;
   }
-
-  resp->WriteText(Response::not_found, "Not found");
+  entry->fn(req, resp);
 }
 
 void ServeMux::set_handler(const std::string& pattern, const Func& func) {
+  set_handler(std::string(), pattern, func);
+}
+
+void ServeMux::set_handler(const std::string& method,
+                           const std::string& pattern, const Func& func) {
   if (pattern.empty()) return;
-  if (funcs_.find(pattern) != funcs_.end()) return;
 
-  FuncEntry entry = {pattern, func};
-  funcs_[pattern] = entry;
+  Node* n = root_.get();
+  size_t nparams = 0;
+  size_t pos = 0;
+  while (pos < pattern.length()) {
+    size_t open = pattern.find('{', pos);
+    if (open == std::string::npos) {
+      n = InsertStatic(n, string_view(pattern).substr(pos));
+      break;
+    }
+    if (open > pos) {
+      n = InsertStatic(n, string_view(pattern).substr(pos, open - pos));
+    }
+
+    // A parameter always spans a whole segment.
+    size_t close = pattern.find('}', open);
+    if (close == std::string::npos || open == 0 || pattern[open - 1] != '/' ||
+        (close + 1 < pattern.length() && pattern[close + 1] != '/')) {
+      CPPBOOT_LOG(ERROR, "invalid pattern {}", pattern);
+      return;
+    }
 
-  if (pattern[pattern.length() - 1] == '/') {
-    for (auto it = prefix_funcs_.begin(); it != prefix_funcs_.end(); it++) {
-      if (pattern.length() > it->pattern.length()) {
-        prefix_funcs_.insert(it, entry);
-        return;
-      }
+    std::string name = pattern.substr(open + 1, close - open - 1);
+    bool rest = EndsWith(name, "...");
+    if (rest) name.resize(name.length() - 3);
+    if (name.empty() || (rest && close + 1 != pattern.length()) ||
+        ++nparams > PathParams::kMaxParams) {
+      CPPBOOT_LOG(ERROR, "invalid pattern {}", pattern);
+      return;
     }
-    prefix_funcs_.push_back(entry);
+
+    std::unique_ptr<Node>& slot = rest ? n->wildcard : n->param;
+    if (!slot) {
+      slot.reset(new Node());
+      slot->name = name;
+    } else if (slot->name != name) {
+      CPPBOOT_LOG(ERROR, "pattern {} conflicts with parameter {}", pattern,
+                  slot->name);
+      return;
+    }
+    n = slot.get();
+    pos = close + 1;
+  }
+
+  auto& entries =
+      (pattern[pattern.length() - 1] == '/') ? n->subtree : n->routes;
+  for (auto& i : entries) {
+    if (i.method == method) return;  // first registration wins
+  }
+
+  FuncEntry entry = {method, pattern, func};
+  entries.push_back(entry);
+}
+
+ServeMux::Node* ServeMux::InsertStatic(Node* n, string_view s) {
+  while (!s.empty()) {
+    size_t i = n->indices.find(s[0]);
+    if (i == std::string::npos) {
+      Node* child = new Node();
+      child->prefix = s.str();
+      n->indices.push_back(s[0]);
+      n->children.emplace_back(child);
+      return child;
+    }
+
+    Node* child = n->children[i].get();
+    size_t max = std::min(child->prefix.length(), s.length());
+    size_t common = 0;
+    while (common < max && child->prefix[common] == s[common]) common++;
+
+    // Split the edge at the first differing byte.
+    if (common < child->prefix.length()) {
+      std::unique_ptr<Node> mid(new Node());
+      mid->prefix = child->prefix.substr(0, common);
+      child->prefix.erase(0, common);
+      mid->indices.push_back(child->prefix[0]);
+      mid->children.push_back(std::move(n->children[i]));
+      n->children[i] = std::move(mid);
+      child = n->children[i].get();
+    }
+
+    s.remove_prefix(common);
+    n = child;
+  }
+  return n;
+}
+
+const ServeMux::Node* ServeMux::Lookup(const Node* n, size_t pos, Match* m) {
+  string_view path = m->path;
+
+  if (!n->subtree.empty() && (!m->subtree || pos > m->subtree_len)) {
+    m->subtree = n;
+    m->subtree_len = pos;
+    m->subtree_params = *m->params;
+  }
+
+  if (pos == path.length()) {
+    if (!n->routes.empty()) return n;
+    if (n->wildcard && !n->wildcard->routes.empty() &&
+        m->params->Push(n->wildcard->name, pos, 0)) {
+      return n->wildcard.get();
+    }
+    return nullptr;
+  }
+
+  size_t i = n->indices.find(path[pos]);
+  if (i != std::string::npos) {
+    const Node* child = n->children[i].get();
+    if (StartsWith(path.substr(pos), child->prefix)) {
+      const Node* found = Lookup(child, pos + child->prefix.length(), m);
+      if (found) return found;
+    }
+  }
+
+  if (n->param && path[pos] != '/') {
+    size_t end = path.find('/', pos);
+    if (end == string_view::npos) end = path.length();
+
+    size_t saved = m->params->size;
+    if (m->params->Push(n->param->name, pos, end - pos)) {
+      const Node* found = Lookup(n->param.get(), end, m);
+      if (found) return found;
+    }
+    m->params->size = saved;
+  }
+
+  if (n->wildcard && !n->wildcard->routes.empty() &&
+      m->params->Push(n->wildcard->name, pos, path.length() - pos)) {
+    return n->wildcard.get();
+  }
+  return nullptr;
+}
+
+const ServeMux::FuncEntry* ServeMux::FindEntry(
+    const std::vector<FuncEntry>& entries, const std::string& method) {
+  const FuncEntry* any = nullptr;
+  const FuncEntry* get = nullptr;
+  for (auto& i : entries) {
+    if (i.method == method) return &i;
+    if (i.method.empty()) any = &i;
+    if (i.method == "GET") get = &i;
   }
+  if (method == "HEAD" && get) return get;
+  return any;
 }
 
 }  // namespace http
-}  // namespace cppboot
\ No newline at end of file
+}  // namespace cppboot
@@ -2,16 +2,29 @@
 #define CPPBOOT_NET_HTTP_REQUEST_HANDLER_H_
 
 #include <string>
-#include <list>
-#include <unordered_map>
+#include <memory>
+#include <vector>
 #include <functional>
 
+#include "cppboot/base/string_view.h"
+
 namespace cppboot {
 namespace http {
 
 struct Request;
 struct Response;
 
+/// Request router backed by a compressed radix tree.
+///
+/// Supported patterns:
+///   "/a/b"           exact path
+///   "/a/"            subtree, matches "/a/" and everything below it
+///   "/users/{id}"    named parameter, matches exactly one path segment
+///   "/files/{p...}"  wildcard, matches the rest of the path
+///
+/// Static segments win over parameters, parameters win over wildcards, and the
+/// longest subtree pattern is used when nothing else matches. Matching costs
+/// O(path length) regardless of the number of registered routes.
 class ServeMux {
  public:
   typedef std::function<void(const Request&, Response*)> Func;
@@ -20,18 +33,34 @@ class ServeMux {
   ServeMux& operator=(const ServeMux&) = delete;
 
   ServeMux();
+  ~ServeMux();
+
   void ServeHttp(Request& req, Response* rep);
 
+  /// Register a handler for all methods.
   void set_handler(const std::string& path, const Func& h);
 
+  /// Register a handler for a single method, e.g. "GET".
+  void set_handler(const std::string& method, const std::string& path,
+                   const Func& h);
+
  private:
   struct FuncEntry {
+    std::string method;  // empty for any method
     std::string pattern;
     Func fn;
   };
 
-  std::unordered_map<std::string, FuncEntry> funcs_;
-  std::list<FuncEntry> prefix_funcs_;
+  struct Node;
+  struct Match;
+
+  static Node* InsertStatic(Node* n, string_view s);
+  static const Node* Lookup(const Node* n, size_t pos, Match* m);
+
+  static const FuncEntry* FindEntry(const std::vector<FuncEntry>& entries,
+                                    const std::string& method);
+
+  std::unique_ptr<Node> root_;
 };
 
 }  // namespace http
@@ -54,4 +54,134 @@ TEST_F(ServeMuxTest, should_match_404) {
   ASSERT_EQ(resp.status, Response::not_found);
 }
 
+TEST_F(ServeMuxTest, should_set_subpath) {
+  req.path = "/a/b/c/d";
+  h.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.content, "func1");
+  ASSERT_EQ(req.subpath, "/c/d");
+}
+
+TEST(ServeMux, should_capture_path_params) {
+  ServeMux h;
+  std::string id, post;
+  h.set_handler("/users/{id}/posts/{post}", [&](const Request& req, Response*) {
+    id = req.PathValue("id").str();
+    post = req.PathValue("post").str();
+  });
+
+  Request req;
+  Response resp;
+  req.path = "/users/42/posts/7";
+  h.ServeHttp(req, &resp);
+  ASSERT_EQ(id, "42");
+  ASSERT_EQ(post, "7");
+  ASSERT_EQ(req.PathValue("none"), "");
+
+  req.path = "/users//posts/7";
+  h.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.status, Response::not_found);
+}
+
+TEST(ServeMux, should_prefer_static_over_param) {
+  ServeMux h;
+  h.set_handler("/users/new", func1);
+  h.set_handler("/users/{id}", func2);
+  h.set_handler("/users/{id}/name", func3);
+
+  Request req;
+  Response resp;
+  req.path = "/users/new";
+  h.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.content, "func1");
+
+  req.path = "/users/newer";
+  h.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.content, "func2");
+  ASSERT_EQ(req.PathValue("id"), "newer");
+
+  req.path = "/users/new/name";
+  h.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.content, "func3");
+  ASSERT_EQ(req.PathValue("id"), "new");
+}
+
+TEST(ServeMux, should_match_wildcard) {
+  ServeMux h;
+  h.set_handler("/files/{path...}", func1);
+
+  Request req;
+  Response resp;
+  req.path = "/files/a/b/c.txt";
+  h.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.content, "func1");
+  ASSERT_EQ(req.PathValue("path"), "a/b/c.txt");
+
+  req.path = "/files/";
+  h.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.content, "func1");
+  ASSERT_EQ(req.PathValue("path"), "");
+}
+
+TEST(ServeMux, should_keep_params_for_subtree) {
+  ServeMux h;
+  h.set_handler("/repos/{name}/", func1);
+
+  Request req;
+  Response resp;
+  req.path = "/repos/cppboot/tree/master";
+  h.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.content, "func1");
+  ASSERT_EQ(req.PathValue("name"), "cppboot");
+  ASSERT_EQ(req.subpath, "/tree/master");
+}
+
+TEST(ServeMux, should_dispatch_by_method) {
+  ServeMux h;
+  h.set_handler("GET", "/items", func1);
+  h.set_handler("POST", "/items", func2);
+
+  Request req;
+  Response resp;
+  req.path = "/items";
+
+  req.method = "GET";
+  h.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.content, "func1");
+
+  req.method = "POST";
+  h.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.content, "func2");
+
+  req.method = "HEAD";
+  h.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.content, "func1");
+
+  req.method = "DELETE";
+  h.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.status, Response::method_not_allowed);
+  ASSERT_EQ(resp.header("Allow"), "GET, POST");
+}
+
+TEST(ServeMux, should_split_shared_prefixes) {
+  ServeMux h;
+  for (int i = 0; i < 200; i++) {
+    h.set_handler("/api/v1/item" + std::to_string(i),
+                  [i](const Request&, Response* resp) {
+                    resp->content = std::to_string(i);
+                  });
+  }
+
+  Request req;
+  Response resp;
+  for (int i = 0; i < 200; i++) {
+    req.path = "/api/v1/item" + std::to_string(i);
+    h.ServeHttp(req, &resp);
+    ASSERT_EQ(resp.content, std::to_string(i));
+  }
+
+  req.path = "/api/v1/item200";
+  h.ServeHttp(req, &resp);
+  ASSERT_EQ(resp.status, Response::not_found);
+}
+
 }  // namespace
\ No newline at end of file
@@ -0,0 +1,7 @@
+document.addEventListener("DOMContentLoaded", function () {
+  document.querySelectorAll("p").forEach(function (p) {
+    p.addEventListener("click", function () {
+      p.classList.toggle("selected");
+    });
+  });
+});
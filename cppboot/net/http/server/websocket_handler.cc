@@ -0,0 +1,417 @@
+#include "cppboot/net/http/server/websocket_handler.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "cppboot/base/fmt.h"
+#include "cppboot/base/str_util.h"
+#include "cppboot/net/http/request.h"
+#include "cppboot/net/http/response.h"
+
+namespace cppboot {
+namespace http {
+
+namespace {
+
+/// Read buffer of a connection between large frames.
+const size_t kReadBufferSize = 8 * 1024;
+
+/// Larger read buffers are released once the frame they held is done.
+const size_t kMaxKeptBuffer = 64 * 1024;
+
+/// Frames gathered into one write.
+const size_t kMaxWriteFrames = 64;
+
+/// Whether the comma-separated list `value` contains `token`.
+bool HasToken(string_view value, string_view token) {
+  while (!value.empty()) {
+    size_t comma = value.find(',');
+    if (EqualsIgnoreCase(StrTrim(value.substr(0, comma)), token)) return true;
+    value = comma == string_view::npos ? string_view()
+                                       : value.substr(comma + 1);
+  }
+  return false;
+}
+
+}  // namespace
+
+const std::chrono::seconds WebSocketConn::kCloseTimeout(5);
+
+WebSocketConn::WebSocketConn(asio::ip::tcp::socket socket, std::string path,
+                             size_t max_message_size,
+                             std::unique_ptr<websocket::Deflate> deflate,
+                             size_t deflate_min_size,
+                             std::function<void()> closed)
+    : socket_(std::move(socket)),
+      close_timer_(socket_.get_executor()),
+      path_(std::move(path)),
+      deflate_(std::move(deflate)),
+      deflate_min_size_(deflate_min_size),
+      closed_(std::move(closed)),
+      decoder_(max_message_size),
+      input_used_(0),
+      peer_closed_(false),
+      close_written_(false),
+      buffered_(0),
+      writing_(false),
+      close_queued_(false),
+      sending_size_(0) {
+  decoder_.set_deflate(deflate_.get());
+  std::error_code ec;
+  auto ep = socket_.remote_endpoint(ec);
+  if (!ec) {
+    remote_address_ =
+        cppboot::format("{}:{}", ep.address().to_string(), ep.port());
+  }
+}
+
+WebSocketConn::~WebSocketConn() = default;
+
+void WebSocketConn::Start(string_view pending) {
+  state_ = kConnected;
+  if (conn_callback_) conn_callback_(shared_from_this());
+
+  input_.resize(std::max(kReadBufferSize, pending.size()));
+  memcpy(input_.data(), pending.data(), pending.size());
+  input_used_ = pending.size();
+  OnRead();
+}
+
+void WebSocketConn::Stop() {
+  auto self = this->self();
+  asio::dispatch(socket_.get_executor(), [this, self]() { CloseSocket(); });
+}
+
+void WebSocketConn::Send(const void* data, size_t len) {
+  SendMessage(websocket::kBinary,
+              string_view(static_cast<const char*>(data), len));
+}
+
+void WebSocketConn::SendMessage(websocket::Opcode opcode,
+                                string_view message) {
+  auto frame = std::make_shared<std::string>();
+  if (deflate_ && message.size() >= deflate_min_size_) {
+    std::string payload;
+    bool ok;
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      ok = deflate_->Compress(message, &payload);
+    }
+    if (ok) {
+      websocket::AppendFrameHeader(opcode, true, true, payload.size(),
+                                   frame.get());
+      frame->append(payload);
+      Queue(std::move(frame), false);
+      return;
+    }
+  }
+
+  frame->reserve(message.size() + 10);
+  websocket::AppendFrameHeader(opcode, true, false, message.size(),
+                               frame.get());
+  frame->append(message.data(), message.size());
+  Queue(std::move(frame), false);
+}
+
+void WebSocketConn::SendFrame(std::shared_ptr<const std::string> frame) {
+  Queue(std::move(frame), false);
+}
+
+void WebSocketConn::Close(uint16_t code, string_view reason) {
+  auto frame = std::make_shared<std::string>();
+  websocket::AppendCloseFrame(code, reason, frame.get());
+  Queue(std::move(frame), true);
+}
+
+size_t WebSocketConn::buffered_amount() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return buffered_;
+}
+
+void WebSocketConn::DoRead() {
+  size_t needed = std::max(decoder_.frame_size(), kReadBufferSize);
+  if (input_.size() < needed) {
+    input_.resize(needed);
+  } else if (input_.size() > kMaxKeptBuffer && needed == kReadBufferSize &&
+             input_used_ < kReadBufferSize) {
+    std::vector<char> smaller(input_.begin(), input_.begin() + input_used_);
+    smaller.resize(kReadBufferSize);
+    input_.swap(smaller);
+  }
+
+  auto self = this->self();
+  socket_.async_read_some(
+      asio::buffer(input_.data() + input_used_, input_.size() - input_used_),
+      [this, self](std::error_code ec, std::size_t bytes_transferred) {
+        if (ec) {
+          if (ec != asio::error::operation_aborted) CloseSocket();
+          return;
+        }
+        input_used_ += bytes_transferred;
+        OnRead();
+      });
+}
+
+void WebSocketConn::OnRead() {
+  if (state_ != kConnected) return;
+
+  size_t consumed = decoder_.Decode(
+      input_.data(), input_used_,
+      [this](websocket::Opcode opcode, string_view payload) {
+        OnFrame(opcode, payload);
+      });
+  input_used_ -= consumed;
+  if (consumed > 0 && input_used_ > 0) {
+    memmove(input_.data(), input_.data() + consumed, input_used_);
+  }
+
+  if (decoder_.error()) {
+    // Nothing the client sends from now on is read.
+    peer_closed_ = true;
+    Close(decoder_.error());
+    return;
+  }
+  if (!peer_closed_ && state_ == kConnected) DoRead();
+}
+
+void WebSocketConn::OnFrame(websocket::Opcode opcode, string_view payload) {
+  switch (opcode) {
+    case websocket::kPing: {
+      auto frame = std::make_shared<std::string>();
+      websocket::AppendFrameHeader(websocket::kPong, true, false,
+                                   payload.size(), frame.get());
+      frame->append(payload.data(), payload.size());
+      Queue(std::move(frame), false);
+      break;
+    }
+    case websocket::kPong:
+      break;
+    case websocket::kClose: {
+      peer_closed_ = true;
+      uint16_t code = 0;
+      if (payload.size() >= 2) {
+        code = static_cast<uint8_t>(payload[0]) << 8 |
+               static_cast<uint8_t>(payload[1]);
+      }
+      // Answered with the same code, unless we started the handshake.
+      Close(code);
+      if (close_written_) CloseSocket();
+      break;
+    }
+    default:
+      if (message_callback_) message_callback_(self(), opcode, payload);
+  }
+}
+
+void WebSocketConn::Queue(std::shared_ptr<const std::string> frame,
+                          bool close) {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (close_queued_) return;
+    close_queued_ = close;
+    buffered_ += frame->size();
+    output_.push_back(std::move(frame));
+    if (writing_) return;
+    writing_ = true;
+  }
+
+  auto self = this->self();
+  asio::post(socket_.get_executor(), [this, self]() { DoWrite(); });
+}
+
+void WebSocketConn::DoWrite() {
+  bool close_sent = false;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    sending_size_ = 0;
+    while (!output_.empty() && sending_.size() < kMaxWriteFrames) {
+      sending_size_ += output_.front()->size();
+      sending_.push_back(std::move(output_.front()));
+      output_.pop_front();
+    }
+    if (sending_.empty()) {
+      writing_ = false;
+      close_sent = close_queued_;
+    }
+  }
+  if (sending_.empty()) {
+    if (close_sent && !close_written_ && state_ == kConnected) OnCloseSent();
+    return;
+  }
+
+  buffers_.clear();
+  for (auto& frame : sending_) buffers_.push_back(asio::buffer(*frame));
+  auto self = this->self();
+  asio::async_write(socket_, buffers_,
+                    [this, self](std::error_code ec, std::size_t) {
+                      sending_.clear();
+                      {
+                        std::lock_guard<std::mutex> guard(mutex_);
+                        buffered_ -= std::min(buffered_, sending_size_);
+                      }
+                      if (!ec) {
+                        DoWrite();
+                      } else if (ec != asio::error::operation_aborted) {
+                        CloseSocket();
+                      }
+                    });
+}
+
+void WebSocketConn::OnCloseSent() {
+  close_written_ = true;
+  if (peer_closed_) {
+    CloseSocket();
+    return;
+  }
+
+  auto self = this->self();
+  close_timer_.expires_after(kCloseTimeout);
+  close_timer_.async_wait([this, self](std::error_code ec) {
+    if (!ec) CloseSocket();
+  });
+}
+
+void WebSocketConn::CloseSocket() {
+  if (state_ != kConnected) return;
+  state_ = kDisconnected;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    close_queued_ = true;
+    output_.clear();
+    buffered_ = 0;
+  }
+
+  close_timer_.cancel();
+  std::error_code ignored_ec;
+  socket_.shutdown(asio::ip::tcp::socket::shutdown_both, ignored_ec);
+  socket_.close(ignored_ec);
+
+  if (conn_callback_) conn_callback_(shared_from_this());
+  if (closed_) {
+    auto closed = std::move(closed_);
+    closed_ = nullptr;
+    closed();
+  }
+}
+
+WebSocketHandler::WebSocketHandler(const Options& options)
+    : options_(options), deflate_(options.deflate_level) {}
+
+WebSocketHandler::~WebSocketHandler() = default;
+
+void WebSocketHandler::ServeHttp(const Request& req, Response* rep) {
+  string_view key = StrTrim(req.headers.Get("Sec-WebSocket-Key"));
+  if (req.method != "GET" || req.http_version_major != 1 ||
+      req.http_version_minor < 1 || req.body_source ||
+      !EqualsIgnoreCase(StrTrim(req.headers.Get(kUpgrade)), "websocket") ||
+      !HasToken(req.headers.Get(kConnection), "upgrade") || key.size() != 24) {
+    *rep = Response::stock_reply(Response::bad_request);
+    return;
+  }
+  if (StrTrim(req.headers.Get("Sec-WebSocket-Version")) != "13") {
+    *rep = Response::stock_reply(Response::bad_request);
+    rep->headers.Add("Sec-WebSocket-Version", "13");
+    return;
+  }
+
+  bool deflate = false;
+  if (options_.permessage_deflate) {
+    for (auto& field : req.headers) {
+      if (EqualsIgnoreCase(field.name, "Sec-WebSocket-Extensions") &&
+          websocket::Deflate::Accepts(field.value)) {
+        deflate = true;
+        break;
+      }
+    }
+  }
+
+  std::string path = req.path;
+  bool ok = rep->Takeover([this, path, deflate](asio::ip::tcp::socket socket,
+                                                string_view pending,
+                                                std::function<void()> closed) {
+    return Start(std::move(socket), pending, path, deflate,
+                 std::move(closed));
+  });
+  if (!ok) {
+    *rep = Response::stock_reply(Response::bad_request);
+    return;
+  }
+
+  rep->status = Response::switching_protocols;
+  rep->headers.Add(kUpgrade, "websocket");
+  rep->headers.Add(kConnection, "Upgrade");
+  rep->headers.Add("Sec-WebSocket-Accept", websocket::AcceptKey(key));
+  if (deflate) {
+    rep->headers.Add("Sec-WebSocket-Extensions",
+                     websocket::Deflate::kResponse);
+  }
+}
+
+void WebSocketHandler::Broadcast(websocket::Opcode opcode,
+                                 string_view message) {
+  auto plain = std::make_shared<std::string>();
+  plain->reserve(message.size() + 10);
+  websocket::AppendFrameHeader(opcode, true, false, message.size(),
+                               plain.get());
+  plain->append(message.data(), message.size());
+
+  std::lock_guard<std::mutex> guard(mutex_);
+  std::shared_ptr<std::string> compressed;
+  if (message.size() >= options_.deflate_min_size) {
+    for (auto& conn : conns_) {
+      if (!conn->deflate()) continue;
+      std::string payload;
+      if (deflate_.Compress(message, &payload)) {
+        compressed = std::make_shared<std::string>();
+        websocket::AppendFrameHeader(opcode, true, true, payload.size(),
+                                     compressed.get());
+        compressed->append(payload);
+      }
+      break;
+    }
+  }
+
+  for (auto& conn : conns_) {
+    conn->SendFrame(conn->deflate() && compressed ? compressed : plain);
+  }
+}
+
+size_t WebSocketHandler::conns() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return conns_.size();
+}
+
+std::shared_ptr<net::Conn> WebSocketHandler::Start(
+    asio::ip::tcp::socket socket, string_view pending, std::string path,
+    bool deflate, std::function<void()> closed) {
+  std::unique_ptr<websocket::Deflate> conn_deflate;
+  if (deflate) {
+    conn_deflate.reset(new websocket::Deflate(options_.deflate_level));
+  }
+
+  auto conn = std::make_shared<WebSocketConn>(
+      std::move(socket), std::move(path), options_.max_message_size,
+      std::move(conn_deflate), options_.deflate_min_size, std::move(closed));
+  conn->set_conn_callback(
+      [this](const net::ConnPtr& conn) { OnConn(conn); });
+  conn->set_message_callback(message_callback_);
+  conn->Start(pending);
+  return conn;
+}
+
+void WebSocketHandler::OnConn(const net::ConnPtr& conn) {
+  auto ws = std::static_pointer_cast<WebSocketConn>(conn);
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (conn->state() == net::Conn::kConnected) {
+      conns_.insert(ws);
+    } else {
+      conns_.erase(ws);
+    }
+  }
+  if (conn_callback_) conn_callback_(conn);
+}
+
+}  // namespace http
+}  // namespace cppboot
@@ -0,0 +1,220 @@
+#ifndef CPPBOOT_NET_HTTP_SERVER_WEBSOCKET_HANDLER_H_
+#define CPPBOOT_NET_HTTP_SERVER_WEBSOCKET_HANDLER_H_
+
+#include <stdint.h>
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "asio.hpp"
+
+#include "cppboot/base/string_view.h"
+#include "cppboot/net/connection.h"
+#include "cppboot/net/http/websocket.h"
+
+namespace cppboot {
+namespace http {
+
+struct Request;
+struct Response;
+
+/// A WebSocket connection, taken over from an HTTP request by a
+/// WebSocketHandler. It is message-oriented: each message received goes to
+/// the message callback instead of the receive callback of Conn, and Send()
+/// sends a binary message. The conn callback is called on connect and on
+/// disconnect, like for TcpConn.
+///
+/// Messages are sent from any thread, the callbacks run on the server's.
+class WebSocketConn : public net::Conn {
+ public:
+  typedef std::function<void(const std::shared_ptr<WebSocketConn>& conn,
+                             websocket::Opcode opcode, string_view message)>
+      MessageCallback;
+
+  /// How long a client has to answer a close frame.
+  static const std::chrono::seconds kCloseTimeout;
+
+  /// Speak WebSocket on `socket` for the request of `path`. Compress with
+  /// `deflate` if permessage-deflate was negotiated, messages smaller than
+  /// `deflate_min_size` are sent as they are. `closed` is called once the
+  /// socket was closed.
+  WebSocketConn(asio::ip::tcp::socket socket, std::string path,
+                size_t max_message_size,
+                std::unique_ptr<websocket::Deflate> deflate,
+                size_t deflate_min_size, std::function<void()> closed);
+  ~WebSocketConn();
+
+  void set_message_callback(const MessageCallback& cb) {
+    message_callback_ = cb;
+  }
+
+  /// Start reading, the client sent `pending` already.
+  void Start(string_view pending);
+
+  /// Close the socket without a closing handshake.
+  void Stop() override;
+
+  /// Send a binary message.
+  void Send(const void* data, size_t len) override;
+
+  void SendText(string_view text) { SendMessage(websocket::kText, text); }
+  void SendBinary(string_view data) { SendMessage(websocket::kBinary, data); }
+  void SendMessage(websocket::Opcode opcode, string_view message);
+
+  /// Send a complete frame, e.g. one encoded once for all connections.
+  void SendFrame(std::shared_ptr<const std::string> frame);
+
+  /// Start the closing handshake. The socket is closed once the client
+  /// answered, or after kCloseTimeout.
+  void Close(uint16_t code = websocket::kNormalClosure,
+             string_view reason = string_view());
+
+  /// Path of the upgraded request.
+  const std::string& path() const noexcept { return path_; }
+
+  /// Whether permessage-deflate was negotiated.
+  bool deflate() const noexcept { return deflate_ != nullptr; }
+
+  /// Bytes queued but not sent yet, e.g. to skip slow clients.
+  size_t buffered_amount() const;
+
+  std::string GetRemoteAddress() const noexcept { return remote_address_; }
+
+ private:
+  std::shared_ptr<WebSocketConn> self() {
+    return std::static_pointer_cast<WebSocketConn>(shared_from_this());
+  }
+
+  void DoRead();
+
+  /// Decode the frames read so far, then read more unless done.
+  void OnRead();
+
+  void OnFrame(websocket::Opcode opcode, string_view payload);
+
+  /// Queue `frame`, the last one if `close`.
+  void Queue(std::shared_ptr<const std::string> frame, bool close);
+
+  void DoWrite();
+
+  /// Our close frame was sent.
+  void OnCloseSent();
+
+  void CloseSocket();
+
+  asio::ip::tcp::socket socket_;
+  asio::steady_timer close_timer_;
+  std::string path_;
+  std::string remote_address_;
+  std::unique_ptr<websocket::Deflate> deflate_;
+  size_t deflate_min_size_;
+  std::function<void()> closed_;
+  MessageCallback message_callback_;
+
+  websocket::Decoder decoder_;
+  /// Bytes read, frames are unmasked in place.
+  std::vector<char> input_;
+  size_t input_used_;
+  /// The client sent a close frame, or broke the protocol.
+  bool peer_closed_;
+  /// Our close frame went out.
+  bool close_written_;
+
+  /// Guards the output and compressing with `deflate_`.
+  mutable std::mutex mutex_;
+  std::deque<std::shared_ptr<const std::string>> output_;
+  size_t buffered_;
+  bool writing_;
+  bool close_queued_;
+
+  /// Frames being written.
+  std::vector<std::shared_ptr<const std::string>> sending_;
+  std::vector<asio::const_buffer> buffers_;
+  size_t sending_size_;
+};
+
+typedef std::shared_ptr<WebSocketConn> WebSocketConnPtr;
+
+/// Handler upgrading requests to WebSocket connections, e.g.
+///
+///   WebSocketHandler chat;
+///   chat.set_message_callback([&chat](const WebSocketConnPtr& conn,
+///                                     websocket::Opcode opcode,
+///                                     string_view message) {
+///     chat.Broadcast(opcode, message);
+///   });
+///   server.Handle("/chat", std::bind(&WebSocketHandler::ServeHttp, &chat,
+///                                    _1, _2));
+///
+/// Requests that are not a valid handshake get a 400. permessage-deflate is
+/// negotiated when the client offers it, see websocket::Deflate.
+///
+/// The handler must outlive the server using it.
+class WebSocketHandler {
+ public:
+  struct Options {
+    Options()
+        : max_message_size(16 * 1024 * 1024),
+          permessage_deflate(true),
+          deflate_level(6),
+          deflate_min_size(256) {}
+
+    /// Larger messages close the connection with kMessageTooBig.
+    size_t max_message_size;
+    /// Negotiate permessage-deflate when the client offers it.
+    bool permessage_deflate;
+    int deflate_level;
+    /// Smaller messages are not worth compressing.
+    size_t deflate_min_size;
+  };
+
+  WebSocketHandler(const WebSocketHandler&) = delete;
+  WebSocketHandler& operator=(const WebSocketHandler&) = delete;
+
+  explicit WebSocketHandler(const Options& options = Options());
+  ~WebSocketHandler();
+
+  /// Called when a connection opens and when it closes.
+  void set_conn_callback(const net::ConnCallback& cb) { conn_callback_ = cb; }
+
+  void set_message_callback(const WebSocketConn::MessageCallback& cb) {
+    message_callback_ = cb;
+  }
+
+  void ServeHttp(const Request& req, Response* rep);
+
+  /// Send a message to every open connection. It is framed, and compressed
+  /// for the connections using permessage-deflate, only once.
+  void Broadcast(websocket::Opcode opcode, string_view message);
+
+  /// Number of open connections.
+  size_t conns() const;
+
+ private:
+  /// Take the socket over after the handshake of `path`.
+  std::shared_ptr<net::Conn> Start(asio::ip::tcp::socket socket,
+                                   string_view pending, std::string path,
+                                   bool deflate, std::function<void()> closed);
+
+  void OnConn(const net::ConnPtr& conn);
+
+  Options options_;
+  net::ConnCallback conn_callback_;
+  WebSocketConn::MessageCallback message_callback_;
+
+  /// Guards the connections and `deflate_`.
+  mutable std::mutex mutex_;
+  std::set<std::shared_ptr<WebSocketConn>> conns_;
+  websocket::Deflate deflate_;
+};
+
+}  // namespace http
+}  // namespace cppboot
+
+#endif  // CPPBOOT_NET_HTTP_SERVER_WEBSOCKET_HANDLER_H_
@@ -0,0 +1,292 @@
+#include "gmock/gmock.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "cppboot/net/http/request.h"
+#include "cppboot/net/http/response.h"
+#include "cppboot/net/http/server.h"
+#include "cppboot/net/http/server/websocket_handler.h"
+#include "cppboot/net/http/websocket.h"
+
+namespace {
+
+namespace websocket = cppboot::http::websocket;
+
+using asio::ip::tcp;
+using cppboot::string_view;
+using cppboot::http::Server;
+using cppboot::http::WebSocketConnPtr;
+using cppboot::http::WebSocketHandler;
+using cppboot::net::Conn;
+using cppboot::net::ConnPtr;
+
+/// A server echoing messages on "/echo", closing the connection when told
+/// "close", and broadcasting what it is told on "/chat".
+class ChatServer {
+ public:
+  ChatServer() : connected_(0), disconnected_(0) {
+    auto on_conn = [this](const ConnPtr& conn) {
+      if (conn->state() == Conn::kConnected) {
+        connected_++;
+      } else {
+        disconnected_++;
+      }
+    };
+    echo_.set_conn_callback(on_conn);
+    echo_.set_message_callback([](const WebSocketConnPtr& conn,
+                                  websocket::Opcode opcode,
+                                  string_view message) {
+      if (message == "close") {
+        conn->Close(websocket::kNormalClosure, "bye");
+      } else {
+        conn->SendMessage(opcode, message);
+      }
+    });
+    chat_.set_conn_callback(on_conn);
+    chat_.set_message_callback([this](const WebSocketConnPtr&,
+                                      websocket::Opcode opcode,
+                                      string_view message) {
+      chat_.Broadcast(opcode, message);
+    });
+
+    server_.Handle("/echo", std::bind(&WebSocketHandler::ServeHttp, &echo_,
+                                      std::placeholders::_1,
+                                      std::placeholders::_2));
+    server_.Handle("/chat", std::bind(&WebSocketHandler::ServeHttp, &chat_,
+                                      std::placeholders::_1,
+                                      std::placeholders::_2));
+    auto st = server_.Listen("127.0.0.1", "59989");
+    EXPECT_TRUE(st) << st.ToString();
+    thread_ = std::thread([this]() { server_.Serve(); });
+  }
+
+  ~ChatServer() {
+    server_.Shutdown();
+    thread_.join();
+  }
+
+  WebSocketHandler& chat() { return chat_; }
+  int connected() const { return connected_; }
+  int disconnected() const { return disconnected_; }
+
+ private:
+  WebSocketHandler echo_;
+  WebSocketHandler chat_;
+  Server server_;
+  std::atomic<int> connected_;
+  std::atomic<int> disconnected_;
+  std::thread thread_;
+};
+
+/// A blocking client speaking just enough WebSocket.
+class Client {
+ public:
+  Client() : socket_(io_context_) {}
+
+  /// Send the handshake for `path` and return the response head.
+  std::string Connect(
+      const std::string& path,
+      const std::string& extra_headers = "Sec-WebSocket-Version: 13\r\n") {
+    tcp::resolver resolver(io_context_);
+    asio::connect(socket_, resolver.resolve("127.0.0.1", "59989"));
+    std::string request = "GET " + path +
+                          " HTTP/1.1\r\n"
+                          "Host: 127.0.0.1\r\n"
+                          "Connection: keep-alive, Upgrade\r\n"
+                          "Upgrade: websocket\r\n"
+                          "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n" +
+                          extra_headers + "\r\n";
+    asio::write(socket_, asio::buffer(request));
+
+    asio::error_code ec;
+    size_t n = asio::read_until(socket_, asio::dynamic_buffer(buffer_),
+                                "\r\n\r\n", ec);
+    if (ec) return std::string();
+    std::string head = buffer_.substr(0, n);
+    buffer_.erase(0, n);
+    return head;
+  }
+
+  void Send(int b0, const std::string& payload) {
+    std::string frame;
+    websocket::AppendFrameHeader(websocket::kText, true, false,
+                                 payload.size(), &frame);
+    frame[0] = static_cast<char>(b0);
+    frame[1] = static_cast<char>(frame[1] | 0x80);
+    const char key[4] = {'\x37', '\xfa', '\x21', '\x3d'};
+    frame.append(key, 4);
+    size_t start = frame.size();
+    frame.resize(start + payload.size());
+    websocket::Mask(payload.data(), &frame[start], payload.size(), key);
+    asio::write(socket_, asio::buffer(frame));
+  }
+
+  /// Read a frame, false at the end of the connection.
+  bool Read(int* b0, std::string* payload) {
+    asio::error_code ec;
+    if (!Fill(2, &ec)) return false;
+    auto p = reinterpret_cast<const uint8_t*>(buffer_.data());
+    *b0 = p[0];
+    uint64_t length = p[1] & 0x7f;
+    size_t header = 2;
+    if (length == 126) {
+      header = 4;
+      if (!Fill(header, &ec)) return false;
+      p = reinterpret_cast<const uint8_t*>(buffer_.data());
+      length = p[2] << 8 | p[3];
+    } else if (length == 127) {
+      header = 10;
+      if (!Fill(header, &ec)) return false;
+      p = reinterpret_cast<const uint8_t*>(buffer_.data());
+      length = 0;
+      for (int i = 2; i < 10; i++) length = length << 8 | p[i];
+    }
+    if (!Fill(header + length, &ec)) return false;
+    payload->assign(buffer_, header, length);
+    buffer_.erase(0, header + length);
+    return true;
+  }
+
+  /// Whether the server closed the connection.
+  bool AtEnd() {
+    asio::error_code ec;
+    return !Fill(buffer_.size() + 1, &ec) && ec == asio::error::eof;
+  }
+
+ private:
+  bool Fill(size_t size, asio::error_code* ec) {
+    if (buffer_.size() >= size) return true;
+    asio::read(socket_, asio::dynamic_buffer(buffer_),
+               asio::transfer_at_least(size - buffer_.size()), *ec);
+    return buffer_.size() >= size;
+  }
+
+  asio::io_context io_context_;
+  tcp::socket socket_;
+  std::string buffer_;
+};
+
+TEST(WebSocketHandler, Echo) {
+  ChatServer server;
+  Client client;
+  std::string head = client.Connect("/echo");
+  ASSERT_THAT(head, ::testing::StartsWith("HTTP/1.1 101 "));
+  ASSERT_THAT(head, ::testing::HasSubstr(
+                        "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo="));
+  ASSERT_THAT(head, ::testing::Not(::testing::HasSubstr("Content-Length")));
+  ASSERT_THAT(head,
+              ::testing::Not(::testing::HasSubstr("Sec-WebSocket-Extensions")));
+
+  int b0;
+  std::string payload;
+  client.Send(0x81, "hello");
+  ASSERT_TRUE(client.Read(&b0, &payload));
+  ASSERT_EQ(b0, 0x81);
+  ASSERT_EQ(payload, "hello");
+
+  // Fragmented, with a ping in between, answered first.
+  std::string big(100000, 'x');
+  client.Send(0x02, big.substr(0, 1000));
+  client.Send(0x89, "are you there");
+  client.Send(0x80, big.substr(1000));
+  ASSERT_TRUE(client.Read(&b0, &payload));
+  ASSERT_EQ(b0, 0x8a);
+  ASSERT_EQ(payload, "are you there");
+  ASSERT_TRUE(client.Read(&b0, &payload));
+  ASSERT_EQ(b0, 0x82);
+  ASSERT_EQ(payload, big);
+
+  // The client closes, the server answers and hangs up.
+  client.Send(0x88, std::string("\x03\xe9", 2));
+  ASSERT_TRUE(client.Read(&b0, &payload));
+  ASSERT_EQ(b0, 0x88);
+  ASSERT_EQ(payload, std::string("\x03\xe9", 2));
+  ASSERT_TRUE(client.AtEnd());
+
+  // The server closes.
+  Client client2;
+  client2.Connect("/echo");
+  client2.Send(0x81, "close");
+  ASSERT_TRUE(client2.Read(&b0, &payload));
+  ASSERT_EQ(b0, 0x88);
+  ASSERT_EQ(payload, std::string("\x03\xe8" "bye", 5));
+  client2.Send(0x88, std::string("\x03\xe8", 2));
+  ASSERT_TRUE(client2.AtEnd());
+
+  // A protocol error, an unknown opcode.
+  Client client3;
+  client3.Connect("/echo");
+  client3.Send(0x83, "");
+  ASSERT_TRUE(client3.Read(&b0, &payload));
+  ASSERT_EQ(b0, 0x88);
+  ASSERT_EQ(payload, std::string("\x03\xea", 2));
+  ASSERT_TRUE(client3.AtEnd());
+
+  for (int i = 0; i < 100 && server.disconnected() < 3; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ(server.connected(), 3);
+  ASSERT_EQ(server.disconnected(), 3);
+}
+
+TEST(WebSocketHandler, BadHandshake) {
+  ChatServer server;
+  Client client;
+  std::string head = client.Connect("/echo", "Sec-WebSocket-Version: 8\r\n");
+  ASSERT_THAT(head, ::testing::StartsWith("HTTP/1.0 400 "));
+  ASSERT_THAT(head, ::testing::HasSubstr("Sec-WebSocket-Version: 13"));
+}
+
+TEST(WebSocketHandler, Broadcast) {
+  ChatServer server;
+  Client plain, compressed;
+  plain.Connect("/chat");
+  std::string head = compressed.Connect(
+      "/chat",
+      "Sec-WebSocket-Version: 13\r\n"
+      "Sec-WebSocket-Extensions: permessage-deflate; "
+      "client_max_window_bits\r\n");
+  bool deflate = websocket::Deflate::Supported();
+  if (deflate) {
+    ASSERT_THAT(head, ::testing::HasSubstr(
+                          "Sec-WebSocket-Extensions: permessage-deflate; "
+                          "server_no_context_takeover; "
+                          "client_no_context_takeover"));
+  }
+  for (int i = 0; i < 100 && server.chat().conns() < 2; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  ASSERT_EQ(server.chat().conns(), 2);
+
+  std::string text;
+  for (int i = 0; i < 500; i++) text += "broadcast ";
+  plain.Send(0x81, text);
+
+  int b0;
+  std::string payload;
+  ASSERT_TRUE(plain.Read(&b0, &payload));
+  ASSERT_EQ(b0, 0x81);
+  ASSERT_EQ(payload, text);
+
+  ASSERT_TRUE(compressed.Read(&b0, &payload));
+  if (deflate) {
+    ASSERT_EQ(b0, 0xc1);
+    ASSERT_LT(payload.size(), text.size() / 10);
+    websocket::Deflate inflater(6);
+    std::string out;
+    ASSERT_TRUE(inflater.Decompress(payload, text.size(), &out));
+    ASSERT_EQ(out, text);
+  } else {
+    ASSERT_EQ(payload, text);
+  }
+
+  // Small messages are not compressed.
+  plain.Send(0x81, "hi");
+  ASSERT_TRUE(compressed.Read(&b0, &payload));
+  ASSERT_EQ(b0, 0x81);
+  ASSERT_EQ(payload, "hi");
+}
+
+}  // namespace
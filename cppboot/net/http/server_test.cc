@@ -9,7 +9,11 @@
 #include "cppboot/base/json.h"
 #include "cppboot/base/str_util.h"
 #include "cppboot/net/http/client.h"
+#include "cppboot/net/http/compress.h"
+#include "cppboot/net/http/hpack.h"
 #include "cppboot/net/http/server.h"
+#include "cppboot/net/http/server/file_io_service.h"
+#include "cppboot/net/http/server/file_server.h"
 #include "cppboot/net/http/request.h"
 #include "cppboot/net/http/response.h"
 
@@ -24,7 +28,7 @@ TEST(Http, HttpServerAndClient) {
     // Get
     if (req.method == "GET") {
       auto name = req.Param("name");
-      resp->WriteText(Response::ok, "Hello, " + name);
+      resp->WriteText(Response::ok, "Hello, " + name.str());
     }
   });
 
@@ -150,6 +154,219 @@ TEST(Http, HttpServerAndClient) {
   t.join();
 }
 
+TEST(Http, SendLargeFile) {
+  auto root = cppboot::GetTempPath("cppboot_http_send_file");
+  cppboot::MkdirAll(root);
+  std::string data;
+  for (int i = 0; i < 100000; i++) data += std::to_string(i);
+  ASSERT_TRUE(cppboot::WriteFile(root + "/big.txt", data));
+
+  cppboot::http::FileServer fileserver(root);
+  fileserver.cache().set_limits(1024, 16, 1024);
+
+  cppboot::http::Server server;
+  server.Handle("/", [&](const Request& req, Response* resp) {
+    fileserver.ServeHttp(req, resp);
+  });
+  auto st = server.Listen("127.0.0.1", "59998");
+  ASSERT_TRUE(st) << st.ToString();
+  std::thread t([&]() { server.Serve(); });
+
+  Response resp;
+  st = cppboot::http::Get("http://127.0.0.1:59998/big.txt", &resp);
+  ASSERT_TRUE(st) << st.ToString();
+  ASSERT_EQ(resp.content.size(), data.size());
+  ASSERT_TRUE(resp.content == data);
+
+  server.Shutdown();
+  t.join();
+  cppboot::RemoveAll(root);
+}
+
+TEST(Http, SendFileOnIoService) {
+  auto root = cppboot::GetTempPath("cppboot_http_send_file_io");
+  cppboot::MkdirAll(root);
+  std::string data;
+  for (int i = 0; i < 100000; i++) data += std::to_string(i);
+  ASSERT_TRUE(cppboot::WriteFile(root + "/big.txt", data));
+  ASSERT_TRUE(cppboot::WriteFile(root + "/small.txt", "small"));
+
+  cppboot::http::FileIoService io;
+  cppboot::http::FileServer fileserver(root);
+  fileserver.cache().set_limits(1024, 16, 1024);
+  fileserver.set_io_service(&io);
+
+  cppboot::http::Server server;
+  server.Handle("/", [&](const Request& req, Response* resp) {
+    fileserver.ServeHttp(req, resp);
+  });
+  auto st = server.Listen("127.0.0.1", "59997");
+  ASSERT_TRUE(st) << st.ToString();
+  std::thread t([&]() { server.Serve(); });
+
+  Response resp;
+  st = cppboot::http::Get("http://127.0.0.1:59997/big.txt", &resp);
+  ASSERT_TRUE(st) << st.ToString();
+  ASSERT_TRUE(resp.content == data);
+
+  Response resp2;
+  st = cppboot::http::Get("http://127.0.0.1:59997/small.txt", &resp2);
+  ASSERT_TRUE(st) << st.ToString();
+  ASSERT_EQ(resp2.content, "small");
+
+  server.Shutdown();
+  t.join();
+  cppboot::RemoveAll(root);
+}
+
+TEST(Http, CompressResponse) {
+  cppboot::json data = cppboot::json::array();
+  for (int i = 0; i < 1000; i++) data.push_back({{"id", i}, {"name", "xrw"}});
+
+  cppboot::http::Server server;
+  server.Handle("/data", [&](const Request& req, Response* resp) {
+    resp->WriteJson(Response::ok, data);
+  });
+  auto st = server.Listen("127.0.0.1", "59996");
+  ASSERT_TRUE(st) << st.ToString();
+  std::thread t([&]() { server.Serve(); });
+
+  Request req("GET", "http://127.0.0.1:59996/data");
+  req.set_header("Accept-Encoding", "gzip");
+  cppboot::http::Client client;
+  Response resp;
+  st = client.Do(req, &resp);
+  ASSERT_TRUE(st) << st.ToString();
+  ASSERT_EQ(resp.header("Content-Encoding"), "gzip");
+
+  std::string body;
+  ASSERT_TRUE(
+      cppboot::http::Decompress(cppboot::http::kGzip, resp.content, &body));
+  ASSERT_LT(resp.content.size(), body.size() / 4);
+  ASSERT_EQ(cppboot::json::parse(body), data);
+
+  server.Shutdown();
+  t.join();
+}
+
+/// Read HTTP/2 frames from `socket` after those in `buf` until the end of
+/// stream 1, returns its status and body.
+std::string ReadH2Response(asio::ip::tcp::socket& socket,
+                           asio::streambuf* buf) {
+  cppboot::http::HpackDecoder decoder;
+  std::string status, body;
+  auto take = [&](size_t n) {
+    if (buf->size() < n) {
+      asio::read(socket, *buf, asio::transfer_exactly(n - buf->size()));
+    }
+    std::string s(asio::buffers_begin(buf->data()),
+                  asio::buffers_begin(buf->data()) + n);
+    buf->consume(n);
+    return s;
+  };
+  for (;;) {
+    std::string frame = take(9);
+    const unsigned char* head =
+        reinterpret_cast<const unsigned char*>(frame.data());
+    std::string payload = take(head[0] << 16 | head[1] << 8 | head[2]);
+    uint32_t id = head[5] << 24 | head[6] << 16 | head[7] << 8 | head[8];
+    if (id != 1) continue;
+
+    if (head[3] == 0x1) {
+      std::vector<cppboot::http::HpackField> fields;
+      EXPECT_TRUE(decoder.Decode(payload, &fields));
+      status = fields.at(0).value;
+    } else if (head[3] == 0x0) {
+      body += payload;
+    }
+    if (head[4] & 0x1) return status + " " + body;
+  }
+}
+
+TEST(Http, ServeHttp2) {
+  cppboot::http::Server server;
+  server.Handle("/hello", [&](const Request& req, Response* resp) {
+    resp->WriteText(Response::ok, "Hello, " + req.Param("name").str());
+  });
+  server.Handle("/upload", [&](const Request& req, Response* resp) {
+    resp->WriteText(Response::ok,
+                    req.content + (req.body_source.read ? "+more" : ""));
+  });
+  auto st = server.Listen("127.0.0.1", "59996");
+  ASSERT_TRUE(st) << st.ToString();
+  std::thread t([&]() { server.Serve(); });
+
+  asio::io_context io;
+  asio::ip::tcp::endpoint endpoint(asio::ip::make_address("127.0.0.1"),
+                                   59996);
+  const std::string preface("PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n", 24);
+  const std::string settings("\0\0\0\x04\0\0\0\0\0", 9);
+
+  // With prior knowledge.
+  {
+    asio::ip::tcp::socket socket(io);
+    socket.connect(endpoint);
+    cppboot::http::HpackEncoder encoder;
+    std::string block;
+    encoder.Begin(&block);
+    encoder.Add(":method", "GET", &block);
+    encoder.Add(":scheme", "http", &block);
+    encoder.Add(":path", "/hello?name=h2", &block);
+    std::string headers("\0\0\0\x01\x05\0\0\0\x01", 9);
+    headers[2] = static_cast<char>(block.size());
+    asio::write(socket, asio::buffer(preface + settings + headers + block));
+    asio::streambuf buf;
+    ASSERT_EQ(ReadH2Response(socket, &buf), "200 Hello, h2");
+  }
+
+  // Upgraded from HTTP/1.1, the request is answered on stream 1.
+  {
+    asio::ip::tcp::socket socket(io);
+    socket.connect(endpoint);
+    asio::write(socket, asio::buffer(std::string(
+                            "GET /hello?name=up HTTP/1.1\r\n"
+                            "Host: 127.0.0.1\r\n"
+                            "Connection: Upgrade, HTTP2-Settings\r\n"
+                            "Upgrade: h2c\r\n"
+                            "HTTP2-Settings: AAMAAABkAAQAAP__\r\n"
+                            "\r\n")));
+    asio::streambuf buf;
+    size_t n = asio::read_until(socket, buf, "\r\n\r\n");
+    std::string head(asio::buffers_begin(buf.data()),
+                     asio::buffers_begin(buf.data()) + n);
+    ASSERT_TRUE(cppboot::StartsWith(head, "HTTP/1.1 101 "));
+    buf.consume(n);
+
+    asio::write(socket, asio::buffer(preface + settings));
+    ASSERT_EQ(ReadH2Response(socket, &buf), "200 Hello, up");
+  }
+
+  // Not upgraded while the body has not arrived with the head.
+  {
+    asio::ip::tcp::socket socket(io);
+    socket.connect(endpoint);
+    asio::write(socket, asio::buffer(std::string(
+                            "POST /upload HTTP/1.1\r\n"
+                            "Host: 127.0.0.1\r\n"
+                            "Connection: Upgrade, HTTP2-Settings\r\n"
+                            "Upgrade: h2c\r\n"
+                            "HTTP2-Settings: AAMAAABkAAQAAP__\r\n"
+                            "Content-Length: 10\r\n"
+                            "\r\n"
+                            "0123")));
+    asio::streambuf buf;
+    asio::error_code ec;
+    asio::read(socket, buf, ec);
+    std::string reply(asio::buffers_begin(buf.data()),
+                      asio::buffers_end(buf.data()));
+    ASSERT_TRUE(cppboot::StartsWith(reply, "HTTP/1.0 200 ")) << reply;
+    ASSERT_TRUE(cppboot::EndsWith(reply, "\r\n\r\n0123+more")) << reply;
+  }
+
+  server.Shutdown();
+  t.join();
+}
+
 TEST(Http, HttpsServerAndClient) {}
 
 }  // namespace
\ No newline at end of file
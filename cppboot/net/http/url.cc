@@ -1,5 +1,7 @@
 #include "cppboot/net/http/url.h"
 
+#include <stdint.h>
+
 #include "cppboot/base/str_util.h"
 #include "cppboot/base/fmt.h"
 
@@ -18,6 +20,32 @@ string_view ConsumeUtil(const char** start, const char* end, char util) {
   return result;
 }
 
+/// Lookup tables, so that escaping and unescaping do not branch on ranges.
+struct EscapeTables {
+  EscapeTables() {
+    for (int c = 0; c < 256; c++) {
+      hex[c] = -1;
+      if (c >= '0' && c <= '9') hex[c] = static_cast<int8_t>(c - '0');
+      if (c >= 'a' && c <= 'f') hex[c] = static_cast<int8_t>(c - 'a' + 10);
+      if (c >= 'A' && c <= 'F') hex[c] = static_cast<int8_t>(c - 'A' + 10);
+
+      unreserved[c] = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+                      (c >= 'A' && c <= 'Z') || c == '-' || c == '_' ||
+                      c == '.' || c == '~';
+    }
+  }
+
+  int8_t hex[256];
+  bool unreserved[256];
+};
+
+const EscapeTables& Tables() noexcept {
+  static const EscapeTables tables;
+  return tables;
+}
+
+const char kUpperHex[] = "0123456789ABCDEF";
+
 }  // namespace
 
 Url::Url(string_view raw_url) noexcept {
@@ -51,5 +79,96 @@ Url::Url(string_view raw_url) noexcept {
   }
 }
 
+std::string Url::hostname() const {
+  auto colon = host.find_last_of(':');
+  if (colon == std::string::npos) return host;
+  return colon == 0 ? "0.0.0.0" : host.substr(0, colon);
+}
+
+std::string Url::port() const {
+  auto colon = host.find_last_of(':');
+  return colon == std::string::npos ? scheme : host.substr(colon + 1);
+}
+
+size_t UnescapeInPlace(char* s, size_t size, bool plus_as_space) noexcept {
+  const int8_t* hex = Tables().hex;
+  const char* p = s;
+  const char* end = s + size;
+  char* out = s;
+  while (p != end) {
+    char c = *p;
+    if (c == '%' && end - p >= 3) {
+      int hi = hex[static_cast<uint8_t>(p[1])];
+      int lo = hex[static_cast<uint8_t>(p[2])];
+      if ((hi | lo) >= 0) {
+        *out++ = static_cast<char>(hi << 4 | lo);
+        p += 3;
+        continue;
+      }
+    } else if (c == '+' && plus_as_space) {
+      c = ' ';
+    }
+    *out++ = c;
+    p++;
+  }
+  return out - s;
+}
+
+std::string PathUnescape(string_view s) {
+  std::string result = s.str();
+  if (!result.empty()) {
+    result.resize(UnescapeInPlace(&result[0], result.size(), false));
+  }
+  return result;
+}
+
+std::string QueryUnescape(string_view s) {
+  std::string result = s.str();
+  if (!result.empty()) {
+    result.resize(UnescapeInPlace(&result[0], result.size(), true));
+  }
+  return result;
+}
+
+size_t QueryEscapedSize(string_view s) noexcept {
+  const bool* unreserved = Tables().unreserved;
+  size_t size = s.size();
+  for (char c : s) {
+    if (!unreserved[static_cast<uint8_t>(c)] && c != ' ') size += 2;
+  }
+  return size;
+}
+
+void QueryEscape(string_view s, std::string* out) {
+  size_t size = QueryEscapedSize(s);
+  if (size == s.size() && s.find(' ') == string_view::npos) {
+    out->append(s.data(), s.size());
+    return;
+  }
+
+  const bool* unreserved = Tables().unreserved;
+  size_t offset = out->size();
+  out->resize(offset + size);
+  char* p = &(*out)[offset];
+  for (char c : s) {
+    uint8_t u = static_cast<uint8_t>(c);
+    if (unreserved[u]) {
+      *p++ = c;
+    } else if (c == ' ') {
+      *p++ = '+';
+    } else {
+      *p++ = '%';
+      *p++ = kUpperHex[u >> 4];
+      *p++ = kUpperHex[u & 15];
+    }
+  }
+}
+
+std::string QueryEscape(string_view s) {
+  std::string result;
+  QueryEscape(s, &result);
+  return result;
+}
+
 }  // namespace http
 }  // namespace cppboot
\ No newline at end of file
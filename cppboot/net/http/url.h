@@ -19,8 +19,32 @@ struct Url {
   explicit Url(string_view raw_url) noexcept;
 
   bool IsValid() const noexcept { return !scheme.empty(); }
+
+  /// `host` without the port, "0.0.0.0" if it is empty.
+  std::string hostname() const;
+  /// The port of `host`, or else the scheme as a service name.
+  std::string port() const;
 };
 
+/// Decode the %XX escapes of the `size` bytes at `s` in place, and '+' into
+/// ' ' if `plus_as_space` as in query strings. Malformed escapes are kept
+/// as they are. Returns the decoded size, which is at most `size`.
+size_t UnescapeInPlace(char* s, size_t size, bool plus_as_space) noexcept;
+
+/// Decoded copy of a path, '+' is kept.
+std::string PathUnescape(string_view s);
+
+/// Decoded copy of a query component, '+' becomes ' '.
+std::string QueryUnescape(string_view s);
+
+/// Size of `s` escaped by QueryEscape().
+size_t QueryEscapedSize(string_view s) noexcept;
+
+/// Append `s` escaped to be a query key or value to `out`. Only
+/// [A-Za-z0-9-_.~] are kept, ' ' becomes '+' and other bytes %XX.
+void QueryEscape(string_view s, std::string* out);
+std::string QueryEscape(string_view s);
+
 }  // namespace http
 }  // namespace cppboot
 
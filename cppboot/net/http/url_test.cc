@@ -45,6 +45,28 @@ TEST(Url, ParseHttps) {
   ASSERT_EQ(url.raw_query, "q=dotnet");
 }
 
+TEST(Url, Unescape) {
+  using cppboot::http::PathUnescape;
+  using cppboot::http::QueryUnescape;
+
+  ASSERT_EQ(PathUnescape("/a%2Fb+c%2"), "/a/b+c%2");
+  ASSERT_EQ(QueryUnescape("a%2fb+c%"), "a/b c%");
+  ASSERT_EQ(QueryUnescape("%00%ff"), std::string("\0\xff", 2));
+}
+
+TEST(Url, QueryEscape) {
+  using cppboot::http::QueryEscape;
+  using cppboot::http::QueryEscapedSize;
+
+  ASSERT_EQ(QueryEscape("azAZ09-_.~"), "azAZ09-_.~");
+  ASSERT_EQ(QueryEscape("a b+c&d"), "a+b%2Bc%26d");
+  ASSERT_EQ(QueryEscapedSize("a b+c&d"), 11);
+
+  std::string out = "x=";
+  QueryEscape("\x01/", &out);
+  ASSERT_EQ(out, "x=%01%2F");
+}
+
 #if 0
 TEST(Url, DISABLED_Parse) {
     cppboot::http::Url url;
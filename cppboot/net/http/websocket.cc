@@ -0,0 +1,575 @@
+#include "cppboot/net/http/websocket.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#if CPPBOOT_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "cppboot/base/str_util.h"
+
+namespace cppboot {
+namespace http {
+namespace websocket {
+
+namespace {
+
+/// Appended to the Sec-WebSocket-Key before hashing it.
+const char kAcceptGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+/// Buffers of larger messages are released once the message was delivered.
+const size_t kMaxKeptCapacity = 64 * 1024;
+
+uint32_t RotateLeft(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+/// SHA-1, only used for the handshake, where the protocol requires it.
+void Sha1(string_view in, uint8_t digest[20]) {
+  uint32_t h[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476,
+                   0xc3d2e1f0};
+
+  std::string msg(in.data(), in.size());
+  msg.push_back('\x80');
+  while (msg.size() % 64 != 56) msg.push_back('\0');
+  uint64_t bits = static_cast<uint64_t>(in.size()) * 8;
+  for (int i = 7; i >= 0; i--) {
+    msg.push_back(static_cast<char>(bits >> (i * 8)));
+  }
+
+  for (size_t chunk = 0; chunk < msg.size(); chunk += 64) {
+    auto p = reinterpret_cast<const uint8_t*>(msg.data() + chunk);
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+      w[i] = static_cast<uint32_t>(p[i * 4]) << 24 | p[i * 4 + 1] << 16 |
+             p[i * 4 + 2] << 8 | p[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++) {
+      w[i] = RotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+      uint32_t f, k;
+      if (i < 20) {
+        f = (b & c) | (~b & d);
+        k = 0x5a827999;
+      } else if (i < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ed9eba1;
+      } else if (i < 60) {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8f1bbcdc;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xca62c1d6;
+      }
+      uint32_t t = RotateLeft(a, 5) + f + e + k + w[i];
+      e = d;
+      d = c;
+      c = RotateLeft(b, 30);
+      b = a;
+      a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+  }
+
+  for (int i = 0; i < 20; i++) {
+    digest[i] = static_cast<uint8_t>(h[i / 4] >> (24 - (i % 4) * 8));
+  }
+}
+
+void Base64Encode(const uint8_t* in, size_t size, std::string* out) {
+  static const char kAlphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t i = 0;
+  for (; i + 3 <= size; i += 3) {
+    uint32_t v = in[i] << 16 | in[i + 1] << 8 | in[i + 2];
+    out->push_back(kAlphabet[v >> 18]);
+    out->push_back(kAlphabet[(v >> 12) & 0x3f]);
+    out->push_back(kAlphabet[(v >> 6) & 0x3f]);
+    out->push_back(kAlphabet[v & 0x3f]);
+  }
+  if (i + 1 == size) {
+    uint32_t v = in[i] << 16;
+    out->push_back(kAlphabet[v >> 18]);
+    out->push_back(kAlphabet[(v >> 12) & 0x3f]);
+    out->append("==");
+  } else if (i + 2 == size) {
+    uint32_t v = in[i] << 16 | in[i + 1] << 8;
+    out->push_back(kAlphabet[v >> 18]);
+    out->push_back(kAlphabet[(v >> 12) & 0x3f]);
+    out->push_back(kAlphabet[(v >> 6) & 0x3f]);
+    out->push_back('=');
+  }
+}
+
+/// Whether a close frame may carry `code`.
+bool IsValidCloseCode(uint16_t code) {
+  return (code >= 1000 && code <= 1003) || (code >= 1007 && code <= 1014) ||
+         (code >= 3000 && code <= 4999);
+}
+
+/// Whether `value` of the window bits parameter `name` of an offer, possibly
+/// quoted and empty if absent, is one we can honor.
+bool AcceptsWindowBits(string_view name, string_view value) {
+  if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+    value = value.substr(1, value.size() - 2);
+  }
+  int bits = 0;
+  for (char c : value) {
+    if (c < '0' || c > '9' || bits > 15) return false;
+    bits = bits * 10 + (c - '0');
+  }
+  if (EqualsIgnoreCase(name, "client_max_window_bits")) {
+    // Only tells that the client could use a smaller window, we inflate
+    // with the largest one anyway.
+    return value.empty() || (bits >= 8 && bits <= 15);
+  }
+  // A smaller server window would make compressed messages depend on the
+  // connection they are sent on.
+  return bits == 15;
+}
+
+/// Whether a single permessage-deflate offer has only parameters we honor.
+bool AcceptsOffer(string_view offer) {
+  size_t semicolon = offer.find(';');
+  if (!EqualsIgnoreCase(StrTrim(offer.substr(0, semicolon)),
+                        "permessage-deflate")) {
+    return false;
+  }
+
+  unsigned seen = 0;
+  while (semicolon != string_view::npos) {
+    offer = offer.substr(semicolon + 1);
+    semicolon = offer.find(';');
+    auto param = StrTrim(offer.substr(0, semicolon));
+    size_t eq = param.find('=');
+    auto name = StrTrim(param.substr(0, eq));
+    auto value =
+        eq == string_view::npos ? string_view() : StrTrim(param.substr(eq + 1));
+
+    unsigned bit;
+    if (EqualsIgnoreCase(name, "server_no_context_takeover")) {
+      bit = 1;
+    } else if (EqualsIgnoreCase(name, "client_no_context_takeover")) {
+      bit = 2;
+    } else if (EqualsIgnoreCase(name, "server_max_window_bits") ||
+               EqualsIgnoreCase(name, "client_max_window_bits")) {
+      if (!AcceptsWindowBits(name, value)) return false;
+      bit = EqualsIgnoreCase(name, "server_max_window_bits") ? 4 : 8;
+    } else {
+      return false;
+    }
+    if (bit < 4 && eq != string_view::npos) return false;
+    // Each parameter may be given once.
+    if (seen & bit) return false;
+    seen |= bit;
+  }
+  return true;
+}
+
+}  // namespace
+
+std::string AcceptKey(string_view key) {
+  std::string input(key.data(), key.size());
+  input.append(kAcceptGuid);
+  uint8_t digest[20];
+  Sha1(input, digest);
+
+  std::string out;
+  Base64Encode(digest, sizeof(digest), &out);
+  return out;
+}
+
+void Mask(const char* in, char* out, size_t size, const char key[4]) noexcept {
+  uint32_t key32;
+  memcpy(&key32, key, 4);
+  size_t i = 0;
+  // Each block starts at a multiple of 4, where the key starts over.
+#if defined(__SSE2__)
+  const __m128i key128 = _mm_set1_epi32(static_cast<int>(key32));
+  for (; i + 16 <= size; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                     _mm_xor_si128(v, key128));
+  }
+#elif defined(__ARM_NEON)
+  const uint8x16_t key128 = vreinterpretq_u8_u32(vdupq_n_u32(key32));
+  for (; i + 16 <= size; i += 16) {
+    uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(in + i));
+    vst1q_u8(reinterpret_cast<uint8_t*>(out + i), veorq_u8(v, key128));
+  }
+#endif
+  const uint64_t key64 = static_cast<uint64_t>(key32) << 32 | key32;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t v;
+    memcpy(&v, in + i, 8);
+    v ^= key64;
+    memcpy(out + i, &v, 8);
+  }
+  for (; i < size; i++) out[i] = in[i] ^ key[i & 3];
+}
+
+bool IsValidUtf8(string_view s) noexcept {
+  auto p = reinterpret_cast<const uint8_t*>(s.data());
+  auto end = p + s.size();
+  while (p < end) {
+    if (end - p >= 8) {
+      uint64_t v;
+      memcpy(&v, p, 8);
+      if ((v & 0x8080808080808080ull) == 0) {
+        p += 8;
+        continue;
+      }
+    }
+    uint8_t c = *p;
+    if (c < 0x80) {
+      p++;
+      continue;
+    }
+
+    int n;
+    uint32_t cp;
+    if ((c & 0xe0) == 0xc0) {
+      n = 2;
+      cp = c & 0x1f;
+    } else if ((c & 0xf0) == 0xe0) {
+      n = 3;
+      cp = c & 0x0f;
+    } else if ((c & 0xf8) == 0xf0) {
+      n = 4;
+      cp = c & 0x07;
+    } else {
+      return false;
+    }
+    if (end - p < n) return false;
+    for (int i = 1; i < n; i++) {
+      if ((p[i] & 0xc0) != 0x80) return false;
+      cp = cp << 6 | (p[i] & 0x3f);
+    }
+    // Overlong forms, surrogates and code points past Unicode.
+    if ((n == 2 && cp < 0x80) || (n == 3 && cp < 0x800) ||
+        (n == 4 && cp < 0x10000) || cp > 0x10ffff ||
+        (cp >= 0xd800 && cp <= 0xdfff)) {
+      return false;
+    }
+    p += n;
+  }
+  return true;
+}
+
+void AppendFrameHeader(Opcode opcode, bool fin, bool compressed,
+                       uint64_t size, std::string* out) {
+  out->push_back(static_cast<char>((fin ? 0x80 : 0) | (compressed ? 0x40 : 0) |
+                                   opcode));
+  if (size < 126) {
+    out->push_back(static_cast<char>(size));
+  } else if (size <= 0xffff) {
+    out->push_back(126);
+    out->push_back(static_cast<char>(size >> 8));
+    out->push_back(static_cast<char>(size));
+  } else {
+    out->push_back(127);
+    for (int i = 7; i >= 0; i--) {
+      out->push_back(static_cast<char>(size >> (i * 8)));
+    }
+  }
+}
+
+void AppendCloseFrame(uint16_t code, string_view reason, std::string* out) {
+  if (code == 0) {
+    AppendFrameHeader(kClose, true, false, 0, out);
+    return;
+  }
+  // Control frames carry at most 125 bytes, and the reason must stay valid
+  // UTF-8: a code point cut in the middle is dropped whole.
+  if (reason.size() > 123) {
+    size_t size = 123;
+    while (size > 0 && (static_cast<uint8_t>(reason[size]) & 0xc0) == 0x80) {
+      size--;
+    }
+    reason = reason.substr(0, size);
+  }
+  AppendFrameHeader(kClose, true, false, 2 + reason.size(), out);
+  out->push_back(static_cast<char>(code >> 8));
+  out->push_back(static_cast<char>(code));
+  out->append(reason.data(), reason.size());
+}
+
+const char Deflate::kResponse[] =
+    "permessage-deflate; server_no_context_takeover; "
+    "client_no_context_takeover";
+
+#if CPPBOOT_HAVE_ZLIB
+struct Deflate::Streams {
+  Streams() : deflater(), inflater(), deflating(false), inflating(false) {}
+  ~Streams() {
+    if (deflating) deflateEnd(&deflater);
+    if (inflating) inflateEnd(&inflater);
+  }
+
+  z_stream deflater;
+  z_stream inflater;
+  bool deflating;
+  bool inflating;
+};
+#else
+struct Deflate::Streams {};
+#endif
+
+Deflate::Deflate(int level) : level_(level), streams_(new Streams) {}
+
+Deflate::~Deflate() = default;
+
+bool Deflate::Supported() noexcept { return CPPBOOT_HAVE_ZLIB; }
+
+bool Deflate::Accepts(string_view offers) noexcept {
+  if (!Supported()) return false;
+  while (!offers.empty()) {
+    size_t comma = offers.find(',');
+    if (AcceptsOffer(offers.substr(0, comma))) return true;
+    offers = comma == string_view::npos ? string_view()
+                                        : offers.substr(comma + 1);
+  }
+  return false;
+}
+
+bool Deflate::Compress(string_view in, std::string* out) {
+#if CPPBOOT_HAVE_ZLIB
+  z_stream& zs = streams_->deflater;
+  if (!streams_->deflating) {
+    // Raw deflate, the extension has no zlib header.
+    if (deflateInit2(&zs, level_, Z_DEFLATED, -MAX_WBITS, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+      return false;
+    }
+    streams_->deflating = true;
+  } else {
+    deflateReset(&zs);
+  }
+
+  size_t start = out->size();
+  size_t used = start;
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+  zs.avail_in = in.size();
+  int ret;
+  do {
+    // Room for the flush marker too.
+    out->resize(used + deflateBound(&zs, zs.avail_in) + 16);
+    zs.next_out = reinterpret_cast<Bytef*>(&(*out)[used]);
+    zs.avail_out = out->size() - used;
+    ret = deflate(&zs, Z_SYNC_FLUSH);
+    used = out->size() - zs.avail_out;
+  } while (ret == Z_OK && zs.avail_out == 0);
+  out->resize(used);
+  if (ret != Z_OK) return false;
+
+  // The empty stored block ending a sync flush is left out.
+  if (used - start >= 4 &&
+      memcmp(out->data() + used - 4, "\0\0\xff\xff", 4) == 0) {
+    out->resize(used - 4);
+  }
+  return true;
+#else
+  (void)in;
+  (void)out;
+  return false;
+#endif
+}
+
+bool Deflate::Decompress(string_view in, size_t max_size, std::string* out) {
+#if CPPBOOT_HAVE_ZLIB
+  z_stream& zs = streams_->inflater;
+  if (!streams_->inflating) {
+    if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) return false;
+    streams_->inflating = true;
+  } else {
+    // The client does not carry its window from one message to the next.
+    inflateReset(&zs);
+  }
+
+  static const char kTail[] = {'\0', '\0', '\xff', '\xff'};
+  size_t start = out->size();
+  size_t used = start;
+  int ret = Z_OK;
+  for (string_view piece : {in, string_view(kTail, sizeof(kTail))}) {
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(piece.data()));
+    zs.avail_in = piece.size();
+    do {
+      out->resize(used + std::max<size_t>(16 * 1024, 2 * zs.avail_in));
+      zs.next_out = reinterpret_cast<Bytef*>(&(*out)[used]);
+      zs.avail_out = out->size() - used;
+      ret = inflate(&zs, Z_SYNC_FLUSH);
+      used = out->size() - zs.avail_out;
+      if (used - start > max_size) {
+        out->resize(used);
+        return false;
+      }
+    } while (ret == Z_OK && (zs.avail_in > 0 || zs.avail_out == 0));
+    if (ret == Z_STREAM_END) break;
+    if (ret != Z_OK && ret != Z_BUF_ERROR) break;
+  }
+  out->resize(used);
+  return ret == Z_OK || ret == Z_STREAM_END || ret == Z_BUF_ERROR;
+#else
+  (void)in;
+  (void)max_size;
+  (void)out;
+  return false;
+#endif
+}
+
+Decoder::Decoder(size_t max_message_size)
+    : max_message_size_(max_message_size),
+      deflate_(nullptr),
+      message_opcode_(kContinuation),
+      message_compressed_(false),
+      error_(0),
+      closed_(false),
+      frame_size_(0) {}
+
+size_t Decoder::Decode(char* data, size_t size, const MessageFunc& fn) {
+  size_t pos = 0;
+  frame_size_ = 0;
+  while (!closed_ && error_ == 0 && size - pos >= 2) {
+    auto p = reinterpret_cast<const uint8_t*>(data + pos);
+    size_t avail = size - pos;
+    uint8_t b0 = p[0];
+    // Clients mask every frame.
+    if (!(p[1] & 0x80)) {
+      Fail(kProtocolError);
+      break;
+    }
+
+    uint64_t length = p[1] & 0x7f;
+    size_t header = 2;
+    if (length == 126) {
+      header = 4;
+      if (avail < header) break;
+      length = p[2] << 8 | p[3];
+    } else if (length == 127) {
+      header = 10;
+      if (avail < header) break;
+      length = 0;
+      for (int i = 2; i < 10; i++) length = length << 8 | p[i];
+    }
+    header += 4;
+
+    // Check the length before waiting for the payload.
+    if ((b0 & 0x08) && length > 125) {
+      Fail(kProtocolError);
+      break;
+    }
+    if (length > max_message_size_ - message_.size()) {
+      Fail(kMessageTooBig);
+      break;
+    }
+    if (avail < header + length) {
+      frame_size_ = header + length;
+      break;
+    }
+
+    char* payload = data + pos + header;
+    if (!OnFrame(b0, payload, length, payload - 4, fn)) break;
+    pos += header + length;
+  }
+  return pos;
+}
+
+bool Decoder::OnFrame(uint8_t b0, char* payload, size_t size, const char* key,
+                      const MessageFunc& fn) {
+  bool fin = b0 & 0x80;
+  bool compressed = b0 & 0x40;
+  if (b0 & 0x30) return Fail(kProtocolError);
+
+  auto opcode = static_cast<Opcode>(b0 & 0x0f);
+  switch (opcode) {
+    case kClose:
+    case kPing:
+    case kPong:
+      if (!fin || compressed) return Fail(kProtocolError);
+      Mask(payload, payload, size, key);
+      if (opcode == kClose) {
+        closed_ = true;
+        if (size == 1) return Fail(kProtocolError);
+        if (size >= 2) {
+          auto p = reinterpret_cast<const uint8_t*>(payload);
+          if (!IsValidCloseCode(p[0] << 8 | p[1])) {
+            return Fail(kProtocolError);
+          }
+          if (!IsValidUtf8(string_view(payload + 2, size - 2))) {
+            return Fail(kInvalidPayload);
+          }
+        }
+      }
+      fn(opcode, string_view(payload, size));
+      return true;
+
+    case kText:
+    case kBinary:
+      // The previous message must be complete.
+      if (message_opcode_ != kContinuation) return Fail(kProtocolError);
+      if (compressed && !deflate_) return Fail(kProtocolError);
+      message_compressed_ = compressed;
+      if (fin) {
+        Mask(payload, payload, size, key);
+        message_opcode_ = opcode;
+        return OnMessage(string_view(payload, size), fn);
+      }
+      message_opcode_ = opcode;
+      break;
+
+    case kContinuation:
+      if (message_opcode_ == kContinuation || compressed) {
+        return Fail(kProtocolError);
+      }
+      break;
+
+    default:
+      return Fail(kProtocolError);
+  }
+
+  size_t used = message_.size();
+  message_.resize(used + size);
+  Mask(payload, &message_[used], size, key);
+  if (!fin) return true;
+
+  bool ok = OnMessage(message_, fn);
+  message_.clear();
+  if (message_.capacity() > kMaxKeptCapacity) std::string().swap(message_);
+  return ok;
+}
+
+bool Decoder::OnMessage(string_view payload, const MessageFunc& fn) {
+  Opcode opcode = message_opcode_;
+  message_opcode_ = kContinuation;
+
+  if (message_compressed_) {
+    inflated_.clear();
+    if (!deflate_->Decompress(payload, max_message_size_, &inflated_)) {
+      return Fail(inflated_.size() > max_message_size_ ? kMessageTooBig
+                                                        : kInvalidPayload);
+    }
+    payload = inflated_;
+  }
+  if (opcode == kText && !IsValidUtf8(payload)) return Fail(kInvalidPayload);
+
+  fn(opcode, payload);
+  if (inflated_.capacity() > kMaxKeptCapacity) std::string().swap(inflated_);
+  return true;
+}
+
+}  // namespace websocket
+}  // namespace http
+}  // namespace cppboot
@@ -0,0 +1,166 @@
+#ifndef CPPBOOT_NET_HTTP_WEBSOCKET_H_
+#define CPPBOOT_NET_HTTP_WEBSOCKET_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "cppboot/base/string_view.h"
+
+namespace cppboot {
+namespace http {
+
+/// The WebSocket protocol (RFC 6455) and its permessage-deflate extension
+/// (RFC 7692), without I/O.
+namespace websocket {
+
+/// Frame opcodes.
+enum Opcode {
+  kContinuation = 0x0,
+  kText = 0x1,
+  kBinary = 0x2,
+  kClose = 0x8,
+  kPing = 0x9,
+  kPong = 0xa,
+};
+
+/// Status codes of close frames.
+enum CloseCode {
+  kNormalClosure = 1000,
+  kGoingAway = 1001,
+  kProtocolError = 1002,
+  kInvalidPayload = 1007,
+  kPolicyViolation = 1008,
+  kMessageTooBig = 1009,
+  kInternalError = 1011,
+};
+
+/// The Sec-WebSocket-Accept answering the Sec-WebSocket-Key `key`.
+std::string AcceptKey(string_view key);
+
+/// XOR `size` bytes of `in` with the 4-byte masking `key` into `out`, which
+/// may be `in` to unmask in place. Works on 16 bytes at a time with SSE2 or
+/// NEON, else on 8.
+void Mask(const char* in, char* out, size_t size, const char key[4]) noexcept;
+
+/// Whether `s` is valid UTF-8, as text messages must be.
+bool IsValidUtf8(string_view s) noexcept;
+
+/// Append the header of an unmasked frame, as a server sends them, with a
+/// payload of `size` bytes. `compressed` sets RSV1, see Deflate.
+void AppendFrameHeader(Opcode opcode, bool fin, bool compressed,
+                       uint64_t size, std::string* out);
+
+/// Append a close frame with `code` and `reason`, without a payload if
+/// `code` is 0. A reason too long for a control frame is cut at the last
+/// complete UTF-8 code point.
+void AppendCloseFrame(uint16_t code, string_view reason, std::string* out);
+
+/// permessage-deflate without context takeover in either direction: every
+/// message is compressed on its own. That costs some ratio on streams of
+/// small similar messages, but no state is carried from one message to the
+/// next, so a message compressed once can be sent as is to any number of
+/// connections. The zlib streams are created on first use. Compress() and
+/// Decompress() use separate streams and may run concurrently.
+class Deflate {
+ public:
+  /// The extension parameters the server answers with.
+  static const char kResponse[];
+
+  Deflate(const Deflate&) = delete;
+  Deflate& operator=(const Deflate&) = delete;
+
+  /// Compress with the zlib `level`.
+  explicit Deflate(int level);
+  ~Deflate();
+
+  /// Whether permessage-deflate can be used, i.e. zlib is available.
+  static bool Supported() noexcept;
+
+  /// Whether the Sec-WebSocket-Extensions `offers` of a client include a
+  /// permessage-deflate we accept, i.e. whose parameters allow the ones of
+  /// kResponse.
+  static bool Accepts(string_view offers) noexcept;
+
+  /// Append the compressed payload of the message `in` to `out`.
+  bool Compress(string_view in, std::string* out);
+
+  /// Append the decompressed message `in` to `out`, false if it is corrupt
+  /// or would grow `out` past `max_size`.
+  bool Decompress(string_view in, size_t max_size, std::string* out);
+
+ private:
+  struct Streams;
+
+  int level_;
+  std::unique_ptr<Streams> streams_;
+};
+
+/// Decodes the frames a client sends to a server. Complete frames are
+/// unmasked in place in the read buffer, so a message sent in one frame is
+/// delivered without being copied. The fragments of a message are unmasked
+/// while they are appended to it, which is the only copy they get.
+class Decoder {
+ public:
+  /// Called with each text or binary message, and with each ping, pong and
+  /// close frame. The payload is valid during the call.
+  typedef std::function<void(Opcode opcode, string_view payload)> MessageFunc;
+
+  Decoder(const Decoder&) = delete;
+  Decoder& operator=(const Decoder&) = delete;
+
+  /// Fail messages larger than `max_message_size` with kMessageTooBig.
+  explicit Decoder(size_t max_message_size);
+
+  /// Decompress the messages flagged compressed with `deflate`, without it
+  /// they are a protocol error.
+  void set_deflate(Deflate* deflate) noexcept { deflate_ = deflate; }
+
+  /// Decode the complete frames at the start of `data` and call `fn` for
+  /// each message and control frame, up to a close frame. Returns the number
+  /// of bytes consumed, the rest is the start of a frame to be passed again
+  /// with more bytes.
+  size_t Decode(char* data, size_t size, const MessageFunc& fn);
+
+  /// The close code of the protocol violation Decode() stopped at, else 0.
+  uint16_t error() const noexcept { return error_; }
+
+  /// Size of the incomplete frame left by Decode(), 0 until its header has
+  /// arrived. The read buffer has to hold it all.
+  size_t frame_size() const noexcept { return frame_size_; }
+
+ private:
+  /// Handle the frame with `payload`, false on an error.
+  bool OnFrame(uint8_t b0, char* payload, size_t size, const char* key,
+               const MessageFunc& fn);
+
+  /// Deliver the complete message `payload`.
+  bool OnMessage(string_view payload, const MessageFunc& fn);
+
+  bool Fail(uint16_t code) {
+    error_ = code;
+    return false;
+  }
+
+  size_t max_message_size_;
+  Deflate* deflate_;
+
+  /// The fragmented message being received, its opcode and whether it is
+  /// compressed.
+  std::string message_;
+  Opcode message_opcode_;
+  bool message_compressed_;
+
+  std::string inflated_;
+  uint16_t error_;
+  bool closed_;
+  size_t frame_size_;
+};
+
+}  // namespace websocket
+}  // namespace http
+}  // namespace cppboot
+
+#endif  // CPPBOOT_NET_HTTP_WEBSOCKET_H_
@@ -0,0 +1,251 @@
+#include "gmock/gmock.h"
+
+#include "cppboot/net/http/websocket.h"
+
+namespace {
+
+namespace websocket = cppboot::http::websocket;
+
+using cppboot::string_view;
+
+/// A frame as a client sends it, masked with a fixed key.
+std::string ClientFrame(int b0, const std::string& payload) {
+  std::string frame;
+  websocket::AppendFrameHeader(static_cast<websocket::Opcode>(b0 & 0x0f),
+                               b0 & 0x80, b0 & 0x40, payload.size(), &frame);
+  frame[0] = static_cast<char>(b0);
+  frame[1] = static_cast<char>(frame[1] | 0x80);
+  const char key[4] = {'\x12', '\x34', '\x56', '\x78'};
+  frame.append(key, 4);
+  size_t start = frame.size();
+  frame.resize(start + payload.size());
+  websocket::Mask(payload.data(), &frame[start], payload.size(), key);
+  return frame;
+}
+
+typedef std::vector<std::pair<int, std::string>> Messages;
+
+/// Decode `input` fed `step` bytes at a time.
+Messages Decode(websocket::Decoder* decoder, const std::string& input,
+                size_t step = std::string::npos) {
+  Messages messages;
+  std::string buffer;
+  for (size_t pos = 0; pos < input.size(); pos += step) {
+    buffer.append(input, pos, step);
+    size_t n = decoder->Decode(
+        &buffer[0], buffer.size(),
+        [&](websocket::Opcode opcode, string_view payload) {
+          messages.emplace_back(opcode, payload.str());
+        });
+    buffer.erase(0, n);
+    if (decoder->error()) break;
+    if (step == std::string::npos) break;
+  }
+  return messages;
+}
+
+TEST(WebSocket, AcceptKey) {
+  // RFC 6455 section 1.3.
+  ASSERT_EQ(websocket::AcceptKey("dGhlIHNhbXBsZSBub25jZQ=="),
+            "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+}
+
+TEST(WebSocket, Mask) {
+  const char key[4] = {'\x01', '\x80', '\x7f', '\xff'};
+  std::string in;
+  for (int i = 0; i < 300; i++) in.push_back(static_cast<char>(i * 7));
+
+  for (size_t offset = 0; offset < 3; offset++) {
+    for (size_t size = 0; size + offset <= in.size(); size += 13) {
+      std::string out(size + 1, '\0');
+      websocket::Mask(in.data() + offset, &out[1], size, key);
+      for (size_t i = 0; i < size; i++) {
+        ASSERT_EQ(out[i + 1], static_cast<char>(in[offset + i] ^ key[i % 4]))
+            << offset << " " << size << " " << i;
+      }
+
+      // In place, and back.
+      std::string copy = in.substr(offset, size);
+      websocket::Mask(&copy[0], &copy[0], size, key);
+      ASSERT_EQ(copy, out.substr(1));
+      websocket::Mask(&copy[0], &copy[0], size, key);
+      ASSERT_EQ(copy, in.substr(offset, size));
+    }
+  }
+}
+
+TEST(WebSocket, Utf8) {
+  ASSERT_TRUE(websocket::IsValidUtf8(""));
+  ASSERT_TRUE(websocket::IsValidUtf8("plain ascii, long enough for words"));
+  ASSERT_TRUE(websocket::IsValidUtf8("\xc3\xa9t\xc3\xa9 \xe2\x82\xac "
+                                     "\xf0\x9f\x98\x80"));
+  ASSERT_FALSE(websocket::IsValidUtf8("\xc3"));
+  ASSERT_FALSE(websocket::IsValidUtf8("abcdefgh\x80"));
+  // Overlong, surrogate, past U+10FFFF.
+  ASSERT_FALSE(websocket::IsValidUtf8("\xc0\xaf"));
+  ASSERT_FALSE(websocket::IsValidUtf8("\xed\xa0\x80"));
+  ASSERT_FALSE(websocket::IsValidUtf8("\xf4\x90\x80\x80"));
+}
+
+TEST(WebSocket, FrameHeader) {
+  std::string out;
+  websocket::AppendFrameHeader(websocket::kText, true, false, 5, &out);
+  ASSERT_EQ(out, std::string("\x81\x05"));
+
+  out.clear();
+  websocket::AppendFrameHeader(websocket::kBinary, true, true, 256, &out);
+  ASSERT_EQ(out, std::string("\xc2\x7e\x01\x00", 4));
+
+  out.clear();
+  websocket::AppendFrameHeader(websocket::kBinary, false, false, 65536, &out);
+  ASSERT_EQ(out, std::string("\x02\x7f\x00\x00\x00\x00\x00\x01\x00\x00", 10));
+
+  out.clear();
+  websocket::AppendCloseFrame(1000, "bye", &out);
+  ASSERT_EQ(out, std::string("\x88\x05\x03\xe8" "bye", 7));
+
+  // 122 bytes then a 3 byte code point, which does not fit.
+  out.clear();
+  std::string reason = std::string(122, 'a') + "\xe2\x82\xac";
+  websocket::AppendCloseFrame(1000, reason, &out);
+  ASSERT_EQ(out, std::string("\x88\x7c\x03\xe8", 4) + std::string(122, 'a'));
+}
+
+TEST(WebSocket, Decode) {
+  std::string input = ClientFrame(0x81, "hello") +
+                      ClientFrame(0x02, std::string(200, 'a')) +
+                      ClientFrame(0x89, "ping") +
+                      ClientFrame(0x00, std::string(70000, 'b')) +
+                      ClientFrame(0x80, "c") + ClientFrame(0x8a, "") +
+                      ClientFrame(0x88, "\x03\xe8" "done");
+  Messages expected = {
+      {websocket::kText, "hello"},
+      {websocket::kPing, "ping"},
+      {websocket::kBinary,
+       std::string(200, 'a') + std::string(70000, 'b') + "c"},
+      {websocket::kPong, ""},
+      {websocket::kClose, "\x03\xe8" "done"},
+  };
+
+  for (size_t step : {std::string::npos, size_t(1), size_t(1000)}) {
+    websocket::Decoder decoder(1024 * 1024);
+    ASSERT_EQ(Decode(&decoder, input, step), expected) << step;
+    ASSERT_EQ(decoder.error(), 0);
+  }
+
+  // Whole frames are consumed, the size of the next one is known once its
+  // header is in.
+  websocket::Decoder decoder(1024 * 1024);
+  std::string partial = ClientFrame(0x81, "x") + ClientFrame(0x82, "12345");
+  size_t n = decoder.Decode(&partial[0], partial.size() - 2,
+                            [](websocket::Opcode, string_view) {});
+  ASSERT_EQ(n, 7);
+  ASSERT_EQ(decoder.frame_size(), 11);
+
+  // Nothing is read past a close frame.
+  std::string closed = ClientFrame(0x88, "") + ClientFrame(0x81, "late");
+  Messages messages = Decode(&decoder, closed);
+  ASSERT_EQ(messages.size(), 1);
+  ASSERT_EQ(messages[0].first, websocket::kClose);
+}
+
+TEST(WebSocket, DecodeErrors) {
+  struct {
+    std::string input;
+    int error;
+  } cases[] = {
+      // Not masked.
+      {std::string("\x81\x01x", 3), websocket::kProtocolError},
+      // Reserved bits, unknown opcode.
+      {ClientFrame(0x91, "x"), websocket::kProtocolError},
+      {ClientFrame(0x83, "x"), websocket::kProtocolError},
+      // Compressed without the extension.
+      {ClientFrame(0xc1, "x"), websocket::kProtocolError},
+      // Fragmented or long control frames.
+      {ClientFrame(0x09, "x"), websocket::kProtocolError},
+      {ClientFrame(0x89, std::string(126, 'x')), websocket::kProtocolError},
+      // Continuation of nothing, new message before the last one ended.
+      {ClientFrame(0x80, "x"), websocket::kProtocolError},
+      {ClientFrame(0x01, "x") + ClientFrame(0x81, "y"),
+       websocket::kProtocolError},
+      // Too big, detected before the payload arrives.
+      {ClientFrame(0x82, std::string(1001, 'x')).substr(0, 8),
+       websocket::kMessageTooBig},
+      {ClientFrame(0x02, std::string(600, 'x')) +
+           ClientFrame(0x80, std::string(600, 'x')),
+       websocket::kMessageTooBig},
+      // Text is UTF-8.
+      {ClientFrame(0x81, "\xff"), websocket::kInvalidPayload},
+      {ClientFrame(0x01, "\xe2\x82") + ClientFrame(0x80, "\xac"), 0},
+      // Close frames.
+      {ClientFrame(0x88, "\x03"), websocket::kProtocolError},
+      {ClientFrame(0x88, "\x03\xed"), websocket::kProtocolError},
+      {ClientFrame(0x88, "\x03\xe8\xff"), websocket::kInvalidPayload},
+  };
+
+  for (auto& c : cases) {
+    websocket::Decoder decoder(1000);
+    Decode(&decoder, c.input);
+    ASSERT_EQ(decoder.error(), c.error) << c.input;
+  }
+}
+
+TEST(WebSocket, Deflate) {
+  if (!websocket::Deflate::Supported()) return;
+
+  ASSERT_TRUE(websocket::Deflate::Accepts("permessage-deflate"));
+  ASSERT_TRUE(websocket::Deflate::Accepts(
+      "permessage-deflate; client_max_window_bits"));
+  ASSERT_TRUE(websocket::Deflate::Accepts(
+      "x-webkit-deflate-frame, permessage-deflate; "
+      "server_no_context_takeover; client_max_window_bits=\"10\""));
+  ASSERT_FALSE(websocket::Deflate::Accepts(
+      "permessage-deflate; server_max_window_bits=10"));
+  ASSERT_FALSE(websocket::Deflate::Accepts("permessage-deflate; unknown"));
+  ASSERT_FALSE(websocket::Deflate::Accepts(
+      "permessage-deflate; client_no_context_takeover; "
+      "client_no_context_takeover"));
+  ASSERT_FALSE(websocket::Deflate::Accepts("x-webkit-deflate-frame"));
+
+  std::string text;
+  for (int i = 0; i < 1000; i++) text += "message " + std::to_string(i % 10);
+
+  websocket::Deflate deflate(6);
+  std::string compressed;
+  ASSERT_TRUE(deflate.Compress(text, &compressed));
+  ASSERT_LT(compressed.size(), text.size() / 10);
+
+  // Each message stands alone.
+  std::string again;
+  ASSERT_TRUE(deflate.Compress(text, &again));
+  ASSERT_EQ(again, compressed);
+
+  std::string out;
+  ASSERT_TRUE(deflate.Decompress(compressed, text.size(), &out));
+  ASSERT_EQ(out, text);
+  out.clear();
+  ASSERT_FALSE(deflate.Decompress(compressed, text.size() - 1, &out));
+  out.clear();
+  ASSERT_FALSE(deflate.Decompress("\xff\xff\xff", 1000, &out));
+
+  // Compressed messages, fragmented or not.
+  websocket::Decoder decoder(text.size());
+  decoder.set_deflate(&deflate);
+  std::string input =
+      ClientFrame(0xc1, compressed) +
+      ClientFrame(0x41, compressed.substr(0, 10)) +
+      ClientFrame(0x80, compressed.substr(10)) + ClientFrame(0x82, "raw");
+  Messages messages = Decode(&decoder, input, 7);
+  ASSERT_EQ(decoder.error(), 0);
+  ASSERT_EQ(messages, Messages({{websocket::kText, text},
+                                {websocket::kText, text},
+                                {websocket::kBinary, "raw"}}));
+
+  // Too big once inflated.
+  websocket::Decoder small(text.size() - 1);
+  small.set_deflate(&deflate);
+  Decode(&small, ClientFrame(0xc1, compressed));
+  ASSERT_EQ(small.error(), websocket::kMessageTooBig);
+}
+
+}  // namespace
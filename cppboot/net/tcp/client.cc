@@ -1,4 +1,5 @@
 #include "cppboot/net/tcp/client.h"
+#include "cppboot/net/dns_cache.h"
 #include "cppboot/net/tcp/connection.h"
 
 namespace cppboot {
@@ -10,10 +11,11 @@ TcpClient::~TcpClient() { Stop(); }
 
 Status TcpClient::Connect(const std::string& address, const std::string& port) {
   try {
-    asio::ip::tcp::resolver resolver(io_context_);
-    auto endpoints = resolver.resolve(address, port);
+    DnsCache::EndpointsPtr endpoints;
+    auto st = DnsCache::Default().Resolve(address, port, &endpoints);
+    if (!st) return st;
     asio::ip::tcp::socket socket(io_context_);
-    asio::connect(socket, endpoints);
+    asio::connect(socket, *endpoints);
 
     conn_ = std::make_shared<TcpConn>(std::move(socket));
     conn_->set_conn_callback(conn_callback_);
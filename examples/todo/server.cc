@@ -1,21 +1,24 @@
+#include <memory>
 #include <string>
 
 #include "cppboot/base/fmt.h"
+#include "cppboot/base/json.h"
 #include "cppboot/base/status.h"
 #include "cppboot/base/str_util.h"
+#include "cppboot/net/html/template.h"
 #include "cppboot/net/http/server.h"
 
 #include "cppboot/adv/args.h"
 
 #include "core.h"
-#include "ui.h"
+#include "todo_templates.h"
 
 cppboot::Status do_add(const char* text);
-std::string do_list(void);
+cppboot::json do_list(void);
 void do_delete(int id);
 void do_modify(int id, const char* new_text);
 
-void DoCommand(HtmlUi& ui, const std::string& cmdline) {
+void DoCommand(const std::string& cmdline) {
   auto sep = cmdline.find_first_of(' ');
 
   if (sep != std::string::npos) {
@@ -29,30 +32,40 @@ void DoCommand(HtmlUi& ui, const std::string& cmdline) {
 }
 
 int main(int argc, char* argv[]) {
-  using cppboot::html::Element;
+  using cppboot::html::TemplateSet;
   using cppboot::http::Request;
   using cppboot::http::Response;
 
   cppboot::Args args;
 
   args.AddLong('p', "port", 12345, "Listen port");
+  args.AddString('t', "templates", "",
+                 "Read the templates from this directory, reloading them "
+                 "when they change");
 
   auto st = args.Parse(argc, argv);
   if (!st) {
     cppboot::println("{}", st);
   }
 
-  cppboot::http::Server server;
-  server.Handle("/todo", [](const Request& req, Response* resp) {
-    HtmlUi ui;
+  // Embedded unless developing them.
+  std::string dir = args.GetString("templates");
+  std::unique_ptr<TemplateSet> templates(
+      dir.empty() ? new TemplateSet(cppboot::embedded::todo_templates())
+                  : new TemplateSet(dir, true));
 
-    auto cmd = req.Param("cmd");
+  cppboot::http::Server server;
+  server.Handle("/todo", [&templates](const Request& req, Response* resp) {
+    auto cmd = req.Param("cmd").str();
     if (!cmd.empty()) {
-      ui.set_cmd(cmd);
-      DoCommand(ui, cmd);
+      DoCommand(cmd);
     }
 
-    resp->WriteHtml(Response::ok, ui.doc().Dump());
+    cppboot::json page = {{"cmd", cmd}, {"items", do_list()}};
+    resp->status = Response::ok;
+    resp->set_header("Content-Type", "text/html");
+    auto st = templates->Render("todo.html", page, &resp->content);
+    if (!st) resp->WriteText(Response::internal_server_error, st.ToString());
   });
 
   auto port = std::to_string(args.GetLong("port"));
@@ -73,8 +86,8 @@ cppboot::Status do_add(const char* text) {
   return cppboot::InvalidArgumentError("can't open respository");
 }
 
-std::string do_list(void) {
-  std::string result;
+cppboot::json do_list(void) {
+  cppboot::json result = cppboot::json::array();
 
   auto repo = todo::CreateFileRepository("/tmp/todo-data.json");
   if (repo) {
@@ -82,7 +95,7 @@ std::string do_list(void) {
     data.set_repository(repo);
     auto items = data.items();
     for (auto item : items) {
-      result += cppboot::format("<p>{}\t{}</p>", item->id, item->text);
+      result.push_back({{"id", item->id}, {"text", item->text}});
     }
   }
   return result;